@@ -32,22 +32,25 @@ __global__ void Ptensors0_reduce0_kernel(float* rarr, const int* rdir, const flo
 }
 
 
-__global__ void Ptensors0_reduce0_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const int* xiarr, const int* xidir, const int n){
+template<typename IXREADER>
+__global__ void Ptensors0_reduce0_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const IXREADER xi, const int n){
   const int b=blockIdx.x;
   const int c=threadIdx.x;
-  const int src=xiarr[xidir[2*b]];
+  const int src=xi.tens(b);
   rarr[rdir[2*b]+c]+=xarr[xdir[2*src]+c];
 }
 
 
-__global__ void Ptensors0_broadcast0_kernel(float* xarr, const int* xdir, const float* rarr, const int* rdir){
+__global__ void Ptensors0_broadcast0_kernel(float* xarr, const int* xdir, const float* rarr, const int* rdir, const bool assign){
   const int i=blockIdx.x;
   const int c=threadIdx.x;
-  xarr[xdir[2*i]+c]+=rarr[rdir[2*i]+c];
+  if(assign) xarr[xdir[2*i]+c]=rarr[rdir[2*i]+c];
+  else xarr[xdir[2*i]+c]+=rarr[rdir[2*i]+c];
 }
 
 
-__global__ void Ptensors0_broadcast0_kernel(float* xarr, const int* xdir, const int* xiarr, const int* xidir, const float* rarr, const int* rdir, const int* bmap){
+template<typename IXREADER>
+__global__ void Ptensors0_broadcast0_kernel(float* xarr, const int* xdir, const IXREADER xi, const float* rarr, const int* rdir, const int* bmap){
   const int b=blockIdx.x;
   const int c=threadIdx.x;
   const int boffs=bmap[3*b];
@@ -144,16 +147,17 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     if(R.size()==0) return;
-    Ptensors0_reduce0_kernel<<<R.size(),n,0,stream>>>(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),n);
+    list.with_reader([&](const auto& xi){
+      Ptensors0_reduce0_kernel<<<R.size(),n,0,stream>>>(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),xi,n);});
   }
 
-  void Ptensors0_broadcast0_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, const int offs, const cudaStream_t& stream){
+  void Ptensors0_broadcast0_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, const int offs, const cudaStream_t& stream, const bool assign){
     int dev=R.dev;
     PTENS_ASSRT(R.dev==1);
     PTENS_ASSRT(x.dev==1);
     if(R.size()==0) return;
     Ptensors0_broadcast0_kernel<<<R.size(),x.nc,0,stream>>>
-      (x.arrg+offs,x.dir.garr(dev),R.arrg,R.dir.garr(dev));
+      (x.arrg+offs,x.dir.garr(dev),R.arrg,R.dir.garr(dev),assign);
   }
 
   void Ptensors0_broadcast0_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, const AindexPack& list, const int offs, const cudaStream_t& stream){
@@ -162,8 +166,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     if(list.get_bmap().n==0) return;
     const_cast<AindexPack&>(list).to_device(1);
-    Ptensors0_broadcast0_kernel<<<list.get_bmap().n,R.nc,0,stream>>>
-      (x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),R.arrg,R.dir.garr(dev),list.get_barr(1));
+    list.with_reader([&](const auto& xi){
+      Ptensors0_broadcast0_kernel<<<list.get_bmap().n,R.nc,0,stream>>>
+	(x.arrg+offs,x.dir.garr(dev),xi,R.arrg,R.dir.garr(dev),list.get_barr(1));});
   }
 
   void Ptensors0_gather_cu(cnine::RtensorPackB& r, const cnine::RtensorPackB& x, const cnine::CSRmatrix<float>& gmap, const cudaStream_t& stream){
@@ -24,17 +24,6 @@ must be accompanied by a verbatim copy of the license.
 #include "AindexPack.hpp"
 
 
-__forceinline__ __device__ int load_indices(int* ix, const int* xiarr, const int* xidir, const int q){
-  int offs=xidir[2*q];
-  int n=xidir[2*q+1];
-  int t=threadIdx.x;
-  if(t<n){
-    ix[t]=xiarr[offs+t];
-  }
-  return n-1;
-}
-
-
 // ---- mprod ------------------------------------------------------------------------------------------------
 
 
@@ -118,12 +107,13 @@ __global__ void Ptensors1_reduce0n_kernel(float* rarr, const int* rdir, const fl
 }
 
 
-__global__ void Ptensors1_reduce0_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const int* xiarr, const int* xidir, const int n){
+template<typename IXREADER>
+__global__ void Ptensors1_reduce0_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const IXREADER xi, const int n){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
   const int q=blockIdx.x;
   const int c=threadIdx.x;
-  const int k=load_indices(ix,xiarr,xidir,q);
+  const int k=xi.load(ix,q);
   __syncthreads();
   const int nc=xdir[2];
   if(c>=n) return;
@@ -136,12 +126,13 @@ __global__ void Ptensors1_reduce0_kernel(float* rarr, const int* rdir, const flo
 }
 
 
-__global__ void Ptensors1_reduce0n_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const int* xiarr, const int* xidir, const int n){
+template<typename IXREADER>
+__global__ void Ptensors1_reduce0n_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const IXREADER xi, const int n){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
   const int q=blockIdx.x;
   const int c=threadIdx.x;
-  const int k=load_indices(ix,xiarr,xidir,q);
+  const int k=xi.load(ix,q);
   __syncthreads();
   const int nc=xdir[2];
   if(c>=n) return;
@@ -169,12 +160,13 @@ __global__ void Ptensors1_reduce1_kernel(float* rarr, const int* rdir, const flo
 }
 
 
-__global__ void Ptensors1_reduce1_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const int* xiarr, const int* xidir, const int n){
+template<typename IXREADER>
+__global__ void Ptensors1_reduce1_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const IXREADER xi, const int n){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
   const int q=blockIdx.x;
   const int c=threadIdx.x;
-  const int k=load_indices(ix,xiarr,xidir,q);
+  const int k=xi.load(ix,q);
   __syncthreads();
   const int nc=xdir[2];
   const int rnc=rdir[2];
@@ -190,7 +182,7 @@ __global__ void Ptensors1_reduce1_kernel(float* rarr, const int* rdir, const flo
 // ---- Broadcast --------------------------------------------------------------------------------------------
 
 
-__global__ void Ptensors1_broadcast0_kernel(float* xarr, const int* xdir, const float* rarr, const int* rdir){
+__global__ void Ptensors1_broadcast0_kernel(float* xarr, const int* xdir, const float* rarr, const int* rdir, const bool assign){
   const int q=blockIdx.x;
   const int c=threadIdx.x;
   const int k=xdir[3*q+1];
@@ -200,6 +192,11 @@ __global__ void Ptensors1_broadcast0_kernel(float* xarr, const int* xdir, const
 
   float* x=xarr+xdir[3*q]+c;
   const float t=rarr[rdir[2*q]+c];
+  if(assign){
+    for(int i=0; i<k; i++)
+      x[i*nc]=t;
+    return;
+  }
   for(int i=0; i<k; i++)
     x[i*nc]+=t;
 }
@@ -220,7 +217,8 @@ __global__ void Ptensors1_broadcast0n_kernel(float* xarr, const int* xdir, const
 }
 
 
-__global__ void Ptensors1_broadcast0_kernel(float* xarr, const int* xdir, const int* xiarr, const int* xidir, 
+template<typename IXREADER>
+__global__ void Ptensors1_broadcast0_kernel(float* xarr, const int* xdir, const IXREADER xi, 
   const float* rarr, const int* rdir, const int* bmap){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
@@ -240,7 +238,7 @@ __global__ void Ptensors1_broadcast0_kernel(float* xarr, const int* xdir, const
   for(int s=0; s<N; s++){
     const int src=bmap[boffs+2*s];
     //if(c==0) printf("%d %d %d\n",b,s,src);
-    const int k=load_indices(ix,xiarr,xidir,src);
+    const int k=xi.load(ix,src);
     __syncthreads();
     if(c>=rnc) continue;
     float t=rarr[rdir[2*src]+c];
@@ -254,7 +252,8 @@ __global__ void Ptensors1_broadcast0_kernel(float* xarr, const int* xdir, const
 }
 
 
-__global__ void Ptensors1_broadcast0n_kernel(float* xarr, const int* xdir, const int* xiarr, const int* xidir, 
+template<typename IXREADER>
+__global__ void Ptensors1_broadcast0n_kernel(float* xarr, const int* xdir, const IXREADER xi, 
   const float* rarr, const int* rdir, const int* bmap){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
@@ -274,7 +273,7 @@ __global__ void Ptensors1_broadcast0n_kernel(float* xarr, const int* xdir, const
   for(int s=0; s<N; s++){
     const int src=bmap[boffs+2*s];
     //if(c==0) printf("%d %d %d\n",b,s,src);
-    const int k=load_indices(ix,xiarr,xidir,src);
+    const int k=xi.load(ix,src);
     __syncthreads();
     if(c>=rnc) continue;
     float t=rarr[rdir[2*src]+c]/k;
@@ -288,7 +287,7 @@ __global__ void Ptensors1_broadcast0n_kernel(float* xarr, const int* xdir, const
 }
 
 
-__global__ void Ptensors1_broadcast1_kernel(float* xarr, const int* xdir, const float* rarr, const int* rdir){
+__global__ void Ptensors1_broadcast1_kernel(float* xarr, const int* xdir, const float* rarr, const int* rdir, const bool assign){
   const int q=blockIdx.x;
   const int c=threadIdx.x;
   const int k=xdir[3*q+1];
@@ -298,12 +297,18 @@ __global__ void Ptensors1_broadcast1_kernel(float* xarr, const int* xdir, const
 
   float* x=xarr+xdir[3*q]+c;
   const float* r=rarr+rdir[3*q]+c;
+  if(assign){
+    for(int i=0; i<k; i++)
+      x[i*nc]=r[i*rnc];
+    return;
+  }
   for(int i=0; i<k; i++)
     x[i*nc]+=r[i*rnc];
 }
 
 
-__global__ void Ptensors1_broadcast1_kernel(float* xarr, const int* xdir, const int* xiarr, const int* xidir, 
+template<typename IXREADER>
+__global__ void Ptensors1_broadcast1_kernel(float* xarr, const int* xdir, const IXREADER xi, 
   const float* rarr, const int* rdir, const int* bmap){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
@@ -320,7 +325,7 @@ __global__ void Ptensors1_broadcast1_kernel(float* xarr, const int* xdir, const
   float* x=xarr+xdir[3*target]+c;
   for(int s=0; s<N; s++){
     const int src=bmap[boffs+2*s];
-    const int k=load_indices(ix,xiarr,xidir,src);
+    const int k=xi.load(ix,src);
     __syncthreads();
     //if(c>=rnc) return;
     if(c>=rnc) continue; // changed 
@@ -489,8 +494,9 @@ namespace ptens{
     const_cast<AindexPack&>(list).to_device(1);
     PTENS_ASSRT(list.dev==1);
     const int nthrd=cnine::roundup(std::max(n,list.max_nix()+1),32);
-    Ptensors1_reduce0_kernel<<<list.size(),nthrd,(list.max_nix()+1)*4,stream>>>
-      (R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),n);
+    list.with_reader([&](const auto& xi){
+      Ptensors1_reduce0_kernel<<<list.size(),nthrd,(list.max_nix()+1)*4,stream>>>
+	(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),xi,n);});
   }
 
   void Ptensors1_reduce0n_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, 
@@ -502,8 +508,9 @@ namespace ptens{
     const_cast<AindexPack&>(list).to_device(1);
     PTENS_ASSRT(list.dev==1);
     const int nthrd=cnine::roundup(std::max(n,list.max_nix()+1),32);
-    Ptensors1_reduce0n_kernel<<<list.size(),nthrd,(list.max_nix()+1)*4,stream>>>
-      (R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),n);
+    list.with_reader([&](const auto& xi){
+      Ptensors1_reduce0n_kernel<<<list.size(),nthrd,(list.max_nix()+1)*4,stream>>>
+	(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),xi,n);});
   }
 
 
@@ -526,20 +533,21 @@ namespace ptens{
     const_cast<AindexPack&>(list).to_device(1);
     PTENS_ASSRT(list.dev==1);
     const int nthrd=cnine::roundup(std::max(n,list.max_nix()+1),32);
-    Ptensors1_reduce1_kernel<<<list.size(),nthrd,(list.max_nix()+1)*4,stream>>>
-      (R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),n);
+    list.with_reader([&](const auto& xi){
+      Ptensors1_reduce1_kernel<<<list.size(),nthrd,(list.max_nix()+1)*4,stream>>>
+	(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),xi,n);});
   }
 
 
 
   void Ptensors1_broadcast0_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, 
-    const int offs, const cudaStream_t& stream){
+    const int offs, const cudaStream_t& stream, const bool assign){
     int dev=R.dev;
     PTENS_ASSRT(R.dev==1);
     PTENS_ASSRT(x.dev==1);
     if(R.size()==0) return;
     int n=R.nc; 
-    Ptensors1_broadcast0_kernel<<<R.size(),n,0,stream>>>(x.arrg+offs,x.dir.garr(dev),R.arrg,R.dir.garr(dev));
+    Ptensors1_broadcast0_kernel<<<R.size(),n,0,stream>>>(x.arrg+offs,x.dir.garr(dev),R.arrg,R.dir.garr(dev),assign);
   }
 
   void Ptensors1_broadcast0n_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, 
@@ -561,8 +569,9 @@ namespace ptens{
     const_cast<AindexPack&>(list).to_device(1);
     PTENS_ASSRT(list.dev==1);
     int n=cnine::roundup(std::max(R.nc,list.max_nix()+1),32);
-    Ptensors1_broadcast0_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>> 
-      (x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),R.arrg,R.dir.garr(dev),list.get_barr(1)); // 32 or 128
+    list.with_reader([&](const auto& xi){
+      Ptensors1_broadcast0_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
+	(x.arrg+offs,x.dir.garr(dev),xi,R.arrg,R.dir.garr(dev),list.get_barr(1));}); // 32 or 128
   }
 
   void Ptensors1_broadcast0n_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, const AindexPack& list, 
@@ -574,20 +583,21 @@ namespace ptens{
     const_cast<AindexPack&>(list).to_device(1);
     PTENS_ASSRT(list.dev==1);
     int n=cnine::roundup(std::max(R.nc,list.max_nix()+1),32);
-    Ptensors1_broadcast0n_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>> 
-      (x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),R.arrg,R.dir.garr(dev),list.get_barr(1)); // 32 or 128
+    list.with_reader([&](const auto& xi){
+      Ptensors1_broadcast0n_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
+	(x.arrg+offs,x.dir.garr(dev),xi,R.arrg,R.dir.garr(dev),list.get_barr(1));}); // 32 or 128
   }
 
 
 
   void Ptensors1_broadcast1_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, 
-    const int offs, const cudaStream_t& stream){
+    const int offs, const cudaStream_t& stream, const bool assign){
     int dev=R.dev;
     PTENS_ASSRT(R.dev==1);
     PTENS_ASSRT(x.dev==1);
     if(R.size()==0) return;
     int n=R.nc;
-    Ptensors1_broadcast1_kernel<<<R.size(),n,0,stream>>>(x.arrg+offs,x.dir.garr(dev),R.arrg,R.dir.garr(dev));
+    Ptensors1_broadcast1_kernel<<<R.size(),n,0,stream>>>(x.arrg+offs,x.dir.garr(dev),R.arrg,R.dir.garr(dev),assign);
   }
 
   void Ptensors1_broadcast1_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, const AindexPack& list, 
@@ -599,8 +609,9 @@ namespace ptens{
     const_cast<AindexPack&>(list).to_device(1);
     PTENS_ASSRT(list.dev==1);
     int n=cnine::roundup(std::max(R.nc,list.max_nix()+1),32); // here??
-    Ptensors1_broadcast1_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
-      (x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),R.arrg,R.dir.garr(dev),list.get_barr(1));
+    list.with_reader([&](const auto& xi){
+      Ptensors1_broadcast1_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
+	(x.arrg+offs,x.dir.garr(dev),xi,R.arrg,R.dir.garr(dev),list.get_barr(1));});
   }
 
 
@@ -24,17 +24,6 @@ must be accompanied by a verbatim copy of the license.
 #include "AindexPack.hpp"
 
 
-__forceinline__ __device__ int load_indices(int* ix, const int* xiarr, const int* xidir, const int q){
-  int offs=xidir[2*q];
-  int n=xidir[2*q+1];
-  int t=threadIdx.x;
-  if(t<n){
-    ix[t]=xiarr[offs+t];
-  }
-  return n-1;
-}
-
-
 // ---- Reduce -----------------------------------------------------------------------------------------------
 
 
@@ -96,12 +85,13 @@ __global__ void Ptensors2_reduce0B_kernel(float* rarr, const int* rdir, const fl
 }
 
 
-__global__ void Ptensors2_reduce0_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const int* xiarr, const int* xidir, const int n){
+template<typename IXREADER>
+__global__ void Ptensors2_reduce0_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const IXREADER xi, const int n){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
   const int b=blockIdx.x;
   const int c=threadIdx.x;
-  const int k=load_indices(ix,xiarr,xidir,b);
+  const int k=xi.load(ix,b);
   __syncthreads();
   const int _k=xdir[4*ix[0]+1];
   const int nc=xdir[3];
@@ -120,12 +110,13 @@ __global__ void Ptensors2_reduce0_kernel(float* rarr, const int* rdir, const flo
 }
 
 
-__global__ void Ptensors2_reduce0n_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const int* xiarr, const int* xidir, const int n){
+template<typename IXREADER>
+__global__ void Ptensors2_reduce0n_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const IXREADER xi, const int n){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
   const int b=blockIdx.x;
   const int c=threadIdx.x;
-  const int k=load_indices(ix,xiarr,xidir,b);
+  const int k=xi.load(ix,b);
   __syncthreads();
   const int _k=xdir[4*ix[0]+1];
   const int nc=xdir[3];
@@ -145,12 +136,13 @@ __global__ void Ptensors2_reduce0n_kernel(float* rarr, const int* rdir, const fl
 
 
 // contracting version
-__global__ void Ptensors2_reduce0B_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const int* xiarr, const int* xidir, const int n){
+template<typename IXREADER>
+__global__ void Ptensors2_reduce0B_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const IXREADER xi, const int n){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
   const int b=blockIdx.x;
   const int c=threadIdx.x;
-  const int k=load_indices(ix,xiarr,xidir,b);
+  const int k=xi.load(ix,b);
   __syncthreads();
   const int _k=xdir[4*ix[0]+1];
   const int nc=xdir[3];
@@ -250,12 +242,13 @@ __global__ void Ptensors2_reduce1B_kernel(float* rarr, const int* rdir, const fl
 }
 
 
-__global__ void Ptensors2_reduce1_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const int* xiarr, const int* xidir, const int n){
+template<typename IXREADER>
+__global__ void Ptensors2_reduce1_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const IXREADER xi, const int n){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
   const int b=blockIdx.x;
   const int c=threadIdx.x;
-  const int k=load_indices(ix,xiarr,xidir,b);
+  const int k=xi.load(ix,b);
   __syncthreads();
   const int _k=xdir[4*ix[0]+1];
   const int nc=xdir[3];
@@ -281,12 +274,13 @@ __global__ void Ptensors2_reduce1_kernel(float* rarr, const int* rdir, const flo
 }
 
 
-__global__ void Ptensors2_reduce1n_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const int* xiarr, const int* xidir, const int n){
+template<typename IXREADER>
+__global__ void Ptensors2_reduce1n_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const IXREADER xi, const int n){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
   const int b=blockIdx.x;
   const int c=threadIdx.x;
-  const int k=load_indices(ix,xiarr,xidir,b);
+  const int k=xi.load(ix,b);
   __syncthreads();
   const int _k=xdir[4*ix[0]+1];
   const int nc=xdir[3];
@@ -313,12 +307,13 @@ __global__ void Ptensors2_reduce1n_kernel(float* rarr, const int* rdir, const fl
 
 
 // contracting version
-__global__ void Ptensors2_reduce1B_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const int* xiarr, const int* xidir, const int n){
+template<typename IXREADER>
+__global__ void Ptensors2_reduce1B_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const IXREADER xi, const int n){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
   const int b=blockIdx.x;
   const int c=threadIdx.x;
-  const int k=load_indices(ix,xiarr,xidir,b);
+  const int k=xi.load(ix,b);
   __syncthreads();
   const int _k=xdir[4*ix[0]+1];
   const int nc=xdir[3];
@@ -379,12 +374,13 @@ __global__ void Ptensors2_reduce2B_kernel(float* rarr, const int* rdir, const fl
 }
 
 
-__global__ void Ptensors2_reduce2_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const int* xiarr, const int* xidir, const int n){
+template<typename IXREADER>
+__global__ void Ptensors2_reduce2_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const IXREADER xi, const int n){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
   const int q=blockIdx.x;
   const int c=threadIdx.x;
-  const int k=load_indices(ix,xiarr,xidir,q);
+  const int k=xi.load(ix,q);
   __syncthreads();
   const int _k=xdir[4*ix[0]+1];
   const int nc=xdir[3];
@@ -400,12 +396,13 @@ __global__ void Ptensors2_reduce2_kernel(float* rarr, const int* rdir, const flo
 
 
 // contracting version and flipping
-__global__ void Ptensors2_reduce2B_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const int* xiarr, const int* xidir, const int n){
+template<typename IXREADER>
+__global__ void Ptensors2_reduce2B_kernel(float* rarr, const int* rdir, const float* xarr, const int* xdir, const IXREADER xi, const int n){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
   const int q=blockIdx.x;
   const int c=threadIdx.x;
-  const int k=load_indices(ix,xiarr,xidir,q);
+  const int k=xi.load(ix,q);
   __syncthreads();
   const int _k=xdir[4*ix[0]+1];
   const int nc=xdir[3];
@@ -424,7 +421,7 @@ __global__ void Ptensors2_reduce2B_kernel(float* rarr, const int* rdir, const fl
 // ---- Broadcast --------------------------------------------------------------------------------------------
 
 
-__global__ void Ptensors2_broadcast0_kernel(float* xarr, const int* xdir, const float* rarr, const int* rdir){
+__global__ void Ptensors2_broadcast0_kernel(float* xarr, const int* xdir, const float* rarr, const int* rdir, const bool assign){
   const int q=blockIdx.x;
   const int c=threadIdx.x;
   const int k=xdir[4*q+1];
@@ -434,6 +431,14 @@ __global__ void Ptensors2_broadcast0_kernel(float* xarr, const int* xdir, const
 
   float* x=xarr+xdir[4*q]+c;
   const float t=rarr[rdir[2*q]+c];
+  if(assign){ // the second block is only set on the diagonal
+    for(int i=0; i<k; i++)
+      for(int j=0; j<k; j++){
+	x[(i*k+j)*nc]=t;
+	x[(i*k+j)*nc+rnc]=(i==j)*t;
+      }
+    return;
+  }
   for(int i=0; i<k; i++)
     for(int j=0; j<k; j++)
       x[(i*k+j)*nc]+=t;
@@ -482,7 +487,8 @@ __global__ void Ptensors2_broadcast0Bn_kernel(float* xarr, const int* xdir, cons
 }
 
 
-__global__ void Ptensors2_broadcast0_kernel(float* xarr, const int* xdir, const int* xiarr, const int* xidir, 
+template<typename IXREADER>
+__global__ void Ptensors2_broadcast0_kernel(float* xarr, const int* xdir, const IXREADER xi, 
   const float* rarr, const int* rdir, const int* bmap){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
@@ -497,7 +503,7 @@ __global__ void Ptensors2_broadcast0_kernel(float* xarr, const int* xdir, const
   float* x=xarr+xdir[4*target]+c;
   for(int s=0; s<N; s++){
     const int src=bmap[boffs+2*s];
-    const int k=load_indices(ix,xiarr,xidir,src);
+    const int k=xi.load(ix,src);
     const int _k=xdir[4*target+1];
     __syncthreads();
     if(c>=rnc) continue; 
@@ -513,7 +519,8 @@ __global__ void Ptensors2_broadcast0_kernel(float* xarr, const int* xdir, const
 
 
 // contracting version
-__global__ void Ptensors2_broadcast0B_kernel(float* xarr, const int* xdir, const int* xiarr, const int* xidir, 
+template<typename IXREADER>
+__global__ void Ptensors2_broadcast0B_kernel(float* xarr, const int* xdir, const IXREADER xi, 
   const float* rarr, const int* rdir, const int* bmap){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
@@ -528,7 +535,7 @@ __global__ void Ptensors2_broadcast0B_kernel(float* xarr, const int* xdir, const
   float* x=xarr+xdir[4*target]+c;
   for(int s=0; s<N; s++){
     const int src=bmap[boffs+2*s];
-    const int k=load_indices(ix,xiarr,xidir,src);
+    const int k=xi.load(ix,src);
     const int _k=xdir[4*target+1];
     __syncthreads();
     if(c>=nc) continue; 
@@ -545,7 +552,8 @@ __global__ void Ptensors2_broadcast0B_kernel(float* xarr, const int* xdir, const
 
 
 // contracting version
-__global__ void Ptensors2_broadcast0Bn_kernel(float* xarr, const int* xdir, const int* xiarr, const int* xidir, 
+template<typename IXREADER>
+__global__ void Ptensors2_broadcast0Bn_kernel(float* xarr, const int* xdir, const IXREADER xi, 
   const float* rarr, const int* rdir, const int* bmap){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
@@ -560,7 +568,7 @@ __global__ void Ptensors2_broadcast0Bn_kernel(float* xarr, const int* xdir, cons
   float* x=xarr+xdir[4*target]+c;
   for(int s=0; s<N; s++){
     const int src=bmap[boffs+2*s];
-    const int k=load_indices(ix,xiarr,xidir,src);
+    const int k=xi.load(ix,src);
     const int _k=xdir[4*target+1];
     __syncthreads();
     if(c>=nc) continue; 
@@ -578,7 +586,7 @@ __global__ void Ptensors2_broadcast0Bn_kernel(float* xarr, const int* xdir, cons
 
 
 
-__global__ void Ptensors2_broadcast1_kernel(float* xarr, const int* xdir, const float* rarr, const int* rdir){
+__global__ void Ptensors2_broadcast1_kernel(float* xarr, const int* xdir, const float* rarr, const int* rdir, const bool assign){
   const int q=blockIdx.x;
   const int c=threadIdx.x;
   const int k=xdir[4*q+1];
@@ -588,6 +596,15 @@ __global__ void Ptensors2_broadcast1_kernel(float* xarr, const int* xdir, const
 
   float* x=xarr+xdir[4*q]+c;
   const float* r=rarr+rdir[3*q]+c;
+  if(assign){ // the third block is only set on the diagonal
+    for(int i=0; i<k; i++)
+      for(int j=0; j<k; j++){
+	x[(i*k+j)*nc]=r[j*rnc];
+	x[(i*k+j)*nc+rnc]=r[i*rnc];
+	x[(i*k+j)*nc+2*rnc]=(i==j)*r[i*rnc];
+      }
+    return;
+  }
   for(int i=0; i<k; i++){
     float t=r[i*rnc];
     for(int j=0; j<k; j++)
@@ -658,7 +675,8 @@ __global__ void Ptensors2_broadcast1Bn_kernel(float* xarr, const int* xdir, cons
 }
 
 
-__global__ void Ptensors2_broadcast1_kernel(float* xarr, const int* xdir, const int* xiarr, const int* xidir, 
+template<typename IXREADER>
+__global__ void Ptensors2_broadcast1_kernel(float* xarr, const int* xdir, const IXREADER xi, 
   const float* rarr, const int* rdir, const int* bmap){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
@@ -673,7 +691,7 @@ __global__ void Ptensors2_broadcast1_kernel(float* xarr, const int* xdir, const
   float* x=xarr+xdir[4*target]+c;
   for(int s=0; s<N; s++){
     const int src=bmap[boffs+2*s];
-    const int k=load_indices(ix,xiarr,xidir,src);
+    const int k=xi.load(ix,src);
     const int _k=xdir[4*target+1];
     __syncthreads();
     if(c>=rnc) return;
@@ -696,7 +714,8 @@ __global__ void Ptensors2_broadcast1_kernel(float* xarr, const int* xdir, const
 
 
 // contracting version
-__global__ void Ptensors2_broadcast1B_kernel(float* xarr, const int* xdir, const int* xiarr, const int* xidir, 
+template<typename IXREADER>
+__global__ void Ptensors2_broadcast1B_kernel(float* xarr, const int* xdir, const IXREADER xi, 
   const float* rarr, const int* rdir, const int* bmap){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
@@ -711,7 +730,7 @@ __global__ void Ptensors2_broadcast1B_kernel(float* xarr, const int* xdir, const
   float* x=xarr+xdir[4*target]+c;
   for(int s=0; s<N; s++){
     const int src=bmap[boffs+2*s];
-    const int k=load_indices(ix,xiarr,xidir,src);
+    const int k=xi.load(ix,src);
     const int _k=xdir[4*target+1];
     __syncthreads();
     if(c>=nc) return;
@@ -734,7 +753,8 @@ __global__ void Ptensors2_broadcast1B_kernel(float* xarr, const int* xdir, const
 
 
 // contracting version
-__global__ void Ptensors2_broadcast1Bn_kernel(float* xarr, const int* xdir, const int* xiarr, const int* xidir, 
+template<typename IXREADER>
+__global__ void Ptensors2_broadcast1Bn_kernel(float* xarr, const int* xdir, const IXREADER xi, 
   const float* rarr, const int* rdir, const int* bmap){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
@@ -749,7 +769,7 @@ __global__ void Ptensors2_broadcast1Bn_kernel(float* xarr, const int* xdir, cons
   float* x=xarr+xdir[4*target]+c;
   for(int s=0; s<N; s++){
     const int src=bmap[boffs+2*s];
-    const int k=load_indices(ix,xiarr,xidir,src);
+    const int k=xi.load(ix,src);
     const int _k=xdir[4*target+1];
     __syncthreads();
     if(c>=nc) return;
@@ -773,7 +793,7 @@ __global__ void Ptensors2_broadcast1Bn_kernel(float* xarr, const int* xdir, cons
 
 
 
-__global__ void Ptensors2_broadcast2_kernel(float* xarr, const int* xdir, const float* rarr, const int* rdir){
+__global__ void Ptensors2_broadcast2_kernel(float* xarr, const int* xdir, const float* rarr, const int* rdir, const bool assign){
   const int q=blockIdx.x;
   const int c=threadIdx.x;
   const int k=xdir[4*q+1];
@@ -783,6 +803,14 @@ __global__ void Ptensors2_broadcast2_kernel(float* xarr, const int* xdir, const
 
   float* x=xarr+xdir[4*q]+c;
   const float* r=rarr+rdir[4*q]+c;
+  if(assign){
+    for(int i=0; i<k; i++)
+      for(int j=0; j<k; j++){
+	x[(i*k+j)*nc]=r[(i*k+j)*rnc];
+	x[(j*k+i)*nc+rnc]=r[(i*k+j)*rnc];
+      }
+    return;
+  }
   for(int i=0; i<k; i++)
     for(int j=0; j<k; j++)
       x[(i*k+j)*nc]+=r[(i*k+j)*rnc];
@@ -809,7 +837,8 @@ __global__ void Ptensors2_broadcast2B_kernel(float* xarr, const int* xdir, const
 }
 
 
-__global__ void Ptensors2_broadcast2_kernel(float* xarr, const int* xdir, const int* xiarr, const int* xidir, 
+template<typename IXREADER>
+__global__ void Ptensors2_broadcast2_kernel(float* xarr, const int* xdir, const IXREADER xi, 
   const float* rarr, const int* rdir, const int* bmap){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
@@ -824,7 +853,7 @@ __global__ void Ptensors2_broadcast2_kernel(float* xarr, const int* xdir, const
   float* x=xarr+xdir[4*target]+c;
   for(int s=0; s<N; s++){
     const int src=bmap[boffs+2*s];
-    const int k=load_indices(ix,xiarr,xidir,src);
+    const int k=xi.load(ix,src);
     const int _k=xdir[4*target+1];
     __syncthreads();
     if(c>=rnc) return;
@@ -841,7 +870,8 @@ __global__ void Ptensors2_broadcast2_kernel(float* xarr, const int* xdir, const
 
 
 // contracting version and without flipping
-__global__ void Ptensors2_broadcast2B_kernel(float* xarr, const int* xdir, const int* xiarr, const int* xidir, 
+template<typename IXREADER>
+__global__ void Ptensors2_broadcast2B_kernel(float* xarr, const int* xdir, const IXREADER xi, 
   const float* rarr, const int* rdir, const int* bmap){
   extern __shared__ unsigned char _shared[]; 
   int* ix=reinterpret_cast<int*>(_shared);
@@ -856,7 +886,7 @@ __global__ void Ptensors2_broadcast2B_kernel(float* xarr, const int* xdir, const
   float* x=xarr+xdir[4*target]+c;
   for(int s=0; s<N; s++){
     const int src=bmap[boffs+2*s];
-    const int k=load_indices(ix,xiarr,xidir,src);
+    const int k=xi.load(ix,src);
     const int _k=xdir[4*target+1];
     __syncthreads();
     if(c>=nc) return;
@@ -1110,8 +1140,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     const int nthrd=cnine::roundup(std::max(n,list.max_nix()+1),32);
-    Ptensors2_reduce0_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
-      (R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),n);
+    list.with_reader([&](const auto& xi){
+      Ptensors2_reduce0_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
+	(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),xi,n);});
   }
 
   void Ptensors2_reduce0n_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, 
@@ -1121,8 +1152,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     const int nthrd=cnine::roundup(std::max(n,list.max_nix()+1),32);
-    Ptensors2_reduce0n_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
-      (R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),n);
+    list.with_reader([&](const auto& xi){
+      Ptensors2_reduce0n_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
+	(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),xi,n);});
   }
 
   void Ptensors2_reduce0B_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, 
@@ -1132,8 +1164,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     const int nthrd=cnine::roundup(std::max(n,list.max_nix()+1),32);
-    Ptensors2_reduce0B_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
-      (R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),n);
+    list.with_reader([&](const auto& xi){
+      Ptensors2_reduce0B_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
+	(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),xi,n);});
   }
 
 
@@ -1169,8 +1202,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     const int nthrd=cnine::roundup(std::max(n,list.max_nix()+1),32);
-    Ptensors2_reduce1_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
-      (R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),n);
+    list.with_reader([&](const auto& xi){
+      Ptensors2_reduce1_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
+	(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),xi,n);});
   }
 
   void Ptensors2_reduce1n_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, 
@@ -1180,8 +1214,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     const int nthrd=cnine::roundup(std::max(n,list.max_nix()+1),32);
-    Ptensors2_reduce1n_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
-      (R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),n);
+    list.with_reader([&](const auto& xi){
+      Ptensors2_reduce1n_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
+	(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),xi,n);});
   }
 
   void Ptensors2_reduce1B_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, 
@@ -1191,8 +1226,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     const int nthrd=cnine::roundup(std::max(n,list.max_nix()+1),32);
-    Ptensors2_reduce1B_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
-      (R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),n);
+    list.with_reader([&](const auto& xi){
+      Ptensors2_reduce1B_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
+	(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),xi,n);});
   }
 
 
@@ -1218,8 +1254,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     const int nthrd=cnine::roundup(std::max(n,list.max_nix()+1),32);
-    Ptensors2_reduce2_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
-      (R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),n);
+    list.with_reader([&](const auto& xi){
+      Ptensors2_reduce2_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
+	(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),xi,n);});
   }
 
   void Ptensors2_reduce2B_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, 
@@ -1229,19 +1266,20 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     const int nthrd=cnine::roundup(std::max(n,list.max_nix()+1),32);
-    Ptensors2_reduce2B_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
-      (R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),n);
+    list.with_reader([&](const auto& xi){
+      Ptensors2_reduce2B_kernel<<<R.size(),nthrd,(list.max_nix()+1)*4,stream>>>
+	(R.arrg,R.dir.garr(dev),x.arrg+offs,x.dir.garr(dev),xi,n);});
   }
 
 
 
   void Ptensors2_broadcast0_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, 
-    const int offs, const cudaStream_t& stream){
+    const int offs, const cudaStream_t& stream, const bool assign){
     int dev=R.dev;
     PTENS_ASSRT(R.dev==1);
     PTENS_ASSRT(x.dev==1);
     int n=R.nc;
-    Ptensors2_broadcast0_kernel<<<R.size(),n,0,stream>>>(x.arrg+offs,x.dir.garr(dev),R.arrg,R.dir.garr(dev));
+    Ptensors2_broadcast0_kernel<<<R.size(),n,0,stream>>>(x.arrg+offs,x.dir.garr(dev),R.arrg,R.dir.garr(dev),assign);
   }
 
   void Ptensors2_broadcast0B_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, 
@@ -1269,8 +1307,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     int n=cnine::roundup(std::max(R.nc,list.max_nix()+1),32);
-    Ptensors2_broadcast0_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
-      (x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),R.arrg,R.dir.garr(dev),list.get_barr(1));
+    list.with_reader([&](const auto& xi){
+      Ptensors2_broadcast0_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
+	(x.arrg+offs,x.dir.garr(dev),xi,R.arrg,R.dir.garr(dev),list.get_barr(1));});
   }
 
   void Ptensors2_broadcast0B_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, const AindexPack& list, 
@@ -1280,8 +1319,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     int n=cnine::roundup(std::max(R.nc,list.max_nix()+1),32); // should be x.nc??
-    Ptensors2_broadcast0B_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
-      (x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),R.arrg,R.dir.garr(dev),list.get_barr(1));
+    list.with_reader([&](const auto& xi){
+      Ptensors2_broadcast0B_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
+	(x.arrg+offs,x.dir.garr(dev),xi,R.arrg,R.dir.garr(dev),list.get_barr(1));});
   }
 
   void Ptensors2_broadcast0Bn_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, const AindexPack& list, 
@@ -1291,19 +1331,20 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     int n=cnine::roundup(std::max(R.nc,list.max_nix()+1),32); // should be x.nc??
-    Ptensors2_broadcast0Bn_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
-      (x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),R.arrg,R.dir.garr(dev),list.get_barr(1));
+    list.with_reader([&](const auto& xi){
+      Ptensors2_broadcast0Bn_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
+	(x.arrg+offs,x.dir.garr(dev),xi,R.arrg,R.dir.garr(dev),list.get_barr(1));});
   }
 
 
 
   void Ptensors2_broadcast1_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, 
-    const int offs, const cudaStream_t& stream){
+    const int offs, const cudaStream_t& stream, const bool assign){
     int dev=R.dev;
     PTENS_ASSRT(R.dev==1);
     PTENS_ASSRT(x.dev==1);
     int n=R.nc;
-    Ptensors2_broadcast1_kernel<<<R.size(),n,0,stream>>>(x.arrg+offs,x.dir.garr(dev),R.arrg,R.dir.garr(dev));
+    Ptensors2_broadcast1_kernel<<<R.size(),n,0,stream>>>(x.arrg+offs,x.dir.garr(dev),R.arrg,R.dir.garr(dev),assign);
   }
 
   void Ptensors2_broadcast1B_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, 
@@ -1331,8 +1372,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     int n=cnine::roundup(std::max(R.nc,list.max_nix()+1),32); // change dim_of?
-    Ptensors2_broadcast1_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
-      (x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),R.arrg,R.dir.garr(dev),list.get_barr(1));
+    list.with_reader([&](const auto& xi){
+      Ptensors2_broadcast1_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
+	(x.arrg+offs,x.dir.garr(dev),xi,R.arrg,R.dir.garr(dev),list.get_barr(1));});
   }
 
   void Ptensors2_broadcast1B_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, const AindexPack& list, 
@@ -1342,8 +1384,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     int n=cnine::roundup(std::max(R.nc,list.max_nix()+1),32);
-    Ptensors2_broadcast1B_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
-      (x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),R.arrg,R.dir.garr(dev),list.get_barr(1));
+    list.with_reader([&](const auto& xi){
+      Ptensors2_broadcast1B_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
+	(x.arrg+offs,x.dir.garr(dev),xi,R.arrg,R.dir.garr(dev),list.get_barr(1));});
   }
 
   void Ptensors2_broadcast1Bn_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, const AindexPack& list, 
@@ -1353,19 +1396,20 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     int n=cnine::roundup(std::max(R.nc,list.max_nix()+1),32);
-    Ptensors2_broadcast1Bn_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
-      (x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),R.arrg,R.dir.garr(dev),list.get_barr(1));
+    list.with_reader([&](const auto& xi){
+      Ptensors2_broadcast1Bn_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
+	(x.arrg+offs,x.dir.garr(dev),xi,R.arrg,R.dir.garr(dev),list.get_barr(1));});
   }
 
 
   void Ptensors2_broadcast2_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, 
-    const int offs, const cudaStream_t& stream){
+    const int offs, const cudaStream_t& stream, const bool assign){
     int dev=R.dev;
     PTENS_ASSRT(R.dev==1);
     PTENS_ASSRT(x.dev==1);
     int n=R.nc;
     Ptensors2_broadcast2_kernel<<<R.size(),n,0,stream>>>
-      (x.arrg+offs,x.dir.garr(dev),R.arrg,R.dir.garr(dev));
+      (x.arrg+offs,x.dir.garr(dev),R.arrg,R.dir.garr(dev),assign);
   }
 
   void Ptensors2_broadcast2B_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, 
@@ -1385,8 +1429,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     int n=cnine::roundup(std::max(R.nc,list.max_nix()+1),32);
-    Ptensors2_broadcast2_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
-      (x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),R.arrg,R.dir.garr(dev),list.get_barr(1));
+    list.with_reader([&](const auto& xi){
+      Ptensors2_broadcast2_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
+	(x.arrg+offs,x.dir.garr(dev),xi,R.arrg,R.dir.garr(dev),list.get_barr(1));});
   }
 
   void Ptensors2_broadcast2B_cu(cnine::RtensorPackB& x, const cnine::RtensorPackB& R, const AindexPack& list, 
@@ -1396,8 +1441,9 @@ namespace ptens{
     PTENS_ASSRT(x.dev==1);
     const_cast<AindexPack&>(list).to_device(1);
     int n=cnine::roundup(std::max(R.nc,list.max_nix()+1),32);
-    Ptensors2_broadcast2B_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
-      (x.arrg+offs,x.dir.garr(dev),list.arrg,list.dir.garr(dev),R.arrg,R.dir.garr(dev),list.get_barr(1));
+    list.with_reader([&](const auto& xi){
+      Ptensors2_broadcast2B_kernel<<<list.get_bmap().n,n,(list.max_nix()+1)*4,stream>>>
+	(x.arrg+offs,x.dir.garr(dev),xi,R.arrg,R.dir.garr(dev),list.get_barr(1));});
   }
 
 
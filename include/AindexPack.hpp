@@ -15,16 +15,145 @@
 #define _ptens_AindexPack
 
 #include <map>
+#include <cstdint>
 
 #include "array_pool.hpp"
+#include "RtensorPackB.hpp"
 #include "Atoms.hpp"
 #include "GatherMap.hpp"
+#include "PtensScratch.hpp"
+#include "PtensMemory.hpp"
 
 
 namespace ptens{
 
 
-  class AindexPack: public cnine::array_pool<int>{
+  // Readers through which the CUDA kernels see an AindexPack. load(ix,q) writes the tensor index
+  // of entry q to ix[0] and its local indices to ix[1],ix[2],..., and returns the number of local
+  // indices. AindexReader reads the plain encoding, AindexReaderC the compact one.
+
+  class AindexReader{
+  public:
+    const int* arr;
+    const int* dir;
+#ifdef __CUDACC__
+    __forceinline__ __device__ int tens(const int q) const{
+      return arr[dir[2*q]];
+    }
+    __forceinline__ __device__ int load(int* ix, const int q) const{
+      int offs=dir[2*q];
+      int n=dir[2*q+1];
+      int t=threadIdx.x;
+      if(t<n) ix[t]=arr[offs+t];
+      return n-1;
+    }
+#endif
+  };
+
+  template<typename IX>
+  class AindexReaderC{
+  public:
+    const int* tix;
+    const int* offs;
+    const IX* ixs;
+#ifdef __CUDACC__
+    __forceinline__ __device__ int tens(const int q) const{
+      return tix[q];
+    }
+    __forceinline__ __device__ int load(int* ix, const int q) const{
+      int a=offs[q];
+      int n=offs[q+1]-a;
+      int t=threadIdx.x;
+      if(t==0) ix[0]=tix[q];
+      if(t<n) ix[t+1]=ixs[a+t];
+      return n;
+    }
+#endif
+  };
+
+
+  // Compact encoding of the entries of an AindexPack. The tensor index of entry i is tix()[i],
+  // and its local indices are stored in offs()[i],...,offs()[i+1]-1 of an array of 8 or 16 bit
+  // integers, depending on the largest local index. Once built it is not modified, so packs
+  // share it on copying.
+
+  class AindexCompact{
+  public:
+
+    int n=0;
+    int width=1;
+    vector<int> hdr; // n tensor indices followed by n+1 offsets
+    vector<unsigned char> ixs;
+
+    mutable int* hdrg=nullptr;
+    mutable unsigned char* ixsg=nullptr;
+
+
+    AindexCompact(const int _n, const int nindices, const int max_index):
+      n(_n), width(max_index<256? 1 : 2), hdr(2*_n+1), ixs((size_t)nindices*width){
+      PTENS_ASSRT(max_index<65536);
+    }
+
+    ~AindexCompact(){
+#ifdef _WITH_CUDA
+      if(hdrg) CUDA_SAFE(cudaFree(hdrg));
+      if(ixsg) CUDA_SAFE(cudaFree(ixsg));
+#endif
+    }
+
+    AindexCompact(const AindexCompact& x)=delete;
+    AindexCompact& operator=(const AindexCompact& x)=delete;
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    int* tix(){
+      return hdr.data();
+    }
+
+    int* offs(){
+      return hdr.data()+n;
+    }
+
+    const int* tix() const{
+      return hdr.data();
+    }
+
+    const int* offs() const{
+      return hdr.data()+n;
+    }
+
+    int get(const int k) const{
+      if(width==1) return ixs[k];
+      return reinterpret_cast<const uint16_t*>(ixs.data())[k];
+    }
+
+    void set(const int k, const int v){
+      if(width==1) ixs[k]=v;
+      else reinterpret_cast<uint16_t*>(ixs.data())[k]=v;
+    }
+
+    size_t memory_bytes() const{
+      return hdr.size()*sizeof(int)+ixs.size();
+    }
+
+    void to_device() const{
+#ifdef _WITH_CUDA
+      if(hdrg) return;
+      CUDA_SAFE(cudaMalloc((void**)&hdrg,std::max(hdr.size(),(size_t)1)*sizeof(int)));
+      CUDA_SAFE(cudaMalloc((void**)&ixsg,std::max(ixs.size(),(size_t)1)));
+      CUDA_SAFE(cudaMemcpy(hdrg,hdr.data(),hdr.size()*sizeof(int),cudaMemcpyHostToDevice));
+      CUDA_SAFE(cudaMemcpy(ixsg,ixs.data(),ixs.size(),cudaMemcpyHostToDevice));
+#else
+      CNINE_NOCUDA_ERROR;
+#endif
+    }
+
+  };
+
+
+  class AindexPack: public cnine::array_pool<int>, public PtensTracked<AindexPack,PtensMemoryTracker::INDICES>{
   public:
 
     int _max_nix=0;
@@ -32,6 +161,11 @@ namespace ptens{
     int count2=0;
 
     std::shared_ptr<cnine::GatherMap> bmap;
+    std::shared_ptr<AindexCompact> compact;
+
+    // Set for packs whose index array was drawn from the scratch arena, see PtensScratch
+    std::shared_ptr<const std::atomic<size_t> > scratch_gen;
+    size_t scratch_stamp=0;
 
 
   public: // ---- Constructors ------------------------------------------------------------------------------
@@ -43,20 +177,34 @@ namespace ptens{
   public: // ---- Copying -----------------------------------------------------------------------------------
 
 
+    // A copy of a pack drawn from the scratch arena owns its indices, so it can outlive the Scope
     AindexPack(const AindexPack& x):
       array_pool<int>(x){
+      PTENS_ASSRT(x.is_live());
       bmap=x.bmap;
+      compact=x.compact;
       _max_nix=x._max_nix;
       count1=x.count1;
       count2=x.count2;
+      if(x.scratch_gen && is_view){
+	int* a=new int[std::max(tail,1)];
+	std::copy(x.arr,x.arr+tail,a);
+	arr=a;
+	memsize=tail;
+	is_view=false;
+      }
     }
 
     AindexPack(AindexPack&& x):
       array_pool<int>(std::move(x)){
+      PTENS_ASSRT(x.is_live());
       bmap=x.bmap; //x.bmap=nullptr;
+      compact=x.compact;
       _max_nix=x._max_nix;
       count1=x.count1;
       count2=x.count2;
+      scratch_gen=x.scratch_gen;
+      scratch_stamp=x.scratch_stamp;
     }
 
     AindexPack& operator=(const AindexPack& x)=delete;
@@ -65,24 +213,52 @@ namespace ptens{
   public: // ---- Access -------------------------------------------------------------------------------------
 
 
+    // Bytes held by the index arrays, as reported to ptens_memory()
+    size_t memory_bytes() const{
+      if(compact) return compact->memory_bytes();
+      if(is_view) return 2*size()*sizeof(int);
+      return (memsize+2*size())*sizeof(int);
+    }
+
+    bool is_compact() const{
+      return (bool)compact;
+    }
+
+    int size() const{
+      assert(is_live());
+      if(compact) return compact->n;
+      return array_pool<int>::size();
+    }
+
+    // False for a pack drawn from the scratch arena once its Scope has closed
+    bool is_live() const{
+      return !scratch_gen || scratch_gen->load(std::memory_order_relaxed)==scratch_stamp;
+    }
+
     int max_nix() const{
       return _max_nix;
     }
 
     int tix(const int i) const{
       assert(i<size());
-      //return arr[lookup[i].first];
+      if(compact) return compact->tix()[i];
       return arr[dir(i,0)];
     }
 
     int tens(const int i) const{
-      assert(i<size());
-      return arr[dir(i,0)];
-      //return arr[lookup[i].first];
+      return tix(i);
     }
 
     vector<int> ix(const int i) const{
       assert(i<size());
+      if(compact){
+	int a=compact->offs()[i];
+	int len=compact->offs()[i+1]-a;
+	vector<int> R(len);
+	for(int j=0; j<len; j++)
+	  R[j]=compact->get(a+j);
+	return R;
+      }
       int addr=dir(i,0);
       int len=dir(i,1)-1;
       PTENS_ASSRT(len>=0);
@@ -95,6 +271,7 @@ namespace ptens{
 
     int ix(const int i, const int j) const{
       assert(i<size());
+      if(compact) return j==0? compact->tix()[i] : compact->get(compact->offs()[i]+j-1);
       int addr=dir(i,0);
       int len=dir(i,1);
       assert(len>=0);
@@ -103,6 +280,7 @@ namespace ptens{
 
     int nix(const int i) const{
       assert(i<size());
+      if(compact) return compact->offs()[i+1]-compact->offs()[i];
       return dir(i,1)-1;
     }
 
@@ -128,6 +306,7 @@ namespace ptens{
     }
 
     void push_back(const int tix, vector<int> indices){
+      PTENS_ASSRT(!compact);
       int len=indices.size()+1;
       if(tail+len>memsize)
 	reserve(std::max(2*memsize,tail+len));
@@ -140,23 +319,242 @@ namespace ptens{
       _max_nix=std::max(_max_nix,len-1);
     }
 
+
+
+  public: // ---- Intermediate packs -------------------------------------------------------------------------
+
+
+    // Output of an indexed reduction: one order k tensor with n channels per entry, of size
+    // nix(i) along each of its k leading dimensions. On the host the entries are left
+    // uninitialized and, while a PtensScratch::Scope is open, drawn from the scratch arena, in
+    // which case the pack must not outlive the Scope. On the GPU it is zero filled, since the
+    // reduction kernels accumulate into it.
+    cnine::RtensorPackB scratch_pack(const int k, const int n, const int _dev=0) const{
+      PTENS_ASSRT(k>=0 && k<=2);
+      int N=size();
+      cnine::RtensorPackB R(k+1,n,_dev);
+      R.dir=cnine::IntTensor::raw({N,k+2});
+      int t=0;
+      for(int i=0; i<N; i++){
+	int m=nix(i);
+	vector<int> v(k+2,m);
+	v[0]=t;
+	v[k+1]=n;
+	R.dir.set_row(i,v);
+	t+=(k==0? 1 : (k==1? m : m*m))*n;
+      }
+      PtensScratch& scratch=ptens_scratch();
+      if(_dev>0) R.reserve_zero(t);
+      else if(scratch.active()){
+	R.arr=scratch.alloc_floats(t);
+	R.memsize=t;
+	R.is_view=true;
+      }else R.reserve(t);
+      R.tail=t;
+      return R;
+    }
+
+
+  public: // ---- Encodings ----------------------------------------------------------------------------------
+
+
+    // The same pack with the local indices stored in 8 or 16 bits (see AindexCompact)
+    AindexPack compacted() const{
+      if(compact) return *this;
+      int n=size();
+      int total=0;
+      int maxix=0;
+      for(int i=0; i<n; i++){
+	total+=nix(i);
+	for(int j=1; j<=nix(i); j++)
+	  maxix=std::max(maxix,arr[dir(i,0)+j]);
+      }
+      AindexPack R;
+      R.compact=std::make_shared<AindexCompact>(n,total,maxix);
+      AindexCompact& c=*R.compact;
+      int t=0;
+      for(int i=0; i<n; i++){
+	c.tix()[i]=tix(i);
+	c.offs()[i]=t;
+	for(int j=1; j<=nix(i); j++)
+	  c.set(t++,arr[dir(i,0)+j]);
+      }
+      c.offs()[n]=t;
+      R.bmap=bmap;
+      R._max_nix=_max_nix;
+      R.count1=count1;
+      R.count2=count2;
+      return R;
+    }
+
+    // The same pack in the plain array_pool layout, for code that reads the base class directly
+    AindexPack expanded() const{
+      if(!compact) return *this;
+      AindexPack R;
+      for(int i=0; i<size(); i++)
+	R.push_back(tix(i),ix(i));
+      R.bmap=bmap;
+      R._max_nix=_max_nix;
+      R.count1=count1;
+      R.count2=count2;
+      return R;
+    }
+
+    void to_device(const int _dev){
+      if(!compact){
+	array_pool<int>::to_device(_dev);
+	return;
+      }
+      PTENS_ASSRT(_dev==1);
+      compact->to_device();
+      dev=_dev;
+    }
+
+    // Call fn with the device side reader matching the encoding of the pack
+    template<typename FN>
+    void with_reader(const FN& fn) const{
+      PTENS_ASSRT(dev==1);
+      if(!compact) fn(AindexReader{arrg,dir.garr(1)});
+      else if(compact->width==1) fn(AindexReaderC<uint8_t>{compact->hdrg,compact->hdrg+compact->n,compact->ixsg});
+      else fn(AindexReaderC<uint16_t>{compact->hdrg,compact->hdrg+compact->n,reinterpret_cast<const uint16_t*>(compact->ixsg)});
+    }
+
     
   public: // ---- Operations ---------------------------------------------------------------------------------
 
+
+    // Index packs for the overlaps between inputs[j] and outputs[i] for each edge (i,j) visited by
+    // forall. Equivalent to intersecting the Atoms of each pair, but uses a position table over
+    // the atom labels instead of building maps. The edges are visited twice, first to size the
+    // packs exactly, then to fill them. Inside a PtensScratch::Scope the index arrays are taken
+    // from the scratch arena, otherwise the packs are built in the compact encoding.
+    template<typename FORALL>
+    static pair<AindexPack,AindexPack> intersects(const cnine::array_pool<int>& inputs, 
+      const cnine::array_pool<int>& outputs, const FORALL& forall){
+      PtensScratch& scratch=ptens_scratch();
+
+      int maxatom=-1;
+      int maxlen=1;
+      for(auto* x:{&inputs,&outputs})
+	for(int i=0; i<x->size(); i++){
+	  maxlen=std::max(maxlen,x->dir(i,1));
+	  for(int a=0; a<x->dir(i,1); a++)
+	    maxatom=std::max(maxatom,x->arr[x->dir(i,0)+a]);
+	}
+
+      vector<int> _table;
+      int* table;
+      if(scratch.active()) table=scratch.alloc_ints(2*(maxatom+1));
+      else{_table.resize(2*(maxatom+1)); table=_table.data();}
+      int* inpos=table;
+      int* outpos=table+maxatom+1;
+      std::fill(table,table+2*(maxatom+1),-1);
+
+      // For each output atom also present in the input, call fn(input position, output position).
+      // As with Atoms, when an atom occurs more than once its last position is used.
+      auto overlap=[&](const int i, const int j, auto fn){
+	const int* in=inputs.arr+inputs.dir(j,0);
+	const int* out=outputs.arr+outputs.dir(i,0);
+	const int nin=inputs.dir(j,1);
+	const int nout=outputs.dir(i,1);
+	for(int a=0; a<nin; a++) inpos[in[a]]=a;
+	for(int a=0; a<nout; a++) outpos[out[a]]=a;
+	for(int a=0; a<nout; a++)
+	  if(inpos[out[a]]>=0) fn(inpos[out[a]],outpos[out[a]]);
+	for(int a=0; a<nin; a++) inpos[in[a]]=-1;
+	for(int a=0; a<nout; a++) outpos[out[a]]=-1;
+      };
+
+      int nedges=0;
+      int total=0;
+      forall([&](const int i, const int j){
+	  nedges++;
+	  overlap(i,j,[&](const int, const int){total++;});
+	});
+
+      AindexPack in_indices;
+      AindexPack out_indices;
+
+      // Packs that outlive the scratch arena are kept in the compact encoding
+      if(!scratch.active() && maxlen<=65536){
+	for(auto* x:{&in_indices,&out_indices})
+	  x->compact=std::make_shared<AindexCompact>(nedges,total,maxlen-1);
+	AindexCompact& in_c=*in_indices.compact;
+	AindexCompact& out_c=*out_indices.compact;
+	int e=0;
+	int t=0;
+	forall([&](const int i, const int j){
+	    in_c.tix()[e]=j;
+	    out_c.tix()[e]=i;
+	    in_c.offs()[e]=t;
+	    out_c.offs()[e]=t;
+	    const int t0=t;
+	    overlap(i,j,[&](const int a, const int b){
+		in_c.set(t,a);
+		out_c.set(t,b);
+		t++;
+	      });
+	    const int k=t-t0;
+	    for(auto* x:{&in_indices,&out_indices}){
+	      x->_max_nix=std::max(x->_max_nix,k);
+	      x->count1+=k;
+	      x->count2+=k*k;
+	    }
+	    e++;
+	  });
+	in_c.offs()[nedges]=t;
+	out_c.offs()[nedges]=t;
+	return make_pair(std::move(in_indices),std::move(out_indices));
+      }
+
+      for(auto* x:{&in_indices,&out_indices}){
+	if(scratch.active()){
+	  x->arr=scratch.alloc_ints(nedges+total);
+	  x->memsize=nedges+total;
+	  x->is_view=true;
+	  x->scratch_gen=scratch.generation;
+	  x->scratch_stamp=*scratch.generation;
+	}else x->reserve(nedges+total);
+      }
+
+      forall([&](const int i, const int j){
+	  const int offs=in_indices.tail;
+	  in_indices.arr[offs]=j;
+	  out_indices.arr[offs]=i;
+	  int k=0;
+	  overlap(i,j,[&](const int a, const int b){
+	      k++;
+	      in_indices.arr[offs+k]=a;
+	      out_indices.arr[offs+k]=b;
+	    });
+	  for(auto* x:{&in_indices,&out_indices}){
+	    x->dir.push_back(offs,k+1);
+	    x->tail+=k+1;
+	    x->_max_nix=std::max(x->_max_nix,k);
+	    x->count1+=k;
+	    x->count2+=k*k;
+	  }
+	});
+
+      return make_pair(std::move(in_indices),std::move(out_indices));
+    }
+
+
   public: // ---- I/O ----------------------------------------------------------------------------------------
 
 
-    /*
     string str(const string indent="") const{
       ostringstream oss;
-      oss<<"(";
-      for(int i=0; i<size()-1; i++)
-	oss<<(*this)[i]<<",";
-      if(size()>0) oss<<(*this)[size()-1];
-      oss<<")";
+      for(int i=0; i<size(); i++){
+	oss<<indent<<tix(i)<<":(";
+	for(int j=0; j<nix(i); j++){
+	  if(j>0) oss<<",";
+	  oss<<ix(i,j+1);
+	}
+	oss<<")"<<endl;
+      }
       return oss.str();
     }
-    */
 
     string repr() const{
       return "<AindexPack[N="+to_string(size())+"]>";
@@ -165,6 +563,11 @@ namespace ptens{
     friend ostream& operator<<(ostream& stream, const AindexPack& v){
       stream<<v.str(); return stream;}
 
+
+  private:
+
+    Registration registration{this}; // last data member, see PtensTracked
+
   };
 
 }
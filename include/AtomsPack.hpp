@@ -15,21 +15,34 @@
 #define _ptens_AtomsPack
 
 #include <map>
+#include <algorithm>
+#include <atomic>
+#include <memory>
 
 #include "array_pool.hpp"
 #include "labeled_forest.hpp"
 #include "Atoms.hpp"
 #include "cpermutation.hpp"
+#include "PtensMemory.hpp"
 
 namespace ptens{
 
-  class AtomsPack: public cnine::array_pool<int>{
+  // A pack that is owned by a shared_ptr, in particular one held by a SharedAtomsPack, must no 
+  // longer be modified. Such packs are recognized by is_shared(), and their id() and hash() are 
+  // fixed for their lifetime.
+
+  class AtomsPack: public cnine::array_pool<int>, public std::enable_shared_from_this<AtomsPack>,
+                   public PtensTracked<AtomsPack,PtensMemoryTracker::INDICES>{
   public:
 
     //int k=-1;
     typedef cnine::array_pool<int> BASE;
     using  BASE::BASE;
 
+    mutable std::atomic<size_t> _id{0}; // 0 until id() is first called
+    mutable size_t _hash=0;
+    mutable bool _hashed=false;
+
 
   public: // ---- Constructors ------------------------------------------------------------------------------
 
@@ -118,6 +131,8 @@ namespace ptens{
       PTENS_ASSIGN_WARNING();
       cnine::array_pool<int>::operator=(x);
       /*k=x.k;*/
+      _id=0;
+      _hashed=false;
       return *this;
     }
 
@@ -145,6 +160,12 @@ namespace ptens{
   public: // ---- Access -------------------------------------------------------------------------------------
 
 
+    // Bytes held by the index arrays, as reported to ptens_memory()
+    size_t memory_bytes() const{
+      if(is_view) return 2*size()*sizeof(int);
+      return (memsize+2*size())*sizeof(int);
+    }
+
     Atoms operator[](const int i) const{
       return Atoms(cnine::array_pool<int>::operator()(i));
     }
@@ -167,6 +188,44 @@ namespace ptens{
       return t;
     }
 
+    bool is_shared() const{
+      return !weak_from_this().expired();
+    }
+
+    // Process wide unique identifier of this object, assigned on first use. Two packs with the 
+    // same id are the same object, so for shared packs the id is an exact key for their contents. 
+    // Threads racing on the first call all get the id stored by the winning compare-exchange.
+    size_t id() const{
+      static std::atomic<size_t> counter(1);
+      size_t r=_id.load(std::memory_order_acquire);
+      if(r!=0) return r;
+      const size_t fresh=counter.fetch_add(1,std::memory_order_relaxed);
+      if(_id.compare_exchange_strong(r,fresh,std::memory_order_acq_rel,std::memory_order_acquire)) return fresh;
+      return r;
+    }
+
+    // Hash of the number of reference domains, their sizes and their contents. 
+    // Memoized for shared packs.
+    size_t hash() const{
+      if(_hashed) return _hash;
+      PTENS_ASSRT(dev==0);
+      size_t h=size();
+      auto mix=[&](const size_t x){
+	h^=x+0x9e3779b97f4a7c15ULL+(h<<6)+(h>>2);};
+      for(int i=0; i<size(); i++){
+	int offs=dir(i,0);
+	int len=dir(i,1);
+	mix(len);
+	for(int j=0; j<len; j++)
+	  mix(arr[offs+j]);
+      }
+      if(is_shared()){
+	_hash=h;
+	_hashed=true;
+      }
+      return h;
+    }
+
     cnine::array_pool<int> dims1(const int nc) const{
       array_pool<int> R;
       for(int i=0; i<size(); i++)
@@ -192,11 +251,22 @@ namespace ptens{
 	    return reference_wrapper<array_pool<int> >(x.get());})));
     }
 
+    static AtomsPack cat(const vector<const AtomsPack*>& list){
+      AtomsPack R;
+      int t=0;
+      for(auto p:list) t+=p->tail;
+      R.reserve(t);
+      for(auto p:list)
+	for(int i=0; i<p->size(); i++)
+	  R.push_back((*p)(i));
+      return R;
+    }
+
 
   public: // ---- Operations ---------------------------------------------------------------------------------
 
 
-    AtomsPack permute(const cnine::permutation& pi){
+    AtomsPack permute(const cnine::permutation& pi) const{
       PTENS_ASSRT(dev==0);
       array_pool<int> A;
       A.dir=dir;
@@ -207,6 +277,36 @@ namespace ptens{
       return A;
     }
 
+    // Map each atom a to map[a], keeping each atom in its position within its domain
+    AtomsPack relabel(const vector<int>& map) const{
+      PTENS_ASSRT(dev==0);
+      array_pool<int> A;
+      A.dir=dir;
+      A.reserve(tail);
+      A.tail=tail;
+      for(int i=0; i<tail; i++)
+	A.arr[i]=map[arr[i]];
+      return A;
+    }
+
+    // Row i of the result is row rows[i] of this pack relabeled by map, with its atoms sorted. 
+    // For moving packs with one domain per vertex (such as nhoods) to another vertex numbering.
+    AtomsPack relabel(const vector<int>& map, const vector<int>& rows) const{
+      PTENS_ASSRT(dev==0);
+      AtomsPack R;
+      R.reserve(tail);
+      for(auto r:rows){
+	int offs=dir(r,0);
+	int len=dir(r,1);
+	R.dir.push_back(R.tail,len);
+	for(int j=0; j<len; j++)
+	  R.arr[R.tail+j]=map[arr[offs+j]];
+	std::sort(R.arr+R.tail,R.arr+R.tail+len);
+	R.tail+=len;
+      }
+      return R;
+    }
+
     /*
     vector<int> intersect(const int i, const vector<int>& I) const{
       vector<int> r;
@@ -242,6 +342,11 @@ namespace ptens{
     friend ostream& operator<<(ostream& stream, const AtomsPack& v){
       stream<<v.str(); return stream;}
 
+
+  private:
+
+    Registration registration{this}; // last data member, see PtensTracked
+
   };
 
 }
@@ -0,0 +1,126 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _ptens_BumpArena
+#define _ptens_BumpArena
+
+#include "Ptens_base.hpp"
+
+
+namespace ptens{
+
+
+  // Memory is handed out sequentially from a list of blocks and is only ever
+  // released wholesale, either back to a previously taken mark or completely.
+  // Blocks are kept between uses, so after warming up there are no further
+  // calls to the system allocator.
+
+  template<typename TYPE>
+  class BumpArena{
+  public:
+
+    class Mark{
+    public:
+      int block=0;
+      int offs=0;
+    };
+
+    int block_size;
+    vector<pair<TYPE*,int> > blocks;
+    int current=0;
+    int offs=0;
+
+
+    ~BumpArena(){
+      for(auto& p:blocks)
+	delete[] p.first;
+    }
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    BumpArena(const int _block_size=4096):
+      block_size(_block_size){}
+
+    BumpArena(const BumpArena& x)=delete;
+    BumpArena& operator=(const BumpArena& x)=delete;
+
+
+  public: // ---- Allocation ---------------------------------------------------------------------------------
+
+
+    TYPE* alloc(const int n){
+      while(current<blocks.size() && offs+n>blocks[current].second){
+	current++;
+	offs=0;
+      }
+      if(current==blocks.size()){
+	int len=std::max(n,block_size);
+	blocks.push_back(pair<TYPE*,int>(new TYPE[len],len));
+	offs=0;
+      }
+      TYPE* r=blocks[current].first+offs;
+      offs+=n;
+      return r;
+    }
+
+    Mark mark() const{
+      Mark r;
+      r.block=current;
+      r.offs=offs;
+      return r;
+    }
+
+    void release(const Mark& m){
+      current=m.block;
+      offs=m.offs;
+    }
+
+    void reset(){
+      current=0;
+      offs=0;
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    size_t capacity() const{
+      size_t t=0;
+      for(auto& p:blocks)
+	t+=p.second;
+      return t;
+    }
+
+    size_t memsize() const{
+      return capacity()*sizeof(TYPE);
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "BumpArena";
+    }
+
+    string repr() const{
+      return "<BumpArena[blocks="+to_string(blocks.size())+",capacity="+to_string(capacity())+"]>";
+    }
+
+  };
+
+}
+
+#endif
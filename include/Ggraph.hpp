@@ -15,6 +15,10 @@
 #define _Ptens_Graph
 
 #include "Hgraph.hpp"
+#include "HgraphRegistry.hpp"
+#include "GraphPartition.hpp"
+#include "TransferMap.hpp"
+#include "PtensFindPlantedSubgraphs.hpp"
 
 
 namespace ptens{
@@ -25,6 +29,18 @@ namespace ptens{
 
     shared_ptr<Hgraph> obj;
 
+    // If the graph has been interned, structural queries and message plans are answered on the 
+    // representative of its isomorphism class and mapped back through from_canon. (Eigenbases 
+    // belong to the patterns, and are shared by the subgraph registry already.)
+    shared_ptr<Hgraph> canon;
+    vector<int> to_canon;
+    vector<int> from_canon;
+
+    // If the graph is a batch, the graphs it is the disjoint union of, and the index of the 
+    // first vertex of each in the union (with the total number of vertices at the end)
+    shared_ptr<vector<Ggraph> > members;
+    vector<int> offsets;
+
     Ggraph():
       obj(new Hgraph()){};
 
@@ -48,6 +64,36 @@ namespace ptens{
       if(n==-1) n=M.max()+1;
       return new Hgraph(M,n);}
 
+    template<typename ITYPE>
+    static Ggraph edge_index(const ITYPE* src, const ITYPE* dst, const int nedges, const int n=-1, const bool symmetrize=false){
+      return new Hgraph(Hgraph::edge_index(src,dst,nedges,n,symmetrize));}
+
+    // Share preprocessing with every other interned graph isomorphic to this one
+    Ggraph shared() const{
+      Ggraph R(*this);
+      auto p=ptens_graph_registry().intern(*obj);
+      R.canon=p.first;
+      R.to_canon=std::move(p.second);
+      R.from_canon.resize(R.to_canon.size());
+      for(int i=0; i<R.to_canon.size(); i++)
+	R.from_canon[R.to_canon[i]]=i;
+      return R;
+    }
+
+
+    // Disjoint union of a minibatch of graphs. Subgraph matches and neighborhoods of the batch 
+    // are assembled from those of its members (and so come from their caches where available). 
+    static Ggraph batch(const vector<Ggraph>& graphs){
+      vector<const Hgraph*> v;
+      for(auto& p:graphs) v.push_back(p.obj.get());
+      Ggraph R(new Hgraph(Hgraph::disjoint_union(v)));
+      R.members=make_shared<vector<Ggraph> >(graphs);
+      R.offsets.push_back(0);
+      for(auto& p:graphs)
+	R.offsets.push_back(R.offsets.back()+p.getn());
+      return R;
+    }
+
 
   public: // ---- Access --------------------------------------------------------------------------------------
 
@@ -64,15 +110,173 @@ namespace ptens{
       return obj==x.obj;
     }
 
+    bool is_shared() const{
+      return canon.get()!=nullptr;
+    }
+
+    bool is_batch() const{
+      return members.get()!=nullptr;
+    }
+
+    int nmembers() const{
+      if(!members) return 1;
+      return members->size();
+    }
+
+    // Rows are the occurrences of H, as in CachedPlantedSubgraphsMx. For a shared graph the rows 
+    // come in the order of the representative's matches, and the relabeled matrix is cached 
+    // under this graph's id.
+    shared_ptr<cnine::Tensor<int> > subgraphs_mx(const Hgraph& H) const{
+      if(members) return batch_subgraphs_mx(H);
+      if(!canon) return CachedPlantedSubgraphsMx(*obj,H).ptr;
+
+      auto sig=PtensCacheManager::signature(H);
+      size_t h=PtensCacheManager::hash_of(sig);
+      auto R=ptens_cache().find_mx(obj->get_cache_id(),h,sig);
+      if(R) return R;
+
+      const cnine::Tensor<int>& T=CachedPlantedSubgraphsMx(*canon,H);
+      R=shared_ptr<cnine::Tensor<int> >(new cnine::Tensor<int>(T));
+      int N=T.dims[0];
+      int k=T.dims[1];
+      for(int i=0; i<N; i++)
+	for(int j=0; j<k; j++)
+	  R->set(i,j,from_canon[T(i,j)]);
+      ptens_cache().insert(obj->get_cache_id(),h,sig,R);
+      return R;
+    }
+
+    // For a shared graph, row v is the representative's row for to_canon[v], relabeled, so the 
+    // result is the same as for an unshared graph. Uncapped results are cached on this graph.
+    AtomsPack nhoods(const int i, const int max_size=-1, const int seed=0) const{
+      if(members) return batch_nhoods(i,max_size,seed);
+      if(!canon) return obj->nhoods(i,max_size,seed);
+      if(max_size>0) return canon->nhoods(i,max_size,seed).relabel(from_canon,to_canon);
+      if(obj->_nhoods.size()<=i) obj->_nhoods.resize(i+1,nullptr);
+      if(!obj->_nhoods[i]) obj->_nhoods[i]=new AtomsPack(canon->nhoods(i).relabel(from_canon,to_canon));
+      return AtomsPack(*obj->_nhoods[i]);
+    }
+
+    // Listing the edges takes no more work than relabeling them would, so this is never shared
+    AtomsPack edges() const{
+      return obj->edges();
+    }
+
+
+  public: // ---- Message plans -------------------------------------------------------------------------------
+
+
+    // Overlap map between the reference domains x and y of two layers on this graph, as in 
+    // TransferMap(x,y). The map is cached under the representative's id with the domains in its 
+    // labels, so it is computed once for all isomorphic graphs whose layers list the same 
+    // domains in the same order up to the isomorphism (e.g., SubgraphLayers built from 
+    // subgraphs_mx(), whose rows follow the representative's matches).
+    shared_ptr<TransferMap> transfer_map(const AtomsPack& x, const AtomsPack& y) const{
+      const Hgraph& host=canon? *canon : *obj;
+      AtomsPack xc=canon? x.relabel(to_canon) : x;
+      AtomsPack yc=canon? y.relabel(to_canon) : y;
+
+      vector<int> sig;
+      sig.reserve(xc.tail+yc.tail+2*(xc.size()+yc.size())+2);
+      for(auto p:{&xc,&yc}){
+	sig.push_back(p->size());
+	for(int i=0; i<p->size(); i++){
+	  int offs=p->dir(i,0);
+	  int len=p->dir(i,1);
+	  sig.push_back(len);
+	  for(int j=0; j<len; j++)
+	    sig.push_back(p->arr[offs+j]);
+	}
+      }
+      size_t h=PtensCacheManager::hash_of(sig);
+      auto R=ptens_cache().find_tmap(host.get_cache_id(),h,sig);
+      if(R) return R;
+      R=make_shared<TransferMap>(xc,yc);
+      ptens_cache().insert(host.get_cache_id(),h,sig,R);
+      return R;
+    }
+
 
   public: // ---- Operations ----------------------------------------------------------------------------------
 
 
+    void freeze() const{
+      obj->freeze();
+      if(canon) canon->freeze();
+    }
+
+
+    GraphPartition partition(const int k, const float imbalance=0.05) const{
+      return GraphPartition(*obj,k,imbalance);
+    }
+
+
     Ggraph permute(const cnine::permutation& pi) const{
       return Ggraph(new Hgraph(obj->permute(pi)));
     }
 
 
+  private: // ---- Batches -------------------------------------------------------------------------------------
+
+
+    shared_ptr<cnine::Tensor<int> > batch_subgraphs_mx(const Hgraph& H) const{
+      auto sig=PtensCacheManager::signature(H);
+      size_t h=PtensCacheManager::hash_of(sig);
+      auto R=ptens_cache().find_mx(obj->get_cache_id(),h,sig);
+      if(R) return R;
+
+      int k=H.getn();
+      int N=0;
+      vector<shared_ptr<cnine::Tensor<int> > > parts;
+      for(auto& p:*members){
+	parts.push_back(p.subgraphs_mx(H));
+	N+=parts.back()->dims[0];
+      }
+      R=shared_ptr<cnine::Tensor<int> >(new cnine::Tensor<int>(cnine::Gdims(N,k)));
+      int t=0;
+      for(int g=0; g<parts.size(); g++){
+	const cnine::Tensor<int>& T=*parts[g];
+	for(int i=0; i<T.dims[0]; i++){
+	  for(int j=0; j<k; j++)
+	    R->set(t,j,T(i,j)+offsets[g]);
+	  t++;
+	}
+      }
+      ptens_cache().insert(obj->get_cache_id(),h,sig,R);
+      return R;
+    }
+
+    AtomsPack batch_nhoods(const int l, const int max_size, const int seed) const{
+      bool cached=(max_size<=0);
+      if(cached && obj->_nhoods.size()>l && obj->_nhoods[l]) return AtomsPack(*obj->_nhoods[l]);
+
+      vector<AtomsPack> parts;
+      int total=0;
+      for(auto& p:*members){
+	parts.push_back(p.nhoods(l,max_size,seed));
+	total+=parts.back().tail;
+      }
+      AtomsPack* R=new AtomsPack();
+      R->reserve(total);
+      for(int g=0; g<parts.size(); g++)
+	for(int i=0; i<parts[g].size(); i++){
+	  vector<int> v=parts[g](i);
+	  R->dir.push_back(R->tail,v.size());
+	  for(auto p:v)
+	    R->arr[R->tail++]=p+offsets[g];
+	}
+
+      if(!cached){
+	AtomsPack r(std::move(*R));
+	delete R;
+	return r;
+      }
+      if(obj->_nhoods.size()<=l) obj->_nhoods.resize(l+1,nullptr);
+      obj->_nhoods[l]=R;
+      return AtomsPack(*R);
+    }
+
+
   public: // ---- I/O -----------------------------------------------------------------------------------------
 
 
@@ -0,0 +1,442 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#ifndef _ptens_GraphPartition
+#define _ptens_GraphPartition
+
+#include "Ptens_base.hpp"
+#include "Hgraph.hpp"
+#include "RtensorPackB.hpp"
+#include "AtomsPack.hpp"
+#include "VertexReordering.hpp"
+
+
+namespace ptens{
+
+
+  // Split of the vertices of a graph into k parts for out-of-core or multi-process message
+  // passing. Each part owns a set of vertices, and its halo consists of the vertices owned by
+  // other parts that send messages to them. Within a part vertices are numbered locally,
+  // owned vertices first, and the part's graph only has the edges whose target is owned.
+  //
+  // Layers with one ptensor per vertex are split with localize(). After each round of message
+  // passing the halo rows are refreshed from their owners (forward) or their contributions
+  // are summed back into the owners (backward). The halo traffic between two parts is packed
+  // into flat float buffers, so it can go through any transport (pipes, shared memory, ...)
+  // or be exchanged in process with exchange_halo()/reduce_halo(). PartitionedLayer in
+  // PartitionedLayers.hpp wraps these steps for add_msg, gather and the SubgraphLayer constructors.
+
+  class GraphPartition{
+  public:
+
+    class Part{
+    public:
+
+      int id=0;
+      int nowned=0;
+      vector<int> globals;               // owned vertices, then halo vertices
+      shared_ptr<Hgraph> graph;          // edges into owned vertices, in local numbering
+      vector<vector<int> > send;         // send[q]: local indices of owned vertices in the halo of part q
+      vector<vector<int> > recv;         // recv[q]: local indices of halo vertices owned by q, matching q.send[id]
+
+      int size() const{
+	return globals.size();
+      }
+
+      int nhalo() const{
+	return globals.size()-nowned;
+      }
+
+    };
+
+
+    int n;
+    int k;
+    vector<int> owner;   // part of each vertex
+    vector<int> local;   // index of each vertex within its owner
+    vector<Part> parts;
+    int cut=0;           // number of edges between different parts
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    // Contiguous slices of the reverse Cuthill-McKee order balanced by number of incident
+    // edges, followed by greedy boundary refinement of the cut within the given imbalance.
+    GraphPartition(const Hgraph& G, const int _k, const float imbalance=0.05):
+      n(G.getn()), k(_k){
+      cnine::flog timer("GraphPartition");
+      PTENS_ASSRT(G.getn()==G.m);
+      PTENS_ASSRT(k>0 && k<=std::max(n,1));
+      make_owners(G,imbalance);
+      build(G);
+    }
+
+    // With the assignment of vertices to parts given, e.g., by an external partitioner
+    GraphPartition(const Hgraph& G, const vector<int>& _owner):
+      n(G.getn()), owner(_owner){
+      PTENS_ASSRT(G.getn()==G.m);
+      PTENS_ASSRT(owner.size()==n);
+      k=0;
+      for(auto p:owner){
+	PTENS_ASSRT(p>=0);
+	k=std::max(k,p+1);
+      }
+      build(G);
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    const Part& operator[](const int p) const{
+      return parts[p];
+    }
+
+    int nhalo() const{
+      int t=0;
+      for(auto& p:parts)
+	t+=p.nhalo();
+      return t;
+    }
+
+
+  public: // ---- Localization -------------------------------------------------------------------------------
+
+
+    // The reference domains of the ptensors of part p. The atoms keep their global labels.
+    AtomsPack atoms(const int p, const AtomsPack& x) const{
+      PTENS_ASSRT(x.size()==n);
+      const Part& P=parts[p];
+      AtomsPack R;
+      int t=0;
+      for(auto g:P.globals)
+	t+=x.size_of(g);
+      R.reserve(t);
+      for(auto g:P.globals){
+	vector<int> v=x(g);
+	R.dir.push_back(R.tail,v.size());
+	for(auto a:v)
+	  R.arr[R.tail++]=a;
+      }
+      return R;
+    }
+
+    // Ptensors0/1/2 layer with one ptensor per vertex restricted to part p, halo included
+    template<typename PACK>
+    PACK localize(const int p, const PACK& x) const{
+      PTENS_ASSRT(x.dev==0);
+      const Part& P=parts[p];
+      PACK R=PACK::zero(atoms(p,x.atoms),x.get_nc());
+      for(int l=0; l<P.size(); l++)
+	std::copy(row_begin(x,P.globals[l]),row_begin(x,P.globals[l])+row_size(x,P.globals[l]),row_begin(R,l));
+      return R;
+    }
+
+    // Add the owned rows of the local layer x of part p to the global layer r
+    template<typename PACK>
+    void add_to_global(PACK& r, const int p, const PACK& x) const{
+      PTENS_ASSRT(r.dev==0 && x.dev==0);
+      const Part& P=parts[p];
+      for(int l=0; l<P.nowned; l++){
+	const float* src=row_begin(x,l);
+	float* dest=row_begin(r,P.globals[l]);
+	int s=row_size(x,l);
+	for(int t=0; t<s; t++) dest[t]+=src[t];
+      }
+    }
+
+
+  public: // ---- Halo exchange ------------------------------------------------------------------------------
+
+
+    // Values of the owned rows of part p that are in the halo of part q
+    template<typename PACK>
+    vector<float> pack_halo(const int p, const int q, const PACK& x) const{
+      return pack_rows(x,parts[p].send[q]);
+    }
+
+    // Overwrite the halo rows of part q owned by p with a buffer from pack_halo(p,q,.)
+    template<typename PACK>
+    void unpack_halo(const int q, const int p, const vector<float>& buf, PACK& x) const{
+      unpack_rows(x,parts[q].recv[p],buf,false);
+    }
+
+    // Contributions accumulated in the halo rows of part q that belong to part p
+    template<typename PACK>
+    vector<float> pack_halo_back(const int q, const int p, const PACK& x) const{
+      return pack_rows(x,parts[q].recv[p]);
+    }
+
+    // Add a buffer from pack_halo_back(q,p,.) to the owned rows of part p
+    template<typename PACK>
+    void unpack_halo_back(const int p, const int q, const vector<float>& buf, PACK& x) const{
+      unpack_rows(x,parts[p].send[q],buf,true);
+    }
+
+    // Owned rows of the local layer x of part p, e.g., to send results back to a coordinating process
+    template<typename PACK>
+    vector<float> pack_owned(const int p, const PACK& x) const{
+      vector<int> rows(parts[p].nowned);
+      for(int l=0; l<rows.size(); l++) rows[l]=l;
+      return pack_rows(x,rows);
+    }
+
+    // Length of the buffer pack_owned(p,.) returns for a local version of the global layer x
+    template<typename PACK>
+    size_t owned_size(const int p, const PACK& x) const{
+      const Part& P=parts[p];
+      size_t t=0;
+      for(int l=0; l<P.nowned; l++)
+	t+=row_size(x,P.globals[l]);
+      return t;
+    }
+
+    // Add a buffer from pack_owned(p,.) to the global layer r
+    template<typename PACK>
+    void unpack_owned(const int p, const vector<float>& buf, PACK& r) const{
+      const Part& P=parts[p];
+      unpack_rows(r,vector<int>(P.globals.begin(),P.globals.begin()+P.nowned),buf,true);
+    }
+
+    // In process versions for when all the parts are held by the same process
+    template<typename PACK>
+    void exchange_halo(vector<PACK>& x) const{
+      PTENS_ASSRT(x.size()==k);
+      for(int p=0; p<k; p++)
+	for(int q=0; q<k; q++)
+	  if(parts[p].send[q].size()>0)
+	    unpack_halo(q,p,pack_halo(p,q,x[p]),x[q]);
+    }
+
+    template<typename PACK>
+    void reduce_halo(vector<PACK>& x) const{
+      PTENS_ASSRT(x.size()==k);
+      for(int q=0; q<k; q++)
+	for(int p=0; p<k; p++)
+	  if(parts[q].recv[p].size()>0)
+	    unpack_halo_back(p,q,pack_halo_back(q,p,x[q]),x[p]);
+    }
+
+
+  private: // ---- Partitioning ------------------------------------------------------------------------------
+
+
+    void make_owners(const Hgraph& G, const float imbalance){
+      vector<int> src;
+      vector<int> dst;
+      G.for_each_edge([&](const int i, const int j){
+	  if(i==j) return;
+	  src.push_back(i);
+	  dst.push_back(j);
+	});
+      Hgraph S=Hgraph::edge_index(src.data(),dst.data(),src.size(),n,true);
+      const HgraphCSR& A=*S.frozen();
+
+      vector<int> w(n);
+      long long W=0;
+      for(int i=0; i<n; i++){
+	w[i]=1+A.degree(i);
+	W+=w[i];
+      }
+
+      VertexReordering order(S);
+      owner.assign(n,0);
+      vector<long long> load(k,0);
+      long long cum=0;
+      int cur=0;
+      for(auto v:order.inverse){
+	while(cur<k-1 && cum>=W*(cur+1)/k) cur++;
+	owner[v]=cur;
+	load[cur]+=w[v];
+	cum+=w[v];
+      }
+
+      // Move boundary vertices to the part most of their neighbors are in
+      long long maxload=W*(1.0+imbalance)/k+1;
+      vector<int> count(k,0);
+      vector<int> touched;
+      for(int pass=0; pass<8; pass++){
+	int moves=0;
+	for(int v=0; v<n; v++){
+	  int a=owner[v];
+	  const int* c=A.cols_of(v);
+	  for(int t=0; t<A.degree(v); t++){
+	    int b=owner[c[t]];
+	    if(count[b]++==0) touched.push_back(b);
+	  }
+	  int best=a;
+	  for(auto b:touched)
+	    if(count[b]>count[best] && load[b]+w[v]<=maxload) best=b;
+	  if(best!=a && load[a]>w[v]){
+	    load[a]-=w[v];
+	    load[best]+=w[v];
+	    owner[v]=best;
+	    moves++;
+	  }
+	  for(auto b:touched) count[b]=0;
+	  touched.clear();
+	}
+	if(moves==0) break;
+      }
+    }
+
+
+    void build(const Hgraph& G){
+      local.assign(n,-1);
+      parts.resize(k);
+      for(int p=0; p<k; p++){
+	parts[p].id=p;
+	parts[p].send.resize(k);
+	parts[p].recv.resize(k);
+      }
+      for(int v=0; v<n; v++){
+	Part& P=parts[owner[v]];
+	local[v]=P.globals.size();
+	P.globals.push_back(v);
+      }
+      for(auto& P:parts)
+	P.nowned=P.globals.size();
+
+      cut=0;
+      G.for_each_edge([&](const int i, const int j){
+	  if(owner[i]!=owner[j]) cut++;});
+
+      for(auto& P:parts){
+	int p=P.id;
+
+	// Halo, ordered by owner and then by global index
+	vector<int> halo;
+	std::unordered_map<int,int> halo_local;
+	for(int l=0; l<P.nowned; l++)
+	  G.for_each_neighbor_of(P.globals[l],[&](const int j, const float v){
+	      if(owner[j]!=p && halo_local.find(j)==halo_local.end()){
+		halo_local[j]=-1;
+		halo.push_back(j);
+	      }
+	    });
+	std::sort(halo.begin(),halo.end(),[&](const int a, const int b){
+	    if(owner[a]!=owner[b]) return owner[a]<owner[b];
+	    return a<b;});
+	for(auto j:halo){
+	  halo_local[j]=P.globals.size();
+	  P.recv[owner[j]].push_back(P.globals.size());
+	  parts[owner[j]].send[p].push_back(local[j]);
+	  P.globals.push_back(j);
+	}
+
+	// Local graph in CSR form
+	int nl=P.globals.size();
+	auto C=make_shared<HgraphCSR>(nl);
+	vector<pair<int,float> > buf;
+	for(int l=0; l<P.nowned; l++){
+	  buf.clear();
+	  G.for_each_neighbor_of(P.globals[l],[&](const int j, const float v){
+	      buf.push_back(make_pair(owner[j]==p?local[j]:halo_local[j],v));});
+	  std::sort(buf.begin(),buf.end());
+	  C->offsets[l+1]=buf.size();
+	  for(auto& e:buf){
+	    C->cols.push_back(e.first);
+	    C->vals.push_back(e.second);
+	  }
+	  if(buf.size()>0) C->rows.push_back(l);
+	}
+	for(int i=0; i<nl; i++)
+	  C->offsets[i+1]+=C->offsets[i];
+
+	P.graph=make_shared<Hgraph>(nl);
+	if(G.is_labeled){
+	  cnine::RtensorA L(cnine::Gdims({nl}),cnine::fill_zero());
+	  for(int l=0; l<nl; l++)
+	    L.set(l,G.labels(P.globals[l]));
+	  P.graph->set_labels(L);
+	}
+	P.graph->csr=C;
+	P.graph->lists_pending=true;
+      }
+    }
+
+
+  public: // ---- Rows ---------------------------------------------------------------------------------------
+
+
+    static int row_size(const cnine::RtensorPackB& x, const int i){
+      vector<int> h=x.headers(i);
+      int s=1;
+      for(int j=1; j<h.size(); j++) s*=h[j];
+      return s;
+    }
+
+    static float* row_begin(const cnine::RtensorPackB& x, const int i){
+      return x.arr+x.headers(i)[0];
+    }
+
+
+  private:
+
+    template<typename PACK>
+    static vector<float> pack_rows(const PACK& x, const vector<int>& rows){
+      PTENS_ASSRT(x.dev==0);
+      size_t t=0;
+      for(auto i:rows) t+=row_size(x,i);
+      vector<float> R(t);
+      t=0;
+      for(auto i:rows){
+	int s=row_size(x,i);
+	std::copy(row_begin(x,i),row_begin(x,i)+s,R.begin()+t);
+	t+=s;
+      }
+      return R;
+    }
+
+    template<typename PACK>
+    static void unpack_rows(PACK& x, const vector<int>& rows, const vector<float>& buf, const bool add){
+      PTENS_ASSRT(x.dev==0);
+      size_t t=0;
+      for(auto i:rows){
+	int s=row_size(x,i);
+	PTENS_ASSRT(t+s<=buf.size());
+	float* dest=row_begin(x,i);
+	if(add) for(int j=0; j<s; j++) dest[j]+=buf[t+j];
+	else std::copy(buf.begin()+t,buf.begin()+t+s,dest);
+	t+=s;
+      }
+      PTENS_ASSRT(t==buf.size());
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "ptens::GraphPartition";
+    }
+
+    string repr() const{
+      return "<GraphPartition[n="+to_string(n)+",k="+to_string(k)+",cut="+to_string(cut)+",halo="+to_string(nhalo())+"]>";
+    }
+
+    string str(const string indent="") const{
+      ostringstream oss;
+      for(auto& P:parts)
+	oss<<indent<<"Part "<<P.id<<": "<<P.nowned<<" owned, "<<P.nhalo()<<" halo, "<<P.graph->nedges()<<" edges"<<endl;
+      return oss.str();
+    }
+
+    friend ostream& operator<<(ostream& stream, const GraphPartition& x){
+      stream<<x.str(); return stream;}
+
+  };
+
+}
+
+#endif
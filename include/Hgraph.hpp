@@ -15,17 +15,23 @@
 #define _Hgraph
 
 #include <set>
+#include <random>
+#include <mutex>
+#include <unordered_map>
 #include "Ptens_base.hpp"
 #include "cpermutation.hpp"
 #include "SparseRmatrix.hpp"
 #include "Tensor.hpp"
 //#include "SparseRmatrixB.hpp"
 #include "AtomsPack.hpp"
+#include "HgraphCSR.hpp"
+#include "PtensParallel.hpp"
 #include "AindexPack.hpp"
 #include "GatherMap.hpp"
 #include "labeled_tree.hpp"
 #include "map_of_lists.hpp"
 #include "flog.hpp"
+#include "PtensCacheManager.hpp"
 //#include "PtensLoggedTimer.hpp"
 
 extern cnine::CnineLog cnine::cnine_log;
@@ -34,6 +40,40 @@ extern cnine::CnineLog cnine::cnine_log;
 namespace ptens{
 
 
+  // A cached result of Hgraph::merge. Shared input packs are never modified, so they are 
+  // matched by id(). For any other input a copy is kept and compared in full, the hash only 
+  // serves to skip most of the comparisons.
+
+  class MergedAtoms{
+  public:
+
+    size_t id=0; // id of the input if it was shared, 0 otherwise
+    size_t hash=0;
+    AtomsPack input;
+    AtomsPack* result;
+
+    MergedAtoms(const AtomsPack& x, const size_t _hash, AtomsPack* _result):
+      hash(_hash), result(_result){
+      if(x.is_shared()) id=x.id();
+      else input=x;
+    }
+
+    ~MergedAtoms(){
+      delete result;
+    }
+
+    MergedAtoms(const MergedAtoms& x)=delete;
+    MergedAtoms& operator=(const MergedAtoms& x)=delete;
+
+    bool matches(const AtomsPack& x, const size_t h) const{
+      if(id>0) return x.is_shared() && x.id()==id;
+      if(h!=hash) return false;
+      return static_cast<const cnine::array_pool<int>&>(input)==static_cast<const cnine::array_pool<int>&>(x);
+    }
+
+  };
+
+
   class Hgraph: public cnine::SparseRmatrix{
   public:
 
@@ -51,19 +91,24 @@ namespace ptens{
     mutable shared_ptr<cnine::GatherMap> bmap;
     mutable vector<AtomsPack*> _nhoods; 
     mutable AtomsPack* _edges=nullptr;
-    mutable unordered_map<BaseMatrix,cnine::array_pool<int>*> subgraphlist_cache;
-    mutable unordered_map<BaseMatrix,shared_ptr<cnine::Tensor<int> > > subgraphlistmx_cache;
-    //mutable HgraphSubgraphListCache* subgraphlist_cache=nullptr;
+    mutable vector<MergedAtoms*> _merged; // results of merge, most recently used first, see MergedAtoms
+    mutable int cache_id=-1; // subgraph lists are kept in ptens_cache() under this id
+    mutable shared_ptr<HgraphCSR> csr; // set by freeze(), dropped on mutation
+    mutable std::atomic<bool> lists_pending{false};  // row lists still to be filled in from csr (bulk constructed graphs)
+    mutable std::mutex materialize_mx;               // guards materialize(), not copied
+    mutable std::mutex merged_mx;                    // guards _merged, not copied
+    mutable std::atomic<size_t> _fingerprint{0};      // 0 if not computed yet, reset by set()
 
     ~Hgraph(){
       if(_reverse) delete _reverse; // hack!
       for(auto p:_nhoods)
 	delete p;
+      for(auto p:_merged)
+	delete p;
       if(!_edges) delete _edges;
       if(gmap) delete gmap;
       //if(bmap) delete bmap;
-      for(auto p:subgraphlist_cache) delete p.second;
-      //delete subgraphlist_cache;
+      if(cache_id>=0) ptens_cache().erase_graph(cache_id);
     }
 
 
@@ -167,6 +212,78 @@ namespace ptens{
       return R;
     }
 
+    // Bulk construction from an integer edge list (e.g., the two rows of a PyG edge_index tensor). 
+    // The edges are bucketed by source vertex in parallel, sorted and deduplicated within each 
+    // row, and optionally symmetrized. The resulting graph starts out frozen, and the row lists 
+    // of the underlying SparseRmatrix are only built if needed (see materialize() and matrix()).
+    template<typename ITYPE>
+    static Hgraph edge_index(const ITYPE* src, const ITYPE* dst, const int nedges, int n=-1, const bool symmetrize=false){
+      if(n==-1){
+	ITYPE mx=-1;
+	for(int i=0; i<nedges; i++) mx=std::max(mx,std::max(src[i],dst[i]));
+	n=mx+1;
+      }
+      Hgraph R(n);
+      R.fill_edges(src,dst,nedges,symmetrize);
+      return R;
+    }
+
+    template<typename ITYPE>
+    static Hgraph edge_index(const ITYPE* src, const ITYPE* dst, const int nedges, const cnine::RtensorA& L, const bool symmetrize=false){
+      PTENS_ASSRT(L.dims.size()==1);
+      Hgraph R(L.dims[0],L);
+      R.fill_edges(src,dst,nedges,symmetrize);
+      return R;
+    }
+
+    // Block diagonal union, assembled directly from the CSR of each graph. Like the bulk 
+    // constructors, the result starts out frozen.
+    static Hgraph disjoint_union(const vector<const Hgraph*>& graphs){
+      int N=0;
+      int E=0;
+      bool labeled=graphs.size()>0 && graphs[0]->is_labeled;
+      for(auto p:graphs){
+	PTENS_ASSRT(p->is_labeled==labeled);
+	E+=p->freeze().nedges();
+	N+=p->getn();
+      }
+
+      Hgraph R(N);
+      if(labeled){
+	cnine::RtensorA L(cnine::Gdims({N}),cnine::fill_zero());
+	int offs=0;
+	for(auto p:graphs){
+	  for(int i=0; i<p->getn(); i++)
+	    L.set(offs+i,p->labels(i));
+	  offs+=p->getn();
+	}
+	R.set_labels(L);
+      }
+
+      auto C=make_shared<HgraphCSR>(N);
+      C->cols.resize(E);
+      C->vals.resize(E);
+      int offs=0;
+      int tail=0;
+      for(auto p:graphs){
+	const HgraphCSR& A=*p->csr;
+	for(int i=0; i<A.n; i++)
+	  C->offsets[offs+i+1]=tail+A.offsets[i+1];
+	for(auto i:A.rows)
+	  C->rows.push_back(offs+i);
+	for(int j=0; j<A.nedges(); j++){
+	  C->cols[tail+j]=A.cols[j]+offs;
+	  C->vals[tail+j]=A.vals[j];
+	}
+	C->sorted=C->sorted && A.sorted;
+	offs+=A.n;
+	tail+=A.nedges();
+      }
+      R.csr=C;
+      R.lists_pending=true;
+      return R;
+    }
+
     static Hgraph random(const int _n, const float p=0.5){
       return BaseMatrix::random_symmetric(_n,p);
     }
@@ -239,12 +356,18 @@ namespace ptens{
     Hgraph(const Hgraph& x):
       BaseMatrix(x), 
       labels(x.labels),
-      is_labeled(x.is_labeled){}
+      is_labeled(x.is_labeled),
+      csr(x.csr),
+      lists_pending(x.lists_pending.load()),
+      _fingerprint(x._fingerprint.load()){}
 
     Hgraph(Hgraph&& x):
       BaseMatrix(std::move(x)),
       labels(std::move(x.labels)),
-      is_labeled(x.is_labeled){}
+      is_labeled(x.is_labeled),
+      csr(std::move(x.csr)),
+      lists_pending(x.lists_pending.load()),
+      _fingerprint(x._fingerprint.load()){}
 
     Hgraph& operator=(const Hgraph& x)=delete;
 
@@ -272,6 +395,7 @@ namespace ptens{
     }
 
     bool is_empty() const{
+      if(lists_pending) return csr->nedges()==0;
       for(auto q:lists)
 	if(q.second->size()>0)
 	  return false;
@@ -279,6 +403,7 @@ namespace ptens{
     }
 
     int nedges() const{
+      if(lists_pending) return csr->nedges();
       int t=0;
       for(auto q:lists)
 	if(q.second->size()>0)
@@ -286,6 +411,28 @@ namespace ptens{
       return t;
     }
 
+    bool is_cycle() const{
+      if(n<3 || n!=m) return false;
+      for(int i=0; i<n; i++){
+	const auto& r=row(i);
+	if(r.size()!=2) return false;
+	for(auto& p:r)
+	  if(p.first==i || p.second!=1.0) return false;
+      }
+      int prev=-1;
+      int v=0;
+      int t=0;
+      do{
+	int next=-1;
+	for(auto& p:row(v))
+	  if(p.first!=prev){next=p.first; break;}
+	prev=v;
+	v=next;
+	t++;
+      }while(v!=0 && t<=n);
+      return t==n;
+    }
+
     void insert(const Hgraph& H, vector<int> v){
       for(auto p:v)
 	PTENS_ASSRT(p<n);
@@ -294,6 +441,7 @@ namespace ptens{
     }
 
     vector<int> neighbors(const int i) const{
+      if(csr) return vector<int>(csr->cols_of(i),csr->cols_of(i)+csr->degree(i));
       vector<int> r;
       const auto _r=row(i);
       for(auto& p: _r)
@@ -301,7 +449,123 @@ namespace ptens{
       return r;
     }
 
+    float operator()(const int i, const int j) const{
+      if(csr) return (*csr)(i,j);
+      return BaseMatrix::operator()(i,j);
+    }
+
+    decltype(auto) row(const int i) const{
+      materialize();
+      return BaseMatrix::row(i);
+    }
+
+    void set(const int i, const int j, const float v){
+      materialize();
+      csr.reset();
+      _fingerprint=0;
+      if(!_merged.empty()){ // the graph must not be in use while it is modified
+	std::lock_guard<std::mutex> lock(merged_mx);
+	clear_merged();
+      }
+      BaseMatrix::set(i,j,v);
+    }
+
+    // Labels must be written through these, so that the fingerprint is recomputed
+    void set_labels(const RtensorA& L){
+      PTENS_ASSRT(L.dims.size()==1);
+      PTENS_ASSRT(L.dims[0]==n);
+      labels=L;
+      is_labeled=true;
+      _fingerprint=0;
+    }
+
+    void set_label(const int i, const float v){
+      PTENS_ASSRT(is_labeled && i<n);
+      labels.set(i,v);
+      _fingerprint=0;
+    }
+
+    // 64 bit hash of the dimensions, edges, edge weights and labels, computed by freeze() or on 
+    // first use, and kept until the graph is modified with set() or set_label(s).
+    size_t fingerprint() const{
+      size_t h=_fingerprint.load(std::memory_order_relaxed);
+      if(h!=0) return h;
+      h=fingerprint_mix(0x243f6a8885a308d3ULL,n);
+      h=fingerprint_mix(h,m);
+      h=fingerprint_mix(h,is_labeled);
+      size_t e=0; // per-edge hashes are summed, so the result does not depend on the storage order
+      for_each_edge([&](const int i, const int j, const float v){
+	  size_t t=fingerprint_mix(0x13198a2e03707344ULL,i);
+	  t=fingerprint_mix(t,j);
+	  e+=fingerprint_mix(t,(unsigned int)PtensCacheManager::float_bits(v));
+	});
+      h=fingerprint_mix(h,e);
+      if(is_labeled)
+	for(int i=0; i<n; i++)
+	  h=fingerprint_mix(h,(unsigned int)PtensCacheManager::float_bits(labels(i)));
+      if(h==0) h=1;
+      _fingerprint.store(h,std::memory_order_relaxed);
+      return h;
+    }
+
+    // Graphs with different fingerprints are rejected without looking at their edges. Otherwise 
+    // the edges are compared in place: array by array if both graphs are frozen with sorted rows, 
+    // row by row if not. Weights and labels are compared bitwise, as in the fingerprint.
+    bool operator==(const Hgraph& x) const{
+      if(this==&x) return true;
+      if(n!=x.n || m!=x.m || is_labeled!=x.is_labeled) return false;
+      if(fingerprint()!=x.fingerprint()) return false;
+      auto same=[](const float a, const float b){
+	return PtensCacheManager::float_bits(a)==PtensCacheManager::float_bits(b);};
+      if(is_labeled)
+	for(int i=0; i<n; i++)
+	  if(!same(labels(i),x.labels(i))) return false;
+      if(csr && x.csr && csr->sorted && x.csr->sorted)
+	return csr->offsets==x.csr->offsets && csr->cols==x.csr->cols && 
+	  std::equal(csr->vals.begin(),csr->vals.end(),x.csr->vals.begin(),same);
+      vector<pair<int,float> > u;
+      vector<pair<int,float> > v;
+      for(int i=0; i<n; i++){
+	u.clear();
+	v.clear();
+	for_each_neighbor_of(i,[&](const int j, const float w){u.emplace_back(j,w);});
+	x.for_each_neighbor_of(i,[&](const int j, const float w){v.emplace_back(j,w);});
+	if(u.size()!=v.size()) return false;
+	std::sort(u.begin(),u.end());
+	std::sort(v.begin(),v.end());
+	for(int t=0; t<u.size(); t++)
+	  if(u[t].first!=v[t].first || !same(u[t].second,v[t].second)) return false;
+      }
+      return true;
+    }
+
+    bool operator!=(const Hgraph& x) const{
+      return !(*this==x);
+    }
+
+    decltype(auto) dense() const{
+      materialize();
+      return BaseMatrix::dense();
+    }
+
+    decltype(auto) csrmatrix() const{
+      materialize();
+      return BaseMatrix::csrmatrix();
+    }
+
+    // The graph as a SparseRmatrix with its row lists filled in (see materialize())
+    const BaseMatrix& matrix() const{
+      materialize();
+      return *this;
+    }
+
+    int get_cache_id() const{
+      if(cache_id<0) cache_id=ptens_cache().new_graph_id();
+      return cache_id;
+    }
+
     const Hgraph& reverse() const{
+      materialize();
       if(!_reverse) _reverse=new Hgraph(transp());
       return *_reverse;
     }
@@ -311,58 +575,351 @@ namespace ptens{
       return *gmap;
     }
 
-    void for_each_neighbor_of(const int i, std::function<void(const int, const float)> lambda) const{
+    template<typename FN>
+    void for_each_neighbor_of(const int i, const FN& lambda) const{
+      if(csr){
+	csr->for_each_neighbor_of(i,lambda);
+	return;
+      }
       const auto& r=row(i);
       for(auto& p: r)
 	lambda(p.first,p.second);
     }
 
-    void for_each_edge(std::function<void(const int, const int)> lambda, const bool self=0) const{
+    // The lambda can take (i,j) or (i,j,value)
+    template<typename FN>
+    void for_each_edge(const FN& lambda, const bool self=0) const{
+      if(csr){
+	for(auto i:csr->rows){
+	  if(self) edge_call(lambda,i,i,1.0);
+	  const int* c=csr->cols_of(i);
+	  const float* v=csr->vals_of(i);
+	  for(int t=0; t<csr->degree(i); t++)
+	    edge_call(lambda,i,c[t],v[t]);
+	}
+	return;
+      }
       for(auto& p: lists){
 	int i=p.first;
-	if(self) lambda(i,i);
+	if(self) edge_call(lambda,i,i,1.0);
 	p.second->forall_nonzero([&](const int j, const float v){
-	    lambda(i,j);});
+	    edge_call(lambda,i,j,v);});
       }
     }
 
-    void for_each_edge(std::function<void(const int, const int, const float)> lambda, const bool self=0) const{
-      for(auto& p: lists){
-	int i=p.first;
-	if(self) lambda(i,i,1.0);
-	p.second->forall_nonzero([&](const int j, const float v){
-	    lambda(i,j,v);});
+    template<typename FN>
+    void forall_edges(const FN& lambda, const bool self=0) const{
+      for_each_edge(lambda,self);
+    }
+
+
+  public: // ---- Freezing -----------------------------------------------------------------------------------
+
+
+    // Build an immutable CSR copy of the adjacency structure. Once the graph is frozen, 
+    // the traversals in this class and the subgraph matcher use it instead of the 
+    // per-row lists of SparseRmatrix. Calling set() unfreezes the graph.
+    const HgraphCSR& freeze() const{
+      if(!csr){
+	csr=shared_ptr<HgraphCSR>(make_csr());
+	fingerprint();
       }
+      return *csr;
+    }
+
+    bool is_frozen() const{
+      return csr.get()!=nullptr;
+    }
+
+    const HgraphCSR* frozen() const{
+      return csr.get();
+    }
+
+    void unfreeze(){
+      materialize();
+      csr.reset();
     }
 
-    void forall_edges(std::function<void(const int, const int, const float)> lambda, const bool self=0) const{
+    // Graphs from the bulk constructors start out with only the CSR. The row lists of the 
+    // underlying SparseRmatrix are filled in the first time something asks for them. 
+    // The accessors of this class call it themselves; code that needs the graph as a 
+    // plain SparseRmatrix must go through matrix(), since the base class methods are 
+    // not virtual and do not know about the pending lists. 
+    void materialize() const{
+      if(!lists_pending) return;
+      std::lock_guard<std::mutex> lock(materialize_mx);
+      if(!lists_pending) return;
+      Hgraph& self=const_cast<Hgraph&>(*this);
+      for(auto i:csr->rows)
+	for(int t=csr->offsets[i]; t<csr->offsets[i+1]; t++)
+	  self.BaseMatrix::set(i,csr->cols[t],csr->vals[t]);
+      lists_pending=false;
+    }
+
+    HgraphCSR* make_csr() const{
+      auto R=new HgraphCSR(n);
       for(auto& p: lists){
-	int i=p.first;
-	if(self) lambda(i,i,1.0);
+	R->rows.push_back(p.first);
 	p.second->forall_nonzero([&](const int j, const float v){
-	    lambda(i,j,v);});
+	    R->offsets[p.first+1]++;});
       }
+      for(int i=0; i<n; i++) R->offsets[i+1]+=R->offsets[i];
+      R->cols.resize(R->offsets[n]);
+      R->vals.resize(R->offsets[n]);
+      for(auto& p: lists){
+	int t=R->offsets[p.first];
+	p.second->forall_nonzero([&](const int j, const float v){
+	    if(t>R->offsets[p.first] && R->cols[t-1]>j) R->sorted=false;
+	    R->cols[t]=j;
+	    R->vals[t++]=v;});
+      }
+      return R;
     }
 
-    AtomsPack nhoods(const int i) const{
-      if(_nhoods.size()==0) _nhoods.push_back(new AtomsPack(n));
-      for(int j=_nhoods.size(); j<=i; j++){
-	const AtomsPack& prev=*_nhoods.back();
-	assert(prev.size()==n);
-	AtomsPack* newlevel=new AtomsPack();
-	for(int i=0; i<prev.size(); i++){
-	  vector<int> v=prev(i);
-	  std::set<int> w;
-	  for(auto p:v){
-	    w.insert(p);
-	    for(auto q: const_cast<Hgraph&>(*this).row(p))
-	      w.insert(q.first);
+
+  private:
+
+    static size_t fingerprint_mix(size_t h, size_t x){
+      x*=0xff51afd7ed558ccdULL;
+      x^=x>>33;
+      x*=0xc4ceb9fe1a85ec53ULL;
+      x^=x>>33;
+      return (h^x)*0x9e3779b97f4a7c15ULL+0x632be59bd9b4e019ULL;
+    }
+
+    template<typename ITYPE>
+    void fill_edges(const ITYPE* src, const ITYPE* dst, const int nedges, const bool symmetrize){
+      cnine::flog timer("Hgraph::fill_edges");
+      PTENS_ASSRT(is_empty());
+
+      // Edges are split into contiguous blocks, each with its own histogram over the source 
+      // vertices, so the counting and scattering passes need no atomics.
+      int nb=parallel_nthreads(nedges,-1,1<<14);
+      nb=std::max(1,std::min<int>(nb,(1<<24)/(n+1)));
+      vector<vector<int> > hist(nb);
+      vector<char> bad(nb,0);
+      parallel_for(nb,[&](const int tid, const int b){
+	  vector<int>& h=hist[b];
+	  h.assign(n,0);
+	  for(int e=(long)nedges*b/nb; e<(long)nedges*(b+1)/nb; e++){
+	    ITYPE i=src[e];
+	    ITYPE j=dst[e];
+	    if(i<0 || i>=n || j<0 || j>=n){bad[b]=1; continue;}
+	    h[i]++;
+	    if(symmetrize) h[j]++;
+	  }
+	},nb,1);
+      for(auto p:bad) PTENS_ASSRT(!p);
+
+      vector<int> offs(n+1,0);
+      for(int i=0; i<n; i++){
+	int t=offs[i];
+	for(int b=0; b<nb; b++){
+	  int c=hist[b][i];
+	  hist[b][i]=t;
+	  t+=c;
+	}
+	offs[i+1]=t;
+      }
+
+      vector<int> buf(offs[n]);
+      parallel_for(nb,[&](const int tid, const int b){
+	  vector<int>& pos=hist[b];
+	  for(int e=(long)nedges*b/nb; e<(long)nedges*(b+1)/nb; e++){
+	    int i=src[e];
+	    int j=dst[e];
+	    buf[pos[i]++]=j;
+	    if(symmetrize) buf[pos[j]++]=i;
 	  }
-	  newlevel->push_back(w);
+	},nb,1);
+      hist.clear();
+
+      vector<int> deg(n);
+      parallel_for(n,[&](const int tid, const int i){
+	  auto b=buf.begin()+offs[i];
+	  auto e=buf.begin()+offs[i+1];
+	  std::sort(b,e);
+	  deg[i]=std::unique(b,e)-b;
+	},-1,256);
+
+      auto C=make_shared<HgraphCSR>(n);
+      for(int i=0; i<n; i++){
+	C->offsets[i+1]=C->offsets[i]+deg[i];
+	if(deg[i]>0) C->rows.push_back(i);
+      }
+      C->cols.resize(C->offsets[n]);
+      C->vals.assign(C->offsets[n],1.0);
+      parallel_for(n,[&](const int tid, const int i){
+	  std::copy(buf.begin()+offs[i],buf.begin()+offs[i]+deg[i],C->cols.begin()+C->offsets[i]);
+	},-1,256);
+
+      csr=C;
+      lists_pending=true;
+    }
+
+    // Bounded BFS from every vertex, run in parallel. A first pass establishes the size of 
+    // each neighborhood, the second writes it directly into its slot in the output pool.
+    AtomsPack* make_nhoods(const int k, const int max_size, const int seed) const{
+      cnine::flog timer("Hgraph::make_nhoods");
+      unique_ptr<HgraphCSR> local;
+      const HgraphCSR* C=csr.get();
+      if(!C){
+	local.reset(make_csr());
+	C=local.get();
+      }
+
+      int nt=parallel_nthreads(n);
+      vector<vector<int> > stamps(nt,vector<int>(n,-1));
+      vector<vector<int> > balls(nt);
+
+      // returns the start of the outermost level in ball
+      auto bfs=[&](const int v, vector<int>& stamp, vector<int>& ball){
+	ball.clear();
+	ball.push_back(v);
+	stamp[v]=v;
+	int level_start=0;
+	for(int d=0; d<k; d++){
+	  if(max_size>0 && ball.size()>=max_size) break;
+	  int end=ball.size();
+	  for(int t=level_start; t<end; t++){
+	    const int* c=C->cols_of(ball[t]);
+	    int deg=C->degree(ball[t]);
+	    for(int j=0; j<deg; j++)
+	      if(stamp[c[j]]!=v){
+		stamp[c[j]]=v;
+		ball.push_back(c[j]);
+	      }
+	  }
+	  if(ball.size()==end) break;
+	  level_start=end;
 	}
-	_nhoods.push_back(newlevel);
+	return level_start;
+      };
+
+      vector<int> offsets(n+1,0);
+      parallel_for(n,[&](const int tid, const int v){
+	  bfs(v,stamps[tid],balls[tid]);
+	  int len=balls[tid].size();
+	  offsets[v+1]=(max_size>0)?std::min(len,max_size):len;
+	},nt);
+      for(int v=0; v<n; v++) offsets[v+1]+=offsets[v];
+      for(auto& s:stamps) std::fill(s.begin(),s.end(),-1);
+
+      AtomsPack* R=new AtomsPack();
+      R->reserve(offsets[n]);
+      for(int v=0; v<n; v++)
+	R->dir.push_back(offsets[v],offsets[v+1]-offsets[v]);
+      R->tail=offsets[n];
+
+      parallel_for(n,[&](const int tid, const int v){
+	  vector<int>& ball=balls[tid];
+	  int level_start=bfs(v,stamps[tid],ball);
+	  int len=offsets[v+1]-offsets[v];
+	  if(ball.size()>len){
+	    std::mt19937 rng(seed*2654435761u+v);
+	    for(int t=level_start; t<len; t++){
+	      std::uniform_int_distribution<int> pick(t,ball.size()-1);
+	      std::swap(ball[t],ball[pick(rng)]);
+	    }
+	  }
+	  int* dest=R->arr+offsets[v];
+	  std::copy(ball.begin(),ball.begin()+len,dest);
+	  std::sort(dest,dest+len);
+	},nt);
+
+      return R;
+    }
+
+    // Each row is gathered into its own slice of a buffer sized by the sum of the neighbors' 
+    // domain sizes, then sorted and deduplicated in place.
+    AtomsPack* make_merge(const AtomsPack& x) const{
+      cnine::flog timer("Hgraph::merge");
+      PTENS_ASSRT(x.dev==0);
+      unique_ptr<HgraphCSR> local;
+      const HgraphCSR* C=csr.get();
+      if(!C){
+	local.reset(make_csr());
+	C=local.get();
+      }
+
+      vector<int> xoffs(m);
+      vector<int> xlen(m);
+      for(int q=0; q<m; q++){
+	xoffs[q]=x.dir(q,0);
+	xlen[q]=x.dir(q,1);
+      }
+
+      vector<size_t> bound(n+1,0);
+      for(int i=0; i<n; i++){
+	const int* c=C->cols_of(i);
+	size_t t=0;
+	for(int j=0; j<C->degree(i); j++) t+=xlen[c[j]];
+	bound[i+1]=bound[i]+t;
       }
-      
+
+      vector<int> buf(bound[n]);
+      vector<int> offsets(n+1,0);
+      parallel_for(n,[&](const int tid, const int i){
+	  int* dest=buf.data()+bound[i];
+	  int* t=dest;
+	  const int* c=C->cols_of(i);
+	  for(int j=0; j<C->degree(i); j++)
+	    t=std::copy(x.arr+xoffs[c[j]],x.arr+xoffs[c[j]]+xlen[c[j]],t);
+	  std::sort(dest,t);
+	  offsets[i+1]=std::unique(dest,t)-dest;
+	});
+      for(int i=0; i<n; i++) offsets[i+1]+=offsets[i];
+
+      AtomsPack* R=new AtomsPack();
+      R->reserve(offsets[n]);
+      for(int i=0; i<n; i++)
+	R->dir.push_back(offsets[i],offsets[i+1]-offsets[i]);
+      R->tail=offsets[n];
+      parallel_for(n,[&](const int tid, const int i){
+	  std::copy(buf.begin()+bound[i],buf.begin()+bound[i]+offsets[i+1]-offsets[i],R->arr+offsets[i]);
+	});
+      return R;
+    }
+
+    // Must be called with merged_mx held
+    void clear_merged() const{
+      for(auto p:_merged)
+	delete p;
+      _merged.clear();
+    }
+
+    // Must be called with merged_mx held. A hit is moved to the front.
+    const AtomsPack* find_merged(const AtomsPack& x, const size_t h) const{
+      for(auto it=_merged.begin(); it!=_merged.end(); it++)
+	if((*it)->matches(x,h)){
+	  std::rotate(_merged.begin(),it,it+1);
+	  return _merged.front()->result;
+	}
+      return nullptr;
+    }
+
+    template<typename FN>
+    static void edge_call(const FN& lambda, const int i, const int j, const float v){
+      if constexpr(std::is_invocable<const FN&,int,int,float>::value) lambda(i,j,v);
+      else lambda(i,j);
+    }
+
+
+  public: // ---- Neighborhoods ------------------------------------------------------------------------------
+
+
+    // The i-hop neighborhood of each vertex, in increasing order of vertex index. If max_size>0, 
+    // neighborhoods that would be larger are cut back to max_size vertices by keeping all 
+    // vertices closer than the outermost level that does not fit and sampling uniformly from 
+    // that level (deterministically for a given seed). Only uncapped results are cached.
+    AtomsPack nhoods(const int i, const int max_size=-1, const int seed=0) const{
+      PTENS_ASSRT(i>=0);
+      if(max_size>0){
+	unique_ptr<AtomsPack> R(make_nhoods(i,max_size,seed));
+	return AtomsPack(std::move(*R));
+      }
+      if(_nhoods.size()<=i) _nhoods.resize(i+1,nullptr);
+      if(!_nhoods[i]) _nhoods[i]=make_nhoods(i,-1,0);
       return AtomsPack(*_nhoods[i]);
     }
 
@@ -393,20 +950,76 @@ namespace ptens{
       return Hgraph(A,getn());
     }
 
+    // Vertex i becomes vertex perm[i]. Unlike permute, edge weights and labels are kept, 
+    // and the result is assembled directly in CSR form.
+    Hgraph relabel(const vector<int>& perm) const{
+      PTENS_ASSRT(n==m);
+      PTENS_ASSRT(perm.size()==n);
+      unique_ptr<HgraphCSR> local;
+      const HgraphCSR* C=csr.get();
+      if(!C){
+	local.reset(make_csr());
+	C=local.get();
+      }
 
-    AtomsPack merge(const AtomsPack& x) const{
-      PTENS_ASSRT(m==x.size());
-      AtomsPack R;
+      auto R=make_shared<HgraphCSR>(n);
+      for(int i=0; i<n; i++)
+	R->offsets[perm[i]+1]=C->degree(i);
+      for(int i=0; i<n; i++)
+	R->offsets[i+1]+=R->offsets[i];
+      R->cols.resize(C->nedges());
+      R->vals.resize(C->nedges());
+      vector<pair<int,float> > buf;
       for(int i=0; i<n; i++){
-	std::set<int> w;
-	for(auto q: const_cast<Hgraph&>(*this).row(i)){
-	  auto a=x[q.first];
-	  for(auto p:a)
-	    w.insert(p);
+	buf.clear();
+	for(int t=C->offsets[i]; t<C->offsets[i+1]; t++)
+	  buf.push_back(make_pair(perm[C->cols[t]],C->vals[t]));
+	std::sort(buf.begin(),buf.end());
+	int offs=R->offsets[perm[i]];
+	for(int t=0; t<buf.size(); t++){
+	  R->cols[offs+t]=buf[t].first;
+	  R->vals[offs+t]=buf[t].second;
 	}
-	R.push_back(w);
       }
-      return R;
+      for(auto i:C->rows)
+	R->rows.push_back(perm[i]);
+      std::sort(R->rows.begin(),R->rows.end());
+
+      Hgraph G(n);
+      if(is_labeled){
+	cnine::RtensorA L(cnine::Gdims({n}),cnine::fill_zero());
+	for(int i=0; i<n; i++)
+	  L.set(perm[i],labels(i));
+	G.set_labels(L);
+      }
+      G.csr=R;
+      G.lists_pending=true;
+      return G;
+    }
+
+
+    // The union of the reference domains of the neighbors of each vertex. The result is cached 
+    // on the graph (the 8 most recently used inputs), since unite layers ask for the same merge 
+    // in every forward pass.
+    AtomsPack merge(const AtomsPack& x) const{
+      PTENS_ASSRT(m==x.size());
+      const size_t h=x.hash();
+      {
+	std::lock_guard<std::mutex> lock(merged_mx);
+	if(auto r=find_merged(x,h)) return AtomsPack(*r);
+      }
+      MergedAtoms* R=new MergedAtoms(x,h,make_merge(x));
+      std::lock_guard<std::mutex> lock(merged_mx);
+      if(auto r=find_merged(x,h)){
+	delete R;
+	return AtomsPack(*r);
+      }
+      if(_merged.size()>=8){
+	delete _merged.back();
+	_merged.pop_back();
+      }
+      _merged.insert(_merged.begin(),R);
+      return AtomsPack(*R->result);
     }
 
 
@@ -414,32 +1027,17 @@ namespace ptens{
       cnine::flog timer("Hgraph::intersects");
       PTENS_ASSRT(outputs.size()==n);
       PTENS_ASSRT(inputs.size()==m);
-      AindexPack in_indices;
-      AindexPack out_indices;
-      forall_edges([&](const int i, const int j, const float v){
-	  Atoms in=inputs[j];
-	  Atoms out=outputs[i];
-	  Atoms common=out.intersect(in);
-	  //in_indices.push_back(j,in(common));
-	  //out_indices.push_back(i,out(common));
-	  auto _in=in(common);
-	  auto _out=out(common);
-	  in_indices.push_back(j,_in);
-	  out_indices.push_back(i,_out);
-	  in_indices.count1+=_in.size();
-	  in_indices.count2+=_in.size()*_in.size();
-	  out_indices.count1+=_out.size();
-	  out_indices.count2+=_out.size()*_out.size();
-	    
-	}, self);
+      auto [in_indices,out_indices]=AindexPack::intersects(inputs,outputs,[&](const auto& fn){
+	  forall_edges([&](const int i, const int j, const float v){fn(i,j);},self);});
       //out_indices.bmap=new cnine::GatherMap(get_bmap());
       if(!bmap) bmap=std::shared_ptr<cnine::GatherMap>(new cnine::GatherMap(broadcast_map())); 
       out_indices.bmap=bmap; //new cnine::GatherMap(get_bmap());
-      return make_pair(in_indices, out_indices);
+      return make_pair(std::move(in_indices),std::move(out_indices));
     }
 
 
     cnine::GatherMap broadcast_map() const{
+      if(csr) return broadcast_map(*csr);
       int nlists=0;
       int nedges=0;
       for(auto q:lists)
@@ -470,6 +1068,32 @@ namespace ptens{
       return R;
     }
 
+    cnine::GatherMap broadcast_map(const HgraphCSR& C) const{
+      int nlists=0;
+      for(auto i:C.rows)
+	if(C.degree(i)>0) nlists++;
+
+      cnine::GatherMap R(nlists,C.nedges());
+      int k=0;
+      int m=0;
+      int tail=3*nlists;
+      for(auto i:C.rows){
+	int len=C.degree(i);
+	if(len==0) continue;
+	R.arr[3*k]=tail;
+	R.arr[3*k+1]=len;
+	R.arr[3*k+2]=i;
+	const float* v=C.vals_of(i);
+	for(int j=0; j<len; j++){
+	  R.arr[tail+2*j]=m++;
+	  *reinterpret_cast<float*>(R.arr+tail+2*j+1)=v[j];
+	}
+	tail+=2*len;
+	k++;
+      }
+      return R;
+    }
+
 
   public: // ---- Subgraphs ----------------------------------------------------------------------------------
 
@@ -485,12 +1109,12 @@ namespace ptens{
     labeled_tree* greedy_spanning_tree(const int v, vector<bool>& matched) const{
       PTENS_ASSRT(v<n);
       labeled_tree* r=new labeled_tree(v);
-      for(auto& p: row(v)){
-	if(p.second==0) continue;
-	if(matched[p.first]) continue;
-	matched[p.first]=true;
-	r->children.push_back(greedy_spanning_tree(p.first,matched));
-      }
+      for_each_neighbor_of(v,[&](const int j, const float x){
+	  if(x==0) return;
+	  if(matched[j]) return;
+	  matched[j]=true;
+	  r->children.push_back(greedy_spanning_tree(j,matched));
+	});
       return r;
     }
  
@@ -525,8 +1149,7 @@ namespace std{
   struct hash<ptens::Hgraph>{
   public:
     size_t operator()(const ptens::Hgraph& x) const{
-      if(x.is_labeled) return (hash<cnine::SparseRmatrix>()(x)<<1)^hash<cnine::RtensorA>()(x.labels);
-      return hash<cnine::SparseRmatrix>()(x);
+      return x.fingerprint();
     }
   };
 }
@@ -0,0 +1,105 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _ptens_HgraphCSR
+#define _ptens_HgraphCSR
+
+#include "Ptens_base.hpp"
+
+
+namespace ptens{
+
+
+  // Immutable compressed sparse row copy of an Hgraph's adjacency structure. The rows that 
+  // are present in the underlying SparseRmatrix and the entries within each row are kept in 
+  // their original order, so edges are visited in exactly the same order either way.
+
+  class HgraphCSR{
+  public:
+
+    int n;
+    vector<int> offsets; // n+1 entries
+    vector<int> cols;
+    vector<float> vals;
+    vector<int> rows;    // rows present in the original matrix, in iteration order
+    bool sorted=true;    // columns increasing within each row
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    HgraphCSR(const int _n):
+      n(_n), offsets(_n+1,0){}
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    int nedges() const{
+      return cols.size();
+    }
+
+    int degree(const int i) const{
+      return offsets[i+1]-offsets[i];
+    }
+
+    const int* cols_of(const int i) const{
+      return cols.data()+offsets[i];
+    }
+
+    const float* vals_of(const int i) const{
+      return vals.data()+offsets[i];
+    }
+
+    float operator()(const int i, const int j) const{
+      const int* b=cols_of(i);
+      const int* e=b+degree(i);
+      const int* p=sorted?std::lower_bound(b,e,j):std::find(b,e,j);
+      if(p==e || *p!=j) return 0;
+      return vals[p-cols.data()];
+    }
+
+    template<typename FN>
+    void for_each_neighbor_of(const int i, const FN& lambda) const{
+      for(int t=offsets[i]; t<offsets[i+1]; t++)
+	lambda(cols[t],vals[t]);
+    }
+
+    template<typename FN>
+    void for_each_edge(const FN& lambda) const{
+      for(auto i:rows)
+	for(int t=offsets[i]; t<offsets[i+1]; t++)
+	  lambda(i,cols[t],vals[t]);
+    }
+
+    size_t memsize() const{
+      return (offsets.size()+cols.size()+rows.size())*sizeof(int)+vals.size()*sizeof(float);
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "HgraphCSR";
+    }
+
+    string repr() const{
+      return "<HgraphCSR[n="+to_string(n)+",nedges="+to_string(nedges())+"]>";
+    }
+
+  };
+
+}
+
+#endif 
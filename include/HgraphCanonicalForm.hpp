@@ -0,0 +1,229 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _ptens_HgraphCanonicalForm
+#define _ptens_HgraphCanonicalForm
+
+#include <climits>
+#include "Ptens_base.hpp"
+#include "Hgraph.hpp"
+#include "PtensCacheManager.hpp"
+
+
+namespace ptens{
+
+
+  // Canonical labeling of a (small, possibly labeled and weighted) graph by color refinement 
+  // followed by an individualization-refinement search. The form is the graph written out 
+  // in the new vertex order: [n, is_labeled, labels..., sorted (i,j,weight) triples...], and 
+  // the smallest form over the leaves of the search is kept. Since the form encodes the graph 
+  // completely, two graphs with the same form are always isomorphic. If the search exceeds 
+  // max_leaves (very symmetric graphs) the form may fail to be canonical, which only means 
+  // that some isomorphic graphs will not be recognized as such.
+
+  class HgraphCanonicalForm{
+  public:
+
+    int n;
+    vector<int> form;
+    vector<int> to_canon; // vertex of G -> vertex of the canonical graph
+    int nleaves=0;
+    int max_leaves;
+
+
+  private:
+
+    vector<vector<pair<int,int> > > adj; // (neighbor, weight bits)
+    vector<int> labels;
+    bool is_labeled;
+    bool symmetric=true;
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    HgraphCanonicalForm(const Hgraph& G, const int _max_leaves=256):
+      n(G.getn()), max_leaves(_max_leaves){
+      is_labeled=G.is_labeled;
+      adj.resize(n);
+      G.for_each_edge([&](const int i, const int j, const float v){
+	  adj[i].push_back(pair<int,int>(j,PtensCacheManager::float_bits(v)));});
+      for(auto& a:adj) std::sort(a.begin(),a.end());
+      for(int i=0; i<n && symmetric; i++)
+	for(auto& p:adj[i])
+	  if(weight(p.first,i)!=p.second){symmetric=false; break;}
+      labels=vector<int>(n,0);
+      if(is_labeled)
+	for(int i=0; i<n; i++) labels[i]=PtensCacheManager::float_bits(G.labels(i));
+
+      vector<int> colors(n);
+      vector<pair<int,int> > init(n);
+      for(int i=0; i<n; i++) init[i]=pair<int,int>(labels[i],adj[i].size());
+      rank(init,colors);
+      refine(colors);
+      search(colors);
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    size_t hash() const{
+      return PtensCacheManager::hash_of(form);
+    }
+
+    Hgraph* canonical_graph() const{
+      Hgraph* R;
+      if(is_labeled){
+	cnine::RtensorA L(cnine::Gdims({n}),cnine::fill_zero());
+	for(int i=0; i<n; i++){
+	  float v;
+	  std::memcpy(&v,&labels[i],sizeof(float));
+	  L.set(to_canon[i],v);
+	}
+	R=new Hgraph(n,L);
+      }else R=new Hgraph(n);
+      for(int i=0; i<n; i++)
+	for(auto& p:adj[i]){
+	  float v;
+	  std::memcpy(&v,&p.second,sizeof(float));
+	  R->set(to_canon[i],to_canon[p.first],v);
+	}
+      return R;
+    }
+
+
+  private: // ---- Search -----------------------------------------------------------------------------------
+
+
+    template<typename KEY>
+    static int rank(const vector<KEY>& keys, vector<int>& colors){
+      int N=keys.size();
+      vector<int> ix(N);
+      for(int i=0; i<N; i++) ix[i]=i;
+      std::sort(ix.begin(),ix.end(),[&](const int a, const int b){return keys[a]<keys[b];});
+      int c=0;
+      for(int i=0; i<N; i++){
+	if(i>0 && keys[ix[i]]!=keys[ix[i-1]]) c++;
+	colors[ix[i]]=c;
+      }
+      return N>0?c+1:0;
+    }
+
+    // 1-WL refinement until the number of colors stops growing
+    void refine(vector<int>& colors) const{
+      int ncolors=0;
+      for(auto c:colors) ncolors=std::max(ncolors,c+1);
+      while(true){
+	vector<vector<int> > keys(n);
+	for(int i=0; i<n; i++){
+	  vector<pair<int,int> > nbrs;
+	  for(auto& p:adj[i]) nbrs.push_back(pair<int,int>(colors[p.first],p.second));
+	  std::sort(nbrs.begin(),nbrs.end());
+	  keys[i].push_back(colors[i]);
+	  for(auto& p:nbrs){
+	    keys[i].push_back(p.first);
+	    keys[i].push_back(p.second);
+	  }
+	}
+	int newn=rank(keys,colors);
+	if(newn==ncolors) break;
+	ncolors=newn;
+      }
+    }
+
+    void search(const vector<int>& colors){
+      if(nleaves>=max_leaves && form.size()>0) return;
+
+      // first smallest non-singleton cell
+      vector<int> cellsize(n,0);
+      for(auto c:colors) cellsize[c]++;
+      int target=-1;
+      for(int c=0; c<n; c++)
+	if(cellsize[c]>1 && (target==-1 || cellsize[c]<cellsize[target])) target=c;
+
+      if(target==-1){
+	nleaves++;
+	vector<int> f=make_form(colors);
+	if(form.size()==0 || f<form){
+	  form=f;
+	  to_canon=colors;
+	}
+	return;
+      }
+
+      vector<int> tried;
+      for(int v=0; v<n; v++){
+	if(colors[v]!=target) continue;
+	bool skip=false;
+	for(auto u:tried)
+	  if(twins(u,v)){skip=true; break;}
+	if(skip) continue;
+	tried.push_back(v);
+	vector<int> c(n);
+	for(int i=0; i<n; i++) c[i]=2*colors[i];
+	c[v]=2*colors[v]-1;
+	vector<int> d(n);
+	rank(c,d);
+	refine(d);
+	search(d);
+	if(nleaves>=max_leaves) return;
+      }
+    }
+
+    int weight(const int i, const int j) const{
+      auto it=std::lower_bound(adj[i].begin(),adj[i].end(),pair<int,int>(j,INT_MIN));
+      if(it==adj[i].end() || it->first!=j) return 0;
+      return it->second;
+    }
+
+    // Swapping twins is an automorphism that fixes every vertex individualized so far, 
+    // so their branches of the search lead to the same leaves.
+    bool twins(const int u, const int v) const{
+      if(!symmetric || labels[u]!=labels[v]) return false;
+      if(weight(u,u)!=weight(v,v)) return false;
+      auto a=adj[u].begin();
+      auto b=adj[v].begin();
+      while(true){
+	while(a!=adj[u].end() && (a->first==v || a->first==u)) a++;
+	while(b!=adj[v].end() && (b->first==u || b->first==v)) b++;
+	if(a==adj[u].end() || b==adj[v].end()) return a==adj[u].end() && b==adj[v].end();
+	if(*a!=*b) return false;
+	a++; b++;
+      }
+    }
+
+    vector<int> make_form(const vector<int>& perm) const{
+      vector<int> R;
+      R.push_back(n);
+      R.push_back(is_labeled);
+      if(is_labeled){
+	vector<int> l(n);
+	for(int i=0; i<n; i++) l[perm[i]]=labels[i];
+	R.insert(R.end(),l.begin(),l.end());
+      }
+      vector<std::array<int,3> > edges;
+      for(int i=0; i<n; i++)
+	for(auto& p:adj[i])
+	  edges.push_back({perm[i],perm[p.first],p.second});
+      std::sort(edges.begin(),edges.end());
+      for(auto& e:edges)
+	R.insert(R.end(),e.begin(),e.end());
+      return R;
+    }
+
+  };
+
+}
+
+#endif 
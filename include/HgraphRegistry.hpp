@@ -0,0 +1,123 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _ptens_HgraphRegistry
+#define _ptens_HgraphRegistry
+
+#include <mutex>
+#include "HgraphCanonicalForm.hpp"
+
+
+namespace ptens{
+
+
+  // Hash-consing of input graphs: isomorphic graphs are mapped to a single canonical 
+  // representative so that subgraph matches, neighborhoods, etc. are only computed once per 
+  // isomorphism class. The registry only holds weak references, so a class (and everything 
+  // cached on it) is released once the last graph using it is gone.
+
+  class HgraphRegistry{
+  public:
+
+    class Entry{
+    public:
+      vector<int> form;
+      std::weak_ptr<Hgraph> graph;
+    };
+
+    unordered_map<size_t,vector<Entry> > classes;
+    long nlookups=0;
+    long nhits=0;
+
+    mutable std::mutex mx;
+
+
+  public: // ---- Lookup -------------------------------------------------------------------------------------
+
+
+    // Returns the representative of G's class and the map from G's vertices to its vertices
+    pair<shared_ptr<Hgraph>,vector<int> > intern(const Hgraph& G){
+      HgraphCanonicalForm cf(G);
+      size_t h=cf.hash();
+      std::lock_guard<std::mutex> lock(mx);
+      nlookups++;
+
+      auto& bucket=classes[h];
+      for(int i=0; i<bucket.size(); i++){
+	if(bucket[i].form!=cf.form) continue;
+	shared_ptr<Hgraph> r=bucket[i].graph.lock();
+	if(r){
+	  nhits++;
+	  return make_pair(r,cf.to_canon);
+	}
+	bucket.erase(bucket.begin()+i);
+	break;
+      }
+
+      prune(bucket);
+      shared_ptr<Hgraph> r(cf.canonical_graph());
+      Entry e;
+      e.form=std::move(cf.form);
+      e.graph=r;
+      bucket.push_back(std::move(e));
+      return make_pair(r,cf.to_canon);
+    }
+
+    void clear(){
+      std::lock_guard<std::mutex> lock(mx);
+      classes.clear();
+      nlookups=0;
+      nhits=0;
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    int nclasses() const{
+      std::lock_guard<std::mutex> lock(mx);
+      int t=0;
+      for(auto& p:classes)
+	for(auto& e:p.second)
+	  if(!e.graph.expired()) t++;
+      return t;
+    }
+
+    map<string,long> stats() const{
+      map<string,long> R;
+      R["classes"]=nclasses();
+      std::lock_guard<std::mutex> lock(mx);
+      R["lookups"]=nlookups;
+      R["hits"]=nhits;
+      return R;
+    }
+
+
+  private:
+
+    static void prune(vector<Entry>& bucket){
+      bucket.erase(std::remove_if(bucket.begin(),bucket.end(),[](const Entry& e){
+	    return e.graph.expired();}),bucket.end());
+    }
+
+  };
+
+
+  inline HgraphRegistry& ptens_graph_registry(){
+    static HgraphRegistry* registry=new HgraphRegistry();
+    return *registry;
+  }
+
+}
+
+#endif 
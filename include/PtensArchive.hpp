@@ -0,0 +1,424 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#ifndef _PtensArchive
+#define _PtensArchive
+
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Ptens_base.hpp"
+#include "AtomsPack.hpp"
+#include "AindexPack.hpp"
+#include "Hgraph.hpp"
+
+
+namespace ptens{
+
+
+  // Binary container for precomputed graph structures. Layout (version 1, native byte order):
+  //
+  //   file header      64 bytes: magic "PTENSARC", version, byte order mark, number of records,
+  //                    offset of the index
+  //   records          each starts with a 128 byte record header of int64 fields, followed by
+  //                    its arrays; the record and each array are 64 byte aligned
+  //   index            (type, offset, length) of each record
+  //
+  // AtomsPack and AindexPack records store the directory of the array_pool as (offset, length)
+  // pairs followed by the flat array. Hgraph records store the CSR form (offsets, columns,
+  // values, present rows) and the labels, if any.
+
+  class PtensArchiveFormat{
+  public:
+
+    static constexpr uint32_t version=1;
+    static constexpr uint32_t byte_order=0x01020304;
+    static constexpr size_t alignment=64;
+
+    enum RecordType: uint32_t{ATOMS=1, AINDEX=2, GRAPH=3};
+
+    class FileHeader{
+    public:
+      char magic[8]={'P','T','E','N','S','A','R','C'};
+      uint32_t version=PtensArchiveFormat::version;
+      uint32_t byte_order=PtensArchiveFormat::byte_order;
+      uint64_t nrecords=0;
+      uint64_t index_offset=0;
+      char pad[32]={0};
+    };
+
+    class IndexEntry{
+    public:
+      uint32_t type;
+      uint32_t reserved;
+      uint64_t offset;
+      uint64_t nbytes;
+    };
+
+    // Fields of the record header by record type
+    //   ATOMS:  n, tail, dir, arr
+    //   AINDEX: n, tail, dir, arr, max_nix, count1, count2
+    //   GRAPH:  n, m, nedges, nrows, flags (1: labeled, 2: sorted), offsets, cols, vals, rows, labels
+    class RecordHeader{
+    public:
+      int64_t f[16]={0};
+    };
+
+    static_assert(sizeof(FileHeader)==64,"Ptens error: unexpected size of archive header.");
+    static_assert(sizeof(RecordHeader)==128,"Ptens error: unexpected size of archive record header.");
+
+    static size_t aligned(const size_t x){
+      return (x+alignment-1)/alignment*alignment;
+    }
+
+  };
+
+
+  // ---- Writer ----------------------------------------------------------------------------------------------
+
+
+  class PtensArchiveWriter: public PtensArchiveFormat{
+  public:
+
+    string filename;
+    std::ofstream ofs;
+    size_t pos=0;
+    vector<IndexEntry> index;
+
+    ~PtensArchiveWriter(){
+      if(!ofs.is_open()) return;
+      try{close();}
+      catch(const std::exception& e){cerr<<e.what()<<endl;}
+    }
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    PtensArchiveWriter(const string _filename):
+      filename(_filename), ofs(_filename,std::ios::binary|std::ios::trunc){
+      if(!ofs) throw std::runtime_error("Ptens error in "+string(__PRETTY_FUNCTION__)+": cannot open "+filename+" for writing.");
+      FileHeader h;
+      write(&h,sizeof(h));
+    }
+
+    PtensArchiveWriter(const PtensArchiveWriter& x)=delete;
+    PtensArchiveWriter& operator=(const PtensArchiveWriter& x)=delete;
+
+
+  public: // ---- Records ------------------------------------------------------------------------------------
+
+
+    int add(const AtomsPack& x){
+      return add_pool(ATOMS,x,{});
+    }
+
+    int add(const AindexPack& x){
+      if(x.is_compact()) return add(x.expanded());
+      return add_pool(AINDEX,x,{x._max_nix,x.count1,x.count2});
+    }
+
+    int add(const Hgraph& G){
+      unique_ptr<HgraphCSR> local;
+      const HgraphCSR* C=G.frozen();
+      if(!C){
+	local.reset(G.make_csr());
+	C=local.get();
+      }
+      int n=G.getn();
+      int E=C->nedges();
+
+      RecordHeader h;
+      h.f[0]=n;
+      h.f[1]=G.m;
+      h.f[2]=E;
+      h.f[3]=C->rows.size();
+      h.f[4]=(G.is_labeled?1:0)|(C->sorted?2:0);
+      size_t offs=aligned(sizeof(h));
+      h.f[5]=offs; offs=aligned(offs+(n+1)*sizeof(int));
+      h.f[6]=offs; offs=aligned(offs+E*sizeof(int));
+      h.f[7]=offs; offs=aligned(offs+E*sizeof(float));
+      h.f[8]=offs; offs=aligned(offs+C->rows.size()*sizeof(int));
+      h.f[9]=offs; if(G.is_labeled) offs=aligned(offs+n*sizeof(float));
+
+      vector<float> labels;
+      if(G.is_labeled){
+	labels.resize(n);
+	for(int i=0; i<n; i++) labels[i]=G.labels(i);
+      }
+
+      size_t start=begin_record(GRAPH);
+      write(&h,sizeof(h));
+      write_at(start+h.f[5],C->offsets.data(),(n+1)*sizeof(int));
+      write_at(start+h.f[6],C->cols.data(),E*sizeof(int));
+      write_at(start+h.f[7],C->vals.data(),E*sizeof(float));
+      write_at(start+h.f[8],C->rows.data(),C->rows.size()*sizeof(int));
+      if(G.is_labeled) write_at(start+h.f[9],labels.data(),n*sizeof(float));
+      return end_record(start,offs);
+    }
+
+    void close(){
+      pad_to(aligned(pos));
+      uint64_t index_offset=pos;
+      write(index.data(),index.size()*sizeof(IndexEntry));
+      FileHeader h;
+      h.nrecords=index.size();
+      h.index_offset=index_offset;
+      ofs.seekp(0);
+      ofs.write(reinterpret_cast<const char*>(&h),sizeof(h));
+      ofs.close();
+      if(!ofs) throw std::runtime_error("Ptens error in "+string(__PRETTY_FUNCTION__)+": error writing "+filename+".");
+    }
+
+
+  private:
+
+    int add_pool(const RecordType type, const cnine::array_pool<int>& x, const vector<int>& extra){
+      int n=x.size();
+      int tail=x.tail;
+      vector<int> dir(2*n);
+      for(int i=0; i<n; i++){
+	dir[2*i]=x.dir(i,0);
+	dir[2*i+1]=x.dir(i,1);
+      }
+
+      RecordHeader h;
+      h.f[0]=n;
+      h.f[1]=tail;
+      size_t offs=aligned(sizeof(h));
+      h.f[2]=offs; offs=aligned(offs+2*n*sizeof(int));
+      h.f[3]=offs; offs=aligned(offs+tail*sizeof(int));
+      for(int i=0; i<extra.size(); i++)
+	h.f[4+i]=extra[i];
+
+      size_t start=begin_record(type);
+      write(&h,sizeof(h));
+      write_at(start+h.f[2],dir.data(),2*n*sizeof(int));
+      write_at(start+h.f[3],x.arr,tail*sizeof(int));
+      return end_record(start,offs);
+    }
+
+    size_t begin_record(const RecordType type){
+      pad_to(aligned(pos));
+      index.push_back(IndexEntry{type,0,pos,0});
+      return pos;
+    }
+
+    int end_record(const size_t start, const size_t nbytes){
+      pad_to(start+nbytes);
+      index.back().nbytes=nbytes;
+      return index.size()-1;
+    }
+
+    void write_at(const size_t at, const void* p, const size_t n){
+      pad_to(at);
+      write(p,n);
+    }
+
+    void pad_to(const size_t at){
+      static const char zeros[alignment]={0};
+      PTENS_ASSRT(at>=pos);
+      while(pos<at) write(zeros,std::min(at-pos,alignment));
+    }
+
+    void write(const void* p, const size_t n){
+      ofs.write(reinterpret_cast<const char*>(p),n);
+      pos+=n;
+    }
+
+  };
+
+
+  // ---- Reader ----------------------------------------------------------------------------------------------
+
+
+  // The file is mapped read-only and shared, so processes that open the same archive (e.g.,
+  // DataLoader workers) share its pages. The arrays of AtomsPack and AindexPack objects
+  // returned by atoms() and aindex() point directly into the mapping: they must not be modified
+  // and must not outlive the archive. Copying them gives ordinary, independent objects.
+
+  class PtensArchive: public PtensArchiveFormat{
+  public:
+
+    string filename;
+    size_t size=0;
+    const char* base=nullptr;
+    const IndexEntry* index=nullptr;
+    int nrecords=0;
+
+    ~PtensArchive(){
+      if(base) munmap(const_cast<char*>(base),size);
+    }
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    PtensArchive(const string _filename):
+      filename(_filename){
+      int fd=open(filename.c_str(),O_RDONLY);
+      if(fd<0) throw std::runtime_error("Ptens error in "+string(__PRETTY_FUNCTION__)+": cannot open "+filename+".");
+      struct stat st;
+      if(fstat(fd,&st)!=0 || st.st_size<(off_t)sizeof(FileHeader)){
+	::close(fd);
+	corrupt("file too short");
+      }
+      size=st.st_size;
+      void* p=mmap(nullptr,size,PROT_READ,MAP_SHARED,fd,0);
+      ::close(fd);
+      if(p==MAP_FAILED) throw std::runtime_error("Ptens error in "+string(__PRETTY_FUNCTION__)+": cannot map "+filename+".");
+      base=reinterpret_cast<const char*>(p);
+      try{
+	read_index();
+      }catch(...){
+	munmap(p,size);
+	base=nullptr;
+	throw;
+      }
+    }
+
+    PtensArchive(const PtensArchive& x)=delete;
+    PtensArchive& operator=(const PtensArchive& x)=delete;
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    int nrec() const{
+      return nrecords;
+    }
+
+    int type(const int i) const{
+      PTENS_ASSRT(i>=0 && i<nrecords);
+      return index[i].type;
+    }
+
+    // Zero copy view of an AtomsPack record
+    AtomsPack atoms(const int i) const{
+      AtomsPack R;
+      view_pool(R,i,ATOMS);
+      return R;
+    }
+
+    // Zero copy view of an AindexPack record
+    AindexPack aindex(const int i) const{
+      AindexPack R;
+      const RecordHeader& h=view_pool(R,i,AINDEX);
+      R._max_nix=h.f[4];
+      R.count1=h.f[5];
+      R.count2=h.f[6];
+      return R;
+    }
+
+    // Graphs are rebuilt in frozen CSR form; this copies the arrays, but involves no parsing.
+    Hgraph graph(const int i) const{
+      const RecordHeader& h=record(i,GRAPH);
+      const char* r=base+index[i].offset;
+      int n=h.f[0];
+      int E=h.f[2];
+      int nrows=h.f[3];
+      check(i,h.f[5],(n+1)*sizeof(int));
+      check(i,h.f[6],E*sizeof(int));
+      check(i,h.f[7],E*sizeof(float));
+      check(i,h.f[8],nrows*sizeof(int));
+
+      auto C=make_shared<HgraphCSR>(n);
+      const int* offsets=reinterpret_cast<const int*>(r+h.f[5]);
+      C->offsets.assign(offsets,offsets+n+1);
+      C->cols.assign(reinterpret_cast<const int*>(r+h.f[6]),reinterpret_cast<const int*>(r+h.f[6])+E);
+      C->vals.assign(reinterpret_cast<const float*>(r+h.f[7]),reinterpret_cast<const float*>(r+h.f[7])+E);
+      C->rows.assign(reinterpret_cast<const int*>(r+h.f[8]),reinterpret_cast<const int*>(r+h.f[8])+nrows);
+      C->sorted=(h.f[4]&2);
+      if(C->offsets[n]!=E) corrupt("bad offsets in record "+to_string(i));
+
+      Hgraph G(n,h.f[1]);
+      if(h.f[4]&1){
+	check(i,h.f[9],n*sizeof(float));
+	const float* l=reinterpret_cast<const float*>(r+h.f[9]);
+	cnine::RtensorA L(cnine::Gdims({n}),cnine::fill_zero());
+	for(int j=0; j<n; j++) L.set(j,l[j]);
+	G.set_labels(L);
+      }
+      G.csr=C;
+      G.lists_pending=true;
+      return G;
+    }
+
+
+  private:
+
+    void read_index(){
+      const FileHeader& h=*reinterpret_cast<const FileHeader*>(base);
+      if(std::memcmp(h.magic,FileHeader().magic,8)!=0) corrupt("not a ptens archive");
+      if(h.byte_order!=byte_order) corrupt("written on a machine with different byte order");
+      if(h.version!=version) corrupt("unsupported version "+to_string(h.version));
+      if(h.index_offset%alignment!=0 || h.index_offset+h.nrecords*sizeof(IndexEntry)>size) corrupt("bad index");
+      index=reinterpret_cast<const IndexEntry*>(base+h.index_offset);
+      nrecords=h.nrecords;
+      for(int i=0; i<nrecords; i++)
+	if(index[i].offset%alignment!=0 || index[i].offset+index[i].nbytes>h.index_offset) corrupt("bad record "+to_string(i));
+    }
+
+    const RecordHeader& record(const int i, const RecordType t) const{
+      PTENS_ASSRT(i>=0 && i<nrecords);
+      if(index[i].type!=t) throw std::invalid_argument("Ptens error in "+string(__PRETTY_FUNCTION__)+": record "+to_string(i)+" is of type "+to_string(index[i].type)+".");
+      if(index[i].nbytes<sizeof(RecordHeader)) corrupt("bad record "+to_string(i));
+      return *reinterpret_cast<const RecordHeader*>(base+index[i].offset);
+    }
+
+    void check(const int i, const int64_t offs, const size_t nbytes) const{
+      if(offs<0 || offs%alignment!=0 || offs+nbytes>index[i].nbytes) corrupt("bad array in record "+to_string(i));
+    }
+
+    const RecordHeader& view_pool(cnine::array_pool<int>& R, const int i, const RecordType t) const{
+      const RecordHeader& h=record(i,t);
+      const char* r=base+index[i].offset;
+      int n=h.f[0];
+      int tail=h.f[1];
+      check(i,h.f[2],2*n*sizeof(int));
+      check(i,h.f[3],tail*sizeof(int));
+      const int* dir=reinterpret_cast<const int*>(r+h.f[2]);
+      for(int j=0; j<n; j++){
+	if(dir[2*j]<0 || dir[2*j+1]<0 || dir[2*j]+dir[2*j+1]>tail) corrupt("bad directory in record "+to_string(i));
+	R.dir.push_back(dir[2*j],dir[2*j+1]);
+      }
+      R.arr=const_cast<int*>(reinterpret_cast<const int*>(r+h.f[3]));
+      R.memsize=tail;
+      R.tail=tail;
+      R.is_view=true;
+      return h;
+    }
+
+    void corrupt(const string msg) const{
+      throw std::runtime_error("Ptens error: "+filename+" is not a valid ptens archive ("+msg+").");
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "ptens::PtensArchive";
+    }
+
+    string repr() const{
+      return "<PtensArchive["+filename+",records="+to_string(nrecords)+"]>";
+    }
+
+  };
+
+}
+
+#endif
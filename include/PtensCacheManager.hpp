@@ -0,0 +1,304 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _PtensCacheManager
+#define _PtensCacheManager
+
+#include <list>
+#include <mutex>
+#include <cstring>
+#include <algorithm>
+#include <tuple>
+
+#include "Ptens_base.hpp"
+#include "array_pool.hpp"
+#include "TransferMap.hpp"
+#include "Tensor.hpp"
+
+
+namespace ptens{
+
+
+  // Session wide store for the subgraph lists computed by CachedPlantedSubgraphs(Mx) and the 
+  // overlap maps computed by Ggraph::transfer_map(). Entries are keyed by the id of the host 
+  // graph and a hash of the pattern (or of the two packs of reference domains), and are 
+  // evicted in least recently used order once their total size exceeds the byte budget. 
+  // Each entry keeps a compact signature of the pattern (size, edge list, labels) so that 
+  // hash collisions are detected exactly without holding a copy of the pattern matrix. 
+  // Values are handed out as shared_ptr's, so evicting an entry never invalidates a 
+  // subgraph list that is still in use.
+
+  class PtensCacheManager{
+  public:
+
+    typedef cnine::array_pool<int> IntPool;
+    typedef cnine::Tensor<int> IntMatrix;
+
+    class Key{
+    public:
+      int graph;
+      int kind;
+      size_t hash;
+      bool operator==(const Key& x) const{
+	return graph==x.graph && kind==x.kind && hash==x.hash;}
+    };
+
+    class KeyHash{
+    public:
+      size_t operator()(const Key& x) const{
+	return (((std::hash<int>()(x.graph)<<1)^std::hash<int>()(x.kind))<<1)^x.hash;}
+    };
+
+    class Entry{
+    public:
+      Key key;
+      vector<int> sig;
+      shared_ptr<IntPool> pool;
+      shared_ptr<IntMatrix> mx;
+      shared_ptr<TransferMap> tmap;
+      size_t bytes=0;
+    };
+
+    size_t budget=((size_t)1)<<30;
+    size_t bytes=0;
+    size_t peak_bytes=0;
+    long hits=0;
+    long misses=0;
+    long evictions=0;
+    long collisions=0;
+
+    std::list<Entry> entries; // most recently used first
+    unordered_map<Key,std::list<Entry>::iterator,KeyHash> index;
+    unordered_map<int,vector<Key> > by_graph; // keys of the entries currently held, by graph
+    int next_graph_id=0;
+    std::mutex mx;
+
+
+  public: // ---- Graphs ------------------------------------------------------------------------------------
+
+
+    int new_graph_id(){
+      std::lock_guard<std::mutex> lock(mx);
+      return next_graph_id++;
+    }
+
+    void erase_graph(const int id){
+      std::lock_guard<std::mutex> lock(mx);
+      auto it=by_graph.find(id);
+      if(it==by_graph.end()) return;
+      vector<Key> keys=it->second; // erase() removes them from by_graph
+      for(auto& key:keys){
+	auto jt=index.find(key);
+	if(jt!=index.end()) erase(jt->second);
+      }
+      by_graph.erase(id);
+    }
+
+
+  public: // ---- Lookup ------------------------------------------------------------------------------------
+
+
+    shared_ptr<IntPool> find_pool(const int graph, const size_t h, const vector<int>& sig){
+      std::lock_guard<std::mutex> lock(mx);
+      auto p=find(Key{graph,0,h},sig);
+      if(!p) return nullptr;
+      return p->pool;
+    }
+
+    shared_ptr<IntMatrix> find_mx(const int graph, const size_t h, const vector<int>& sig){
+      std::lock_guard<std::mutex> lock(mx);
+      auto p=find(Key{graph,1,h},sig);
+      if(!p) return nullptr;
+      return p->mx;
+    }
+
+    shared_ptr<TransferMap> find_tmap(const int graph, const size_t h, const vector<int>& sig){
+      std::lock_guard<std::mutex> lock(mx);
+      auto p=find(Key{graph,2,h},sig);
+      if(!p) return nullptr;
+      return p->tmap;
+    }
+
+    void insert(const int graph, const size_t h, const vector<int>& sig, const shared_ptr<IntPool>& x){
+      std::lock_guard<std::mutex> lock(mx);
+      Entry& e=insert(Key{graph,0,h},sig);
+      e.pool=x;
+      e.bytes=sizeof(Entry)+sig.size()*sizeof(int)+(x->tail+2*x->size())*sizeof(int);
+      account(e);
+    }
+
+    void insert(const int graph, const size_t h, const vector<int>& sig, const shared_ptr<IntMatrix>& x){
+      std::lock_guard<std::mutex> lock(mx);
+      Entry& e=insert(Key{graph,1,h},sig);
+      e.mx=x;
+      size_t t=1;
+      for(int i=0; i<x->dims.size(); i++) t*=x->dims[i];
+      e.bytes=sizeof(Entry)+sig.size()*sizeof(int)+t*sizeof(int);
+      account(e);
+    }
+
+    void insert(const int graph, const size_t h, const vector<int>& sig, const shared_ptr<TransferMap>& x){
+      size_t nnz=0;
+      x->forall_edges([&](const int i, const int j, const float v){nnz++;});
+      std::lock_guard<std::mutex> lock(mx);
+      Entry& e=insert(Key{graph,2,h},sig);
+      e.tmap=x;
+      e.bytes=sizeof(Entry)+sig.size()*sizeof(int)+nnz*(sizeof(int)+sizeof(float));
+      account(e);
+    }
+
+
+  public: // ---- Control -----------------------------------------------------------------------------------
+
+
+    void set_budget(const size_t _budget){
+      std::lock_guard<std::mutex> lock(mx);
+      budget=_budget;
+      shrink();
+    }
+
+    void clear(){
+      std::lock_guard<std::mutex> lock(mx);
+      entries.clear();
+      index.clear();
+      by_graph.clear();
+      bytes=0;
+    }
+
+    void reset_stats(){
+      std::lock_guard<std::mutex> lock(mx);
+      hits=0;
+      misses=0;
+      evictions=0;
+      collisions=0;
+      peak_bytes=bytes;
+    }
+
+    map<string,long> stats(){
+      std::lock_guard<std::mutex> lock(mx);
+      map<string,long> R;
+      R["entries"]=entries.size();
+      R["bytes"]=bytes;
+      R["peak_bytes"]=peak_bytes;
+      R["budget"]=budget;
+      R["hits"]=hits;
+      R["misses"]=misses;
+      R["evictions"]=evictions;
+      R["collisions"]=collisions;
+      return R;
+    }
+
+
+  public: // ---- Signatures --------------------------------------------------------------------------------
+
+
+    template<typename GRAPH>
+    static vector<int> signature(const GRAPH& H){
+      vector<int> R;
+      R.push_back(H.getn());
+      R.push_back(H.is_labeled);
+      vector<std::tuple<int,int,int> > edges; // sorted, so that the storage order does not matter
+      H.for_each_edge([&](const int i, const int j, const float v){
+	  edges.emplace_back(i,j,float_bits(v));});
+      std::sort(edges.begin(),edges.end());
+      for(auto& e:edges){
+	R.push_back(std::get<0>(e));
+	R.push_back(std::get<1>(e));
+	R.push_back(std::get<2>(e));
+      }
+      if(H.is_labeled)
+	for(int i=0; i<H.getn(); i++)
+	  R.push_back(float_bits(H.labels(i)));
+      return R;
+    }
+
+    static size_t hash_of(const vector<int>& sig){
+      size_t h=14695981039346656037ULL;
+      for(auto p:sig){
+	h^=(size_t)(unsigned int)p;
+	h*=1099511628211ULL;
+      }
+      return h;
+    }
+
+    static int float_bits(const float x){
+      int r;
+      std::memcpy(&r,&x,sizeof(int));
+      return r;
+    }
+
+
+  private:
+
+
+    Entry* find(const Key& key, const vector<int>& sig){
+      auto it=index.find(key);
+      if(it==index.end() || it->second->sig!=sig){
+	if(it!=index.end()) collisions++;
+	misses++;
+	return nullptr;
+      }
+      hits++;
+      entries.splice(entries.begin(),entries,it->second);
+      return &entries.front();
+    }
+
+    Entry& insert(const Key& key, const vector<int>& sig){
+      auto it=index.find(key);
+      if(it!=index.end()) erase(it->second);
+      entries.push_front(Entry());
+      Entry& e=entries.front();
+      e.key=key;
+      e.sig=sig;
+      index[key]=entries.begin();
+      by_graph[key.graph].push_back(key);
+      return e;
+    }
+
+    void account(const Entry& e){
+      bytes+=e.bytes;
+      shrink();
+      peak_bytes=std::max(peak_bytes,bytes);
+    }
+
+    void erase(const std::list<Entry>::iterator& it){
+      bytes-=it->bytes;
+      index.erase(it->key);
+      auto gt=by_graph.find(it->key.graph);
+      if(gt!=by_graph.end()){
+	auto& keys=gt->second;
+	keys.erase(std::remove(keys.begin(),keys.end(),it->key),keys.end());
+	if(keys.empty()) by_graph.erase(gt);
+      }
+      entries.erase(it);
+    }
+
+    void shrink(){
+      while(bytes>budget && entries.size()>1){
+	erase(std::prev(entries.end()));
+	evictions++;
+      }
+    }
+
+  };
+
+
+  // The manager is never destroyed, so graphs that outlive static destruction can still unregister. 
+  inline PtensCacheManager& ptens_cache(){
+    static PtensCacheManager* manager=new PtensCacheManager();
+    return *manager;
+  }
+
+}
+
+#endif 
@@ -0,0 +1,205 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _PtensFindCycles
+#define _PtensFindCycles
+
+#include "Ptens_base.hpp"
+#include "Hgraph.hpp"
+#include "AindexPack.hpp"
+#include "Tensor.hpp"
+#include "flog.hpp"
+
+
+namespace ptens{
+
+
+  // Enumerates the simple cycles of G with minlen<=length<=maxlen. Each cycle is grown as a path 
+  // from its smallest vertex r through vertices larger than r, and is only accepted if the 
+  // second vertex is smaller than the last, so every cycle is emitted exactly once, 
+  // in canonical rotation (smallest vertex first, smaller of its two neighbors second). 
+  // In induced mode chords are pruned as soon as they appear, not when the cycle is closed, 
+  // giving the same set of cycles as FindPlantedSubgraphs with H=Subgraph::cycle(k). 
+
+  class FindCycles{
+  public:
+
+    typedef Hgraph Graph;
+
+    int minlen;
+    int maxlen;
+    bool induced;
+
+    vector<int> matches;
+    vector<int> offsets={0};
+
+    vector<int> offs;
+    vector<int> cols;
+
+
+  private:
+
+    vector<int> path;
+    vector<int> cover;
+    vector<char> rootadj;
+    vector<char> onpath;
+    int root=0;
+
+
+  public:
+
+
+    FindCycles(const Graph& G, const int _minlen, const int _maxlen, const bool _induced=true):
+      minlen(std::max(_minlen,3)), maxlen(_maxlen), induced(_induced){
+      cnine::flog timer("FindCycles");
+      const int n=G.getn();
+      make_adjacency(G);
+      cover=vector<int>(n,0);
+      rootadj=vector<char>(n,0);
+      onpath=vector<char>(n,0);
+
+      for(root=0; root<n; root++){
+	for(int t=offs[root]; t<offs[root+1]; t++) rootadj[cols[t]]=1;
+	path.push_back(root);
+	onpath[root]=1;
+	for(int t=offs[root]; t<offs[root+1]; t++){
+	  int w=cols[t];
+	  if(w<=root) continue;
+	  path.push_back(w);
+	  onpath[w]=1;
+	  extend();
+	  onpath[w]=0;
+	  path.pop_back();
+	}
+	onpath[root]=0;
+	path.pop_back();
+	for(int t=offs[root]; t<offs[root+1]; t++) rootadj[cols[t]]=0;
+      }
+    }
+
+
+    // FindCycles gives the same results as the generic matcher if G is unweighted and symmetric. 
+    // Only the out-neighbors of each vertex are followed. 
+    static bool is_unweighted(const Graph& G){
+      bool r=true;
+      G.for_each_edge([&](const int i, const int j, const float v){
+	  if(v!=1.0) r=false;});
+      return r;
+    }
+
+    static bool is_symmetric(const Graph& G){
+      vector<pair<int,int> > fwd;
+      vector<pair<int,int> > bwd;
+      G.for_each_edge([&](const int i, const int j, const float v){
+	  fwd.push_back(make_pair(i,j));
+	  bwd.push_back(make_pair(j,i));});
+      std::sort(fwd.begin(),fwd.end());
+      std::sort(bwd.begin(),bwd.end());
+      return fwd==bwd;
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    int nmatches() const{
+      return offsets.size()-1;
+    }
+
+    operator AindexPack() const{
+      AindexPack R;
+      for(int i=0; i<nmatches(); i++)
+	R.push_back(i,vector<int>(matches.begin()+offsets[i],matches.begin()+offsets[i+1]));
+      return R;
+    }
+
+    operator cnine::array_pool<int>() const{
+      cnine::array_pool<int> R;
+      R.reserve(matches.size());
+      for(int i=0; i<nmatches(); i++){
+	int len=offsets[i+1]-offsets[i];
+	std::copy(matches.begin()+offsets[i],matches.begin()+offsets[i+1],R.arr+R.tail);
+	R.dir.push_back(R.tail,len);
+	R.tail+=len;
+      }
+      return R;
+    }
+
+    operator cnine::Tensor<int>() const{
+      PTENS_ASSRT(minlen==maxlen);
+      int N=nmatches();
+      cnine::Tensor<int> R(cnine::Gdims(N,maxlen));
+      for(int t=0; t<N; t++)
+	for(int i=0; i<maxlen; i++)
+	  R.set(t,i,matches[t*maxlen+i]);
+      return R;
+    }
+
+
+  private:
+
+
+    void make_adjacency(const Graph& G){
+      const int n=G.getn();
+      offs=vector<int>(n+1,0);
+      G.for_each_edge([&](const int i, const int j){
+	  if(i!=j) offs[i+1]++;});
+      for(int i=0; i<n; i++) offs[i+1]+=offs[i];
+      cols=vector<int>(offs[n]);
+      vector<int> tail(offs.begin(),offs.end()-1);
+      G.for_each_edge([&](const int i, const int j){
+	  if(i!=j) cols[tail[i]++]=j;});
+    }
+
+    // path=(root,p1,...,pm) with m>=1. In induced mode cover[w] is the number of 
+    // vertices among p1,...,pm adjacent to w. 
+    void extend(){
+      const int m=path.size()-1;
+      const int last=path[m];
+      const bool closes=(m>=2 && rootadj[last]);
+
+      if(closes && m+1>=minlen && path[1]<last) emit();
+      if(m+1>=maxlen) return;
+      if(closes && induced) return; // any longer cycle would have the chord (last,root)
+
+      if(induced) add_cover(last,1);
+      for(int t=offs[last]; t<offs[last+1]; t++){
+	int w=cols[t];
+	if(w<=root || onpath[w]) continue;
+	if(induced){
+	  if(cover[w]>1) continue; // adjacent to a vertex other than last
+	  if(rootadj[w] && m+2<minlen) continue; 
+	}
+	path.push_back(w);
+	onpath[w]=1;
+	extend();
+	onpath[w]=0;
+	path.pop_back();
+      }
+      if(induced) add_cover(last,-1);
+    }
+
+    void add_cover(const int v, const int d){
+      for(int t=offs[v]; t<offs[v+1]; t++) cover[cols[t]]+=d;
+    }
+
+    void emit(){
+      for(auto p:path) matches.push_back(p);
+      offsets.push_back(matches.size());
+    }
+
+  };
+
+}
+
+#endif 
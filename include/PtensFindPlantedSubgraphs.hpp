@@ -22,6 +22,8 @@
 #include "AindexPack.hpp"
 #include "Hgraph.hpp"
 #include "Tensor.hpp"
+#include "BumpArena.hpp"
+#include "PtensFindCycles.hpp"
 #include "flog.hpp"
 
 
@@ -149,6 +151,287 @@ namespace ptens{
   };
 
 
+  // Non-recursive matching engine behind FindPlantedSubgraphsFlat. The vertices of H are visited in 
+  // the order of a greedy spanning tree, and the candidates for each level are the unused neighbors 
+  // of the image of the parent. Candidate lists live in a BumpArena that is rewound on backtracking, 
+  // so the search itself does no heap allocation.
+  // Each completed match is passed to the callback as a pointer to the n matched vertices of G, 
+  // listed in traversal order (the same order as the paths of FindPlantedSubgraphs). 
+
+  class PlantedSubgraphMatcher{
+  public:
+
+    typedef Hgraph Graph;
+    typedef cnine::labeled_tree<int> labeled_tree;
+
+    const Graph& G;
+    const Graph& H;
+    int n;
+
+    vector<int> order;  // H vertex visited at each level
+    vector<int> parent; // level of the parent of each level in the spanning tree 
+    vector<vector<pair<int,float> > > Hrows;
+    vector<float> Hmx;
+
+    vector<int> assignment; // H vertex -> G vertex 
+    vector<int> inverse;    // G vertex -> H vertex
+    vector<int> match;      // level -> G vertex
+
+    vector<int*> cands;
+    vector<int> ncands;
+    vector<int> cursor;
+    vector<BumpArena<int>::Mark> marks;
+    BumpArena<int> arena;
+
+    vector<vector<int> > automorphisms;
+    bool automorphisms_computed=false;
+
+
+  public:
+
+
+    PlantedSubgraphMatcher(const Graph& _G, const Graph& _H):
+      G(_G), H(_H), n(_H.getn()){
+      PTENS_ASSRT(n>0);
+
+      labeled_tree S=H.greedy_spanning_tree();
+      for(auto& p:S.indexed_depth_first_traversal()){
+	order.push_back(p.first);
+	parent.push_back(p.second);
+      }
+      PTENS_ASSRT(order.size()==n);
+
+      Hrows.resize(n);
+      Hmx=vector<float>(n*n,0);
+      for(int i=0; i<n; i++)
+	for(auto& p:H.row(i)){
+	  Hrows[i].push_back(p);
+	  Hmx[i*n+p.first]=p.second;
+	}
+
+      assignment=vector<int>(n,-1);
+      inverse=vector<int>(G.getn(),-1);
+      match=vector<int>(n,-1);
+      cands=vector<int*>(n,nullptr);
+      ncands=vector<int>(n,0);
+      cursor=vector<int>(n,0);
+      marks.resize(n);
+    }
+
+
+  public: // ---- Matching -----------------------------------------------------------------------------------
+
+
+    // Every embedding of H in G with match[0]==root
+    template<typename FN>
+    void for_each_match(const int root, const FN& lambda){
+      if(!try_assign(0,root)) return;
+      if(n==1){
+	lambda(match.data());
+	unassign(0);
+	return;
+      }
+
+      int m=1;
+      open(m);
+      while(m>0){
+	if(match[m]!=-1) unassign(m);
+	bool found=false;
+	while(cursor[m]<ncands[m]){
+	  int w=cands[m][cursor[m]++];
+	  if(try_assign(m,w)){found=true; break;}
+	}
+	if(!found){
+	  arena.release(marks[m]);
+	  m--;
+	  continue;
+	}
+	if(m==n-1){
+	  lambda(match.data());
+	  continue;
+	}
+	m++;
+	open(m);
+      }
+      unassign(0);
+    }
+
+
+    // Each vertex set of G that supports an embedding of H is reported exactly once, namely 
+    // for the embedding that is lexicographically smallest among its images under Aut(H). 
+    template<typename FN>
+    void for_each_distinct_match(const int root, const FN& lambda){
+      make_automorphisms();
+      for_each_match(root,[&](const int* x){
+	  if(is_canonical(x)) lambda(x);});
+    }
+
+    int n_automorphisms(){
+      make_automorphisms();
+      return automorphisms.size();
+    }
+
+
+  private:
+
+
+    void open(const int m){
+      marks[m]=arena.mark();
+      match[m]=-1;
+      cursor[m]=0;
+      const int p=match[parent[m]];
+      int t=0;
+      if(const HgraphCSR* C=G.frozen()){
+	const int* c=C->cols_of(p);
+	cands[m]=arena.alloc(C->degree(p));
+	for(int j=0; j<C->degree(p); j++)
+	  if(inverse[c[j]]==-1) cands[m][t++]=c[j];
+      }else{
+	const auto& r=G.row(p);
+	cands[m]=arena.alloc(r.size());
+	for(auto& q:r)
+	  if(inverse[q.first]==-1) cands[m][t++]=q.first;
+      }
+      ncands[m]=t;
+    }
+
+    bool try_assign(const int m, const int w){
+      const int v=order[m];
+      if(inverse[w]!=-1) return false;
+      if(G.is_labeled && H.is_labeled && (G.labels(w)!=H.labels(v))) return false;
+
+      for(auto& p:Hrows[v]){
+	int u=assignment[p.first];
+	if(u==-1) continue;
+	if(p.second!=G(w,u)) return false;
+      }
+      if(const HgraphCSR* C=G.frozen()){
+	const int* c=C->cols_of(w);
+	const float* x=C->vals_of(w);
+	for(int j=0; j<C->degree(w); j++){
+	  int u=inverse[c[j]];
+	  if(u==-1) continue;
+	  if(x[j]!=Hmx[v*n+u]) return false;
+	}
+      }else{
+	for(auto& p:G.row(w)){
+	  int u=inverse[p.first];
+	  if(u==-1) continue;
+	  if(p.second!=Hmx[v*n+u]) return false;
+	}
+      }
+
+      assignment[v]=w;
+      inverse[w]=v;
+      match[m]=w;
+      return true;
+    }
+
+    void unassign(const int m){
+      const int w=match[m];
+      assignment[order[m]]=-1;
+      inverse[w]=-1;
+      match[m]=-1;
+    }
+
+    void make_automorphisms(){
+      if(automorphisms_computed) return;
+      automorphisms_computed=true;
+      PlantedSubgraphMatcher self(H,H);
+      for(int i=0; i<n; i++)
+	self.for_each_match(i,[&](const int* x){
+	    vector<int> sigma(n);
+	    for(int j=0; j<n; j++) sigma[self.order[j]]=x[j];
+	    bool is_identity=true;
+	    for(int j=0; j<n; j++) if(sigma[j]!=j) is_identity=false;
+	    if(!is_identity) automorphisms.push_back(sigma);
+	  });
+    }
+
+    bool is_canonical(const int* x) const{
+      for(auto& sigma:automorphisms){
+	for(int j=0; j<n; j++){
+	  int y=assignment[sigma[order[j]]];
+	  if(y<x[j]) return false;
+	  if(y>x[j]) break;
+	}
+      }
+      return true;
+    }
+
+  };
+
+
+  // Streaming version of FindPlantedSubgraphs: matches are written straight into a flat buffer 
+  // of n ints per match rather than being assembled into a labeled_forest. 
+  // If H is a cycle and G is unweighted and symmetric, the work is handed to FindCycles unless 
+  // specialize=false.
+
+  class FindPlantedSubgraphsFlat{
+  public:
+
+    typedef Hgraph Graph;
+
+    int n;
+    int N=0;
+    vector<int> matches;
+
+
+  public:
+
+
+    FindPlantedSubgraphsFlat(const Graph& G, const Graph& H, const bool specialize=true):
+      n(H.getn()){
+      cnine::flog timer("FindPlantedSubgraphsFlat");
+
+      if(specialize && H.is_cycle() && !(G.is_labeled && H.is_labeled) && FindCycles::is_unweighted(G) && FindCycles::is_symmetric(G)){
+	FindCycles cycles(G,n,n);
+	N=cycles.nmatches();
+	matches=std::move(cycles.matches);
+	return;
+      }
+
+      PlantedSubgraphMatcher matcher(G,H);
+      for(int i=0; i<G.getn(); i++)
+	matcher.for_each_distinct_match(i,[&](const int* x){
+	    matches.insert(matches.end(),x,x+n);
+	    N++;
+	  });
+    }
+
+    int nmatches() const{
+      return N;
+    }
+
+    operator AindexPack() const{
+      AindexPack R;
+      for(int i=0; i<N; i++)
+	R.push_back(i,vector<int>(matches.begin()+i*n,matches.begin()+(i+1)*n));
+      return R;
+    }
+
+    operator cnine::array_pool<int>() const{
+      cnine::array_pool<int> R;
+      R.reserve(N*n);
+      for(int i=0; i<N; i++){
+	std::copy(matches.begin()+i*n,matches.begin()+(i+1)*n,R.arr+R.tail);
+	R.dir.push_back(R.tail,n);
+	R.tail+=n;
+      }
+      return R;
+    }
+
+    operator cnine::Tensor<int>() const{
+      cnine::Tensor<int> R(cnine::Gdims(N,n));
+      for(int t=0; t<N; t++)
+	for(int i=0; i<n; i++) 
+	  R.set(t,i,matches[t*n+i]);
+      return R;
+    }
+
+  };
+
+
   class CachedPlantedSubgraphs{
   public:
 
@@ -156,11 +439,12 @@ namespace ptens{
 
     cnine::array_pool<int> operator()(const Graph& G, const Graph& H){
       cnine::flog timer("CachedPlantedSubgraphs");
-      //if(!G.subgraphlist_cache) G.subgraphlist_cache=new HgraphSubgraphListCache; 
-      auto it=G.subgraphlist_cache.find(H);
-      if(it!=G.subgraphlist_cache.end()) return *it->second;
-      auto newpack=new cnine::array_pool<int>(FindPlantedSubgraphs(G,H));
-      G.subgraphlist_cache[H]=newpack;
+      auto sig=PtensCacheManager::signature(H);
+      size_t h=PtensCacheManager::hash_of(sig);
+      auto p=ptens_cache().find_pool(G.get_cache_id(),h,sig);
+      if(p) return *p;
+      shared_ptr<cnine::array_pool<int> > newpack(new cnine::array_pool<int>(FindPlantedSubgraphsFlat(G,H)));
+      ptens_cache().insert(G.get_cache_id(),h,sig,newpack);
       return *newpack;
     }
   };
@@ -175,13 +459,12 @@ namespace ptens{
 
     CachedPlantedSubgraphsMx(const Graph& G, const Graph& H){
       cnine::flog timer("CachedPlantedSubgraphsMx");
-      //if(!G.subgraphlist_cache) G.subgraphlist_cache=new HgraphSubgraphListCache; 
-      auto it=G.subgraphlistmx_cache.find(H);
-      if(it!=G.subgraphlistmx_cache.end()) ptr=it->second;
-      else{
-	shared_ptr<cnine::Tensor<int> > A(new cnine::Tensor<int>(FindPlantedSubgraphs(G,H)));
-	G.subgraphlistmx_cache[H]=A;
-	ptr=A;
+      auto sig=PtensCacheManager::signature(H);
+      size_t h=PtensCacheManager::hash_of(sig);
+      ptr=ptens_cache().find_mx(G.get_cache_id(),h,sig);
+      if(!ptr){
+	ptr=shared_ptr<cnine::Tensor<int> >(new cnine::Tensor<int>(FindPlantedSubgraphsFlat(G,H)));
+	ptens_cache().insert(G.get_cache_id(),h,sig,ptr);
       }
     }
 
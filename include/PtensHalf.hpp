@@ -0,0 +1,192 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _ptens_PtensHalf
+#define _ptens_PtensHalf
+
+#include <cstring>
+#include <cstdint>
+
+#if defined(__AVX512F__) || defined(__F16C__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "Ptens_base.hpp"
+
+
+namespace ptens{
+
+
+  // 16 bit storage formats. Arithmetic is never done in these types: values are widened to
+  // float, combined in float, and rounded back (to nearest even) only when stored.
+  //
+  // The bulk conversions use AVX-512 BF16 and F16C instructions when the compiler targets them
+  // (e.g. with -march=native), and bit manipulation otherwise. The one difference between the
+  // two is that the AVX-512 BF16 conversion treats denormal floats as zero.
+
+  class bfloat16{
+  public:
+
+    uint16_t bits=0;
+
+    bfloat16(){}
+
+    explicit bfloat16(const float x):
+      bits(from_float(x)){}
+
+    operator float() const{
+      return to_float(bits);
+    }
+
+    static uint16_t from_float(const float x){
+      uint32_t u;
+      std::memcpy(&u,&x,4);
+      if((u&0x7fffffff)>0x7f800000) return (u>>16)|0x40; // keep NaNs quiet
+      u+=0x7fff+((u>>16)&1);
+      return u>>16;
+    }
+
+    static float to_float(const uint16_t h){
+      uint32_t u=((uint32_t)h)<<16;
+      float r;
+      std::memcpy(&r,&u,4);
+      return r;
+    }
+
+    static string str(){
+      return "bfloat16";
+    }
+
+  };
+
+
+  class float16{
+  public:
+
+    uint16_t bits=0;
+
+    float16(){}
+
+    explicit float16(const float x):
+      bits(from_float(x)){}
+
+    operator float() const{
+      return to_float(bits);
+    }
+
+    static uint16_t from_float(const float x){
+      uint32_t u;
+      std::memcpy(&u,&x,4);
+      uint32_t sign=(u>>16)&0x8000;
+      uint32_t a=u&0x7fffffff;
+      if(a>=0x7f800000) return sign|0x7c00|(a>0x7f800000?0x200:0); // inf and NaN
+      if(a>=0x477ff000) return sign|0x7c00; // rounds to inf
+      if(a<0x38800000){ // subnormal in half precision
+	if(a<=0x33000000) return sign;
+	uint32_t e=a>>23;
+	uint32_t m=(a&0x7fffff)|0x800000;
+	int shift=126-e;
+	uint32_t r=m>>shift;
+	uint32_t rem=m&((1u<<shift)-1);
+	uint32_t half=1u<<(shift-1);
+	if(rem>half || (rem==half && (r&1))) r++;
+	return sign|r;
+      }
+      uint32_t r=(a-0x38000000)>>13;
+      uint32_t rem=a&0x1fff;
+      if(rem>0x1000 || (rem==0x1000 && (r&1))) r++;
+      return sign|r;
+    }
+
+    static float to_float(const uint16_t h){
+      uint32_t sign=((uint32_t)(h&0x8000))<<16;
+      uint32_t e=(h>>10)&0x1f;
+      uint32_t m=h&0x3ff;
+      uint32_t u;
+      if(e==0){
+	if(m==0) u=sign;
+	else{
+	  e=113;
+	  while(!(m&0x400)){m<<=1; e--;}
+	  u=sign|(e<<23)|((m&0x3ff)<<13);
+	}
+      }
+      else if(e==31) u=sign|0x7f800000|(m<<13);
+      else u=sign|((e+112)<<23)|(m<<13);
+      float r;
+      std::memcpy(&r,&u,4);
+      return r;
+    }
+
+    static string str(){
+      return "float16";
+    }
+
+  };
+
+
+  // ---- Bulk conversions -----------------------------------------------------------------------------------
+
+
+  inline void convert(const float* x, bfloat16* r, const size_t n){
+    size_t i=0;
+#if defined(__AVX512BF16__) && defined(__AVX512F__)
+    for(; i+16<=n; i+=16){
+      __m256bh v=_mm512_cvtneps_pbh(_mm512_loadu_ps(x+i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(r+i),reinterpret_cast<__m256i&>(v));
+    }
+#endif
+    for(; i<n; i++)
+      r[i].bits=bfloat16::from_float(x[i]);
+  }
+
+  inline void convert(const bfloat16* x, float* r, const size_t n){
+    size_t i=0;
+#if defined(__AVX512F__)
+    for(; i+16<=n; i+=16){
+      __m512i v=_mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x+i)));
+      _mm512_storeu_ps(r+i,_mm512_castsi512_ps(_mm512_slli_epi32(v,16)));
+    }
+#elif defined(__AVX2__)
+    for(; i+8<=n; i+=8){
+      __m256i v=_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x+i)));
+      _mm256_storeu_ps(r+i,_mm256_castsi256_ps(_mm256_slli_epi32(v,16)));
+    }
+#endif
+    for(; i<n; i++)
+      r[i]=bfloat16::to_float(x[i].bits);
+  }
+
+  inline void convert(const float* x, float16* r, const size_t n){
+    size_t i=0;
+#if defined(__F16C__)
+    for(; i+8<=n; i+=8)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(r+i),_mm256_cvtps_ph(_mm256_loadu_ps(x+i),_MM_FROUND_TO_NEAREST_INT));
+#endif
+    for(; i<n; i++)
+      r[i].bits=float16::from_float(x[i]);
+  }
+
+  inline void convert(const float16* x, float* r, const size_t n){
+    size_t i=0;
+#if defined(__F16C__)
+    for(; i+8<=n; i+=8)
+      _mm256_storeu_ps(r+i,_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x+i))));
+#endif
+    for(; i<n; i++)
+      r[i]=float16::to_float(x[i].bits);
+  }
+
+}
+
+#endif
@@ -20,6 +20,7 @@
 #include <ctime>
 
 #include "PtensSession.hpp"
+#include "PtensMemory.hpp"
 
 //extern ptens::PtensLog* ptens_log;
 extern ptens::PtensSession ptens_session;
@@ -114,33 +115,43 @@ namespace ptens{
   };
 
 
+  // Also brackets the call for the per operation memory peaks when memory profiling is on
+
   class TimedFn: public LoggedTimer{
   public:
 
+    PtensMemoryTracker::Op memop;
+
     template<typename OBJ0>
     TimedFn(string cl, string fn, const OBJ0& obj0):
-      LoggedTimer(cl+"::"+fn+"("+obj0.repr()+")"){}
+      LoggedTimer(cl+"::"+fn+"("+obj0.repr()+")"),
+      memop(ptens_memory(),cl+"::"+fn){}
 
     template<typename OBJ0, typename OBJ1>
     TimedFn(string cl, string fn, const OBJ0& obj0, const OBJ1& obj1):
-      LoggedTimer(cl+"::"+fn+"("+obj0.repr()+","+obj1.repr()+")"){}
+      LoggedTimer(cl+"::"+fn+"("+obj0.repr()+","+obj1.repr()+")"),
+      memop(ptens_memory(),cl+"::"+fn){}
 
     template<typename OBJ0, typename OBJ1, typename OBJ2>
     TimedFn(string cl, string fn, const OBJ0& obj0, const OBJ1& obj1, const OBJ2& obj2):
-      LoggedTimer(cl+"::"+fn+"("+obj0.repr()+","+obj1.repr()+","+obj2.repr()+")"){}
+      LoggedTimer(cl+"::"+fn+"("+obj0.repr()+","+obj1.repr()+","+obj2.repr()+")"),
+      memop(ptens_memory(),cl+"::"+fn){}
 
 
     template<typename OBJ0>
     TimedFn(string cl, string fn, const OBJ0& obj0, const int count):
-      LoggedTimer(cl+"::"+fn+"("+obj0.repr()+")"+" [n="+to_string(count)+"]",count){}
+      LoggedTimer(cl+"::"+fn+"("+obj0.repr()+")"+" [n="+to_string(count)+"]",count),
+      memop(ptens_memory(),cl+"::"+fn){}
 
     template<typename OBJ0, typename OBJ1>
     TimedFn(string cl, string fn, const OBJ0& obj0, const OBJ1& obj1, const int count):
-      LoggedTimer(cl+"::"+fn+"("+obj0.repr()+","+obj1.repr()+")"+" [n="+to_string(count)+"]",count){}
+      LoggedTimer(cl+"::"+fn+"("+obj0.repr()+","+obj1.repr()+")"+" [n="+to_string(count)+"]",count),
+      memop(ptens_memory(),cl+"::"+fn){}
 
     template<typename OBJ0, typename OBJ1, typename OBJ2>
     TimedFn(string cl, string fn, const OBJ0& obj0, const OBJ1& obj1, const OBJ2& obj2, const int count):
-      LoggedTimer(cl+"::"+fn+"("+obj0.repr()+","+obj1.repr()+","+obj2.repr()+")"+" [n="+to_string(count)+"]",count){}
+      LoggedTimer(cl+"::"+fn+"("+obj0.repr()+","+obj1.repr()+","+obj2.repr()+")"+" [n="+to_string(count)+"]",count),
+      memop(ptens_memory(),cl+"::"+fn){}
 
 
   };
@@ -0,0 +1,355 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _ptens_PtensMemory
+#define _ptens_PtensMemory
+
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <set>
+
+#include "Ptens_base.hpp"
+#include "PtensCacheManager.hpp"
+#include "PtensScratch.hpp"
+
+
+namespace ptens{
+
+
+  // Accounting of the memory held by ptens objects, broken down by category. While accounting
+  // is on, packs, atoms and index packs register themselves when they are built and unregister
+  // when they are destroyed (see PtensTracked). The totals and high-water marks are updated at
+  // both points, so temporaries that live and die inside a single operation still show up in
+  // the peaks. The size of an object is read again when it is destroyed and whenever the
+  // tracker is sampled, so a pack that grows after construction is still accounted for. Objects
+  // constructed while accounting is off are never registered, so that construction and
+  // destruction stay free of locking on the hot path; turn accounting on before building the
+  // objects to be measured. Caches and scratch space are reported by named sources, which are
+  // only polled by stats() and at the entry to and exit from operations timed with TimedFn.
+
+  class PtensMemoryTracker{
+  public:
+
+    enum Category{FEATURES=0, GRADIENTS=1, INDICES=2, CACHES=3, TEMPORARIES=4, NCATEGORIES=5};
+
+    class Object{
+    public:
+      int cat;
+      size_t (*bytes)(const void*);
+      size_t last; // size at the last reading
+    };
+
+    class Source{
+    public:
+      int cat;
+      std::function<size_t()> bytes;
+    };
+
+    class Frame{
+    public:
+      string name;
+      size_t base;
+      size_t peak;
+    };
+
+    unordered_map<const void*,Object> objects;
+    map<string,Source> sources;
+
+    size_t held[NCATEGORIES]={0};   // by the registered objects
+    size_t polled[NCATEGORIES]={0}; // by the sources, at the last sample
+    size_t current[NCATEGORIES]={0};
+    size_t peak[NCATEGORIES]={0};
+    size_t current_total=0;
+    size_t peak_total=0;
+    long nsamples=0;
+
+    std::atomic<bool> accounting{false};
+    std::atomic<bool> profiling{false};
+    std::set<Frame*> active; // open frames of all threads
+    map<string,size_t> op_peaks;
+
+    std::mutex mx;
+
+
+    PtensMemoryTracker(){
+      sources["subgraph_cache"]=Source{CACHES,[](){return (size_t)ptens_cache().stats()["bytes"];}};
+      sources["scratch"]=Source{TEMPORARIES,[](){return ptens_scratch().memsize();}};
+    }
+
+
+  public: // ---- Registration -------------------------------------------------------------------------------
+
+
+    // p must be fully constructed, and stay so until remove(p) returns
+    void add(const void* p, const int cat, size_t (*bytes)(const void*)){
+      size_t b=bytes(p);
+      std::lock_guard<std::mutex> lock(mx);
+      objects[p]=Object{cat,bytes,b};
+      held[cat]+=b;
+      update_locked();
+    }
+
+    void remove(const void* p){
+      std::lock_guard<std::mutex> lock(mx);
+      auto it=objects.find(p);
+      if(it==objects.end()) return;
+      refresh(it->second,p);
+      held[it->second.cat]-=it->second.last;
+      objects.erase(it);
+      update_locked();
+    }
+
+    void set_category(const void* p, const int cat){
+      std::lock_guard<std::mutex> lock(mx);
+      auto it=objects.find(p);
+      if(it==objects.end()) return;
+      held[it->second.cat]-=it->second.last;
+      held[cat]+=it->second.last;
+      it->second.cat=cat;
+      update_locked();
+    }
+
+    void set_source(const string& name, const int cat, const std::function<size_t()>& fn){
+      std::lock_guard<std::mutex> lock(mx);
+      sources[name]=Source{cat,fn};
+    }
+
+    void erase_source(const string& name){
+      std::lock_guard<std::mutex> lock(mx);
+      sources.erase(name);
+    }
+
+
+  public: // ---- Sampling -----------------------------------------------------------------------------------
+
+
+    void sample(){
+      std::lock_guard<std::mutex> lock(mx);
+      sample_locked();
+    }
+
+    void set_accounting(const bool x){
+      accounting=x;
+    }
+
+    // Profiling also turns accounting on
+    void set_profiling(const bool x){
+      std::lock_guard<std::mutex> lock(mx);
+      if(x) accounting=true;
+      profiling=x;
+      if(!x) active.clear();
+    }
+
+    void reset_peaks(){
+      std::lock_guard<std::mutex> lock(mx);
+      sample_locked();
+      for(int i=0; i<NCATEGORIES; i++)
+	peak[i]=current[i];
+      peak_total=current_total;
+      op_peaks.clear();
+    }
+
+
+  public: // ---- Reports ------------------------------------------------------------------------------------
+
+
+    static string category_name(const int cat){
+      static const char* names[]={"features","gradients","indices","caches","temporaries"};
+      PTENS_ASSRT(cat>=0 && cat<NCATEGORIES);
+      return names[cat];
+    }
+
+    map<string,long> stats(){
+      std::lock_guard<std::mutex> lock(mx);
+      sample_locked();
+      map<string,long> R;
+      for(int i=0; i<NCATEGORIES; i++){
+	R[category_name(i)]=current[i];
+	R["peak_"+category_name(i)]=peak[i];
+      }
+      R["total"]=current_total;
+      R["peak_total"]=peak_total;
+      R["objects"]=objects.size();
+      R["accounting"]=accounting.load();
+      R["samples"]=nsamples;
+      return R;
+    }
+
+    // The largest amount of memory allocated by each operation over what was held on entry
+    map<string,long> op_stats(){
+      std::lock_guard<std::mutex> lock(mx);
+      map<string,long> R;
+      for(auto& p:op_peaks)
+	R[p.first]=p.second;
+      return R;
+    }
+
+
+  public: // ---- Operations ---------------------------------------------------------------------------------
+
+
+    // Operations nest within a thread, but the peak of each one counts the memory allocated by
+    // every thread while it is open.
+    bool begin_op(const string& name){
+      auto& stack=frames();
+      std::lock_guard<std::mutex> lock(mx);
+      if(!profiling) return false;
+      sample_locked();
+      stack.push_back(unique_ptr<Frame>(new Frame{name,current_total,current_total}));
+      active.insert(stack.back().get());
+      return true;
+    }
+
+    void end_op(){
+      auto& stack=frames();
+      std::lock_guard<std::mutex> lock(mx);
+      if(stack.size()==0) return;
+      Frame* f=stack.back().get();
+      if(active.erase(f)){
+	sample_locked();
+	size_t& r=op_peaks[f->name];
+	r=std::max(r,f->peak-f->base);
+      }
+      stack.pop_back();
+    }
+
+    // Brackets an operation for the per operation peaks. Does nothing unless profiling is on.
+    class Op{
+    public:
+      PtensMemoryTracker& owner;
+      bool active;
+      Op(PtensMemoryTracker& _owner, const string& name):
+	owner(_owner), active(_owner.profiling.load(std::memory_order_relaxed) && _owner.begin_op(name)){}
+      ~Op(){
+	if(active) owner.end_op();
+      }
+      Op(const Op& x)=delete;
+      Op& operator=(const Op& x)=delete;
+    };
+
+
+  private:
+
+    static vector<unique_ptr<Frame> >& frames(){
+      static thread_local vector<unique_ptr<Frame> > stack;
+      return stack;
+    }
+
+    void refresh(Object& x, const void* p){
+      size_t b=x.bytes(p);
+      held[x.cat]=held[x.cat]-x.last+b;
+      x.last=b;
+    }
+
+    void update_locked(){
+      current_total=0;
+      for(int i=0; i<NCATEGORIES; i++){
+	current[i]=held[i]+polled[i];
+	peak[i]=std::max(peak[i],current[i]);
+	current_total+=current[i];
+      }
+      peak_total=std::max(peak_total,current_total);
+      for(auto f:active)
+	f->peak=std::max(f->peak,current_total);
+    }
+
+    void sample_locked(){
+      for(auto& p:objects)
+	refresh(p.second,p.first);
+      for(int i=0; i<NCATEGORIES; i++)
+	polled[i]=0;
+      for(auto& p:sources)
+	polled[p.second.cat]+=p.second.bytes();
+      update_locked();
+      nsamples++;
+    }
+
+  };
+
+
+  // Like the cache manager, the tracker is never destroyed, since objects may be released
+  // during static destruction.
+  inline PtensMemoryTracker& ptens_memory(){
+    static PtensMemoryTracker* tracker=new PtensMemoryTracker();
+    return *tracker;
+  }
+
+
+  // Base class for objects whose memory is accounted for. OWNER must provide memory_bytes(),
+  // and declare a Registration as its last data member:
+  //
+  //   Registration registration{this};
+  //
+  // so that it is constructed after, and destroyed before, everything memory_bytes() reads.
+  // This registers the object from every constructor of OWNER, including the implicit copy and
+  // move constructors, and unregisters it while it is still intact.
+
+  template<typename OWNER, int CATEGORY>
+  class PtensTracked{
+  public:
+
+    class Registration{
+    public:
+
+      const OWNER* owner;
+      bool tracked=false;
+
+      Registration(const OWNER* _owner):
+	owner(_owner){
+	add();
+      }
+
+      // The copy sits at the same offset within its owner as x does within x.owner
+      Registration(const Registration& x):
+	owner(reinterpret_cast<const OWNER*>(reinterpret_cast<const char*>(this)-
+	    (reinterpret_cast<const char*>(&x)-reinterpret_cast<const char*>(x.owner)))){
+	add();
+      }
+
+      Registration& operator=(const Registration& x){
+	return *this;
+      }
+
+      ~Registration(){
+	if(tracked) ptens_memory().remove(owner);
+      }
+
+    private:
+
+      void add(){
+	PtensMemoryTracker& tracker=ptens_memory();
+	if(!tracker.accounting.load(std::memory_order_relaxed)) return;
+	tracker.add(owner,CATEGORY,&bytes_of);
+	tracked=true;
+      }
+
+    };
+
+    void set_memory_category(const int cat) const{
+      PtensMemoryTracker& tracker=ptens_memory();
+      if(tracker.accounting.load(std::memory_order_relaxed))
+	tracker.set_category(static_cast<const OWNER*>(this),cat);
+    }
+
+  private:
+
+    static size_t bytes_of(const void* p){
+      return static_cast<const OWNER*>(p)->memory_bytes();
+    }
+
+  };
+
+}
+
+#endif
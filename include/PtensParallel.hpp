@@ -0,0 +1,68 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _PtensParallel
+#define _PtensParallel
+
+#include <thread>
+#include <atomic>
+#include "Ptens_base.hpp"
+
+
+namespace ptens{
+
+
+  // Number of worker threads used by the preprocessing routines (matching, counting, etc.)
+  inline int& ptens_nthreads(){
+    static int n=std::max(1,(int)std::thread::hardware_concurrency());
+    return n;
+  }
+
+  inline int parallel_nthreads(const int n, int nthreads=-1, const int grain=16){
+    if(nthreads<0) nthreads=ptens_nthreads();
+    return std::max(1,std::min(nthreads,(n+grain-1)/grain));
+  }
+
+
+  // Calls lambda(tid,i) for each i in [0,n). Indices are handed out in chunks of size grain 
+  // so that uneven amounts of work per index are balanced dynamically. tid<parallel_nthreads(n,nthreads,grain)
+  // identifies the worker thread, which is useful for keeping per-thread scratch space.
+
+  template<typename FN>
+  void parallel_for(const int n, const FN& lambda, int nthreads=-1, const int grain=16){
+    nthreads=parallel_nthreads(n,nthreads,grain);
+    if(nthreads==1){
+      for(int i=0; i<n; i++) lambda(0,i);
+      return;
+    }
+
+    std::atomic<int> next(0);
+    auto worker=[&](const int tid){
+      while(true){
+	int start=next.fetch_add(grain);
+	if(start>=n) break;
+	int end=std::min(start+grain,n);
+	for(int i=start; i<end; i++) lambda(tid,i);
+      }
+    };
+
+    vector<std::thread> threads;
+    for(int t=1; t<nthreads; t++)
+      threads.push_back(std::thread(worker,t));
+    worker(0);
+    for(auto& p:threads) p.join();
+  }
+
+}
+
+#endif 
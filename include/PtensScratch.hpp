@@ -0,0 +1,146 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _ptens_PtensScratch
+#define _ptens_PtensScratch
+
+#include <atomic>
+
+#include "Ptens_base.hpp"
+#include "BumpArena.hpp"
+
+
+namespace ptens{
+
+
+  // Per thread scratch memory for index arrays and intermediate packs that only live for the
+  // duration of a single message passing operation. A Scope is opened at the top of each operation; while one is
+  // open, temporaries are carved out of the arena, and when the outermost Scope closes the
+  // arena is rewound in one step. The blocks are kept, so after the first few calls the hot
+  // path makes no calls to the system allocator.
+  //
+  //   void add_msg(...){
+  //     PtensScratch::Scope scope(r.dev==0);
+  //     auto [in,out]=G.intersects(x.atoms,r.atoms);
+  //     ...
+  //   }
+  //
+  // Anything drawn from the arena must be destroyed before the Scope that was open when it was
+  // allocated. To catch violations, the arena has a generation counter that is advanced every
+  // time it is rewound (and zeroed when the thread's arena is destroyed). Index packs drawn
+  // from the arena record it: copying such a pack makes a copy that owns its indices, while
+  // moving it or reading it after the Scope has closed fails an assertion.
+  //
+  // The intermediate packs returned by the indexed reductions on the host (see
+  // AindexPack::scratch_pack) take their entries from a second arena of floats. These are not
+  // zero filled: the reductions write each entry before adding to it.
+
+  class PtensScratch{
+  public:
+
+    BumpArena<int> ints;
+    BumpArena<float> floats;
+    int depth=0;
+    shared_ptr<std::atomic<size_t> > generation=std::make_shared<std::atomic<size_t> >(1);
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    PtensScratch():
+      ints(1<<16), floats(1<<18){}
+
+    ~PtensScratch(){
+      *generation=0;
+    }
+
+    PtensScratch(const PtensScratch& x)=delete;
+    PtensScratch& operator=(const PtensScratch& x)=delete;
+
+
+  public: // ---- Scopes -------------------------------------------------------------------------------------
+
+
+    class Scope{
+    public:
+
+      PtensScratch& owner;
+      const bool enabled;
+
+      Scope(const bool _enabled=true);
+
+      ~Scope(){
+	if(!enabled) return;
+	if(--owner.depth==0){
+	  owner.ints.reset();
+	  owner.floats.reset();
+	  (*owner.generation)++;
+	}
+      }
+
+      Scope(const Scope& x)=delete;
+      Scope& operator=(const Scope& x)=delete;
+    };
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    bool active() const{
+      return depth>0;
+    }
+
+    // Only valid while a Scope is open
+    int* alloc_ints(const int n){
+      PTENS_ASSRT(depth>0);
+      return ints.alloc(n);
+    }
+
+    // Only valid while a Scope is open
+    float* alloc_floats(const int n){
+      PTENS_ASSRT(depth>0);
+      return floats.alloc(n);
+    }
+
+    size_t memsize() const{
+      return ints.memsize()+floats.memsize();
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "PtensScratch";
+    }
+
+    string repr() const{
+      return "<PtensScratch[depth="+to_string(depth)+","+to_string(memsize())+" bytes]>";
+    }
+
+  };
+
+
+  inline PtensScratch& ptens_scratch(){
+    thread_local PtensScratch scratch;
+    return scratch;
+  }
+
+  inline PtensScratch::Scope::Scope(const bool _enabled):
+    owner(ptens_scratch()), enabled(_enabled){
+    if(enabled) owner.depth++;
+  }
+
+}
+
+#endif
@@ -24,6 +24,7 @@
 
 #include "Ptens_base.hpp"
 #include "SubgraphObj.hpp"
+#include "PtensMemory.hpp"
 
 
 namespace ptens{
@@ -59,6 +60,16 @@ namespace ptens{
       #else
       logfile<<"Ptens session started without CUDA at "<<std::ctime(&timet)<<endl;
       #endif 
+
+      ptens_memory().set_source("eigenbases",PtensMemoryTracker::CACHES,[this](){
+	  size_t t=0;
+	  for(auto& p:subgraphs){
+	    if(p.evecs.dims.size()==0) continue;
+	    size_t n=1;
+	    for(int i=0; i<p.evecs.dims.size(); i++) n*=p.evecs.dims[i];
+	    t+=n*sizeof(float);
+	  }
+	  return t;});
       
     }
 
@@ -66,6 +77,8 @@ namespace ptens{
     ~PtensSession(){
 
       cout<<"Shutting down ptens."<<endl;
+      ptens_memory().erase_source("eigenbases");
+      logfile<<"Peak memory: "<<ptens_memory().stats()["peak_total"]<<" bytes"<<endl;
       std::time_t timet = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
       logfile<<endl<<"Ptens session shut down at "<<std::ctime(&timet)<<endl<<endl<<endl;
       logfile.close();
@@ -74,6 +87,31 @@ namespace ptens{
     }
 
 
+  public: // ---- Memory -------------------------------------------------------------------------------------
+
+
+    // Current and high-water bytes by category, see PtensMemoryTracker
+    map<string,long> memory_stats() const{
+      return ptens_memory().stats();
+    }
+
+    map<string,long> memory_op_stats() const{
+      return ptens_memory().op_stats();
+    }
+
+    void set_memory_accounting(const bool x){
+      ptens_memory().set_accounting(x);
+    }
+
+    void set_memory_profiling(const bool x){
+      ptens_memory().set_profiling(x);
+    }
+
+    void reset_memory_peaks(){
+      ptens_memory().reset_peaks();
+    }
+
+
   public: // Logging 
 
     void log(const string msg){
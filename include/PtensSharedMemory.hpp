@@ -0,0 +1,104 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#ifndef _PtensSharedMemory
+#define _PtensSharedMemory
+
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Ptens_base.hpp"
+
+
+namespace ptens{
+
+
+  // POSIX shared memory segment. The process that creates it unlinks the name when the
+  // segment is destroyed; processes forked after creation simply inherit the mapping, and
+  // unrelated processes on the same node can attach to it by name.
+
+  class PtensSharedSegment{
+  public:
+
+    string name;
+    size_t size=0;
+    char* base=nullptr;
+    bool owner=false;
+
+    ~PtensSharedSegment(){
+      if(base) munmap(base,size);
+      if(owner) shm_unlink(name.c_str());
+    }
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    // Create a new zero filled segment
+    PtensSharedSegment(const size_t _size):
+      size(std::max(_size,(size_t)1)), owner(true){
+      static std::atomic<int> counter(0);
+      name="/ptens_"+to_string(getpid())+"_"+to_string(counter++);
+      int fd=shm_open(name.c_str(),O_CREAT|O_EXCL|O_RDWR,0600);
+      if(fd<0) throw std::runtime_error("Ptens error in "+string(__PRETTY_FUNCTION__)+": cannot create shared memory segment "+name+".");
+      if(ftruncate(fd,size)!=0){
+	close(fd);
+	shm_unlink(name.c_str());
+	throw std::runtime_error("Ptens error in "+string(__PRETTY_FUNCTION__)+": cannot allocate "+to_string(size)+" bytes of shared memory.");
+      }
+      map(fd);
+    }
+
+    // Attach to an existing segment
+    PtensSharedSegment(const string _name, const size_t _size):
+      name(_name), size(_size), owner(false){
+      int fd=shm_open(name.c_str(),O_RDWR,0600);
+      if(fd<0) throw std::runtime_error("Ptens error in "+string(__PRETTY_FUNCTION__)+": cannot open shared memory segment "+name+".");
+      map(fd);
+    }
+
+    PtensSharedSegment(const PtensSharedSegment& x)=delete;
+    PtensSharedSegment& operator=(const PtensSharedSegment& x)=delete;
+
+
+  private:
+
+    void map(const int fd){
+      void* p=mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+      close(fd);
+      if(p==MAP_FAILED){
+	if(owner) shm_unlink(name.c_str());
+	throw std::runtime_error("Ptens error in "+string(__PRETTY_FUNCTION__)+": cannot map shared memory segment "+name+".");
+      }
+      base=reinterpret_cast<char*>(p);
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "PtensSharedSegment";
+    }
+
+    string repr() const{
+      return "<PtensSharedSegment["+name+","+to_string(size)+" bytes]>";
+    }
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _PtensSubgraphCounts
+#define _PtensSubgraphCounts
+
+#include "Ptens_base.hpp"
+#include "Hgraph.hpp"
+#include "Tensor.hpp"
+#include "PtensFindPlantedSubgraphs.hpp"
+#include "PtensParallel.hpp"
+#include "flog.hpp"
+
+
+namespace ptens{
+
+
+  // For each vertex of G (and optionally each edge), the number of distinct occurrences of H 
+  // that contain it. Matches are counted on the fly and never stored. The roots of the search 
+  // are distributed over threads, each with its own matcher and its own count vectors. 
+  // Edges are numbered in the order of Hgraph::for_each_edge, i.e., the same order as Hgraph::edges().
+
+  class SubgraphCounts{
+  public:
+
+    typedef Hgraph Graph;
+
+    int n=0;
+    int nmatches=0;
+    vector<float> vertex_counts;
+    vector<float> edge_counts;
+    bool with_edges=false;
+
+
+  public:
+
+
+    SubgraphCounts(const Graph& G, const Graph& H, const bool _with_edges=false, const int nthreads=-1):
+      n(G.getn()), with_edges(_with_edges){
+      cnine::flog timer("SubgraphCounts");
+      const int k=H.getn();
+
+      vector<int> eoffs;
+      vector<int> ecols;
+      vector<pair<int,int> > Hedges;
+      if(with_edges){
+	eoffs=vector<int>(n+1,0);
+	G.for_each_edge([&](const int i, const int j){
+	    eoffs[i+1]++;
+	    ecols.push_back(j);});
+	for(int i=0; i<n; i++) eoffs[i+1]+=eoffs[i];
+	H.for_each_edge([&](const int i, const int j){
+	    Hedges.push_back(pair<int,int>(i,j));});
+      }
+
+      const int nt=parallel_nthreads(n,nthreads,4);
+      vector<vector<float> > vcounts(nt,vector<float>(n,0));
+      vector<vector<float> > ecounts(nt,vector<float>(with_edges?ecols.size():0,0));
+      vector<int> counts(nt,0);
+      vector<PlantedSubgraphMatcher*> matchers(nt,nullptr);
+
+      parallel_for(n,[&](const int tid, const int root){
+	  if(!matchers[tid]) matchers[tid]=new PlantedSubgraphMatcher(G,H);
+	  PlantedSubgraphMatcher& matcher=*matchers[tid];
+	  vector<float>& vc=vcounts[tid];
+	  vector<float>& ec=ecounts[tid];
+	  matcher.for_each_distinct_match(root,[&](const int* x){
+	      counts[tid]++;
+	      for(int j=0; j<k; j++) vc[x[j]]++;
+	      if(!with_edges) return;
+	      for(auto& e:Hedges){
+		int a=matcher.assignment[e.first];
+		int b=matcher.assignment[e.second];
+		for(int t=eoffs[a]; t<eoffs[a+1]; t++)
+		  if(ecols[t]==b){ec[t]++; break;}
+	      }
+	    });
+	},nt,4);
+
+      for(auto p:matchers) delete p;
+
+      vertex_counts=vector<float>(n,0);
+      for(int t=0; t<nt; t++){
+	nmatches+=counts[t];
+	for(int i=0; i<n; i++) vertex_counts[i]+=vcounts[t][i];
+      }
+      if(with_edges){
+	edge_counts=vector<float>(ecols.size(),0);
+	for(int t=0; t<nt; t++)
+	  for(int i=0; i<ecols.size(); i++) edge_counts[i]+=ecounts[t][i];
+      }
+    }
+
+
+  public: // ---- Conversions --------------------------------------------------------------------------------
+
+
+    // n x 1 matrix, ready to be turned into a Ptensors0 over the vertices of G
+    cnine::Tensor<float> vertex_tensor() const{
+      cnine::Tensor<float> R(cnine::Gdims(n,1),cnine::fill_zero());
+      for(int i=0; i<n; i++) R.set(i,0,vertex_counts[i]);
+      return R;
+    }
+
+    // nedges x 1 matrix, ready to be turned into a Ptensors0 over G.edges()
+    cnine::Tensor<float> edge_tensor() const{
+      PTENS_ASSRT(with_edges);
+      int N=edge_counts.size();
+      cnine::Tensor<float> R(cnine::Gdims(N,1),cnine::fill_zero());
+      for(int i=0; i<N; i++) R.set(i,0,edge_counts[i]);
+      return R;
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "SubgraphCounts";
+    }
+
+    string repr() const{
+      return "<SubgraphCounts[n="+to_string(n)+",matches="+to_string(nmatches)+"]>";
+    }
+
+  };
+
+}
+
+#endif 
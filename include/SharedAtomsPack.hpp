@@ -0,0 +1,181 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _ptens_SharedAtomsPack
+#define _ptens_SharedAtomsPack
+
+#include "AtomsPack.hpp"
+
+
+namespace ptens{
+
+
+  // Reference counted handle to an immutable AtomsPack. Copying a handle, or constructing one
+  // from an AtomsPack that is already held by a handle, shares the underlying pack rather than
+  // copying it, so layers derived from one another all refer to the same atoms. Appending to a
+  // handle copies the pack first if it is shared with any other handle.
+
+  class SharedAtomsPack{
+  public:
+
+    shared_ptr<AtomsPack> obj;
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    SharedAtomsPack():
+      obj(std::make_shared<AtomsPack>()){}
+
+    SharedAtomsPack(const AtomsPack& x):
+      obj(share(x)){}
+
+    SharedAtomsPack(AtomsPack&& x):
+      obj(x.is_shared()?share(x):std::make_shared<AtomsPack>(std::move(x))){}
+
+    explicit SharedAtomsPack(const int n):
+      obj(std::make_shared<AtomsPack>(n)){}
+
+    explicit SharedAtomsPack(const int n, const int k):
+      obj(std::make_shared<AtomsPack>(n,k)){}
+
+    explicit SharedAtomsPack(const cnine::Tensor<int>& M):
+      obj(std::make_shared<AtomsPack>(M)){}
+
+
+  private:
+
+    static shared_ptr<AtomsPack> share(const AtomsPack& x){
+      auto p=std::const_pointer_cast<AtomsPack>(x.weak_from_this().lock());
+      if(p) return p;
+      return std::make_shared<AtomsPack>(x);
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    const AtomsPack& get() const{
+      return *obj;
+    }
+
+    operator const AtomsPack&() const{
+      return *obj;
+    }
+
+    const AtomsPack& operator*() const{
+      return *obj;
+    }
+
+    const AtomsPack* operator->() const{
+      return obj.get();
+    }
+
+    size_t id() const{
+      return obj->id();
+    }
+
+    size_t hash() const{
+      return obj->hash();
+    }
+
+    int size() const{
+      return obj->size();
+    }
+
+    int size_of(const int i) const{
+      return obj->size_of(i);
+    }
+
+    int tsize0() const{
+      return obj->tsize0();
+    }
+
+    int tsize1() const{
+      return obj->tsize1();
+    }
+
+    int tsize2() const{
+      return obj->tsize2();
+    }
+
+    vector<int> operator()(const int i) const{
+      return (*obj)(i);
+    }
+
+    Atoms operator[](const int i) const{
+      return (*obj)[i];
+    }
+
+    vector<vector<int> > as_vecs() const{
+      return obj->as_vecs();
+    }
+
+    cnine::array_pool<int> dims1(const int nc) const{
+      return obj->dims1(nc);
+    }
+
+    cnine::array_pool<int> dims2(const int nc) const{
+      return obj->dims2(nc);
+    }
+
+    // The view must not be written to
+    AtomsPack view() const{
+      return obj->view();
+    }
+
+    AtomsPack permute(const cnine::permutation& pi) const{
+      return obj->permute(pi);
+    }
+
+    // Packs held by the same handle compare equal without looking at their contents
+    bool operator==(const SharedAtomsPack& y) const{
+      if(obj==y.obj) return true;
+      return static_cast<const cnine::array_pool<int>&>(*obj)==static_cast<const cnine::array_pool<int>&>(*y.obj);
+    }
+
+    bool operator!=(const SharedAtomsPack& y) const{
+      return !(*this==y);
+    }
+
+
+  public: // ---- Modification -------------------------------------------------------------------------------
+
+
+    void push_back(const vector<int>& v){
+      if(obj.use_count()>1) obj=std::make_shared<AtomsPack>(*obj);
+      obj->push_back(v);
+      obj->_id=0;
+      obj->_hashed=false;
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "SharedAtomsPack";
+    }
+
+    string str(const string indent="") const{
+      return obj->str(indent);
+    }
+
+    friend ostream& operator<<(ostream& stream, const SharedAtomsPack& v){
+      stream<<v.str(); return stream;}
+
+  };
+
+}
+
+#endif
@@ -151,8 +151,7 @@ namespace std{
   struct hash<ptens::SubgraphObj>{
   public:
     size_t operator()(const ptens::SubgraphObj& x) const{
-      if(x.is_labeled) return (hash<cnine::SparseRmatrix>()(x)<<1)^hash<cnine::RtensorA>()(x.labels);
-      return hash<cnine::SparseRmatrix>()(x);
+      return x.fingerprint();
     }
   };
 }
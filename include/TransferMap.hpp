@@ -203,29 +203,12 @@ namespace ptens{
 
     pair<AindexPack,AindexPack> intersects(const AtomsPack& inputs, const AtomsPack& outputs, const bool self=0) const{
       cnine::ftimer timer("TransferMap::intersects");
-      //cout<<n<<" "<<m<<" "<<inputs.size()<<" "<<outputs.size()<<endl;
       PTENS_ASSRT(outputs.size()==n);
       PTENS_ASSRT(inputs.size()==m);
-      AindexPack in_indices;
-      AindexPack out_indices;
-      forall_edges([&](const int i, const int j, const float v){
-	  Atoms in=inputs[j];
-	  Atoms out=outputs[i];
-	  Atoms common=out.intersect(in);
-	  //in_indices.push_back(j,in(common));
-	  //out_indices.push_back(i,out(common));
-	  auto _in=in(common);
-	  auto _out=out(common);
-	  in_indices.push_back(j,_in);
-	  out_indices.push_back(i,_out);
-	  in_indices.count1+=_in.size();
-	  in_indices.count2+=_in.size()*_in.size();
-	  out_indices.count1+=_out.size();
-	  out_indices.count2+=_out.size()*_out.size();
-	    
-	}, self);
+      auto [in_indices,out_indices]=AindexPack::intersects(inputs,outputs,[&](const auto& fn){
+	  forall_edges([&](const int i, const int j, const float v){fn(i,j);},self);});
       out_indices.bmap=get_bmap();
-      return make_pair(in_indices, out_indices);
+      return make_pair(std::move(in_indices),std::move(out_indices));
     }
 
 
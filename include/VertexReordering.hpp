@@ -0,0 +1,252 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _ptens_VertexReordering
+#define _ptens_VertexReordering
+
+#include "Ptens_base.hpp"
+#include "Hgraph.hpp"
+#include "AtomsPack.hpp"
+
+
+namespace ptens{
+
+  class Ptensors1;
+  class Ptensors2;
+
+
+  // Locality improving renumbering of the vertices of a graph. Methods:
+  //   "rcm"    reverse Cuthill-McKee (bandwidth reduction) 
+  //   "cm"     Cuthill-McKee
+  //   "bfs"    breadth first order, one component at a time
+  //   "degree" decreasing degree, so that hubs are next to each other
+  // The ordering is computed on the symmetrized graph. perm maps old vertex indices to new 
+  // ones and inverse maps them back, so results computed in the new order can be returned 
+  // to the original one with inv().
+
+  class VertexReordering{
+  public:
+
+    int n;
+    vector<int> perm;    // old index -> new index
+    vector<int> inverse; // new index -> old index
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    VertexReordering(const vector<int>& _perm):
+      n(_perm.size()), perm(_perm), inverse(_perm.size()){
+      for(int i=0; i<n; i++)
+	inverse[perm[i]]=i;
+    }
+
+    VertexReordering(const Hgraph& G, const string method="rcm"):
+      n(G.getn()){
+      cnine::flog timer("VertexReordering");
+      PTENS_ASSRT(G.getn()==G.m);
+
+      vector<int> src;
+      vector<int> dst;
+      G.for_each_edge([&](const int i, const int j){
+	  if(i==j) return;
+	  src.push_back(i);
+	  dst.push_back(j);
+	});
+      Hgraph S=Hgraph::edge_index(src.data(),dst.data(),src.size(),n,true);
+      const HgraphCSR& A=*S.frozen();
+
+      vector<int> order;
+      if(method=="degree") order=degree_order(A);
+      else if(method=="bfs") order=bfs_order(A,false);
+      else if(method=="cm") order=bfs_order(A,true);
+      else if(method=="rcm"){
+	order=bfs_order(A,true);
+	std::reverse(order.begin(),order.end());
+      }
+      else throw std::invalid_argument("Ptens error in "+string(__PRETTY_FUNCTION__)+": unknown ordering \""+method+"\".");
+
+      inverse=order;
+      perm.resize(n);
+      for(int i=0; i<n; i++)
+	perm[order[i]]=i;
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    VertexReordering inv() const{
+      return VertexReordering(inverse);
+    }
+
+    static int bandwidth(const Hgraph& G){
+      int r=0;
+      G.for_each_edge([&](const int i, const int j){
+	  r=std::max(r,std::abs(i-j));});
+      return r;
+    }
+
+
+  public: // ---- Application --------------------------------------------------------------------------------
+
+
+    Hgraph operator()(const Hgraph& G) const{
+      return G.relabel(perm);
+    }
+
+    // Renumber the atoms in each reference domain, but keep the domains in place 
+    AtomsPack relabel(const AtomsPack& x) const{
+      return x.relabel(perm);
+    }
+
+    // For packs with one reference domain per vertex (such as nhoods): the domains are also 
+    // moved to the position of their vertex in the new order, and the atoms in each domain 
+    // are sorted in the new numbering, like those of the packs built from the new graph.
+    AtomsPack operator()(const AtomsPack& x) const{
+      PTENS_ASSRT(x.size()==n);
+      AtomsPack R;
+      R.reserve(x.tail);
+      for(int k=0; k<n; k++){
+	vector<int> v=x(inverse[k]);
+	R.dir.push_back(R.tail,v.size());
+	for(auto p:domain_order(v))
+	  R.arr[R.tail++]=perm[v[p]];
+      }
+      return R;
+    }
+
+    // The same for Ptensors0/1/2 with one ptensor per vertex. The rows (and for second order 
+    // ptensors the columns) follow the atoms to their sorted position, so applying inv() 
+    // afterwards gives back x exactly.
+    template<typename PACK>
+    PACK apply(const PACK& x) const{
+      PTENS_ASSRT(x.dev==0);
+      const int order=std::is_same<PACK,Ptensors2>::value? 2 : (std::is_same<PACK,Ptensors1>::value? 1 : 0);
+      const int nc=x.get_nc();
+      const AtomsPack& atoms=x.atoms;
+      PACK R=PACK::raw((*this)(atoms),nc);
+      parallel_for(n,[&](const int tid, const int k){
+	  vector<int> src=domain_order(atoms(inverse[k]));
+	  const int m=src.size();
+	  const float* xp=x.arr+x.dir(inverse[k],0);
+	  float* rp=R.arr+R.dir(k,0);
+	  if(order==0) std::copy(xp,xp+nc,rp);
+	  if(order==1)
+	    for(int a=0; a<m; a++)
+	      std::copy(xp+src[a]*nc,xp+(src[a]+1)*nc,rp+a*nc);
+	  if(order==2)
+	    for(int a=0; a<m; a++)
+	      for(int b=0; b<m; b++){
+		const float* t=xp+(src[a]*m+src[b])*nc;
+		std::copy(t,t+nc,rp+(a*m+b)*nc);
+	      }
+	});
+      return R;
+    }
+
+
+  private:
+
+
+    // Positions in v of the atoms of v taken in increasing order of their new index
+    vector<int> domain_order(const vector<int>& v) const{
+      vector<int> R(v.size());
+      for(int i=0; i<v.size(); i++) R[i]=i;
+      std::sort(R.begin(),R.end(),[&](const int a, const int b){
+	  return perm[v[a]]<perm[v[b]];});
+      return R;
+    }
+
+    static vector<int> degree_order(const HgraphCSR& A){
+      int n=A.n;
+      vector<int> order(n);
+      for(int i=0; i<n; i++) order[i]=i;
+      std::stable_sort(order.begin(),order.end(),[&](const int a, const int b){
+	  return A.degree(a)>A.degree(b);});
+      return order;
+    }
+
+    // With by_degree, each component is started from a pseudo-peripheral vertex and 
+    // neighbors are enqueued in increasing order of degree (Cuthill-McKee). 
+    static vector<int> bfs_order(const HgraphCSR& A, const bool by_degree){
+      int n=A.n;
+      vector<int> order;
+      order.reserve(n);
+      vector<char> visited(n,0);
+      vector<int> level(n,-1);
+
+      vector<int> starts(n);
+      for(int i=0; i<n; i++) starts[i]=i;
+      if(by_degree)
+	std::stable_sort(starts.begin(),starts.end(),[&](const int a, const int b){
+	    return A.degree(a)<A.degree(b);});
+
+      for(auto s:starts){
+	if(visited[s]) continue;
+	if(by_degree) s=peripheral(A,s,level);
+	int head=order.size();
+	order.push_back(s);
+	visited[s]=1;
+	while(head<order.size()){
+	  int u=order[head++];
+	  int first=order.size();
+	  const int* c=A.cols_of(u);
+	  for(int j=0; j<A.degree(u); j++)
+	    if(!visited[c[j]]){
+	      visited[c[j]]=1;
+	      order.push_back(c[j]);
+	    }
+	  if(by_degree)
+	    std::stable_sort(order.begin()+first,order.end(),[&](const int a, const int b){
+		return A.degree(a)<A.degree(b);});
+	}
+      }
+      return order;
+    }
+
+    // George-Liu: move to a vertex of smallest degree in the last BFS level while the 
+    // eccentricity keeps growing
+    static int peripheral(const HgraphCSR& A, int v, vector<int>& level){
+      int ecc=-1;
+      vector<int> reached;
+      for(int iter=0; iter<8; iter++){
+	reached.clear();
+	reached.push_back(v);
+	level[v]=0;
+	for(int head=0; head<reached.size(); head++){
+	  int u=reached[head];
+	  const int* c=A.cols_of(u);
+	  for(int j=0; j<A.degree(u); j++)
+	    if(level[c[j]]<0){
+	      level[c[j]]=level[u]+1;
+	      reached.push_back(c[j]);
+	    }
+	}
+	int e=level[reached.back()];
+	int best=reached.back();
+	for(auto u:reached)
+	  if(level[u]==e && A.degree(u)<A.degree(best)) best=u;
+	for(auto u:reached) level[u]=-1;
+	if(e<=ecc) break;
+	ecc=e;
+	v=best;
+      }
+      return v;
+    }
+
+  };
+
+}
+
+#endif 
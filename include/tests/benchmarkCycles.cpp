@@ -0,0 +1,53 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "Hgraph.hpp"
+#include "Subgraph.hpp"
+#include "PtensFindPlantedSubgraphs.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+namespace ptens{
+  PtensSession ptens_session;
+}
+
+template<typename FN>
+double timeit(const FN& lambda){
+  auto t0=std::chrono::system_clock::now();
+  lambda();
+  return std::chrono::duration<double,std::milli>(std::chrono::system_clock::now()-t0).count();
+}
+
+int main(int argc, char** argv){
+
+  int n=2000;
+  float p=0.004;
+  if(argc>1) n=atoi(argv[1]);
+  if(argc>2) p=atof(argv[2]);
+
+  Hgraph G=Hgraph::random(n,p);
+  cout<<"Random graph with "<<n<<" vertices and "<<G.nedges()/2<<" edges"<<endl;
+
+  for(int k=3; k<=8; k++){
+    Subgraph S=Subgraph::cycle(k);
+    int N0=0, N1=0;
+    double t0=timeit([&](){N0=FindPlantedSubgraphsFlat(G,*S.obj,false).nmatches();});
+    double t1=timeit([&](){N1=FindPlantedSubgraphsFlat(G,*S.obj).nmatches();});
+    cout<<"cycle("<<k<<"): "<<N0<<" matches, generic "<<t0<<" ms, cycle enumerator "<<t1<<" ms"; 
+    if(N0!=N1) cout<<" MISMATCH ("<<N1<<")";
+    cout<<endl;
+  }
+
+}
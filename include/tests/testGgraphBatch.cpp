@@ -0,0 +1,39 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "Ggraph.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  Hgraph triangle(3,{{0,1},{1,2},{2,0}});
+
+  Ggraph G0({{0,1},{1,2},{2,0},{2,3}},4);
+  Ggraph G1({{0,1},{1,2},{2,3},{3,0},{0,2}},4);
+  Ggraph G2=Ggraph::random(6,0.5);
+
+  Ggraph B=Ggraph::batch({G0,G1,G2});
+  cout<<B<<endl;
+  for(auto p:B.offsets) cout<<p<<" ";
+  cout<<endl;
+
+  cout<<*B.subgraphs_mx(triangle)<<endl;
+  cout<<B.obj->frozen()->repr()<<endl;
+  cout<<B.nhoods(1)<<endl;
+
+}
@@ -37,9 +37,34 @@ int main(int argc, char** argv){
   cout<<Mg<<endl;
   //for(int i=0; i<5; i++)
   //cout<<M.nhoods(i)<<endl;
+  cout<<M.nhoods(2)<<endl;
+  cout<<M.nhoods(2,4)<<endl;
 
   auto E=M.edges();
   cout<<E<<endl;
 
+  Hgraph M2(M);
+  cout<<M.fingerprint()<<" "<<M2.fingerprint()<<" "<<(M==M2)<<endl;
+  M2.set(0,9,2.0);
+  cout<<M.fingerprint()<<" "<<M2.fingerprint()<<" "<<(M==M2)<<endl;
+
+  // The same edges stored in a different order have the same fingerprint
+  int src[]={4,0,2,2,1};
+  int dst[]={1,3,0,4,2};
+  Hgraph B=Hgraph::edge_index(src,dst,5,5);
+  Hgraph C(5);
+  for(int t=4; t>=0; t--)
+    C.set(src[t],dst[t],1.0);
+  cout<<B.fingerprint()<<" "<<C.fingerprint()<<" "<<(B==C)<<endl;
+  C.freeze();
+  cout<<(B==C)<<endl; // both frozen: compared on the CSR arrays
+
+  // Writing a label resets the fingerprint
+  Hgraph D(5,{{0,1},{1,2}},RtensorA::zero({5}));
+  Hgraph D2(D);
+  cout<<(D==D2)<<" ";
+  D2.set_label(3,1.0);
+  cout<<(D.fingerprint()==D2.fingerprint())<<" "<<(D==D2)<<endl;
+
 }
 
@@ -0,0 +1,47 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "Hgraph.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  vector<int64_t> src={0,1,1,2,3,3};
+  vector<int64_t> dst={1,2,2,3,0,4};
+
+  Hgraph G=Hgraph::edge_index(src.data(),dst.data(),src.size());
+  cout<<G.frozen()->repr()<<endl;
+  cout<<G<<endl;
+
+  Hgraph Gs=Hgraph::edge_index(src.data(),dst.data(),src.size(),-1,true);
+  cout<<Gs<<endl;
+
+  int n=100000;
+  int E=1000000;
+  vector<int> s(E), d(E);
+  for(int i=0; i<E; i++){
+    s[i]=rand()%n;
+    d[i]=rand()%n;
+  }
+  {
+    cnine::flog timer("bulk edge_index");
+    Hgraph B=Hgraph::edge_index(s.data(),d.data(),E,n,true);
+    cout<<B.nedges()<<endl;
+  }
+
+}
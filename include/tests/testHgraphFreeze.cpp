@@ -0,0 +1,52 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "Hgraph.hpp"
+#include "PtensFindPlantedSubgraphs.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+bool same(const AtomsPack& x, const AtomsPack& y){
+  if(x.size()!=y.size()) return false;
+  for(int i=0; i<x.size(); i++)
+    if(x(i)!=y(i)) return false;
+  return true;
+}
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  Hgraph square(4,{{0,1},{1,2},{2,3},{3,0}});
+
+  Hgraph G=Hgraph::random(300,0.03);
+  Hgraph F(G);
+  F.freeze();
+  cout<<F.frozen()->repr()<<endl;
+
+  AtomsPack A=G.nhoods(2);
+  AtomsPack B=F.nhoods(2);
+  cout<<"nhoods agree: "<<same(A,B)<<endl;
+  cout<<"merge agrees: "<<same(G.merge(A),F.merge(A))<<endl;
+
+  int nG=0, nF=0;
+  {cnine::flog timer("matcher (lists)"); nG=FindPlantedSubgraphsFlat(G,square).nmatches();}
+  {cnine::flog timer("matcher (CSR)"); nF=FindPlantedSubgraphsFlat(F,square).nmatches();}
+  cout<<"squares: "<<nG<<" "<<nF<<endl;
+
+  F.set(0,1,1.0);
+  cout<<"frozen after set: "<<F.is_frozen()<<endl;
+
+}
@@ -0,0 +1,46 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ *
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "Hgraph.hpp"
+#include "PtensFindPlantedSubgraphs.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  Hgraph triangle(3,{{0,1},{1,2},{2,0}});
+  Hgraph square(4,{{0,1},{1,2},{2,3},{3,0}});
+
+  Hgraph G(8);
+  G.insert(triangle,{0,1,2});
+  G.insert(triangle,{5,6,7});
+  G.insert(square,{1,2,3,4});
+
+  FindPlantedSubgraphsFlat flat(G,triangle);
+  cout<<cnine::array_pool<int>(flat)<<endl;
+  cout<<"Triangles: "<<flat.nmatches()<<" (tree matcher: "<<FindPlantedSubgraphs(G,triangle).nmatches()<<")"<<endl;
+
+  FindPlantedSubgraphsFlat flat2(G,square);
+  cout<<cnine::array_pool<int>(flat2)<<endl;
+  cout<<"Squares: "<<flat2.nmatches()<<" (tree matcher: "<<FindPlantedSubgraphs(G,square).nmatches()<<")"<<endl;
+
+  Hgraph R=Hgraph::random(200,0.05);
+  {cnine::flog timer("tree matcher"); cout<<FindPlantedSubgraphs(R,square).nmatches()<<endl;}
+  {cnine::flog timer("flat matcher"); cout<<FindPlantedSubgraphsFlat(R,square).nmatches()<<endl;}
+
+}
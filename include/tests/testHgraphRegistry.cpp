@@ -0,0 +1,50 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "Ggraph.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  Hgraph triangle(3,{{0,1},{1,2},{2,0}});
+
+  Ggraph G0({{0,1},{1,2},{2,0},{2,3},{3,4},{4,5},{5,3}},6);
+  Ggraph G1({{5,4},{4,3},{3,5},{3,2},{2,1},{1,0},{0,2}},6);
+  Ggraph G2({{0,1},{1,2},{2,3},{3,4},{4,5},{5,0}},6);
+
+  Ggraph S0=G0.shared();
+  Ggraph S1=G1.shared();
+  Ggraph S2=G2.shared();
+  cout<<(S0.canon==S1.canon)<<(S0.canon==S2.canon)<<endl;
+  cout<<ptens_graph_registry().stats()["classes"]<<endl;
+
+  cout<<*S1.subgraphs_mx(triangle)<<endl;
+  cout<<*G1.subgraphs_mx(triangle)<<endl;
+
+  cout<<S1.nhoods(1)<<endl;
+  cout<<G1.nhoods(1)<<endl;
+  cout<<"Same nhoods: "<<(S1.nhoods(1).hash()==G1.nhoods(1).hash())<<endl;
+  cout<<"Remapped matches cached: "<<(S1.subgraphs_mx(triangle)==S1.subgraphs_mx(triangle))<<endl;
+
+  // Overlap maps between layers on the occurrences of two patterns are computed once per class
+  Hgraph edge(2,{{0,1}});
+  auto T0=S0.transfer_map(AtomsPack(*S0.subgraphs_mx(edge)),AtomsPack(*S0.subgraphs_mx(triangle)));
+  auto T1=S1.transfer_map(AtomsPack(*S1.subgraphs_mx(edge)),AtomsPack(*S1.subgraphs_mx(triangle)));
+  cout<<"Shared transfer map: "<<(T0==T1)<<endl;
+
+}
@@ -34,4 +34,37 @@ int main(int argc, char** argv){
   Hgraph G=Hgraph::overlaps(x,y);
   cout<<G.dense()<<endl;
 
+  auto [in,out]=G.intersects(x,y);
+  for(int i=0; i<in.size(); i++)
+    cout<<in.tix(i)<<"->"<<out.tix(i)<<": "<<Atoms(in.ix(i))<<" "<<Atoms(out.ix(i))<<endl;
+
+  {
+    PtensScratch::Scope scope;
+    auto [in2,out2]=G.intersects(x,y);
+    for(int i=0; i<in2.size(); i++)
+      if(in2.ix(i)!=in.ix(i) || out2.ix(i)!=out.ix(i)) cout<<"Mismatch at "<<i<<endl;
+    cout<<ptens_scratch().repr()<<endl;
+
+    // Outside the scratch arena the packs are built in the compact encoding
+    AindexPack in3=in2.compacted();
+    cout<<in.is_compact()<<in2.is_compact()<<in3.is_compact()<<endl;
+    for(int i=0; i<in3.size(); i++)
+      if(in3.tix(i)!=in2.tix(i) || in3.ix(i)!=in2.ix(i)) cout<<"Mismatch at "<<i<<endl;
+    cout<<"index bytes: "<<(in2.tail+2*in2.size())*sizeof(int)<<" -> "<<in3.memory_bytes()<<endl;
+    if(in3.str()!=in.str() || in3.expanded().str()!=in.str()) cout<<"Mismatch in str()"<<endl;
+    cout<<in3<<endl;
+  }
+
+  // Copies of arena packs own their indices and stay valid after the Scope closes
+  AindexPack* keep=nullptr;
+  {
+    PtensScratch::Scope scope;
+    auto [in4,out4]=G.intersects(x,y);
+    keep=new AindexPack(in4);
+  }
+  for(int i=0; i<keep->size(); i++)
+    if(keep->ix(i)!=in.ix(i)) cout<<"Mismatch at "<<i<<endl;
+  cout<<"copy live after scope: "<<keep->is_live()<<endl;
+  delete keep;
+
 }
@@ -0,0 +1,67 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "Hgraph.hpp"
+#include "PtensArchive.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+bool same(const AtomsPack& x, const AtomsPack& y){
+  if(x.size()!=y.size()) return false;
+  for(int i=0; i<x.size(); i++)
+    if(x(i)!=y(i)) return false;
+  return true;
+}
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  int N=1000;
+  if(argc>1) N=atoi(argv[1]);
+  string filename="testPtensArchive.ptar";
+
+  vector<Hgraph> graphs;
+  for(int i=0; i<N; i++)
+    graphs.push_back(Hgraph::random(20,0.2));
+
+  {
+    cnine::flog timer("write");
+    PtensArchiveWriter writer(filename);
+    for(auto& G:graphs){
+      writer.add(G);
+      writer.add(G.nhoods(1));
+    }
+  }
+
+  PtensArchive archive(filename);
+  cout<<archive.repr()<<endl;
+
+  int bad=0;
+  {
+    cnine::flog timer("read");
+    for(int i=0; i<N; i++){
+      Hgraph G=archive.graph(2*i);
+      AtomsPack A=archive.atoms(2*i+1);
+      if(G!=graphs[i]) bad++;
+      if(!same(A,graphs[i].nhoods(1))) bad++;
+    }
+  }
+  cout<<"Mismatches: "<<bad<<endl;
+
+  AtomsPack copy(archive.atoms(1));
+  cout<<copy<<endl;
+
+}
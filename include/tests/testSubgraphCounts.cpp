@@ -0,0 +1,43 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "Hgraph.hpp"
+#include "PtensSubgraphCounts.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  Hgraph triangle(3,{{0,1},{1,2},{2,0}});
+
+  Hgraph G(8);
+  G.insert(triangle,{0,1,2});
+  G.insert(triangle,{1,2,3});
+  G.insert(triangle,{5,6,7});
+
+  SubgraphCounts counts(G,triangle,true);
+  cout<<counts.repr()<<endl;
+  cout<<counts.vertex_tensor()<<endl;
+  cout<<G.edges()<<endl;
+  cout<<counts.edge_tensor()<<endl;
+
+  Hgraph R=Hgraph::random(500,0.05);
+  SubgraphCounts counts1(R,triangle,false,1);
+  SubgraphCounts counts2(R,triangle);
+  cout<<counts1.nmatches<<" "<<counts2.nmatches<<endl;
+
+}
@@ -25,11 +25,13 @@ namespace ptens{
   // 0 -> 0
   void add_msg(Ptensors0& r, const Ptensors0& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first),indices.second,offs);
   }
   void add_msg_back(Ptensors0& r, const Ptensors0& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first,offs,r.nc),indices.second);
   }
@@ -37,11 +39,13 @@ namespace ptens{
   // 0 -> 1
   void add_msg(Ptensors1& r, const Ptensors0& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first),indices.second,offs);
   }
   void add_msg_back(Ptensors0& r, const Ptensors1& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first,offs,r.nc),indices.second);
   }
@@ -49,11 +53,13 @@ namespace ptens{
   // 0 -> 2
   void add_msg(Ptensors2& r, const Ptensors0& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first),indices.second,offs);
   }
   void add_msg_back(Ptensors0& r, const Ptensors2& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first,offs,r.nc),indices.second);
   }
@@ -62,22 +68,26 @@ namespace ptens{
   // 1 -> 0
   void add_msg(Ptensors0& r, const Ptensors1& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first),indices.second,offs);
   }
   void add_msg_back(Ptensors1& r, const Ptensors0& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first,offs,r.nc),indices.second);
   }
 
   void add_msg_n(Ptensors0& r, const Ptensors1& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0_n(indices.first),indices.second,offs);
   }
   void add_msg_back_n(Ptensors1& r, const Ptensors0& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0_n(x.reduce0(indices.first,offs,r.nc),indices.second);
   }
@@ -87,6 +97,7 @@ namespace ptens{
   void add_msg(Ptensors1& r, const Ptensors1& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=x.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first),indices.second,offs);
     r.broadcast1(x.reduce1(indices.first),indices.second,offs+nc);
@@ -94,6 +105,7 @@ namespace ptens{
   void add_msg_back(Ptensors1& r, const Ptensors1& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first,offs,nc),indices.second);
     r.broadcast1(x.reduce1(indices.first,offs+nc,nc),indices.second);
@@ -102,6 +114,7 @@ namespace ptens{
   void add_msg_n(Ptensors1& r, const Ptensors1& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=x.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0_n(indices.first),indices.second,offs);
     r.broadcast1(x.reduce1(indices.first),indices.second,offs+nc);
@@ -109,6 +122,7 @@ namespace ptens{
   void add_msg_back_n(Ptensors1& r, const Ptensors1& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0_n(x.reduce0(indices.first,offs,nc),indices.second);
     r.broadcast1(x.reduce1(indices.first,offs+nc,nc),indices.second);
@@ -119,6 +133,7 @@ namespace ptens{
   void add_msg(Ptensors2& r, const Ptensors1& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=x.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first),indices.second,offs);
     r.broadcast1(x.reduce1(indices.first),indices.second,offs+2*nc);
@@ -126,6 +141,7 @@ namespace ptens{
   void add_msg_back(Ptensors1& r, const Ptensors2& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first,offs,nc),indices.second);
     r.broadcast1(x.reduce1(indices.first,offs+2*nc,nc),indices.second);
@@ -134,6 +150,7 @@ namespace ptens{
   void add_msg_n(Ptensors2& r, const Ptensors1& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=x.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0_n(indices.first),indices.second,offs);
     r.broadcast1(x.reduce1(indices.first),indices.second,offs+2*nc);
@@ -141,6 +158,7 @@ namespace ptens{
   void add_msg_back_n(Ptensors1& r, const Ptensors2& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0_n(x.reduce0(indices.first,offs,nc),indices.second);
     r.broadcast1(x.reduce1(indices.first,offs+2*nc,nc),indices.second);
@@ -150,24 +168,28 @@ namespace ptens{
   // 2 -> 0
   void add_msg(Ptensors0& r, const Ptensors2& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first),indices.second,offs);
   }
   void add_msg_back(Ptensors2& r, const Ptensors0& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first,offs,2*nc),indices.second);
   }
 
   void add_msg_n(Ptensors0& r, const Ptensors2& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0_n(indices.first),indices.second,offs);
   }
   void add_msg_back_n(Ptensors2& r, const Ptensors0& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0_n(x.reduce0(indices.first,offs,2*nc),indices.second);
   }
@@ -177,6 +199,7 @@ namespace ptens{
   void add_msg(Ptensors1& r, const Ptensors2& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=x.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first),indices.second,offs);
     r.broadcast1(x.reduce1(indices.first),indices.second,offs+2*nc);
@@ -184,6 +207,7 @@ namespace ptens{
   void add_msg_back(Ptensors2& r, const Ptensors1& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first,offs,2*nc),indices.second); // !!
     r.broadcast1(x.reduce1(indices.first,offs+2*nc,3*nc),indices.second);
@@ -192,6 +216,7 @@ namespace ptens{
   void add_msg_n(Ptensors1& r, const Ptensors2& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=x.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0_n(indices.first),indices.second,offs);
     r.broadcast1(x.reduce1_n(indices.first),indices.second,offs+2*nc);
@@ -199,6 +224,7 @@ namespace ptens{
   void add_msg_back_n(Ptensors2& r, const Ptensors1& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0_n(x.reduce0(indices.first,offs,2*nc),indices.second); // !!
     r.broadcast1_n(x.reduce1(indices.first,offs+2*nc,3*nc),indices.second);
@@ -209,6 +235,7 @@ namespace ptens{
   void add_msg(Ptensors2& r, const Ptensors2& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=x.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first),indices.second,offs);
     r.broadcast1(x.reduce1(indices.first),indices.second,offs+4*nc);
@@ -218,6 +245,7 @@ namespace ptens{
   void add_msg_back(Ptensors2& r, const Ptensors2& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(indices.first,offs,2*nc),indices.second);
     r.broadcast1(x.reduce1(indices.first,offs+4*nc,3*nc),indices.second);
@@ -227,6 +255,7 @@ namespace ptens{
   void add_msg_n(Ptensors2& r, const Ptensors2& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=x.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0_n(indices.first),indices.second,offs);
     r.broadcast1(x.reduce1_n(indices.first),indices.second,offs+4*nc);
@@ -236,6 +265,7 @@ namespace ptens{
   void add_msg_back_n(Ptensors2& r, const Ptensors2& x, const Hgraph& G, int offs=0){
     if(G.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto indices=G.intersects(x.atoms,r.atoms);
     r.broadcast0_n(x.reduce0(indices.first,offs,2*nc),indices.second);
     r.broadcast1_n(x.reduce1(indices.first,offs+4*nc,3*nc),indices.second);
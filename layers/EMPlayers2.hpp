@@ -27,6 +27,7 @@ namespace ptens{
   template<typename SRC, typename DEST>
   void emp00(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(map0),map1,0);
   }
@@ -34,6 +35,7 @@ namespace ptens{
   template<typename SRC, typename DEST>
   void emp01(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(map0),map1,0);
   }
@@ -41,6 +43,7 @@ namespace ptens{
   template<typename SRC, typename DEST>
   void emp10(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(map0),map1,0);
   }
@@ -49,6 +52,7 @@ namespace ptens{
   void emp11(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
     int nc=x.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     cnine::flog timer("ptens::emp11");
     r.broadcast0(x.reduce0(map0),map1,0);
@@ -59,6 +63,7 @@ namespace ptens{
   void emp11_back(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     cnine::flog timer("ptens::emp11_back");
     r.reduce0_back(x.broadcast0_back(map0,0,nc),map1);
@@ -70,6 +75,7 @@ namespace ptens{
   template<typename SRC, typename DEST>
   void emp02(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(map0),map1);
   }
@@ -78,6 +84,7 @@ namespace ptens{
   void emp02_back(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.reduce0_back(x.broadcast0_back(map0,0,nc),map1);
   }
@@ -86,6 +93,7 @@ namespace ptens{
   void emp12(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
     int nc=x.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(map0),map1);
     r.broadcast1(x.reduce1(map0),map1,2*nc);
@@ -95,6 +103,7 @@ namespace ptens{
   void emp12_back(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.reduce0_back(x.broadcast0_back(map0,0,nc),map1);
     r.reduce1_back(x.broadcast1_back(map0,2*nc,nc),map1);
@@ -104,6 +113,7 @@ namespace ptens{
   void emp22(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
     int nc=x.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(map0),map1);
     r.broadcast1(x.reduce1(map0),map1,4*nc);
@@ -114,6 +124,7 @@ namespace ptens{
   void emp22_back(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.reduce0_back(x.broadcast0_back(map0,0,2*nc),map1);
     r.reduce1_back(x.broadcast1_back(map0,4*nc,3*nc),map1);
@@ -123,6 +134,7 @@ namespace ptens{
   template<typename SRC, typename DEST>
   void emp20(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(map0),map1);
   }
@@ -131,6 +143,7 @@ namespace ptens{
   void emp20_back(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.reduce0_back(x.broadcast0_back(map0,0,2*nc),map1);
   }
@@ -139,6 +152,7 @@ namespace ptens{
   void emp21(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
     int nc=x.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.broadcast0(x.reduce0(map0),map1);
     r.broadcast1(x.reduce1(map0),map1,2*nc);
@@ -148,6 +162,7 @@ namespace ptens{
   void emp21_back(DEST& r, const SRC& x, const TransferMap& map){
     if(map.is_empty()) return;
     int nc=r.get_nc();
+    PtensScratch::Scope scope(r.dev==0);
     auto [map0,map1]=map.intersects(x.atoms,r.atoms);
     r.reduce0_back(x.broadcast0_back(map0,0,2*nc),map1);
     r.reduce1_back(x.broadcast1_back(map0,2*nc,3*nc),map1);
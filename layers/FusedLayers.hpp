@@ -0,0 +1,138 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _ptens_FusedLayers
+#define _ptens_FusedLayers
+
+#include "Ptensors0.hpp"
+#include "Ptensors1.hpp"
+#include "Ptensors2.hpp"
+#include "PtensParallel.hpp"
+
+
+namespace ptens{
+
+
+  // ---- Linear layer followed by leaky ReLU -------------------------------------------------------------------
+
+
+  // Each row of a pack holds the nc channels of one entry of one ptensor, and the rows are stored 
+  // one after the other, so the linear layer acts on the whole pack as one tall matrix. The fused 
+  // forward computes every output row in a row-sized buffer, applies the bias and the activation 
+  // there, and writes it out once. Instead of the pre-activations it saves their signs, one bit 
+  // per output entry: bit j%8 of byte i*linear_leaky_mask_stride(nout)+j/8 of mask is set if 
+  // entry (i,j) was positive. The backward pass only needs these bits.
+
+  inline int linear_leaky_mask_stride(const int nout){
+    return (nout+7)/8;
+  }
+
+  template<typename TYPE>
+  size_t linear_leaky_mask_size(const TYPE& x, const int nout){
+    if(x.nc==0) return 0;
+    return (size_t)(x.tail/x.nc)*linear_leaky_mask_stride(nout);
+  }
+
+
+  // r=leaky_relu(x*w+b,alpha), where w is an x.nc x r.nc row major matrix. r may be uninitialized.
+  template<typename TYPE>
+  void set_linear_leaky(TYPE& r, const TYPE& x, const float* w, const float* b, const float alpha, unsigned char* mask){
+    PTENS_ASSRT(x.dev==0 && r.dev==0);
+    const int nin=x.nc;
+    const int nout=r.nc;
+    const int n=(nin==0)? 0 : x.tail/nin;
+    PTENS_ASSRT(r.tail==(size_t)n*nout);
+    const int mstride=linear_leaky_mask_stride(nout);
+    const int grain=64;
+
+    vector<float> buf((size_t)parallel_nthreads(n,-1,grain)*nout);
+    parallel_for(n,[&](const int tid, const int i){
+	float* t=buf.data()+(size_t)tid*nout;
+	std::copy(b,b+nout,t);
+	const float* xi=x.arr+(size_t)i*nin;
+	for(int k=0; k<nin; k++){
+	  const float a=xi[k];
+	  if(a==0) continue;
+	  const float* wk=w+(size_t)k*nout;
+	  for(int j=0; j<nout; j++)
+	    t[j]+=a*wk[j];
+	}
+	float* ri=r.arr+(size_t)i*nout;
+	unsigned char* mi=mask+(size_t)i*mstride;
+	std::fill(mi,mi+mstride,0);
+	for(int j=0; j<nout; j++){
+	  if(t[j]>0){
+	    ri[j]=t[j];
+	    mi[j>>3]|=(1<<(j&7));
+	  }else ri[j]=alpha*t[j];
+	}
+      },-1,grain);
+  }
+
+
+  // With d=g*(mask? 1 : alpha): xg+=d*w^T, wg+=x^T*d and bg+=the column sums of d. Each thread 
+  // accumulates wg and bg separately and the partial sums are added at the end.
+  template<typename TYPE>
+  void add_linear_leaky_back(TYPE& xg, float* wg, float* bg, const TYPE& g, const TYPE& x, const float* w, 
+    const float alpha, const unsigned char* mask){
+    PTENS_ASSRT(x.dev==0 && g.dev==0 && xg.dev==0);
+    const int nin=x.nc;
+    const int nout=g.nc;
+    const int n=(nin==0)? 0 : x.tail/nin;
+    PTENS_ASSRT(g.tail==(size_t)n*nout);
+    PTENS_ASSRT(xg.tail==x.tail);
+    const int mstride=linear_leaky_mask_stride(nout);
+    const int grain=64;
+    const int nthreads=parallel_nthreads(n,-1,grain);
+    const size_t psize=(size_t)nin*nout+2*nout;
+
+    vector<float> part(nthreads*psize,0);
+    parallel_for(n,[&](const int tid, const int i){
+	float* pw=part.data()+tid*psize;
+	float* pb=pw+(size_t)nin*nout;
+	float* d=pb+nout;
+	const float* gi=g.arr+(size_t)i*nout;
+	const unsigned char* mi=mask+(size_t)i*mstride;
+	for(int j=0; j<nout; j++)
+	  d[j]=(mi[j>>3]&(1<<(j&7)))? gi[j] : alpha*gi[j];
+
+	const float* xi=x.arr+(size_t)i*nin;
+	float* xgi=xg.arr+(size_t)i*nin;
+	for(int k=0; k<nin; k++){
+	  const float* wk=w+(size_t)k*nout;
+	  float s=0;
+	  for(int j=0; j<nout; j++)
+	    s+=wk[j]*d[j];
+	  xgi[k]+=s;
+	  const float a=xi[k];
+	  if(a==0) continue;
+	  float* pwk=pw+(size_t)k*nout;
+	  for(int j=0; j<nout; j++)
+	    pwk[j]+=a*d[j];
+	}
+	for(int j=0; j<nout; j++)
+	  pb[j]+=d[j];
+      },-1,grain);
+
+    for(int t=0; t<nthreads; t++){
+      const float* pw=part.data()+t*psize;
+      for(size_t k=0; k<(size_t)nin*nout; k++)
+	wg[k]+=pw[k];
+      for(int j=0; j<nout; j++)
+	bg[j]+=pw[(size_t)nin*nout+j];
+    }
+  }
+
+}
+
+#endif 
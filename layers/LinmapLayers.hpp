@@ -180,98 +180,164 @@ namespace ptens{
 
 
 
+  // ---- Assigning versions -------------------------------------------------------------------------------
+  // Each broadcast below writes every element of its own block of channels, so these can be
+  // applied to an uninitialized r in place of the corresponding add_linmaps
+
+  inline void set_linmaps(Ptensors0& r, const Ptensors0& x, const int offs=0){
+    r.broadcast0(x.reduce0(),offs,true);
+  }
+  inline void set_linmaps(Ptensors1& r, const Ptensors0& x, const int offs=0){
+    r.broadcast0(x.reduce0(),offs,true);
+  }
+  inline void set_linmaps(Ptensors2& r, const Ptensors0& x, const int offs=0){
+    r.broadcast0(x.reduce0(),offs,true);
+  }
+
+  inline void set_linmaps(Ptensors0& r, const Ptensors1& x, const int offs=0){
+    r.broadcast0(x.reduce0(),offs,true);
+  }
+  inline void set_linmaps(Ptensors1& r, const Ptensors1& x, const int offs=0){
+    r.broadcast0(x.reduce0(),offs,true);
+    r.broadcast1(x.reduce1(),offs+x.nc,true);
+  }
+  inline void set_linmaps(Ptensors2& r, const Ptensors1& x, const int offs=0){
+    r.broadcast0(x.reduce0(),offs,true);
+    r.broadcast1(x.reduce1(),offs+2*x.nc,true);
+  }
+
+  inline void set_linmaps(Ptensors0& r, const Ptensors2& x, const int offs=0){
+    r.broadcast0(x.reduce0(),offs,true);
+  }
+  inline void set_linmaps(Ptensors1& r, const Ptensors2& x, const int offs=0){
+    r.broadcast0(x.reduce0(),offs,true);
+    r.broadcast1(x.reduce1(),offs+2*x.nc,true);
+  }
+  inline void set_linmaps(Ptensors2& r, const Ptensors2& x, const int offs=0){
+    r.broadcast0(x.reduce0(),offs,true);
+    r.broadcast1(x.reduce1(),offs+4*x.nc,true);
+    r.broadcast2(x.reduce2(),offs+13*x.nc,true);
+  }
+
+  inline void set_linmaps_n(Ptensors0& r, const Ptensors1& x, const int offs=0){
+    r.broadcast0(x.reduce0_n(),offs,true);
+  }
+  inline void set_linmaps_n(Ptensors1& r, const Ptensors1& x, const int offs=0){
+    r.broadcast0(x.reduce0_n(),offs,true);
+    r.broadcast1(x.reduce1(),offs+x.nc,true);
+  }
+  inline void set_linmaps_n(Ptensors2& r, const Ptensors1& x, const int offs=0){
+    r.broadcast0(x.reduce0_n(),offs,true);
+    r.broadcast1(x.reduce1(),offs+2*x.nc,true);
+  }
+
+  inline void set_linmaps_n(Ptensors0& r, const Ptensors2& x, const int offs=0){
+    r.broadcast0(x.reduce0_n(),offs,true);
+  }
+  inline void set_linmaps_n(Ptensors1& r, const Ptensors2& x, const int offs=0){
+    r.broadcast0(x.reduce0_n(),offs,true);
+    r.broadcast1(x.reduce1_n(),offs+2*x.nc,true);
+  }
+  inline void set_linmaps_n(Ptensors2& r, const Ptensors2& x, const int offs=0){
+    r.broadcast0(x.reduce0_n(),offs,true);
+    r.broadcast1(x.reduce1_n(),offs+4*x.nc,true);
+    r.broadcast2(x.reduce2(),offs+13*x.nc,true);
+  }
+
+
+
   inline Ptensors0 linmaps0(const Ptensors0& x){
-    Ptensors0 R=Ptensors0::zero(x.atoms,x.nc,x.dev);
-    add_linmaps(R,x);
+    Ptensors0 R=Ptensors0::raw(x.atoms,x.nc,x.dev);
+    set_linmaps(R,x);
     return R;
   }
 
   inline Ptensors1 linmaps1(const Ptensors0& x){
-    Ptensors1 R=Ptensors1::zero(x.atoms,x.nc,x.dev);
-    add_linmaps(R,x);
+    Ptensors1 R=Ptensors1::raw(x.atoms,x.nc,x.dev);
+    set_linmaps(R,x);
     return R;
   }
 
   inline Ptensors2 linmaps2(const Ptensors0& x){
-    Ptensors2 R=Ptensors2::zero(x.atoms,2*x.nc,x.dev);
-    add_linmaps(R,x);
+    Ptensors2 R=Ptensors2::raw(x.atoms,2*x.nc,x.dev);
+    set_linmaps(R,x);
     return R;
   }
 
 
   inline Ptensors0 linmaps0(const Ptensors1& x){
-    Ptensors0 R=Ptensors0::zero(x.atoms,x.nc,x.dev);
-    add_linmaps(R,x);
+    Ptensors0 R=Ptensors0::raw(x.atoms,x.nc,x.dev);
+    set_linmaps(R,x);
     return R;
   }
 
   inline Ptensors1 linmaps1(const Ptensors1& x){
-    Ptensors1 R=Ptensors1::zero(x.atoms,2*x.nc,x.dev);
-    add_linmaps(R,x);
+    Ptensors1 R=Ptensors1::raw(x.atoms,2*x.nc,x.dev);
+    set_linmaps(R,x);
     return R;
   }
 
   inline Ptensors2 linmaps2(const Ptensors1& x){
-    Ptensors2 R=Ptensors2::zero(x.atoms,5*x.nc,x.dev);
-    add_linmaps(R,x);
+    Ptensors2 R=Ptensors2::raw(x.atoms,5*x.nc,x.dev);
+    set_linmaps(R,x);
     return R;
   }
 
 
   inline Ptensors0 linmaps0(const Ptensors2& x){
-    Ptensors0 R=Ptensors0::zero(x.atoms,2*x.nc,x.dev);
-    add_linmaps(R,x);
+    Ptensors0 R=Ptensors0::raw(x.atoms,2*x.nc,x.dev);
+    set_linmaps(R,x);
     return R;
   }
 
   inline Ptensors1 linmaps1(const Ptensors2& x){
-    Ptensors1 R=Ptensors1::zero(x.atoms,5*x.nc,x.dev);
-    add_linmaps(R,x);
+    Ptensors1 R=Ptensors1::raw(x.atoms,5*x.nc,x.dev);
+    set_linmaps(R,x);
     return R;
   }
 
   inline Ptensors2 linmaps2(const Ptensors2& x){
-    Ptensors2 R=Ptensors2::zero(x.atoms,15*x.nc,x.dev);
-    add_linmaps(R,x);
+    Ptensors2 R=Ptensors2::raw(x.atoms,15*x.nc,x.dev);
+    set_linmaps(R,x);
     return R;
   }
 
 
 
   inline Ptensors0 linmaps0_n(const Ptensors1& x){
-    Ptensors0 R=Ptensors0::zero(x.atoms,x.nc,x.dev);
-    add_linmaps_n(R,x);
+    Ptensors0 R=Ptensors0::raw(x.atoms,x.nc,x.dev);
+    set_linmaps_n(R,x);
     return R;
   }
 
   inline Ptensors1 linmaps1_n(const Ptensors1& x){
-    Ptensors1 R=Ptensors1::zero(x.atoms,2*x.nc,x.dev);
-    add_linmaps_n(R,x);
+    Ptensors1 R=Ptensors1::raw(x.atoms,2*x.nc,x.dev);
+    set_linmaps_n(R,x);
     return R;
   }
 
   inline Ptensors2 linmaps2_n(const Ptensors1& x){
-    Ptensors2 R=Ptensors2::zero(x.atoms,5*x.nc,x.dev);
-    add_linmaps_n(R,x);
+    Ptensors2 R=Ptensors2::raw(x.atoms,5*x.nc,x.dev);
+    set_linmaps_n(R,x);
     return R;
   }
 
 
   inline Ptensors0 linmaps0_n(const Ptensors2& x){
-    Ptensors0 R=Ptensors0::zero(x.atoms,2*x.nc,x.dev);
-    add_linmaps_n(R,x);
+    Ptensors0 R=Ptensors0::raw(x.atoms,2*x.nc,x.dev);
+    set_linmaps_n(R,x);
     return R;
   }
 
   inline Ptensors1 linmaps1_n(const Ptensors2& x){
-    Ptensors1 R=Ptensors1::zero(x.atoms,5*x.nc,x.dev);
-    add_linmaps_n(R,x);
+    Ptensors1 R=Ptensors1::raw(x.atoms,5*x.nc,x.dev);
+    set_linmaps_n(R,x);
     return R;
   }
 
   inline Ptensors2 linmaps2_n(const Ptensors2& x){
-    Ptensors2 R=Ptensors2::zero(x.atoms,15*x.nc,x.dev);
-    add_linmaps_n(R,x);
+    Ptensors2 R=Ptensors2::raw(x.atoms,15*x.nc,x.dev);
+    set_linmaps_n(R,x);
     return R;
   }
 
@@ -0,0 +1,297 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#ifndef _ptens_PartitionedLayers
+#define _ptens_PartitionedLayers
+
+#include "GraphPartition.hpp"
+#include "EMPlayers.hpp"
+#include "EMPlayers2.hpp"
+#include "GatherLayers.hpp"
+#include "SubgraphLayer0.hpp"
+#include "SubgraphLayer1.hpp"
+#include "SubgraphLayer2.hpp"
+
+
+namespace ptens{
+
+
+  // Layer with one ptensor per vertex split by a GraphPartition. parts[p] is the local layer of
+  // part p: its owned rows followed by its halo rows, as returned by GraphPartition::localize().
+  // The halo rows always hold a copy of the owner's values, so the ops below can run part by
+  // part on the local graphs and only exchange halos at the end.
+
+  template<typename PACK>
+  class PartitionedLayer{
+  public:
+
+    shared_ptr<GraphPartition> partition;
+    vector<PACK> parts;
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    PartitionedLayer(const shared_ptr<GraphPartition>& _partition, vector<PACK>&& _parts):
+      partition(_partition), parts(std::move(_parts)){
+      PTENS_ASSRT(parts.size()==partition->k);
+    }
+
+    // Split the global layer x
+    PartitionedLayer(const shared_ptr<GraphPartition>& _partition, const PACK& x):
+      partition(_partition){
+      PTENS_ASSRT(x.size()==partition->n);
+      for(int p=0; p<partition->k; p++)
+	parts.push_back(partition->localize(p,x));
+    }
+
+    static PartitionedLayer zero(const shared_ptr<GraphPartition>& _partition, const AtomsPack& _atoms, const int _nc){
+      vector<PACK> v;
+      for(int p=0; p<_partition->k; p++)
+	v.push_back(PACK::zero(_partition->atoms(p,_atoms),_nc));
+      return PartitionedLayer(_partition,std::move(v));
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    int k() const{
+      return parts.size();
+    }
+
+    int size() const{
+      return partition->n;
+    }
+
+    int get_nc() const{
+      PTENS_ASSRT(parts.size()>0);
+      return parts[0].get_nc();
+    }
+
+    PACK& operator[](const int p){
+      return parts[p];
+    }
+
+    const PACK& operator[](const int p) const{
+      return parts[p];
+    }
+
+    // Reference domain of vertex v
+    vector<int> atoms_of(const int v) const{
+      return parts[partition->owner[v]].atoms(partition->local[v]);
+    }
+
+    AtomsPack atoms() const{
+      AtomsPack R;
+      for(int v=0; v<size(); v++)
+	R.push_back(atoms_of(v));
+      return R;
+    }
+
+    // Assemble the global layer from the owned rows of the parts
+    PACK global() const{
+      PACK R=PACK::zero(atoms(),get_nc());
+      for(int p=0; p<k(); p++)
+	partition->add_to_global(R,p,parts[p]);
+      return R;
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "PartitionedLayer";
+    }
+
+    string repr() const{
+      return "<PartitionedLayer[N="+to_string(size())+",k="+to_string(k())+",nc="+to_string(get_nc())+"]>";
+    }
+
+  };
+
+
+  // ---- Message passing ------------------------------------------------------------------------------------
+
+
+  template<typename RPACK, typename XPACK>
+  void add_msg(PartitionedLayer<RPACK>& r, const PartitionedLayer<XPACK>& x, const bool normalized=false){
+    PTENS_ASSRT(r.partition==x.partition);
+    const GraphPartition& P=*r.partition;
+    for(int p=0; p<P.k; p++){
+      if constexpr(std::is_same<XPACK,Ptensors0>::value) ptens::add_msg(r[p],x[p],*P[p].graph);
+      else if(normalized) ptens::add_msg_n(r[p],x[p],*P[p].graph);
+      else ptens::add_msg(r[p],x[p],*P[p].graph);
+    }
+    P.exchange_halo(r.parts);
+  }
+
+  // Each part only has the edges into its owned vertices, so the contributions that the local
+  // backward pass sends to halo rows are collected separately and summed into their owners.
+  template<typename XPACK, typename RPACK>
+  void add_msg_back(PartitionedLayer<XPACK>& xgrad, const PartitionedLayer<RPACK>& rgrad, const bool normalized=false){
+    PTENS_ASSRT(xgrad.partition==rgrad.partition);
+    const GraphPartition& P=*xgrad.partition;
+    vector<XPACK> g;
+    for(int p=0; p<P.k; p++){
+      g.push_back(XPACK::zeros_like(xgrad[p]));
+      const Hgraph& Gl=P[p].graph->reverse();
+      if constexpr(std::is_same<XPACK,Ptensors0>::value) ptens::add_msg_back(g[p],rgrad[p],Gl);
+      else if(normalized) ptens::add_msg_back_n(g[p],rgrad[p],Gl);
+      else ptens::add_msg_back(g[p],rgrad[p],Gl);
+    }
+    P.reduce_halo(g);
+    for(int p=0; p<P.k; p++)
+      for(int l=0; l<P[p].nowned; l++){
+	const float* src=GraphPartition::row_begin(g[p],l);
+	float* dest=GraphPartition::row_begin(xgrad[p],l);
+	int s=GraphPartition::row_size(g[p],l);
+	for(int t=0; t<s; t++) dest[t]+=src[t];
+      }
+    P.exchange_halo(xgrad.parts);
+  }
+
+
+  // ---- Gather ---------------------------------------------------------------------------------------------
+
+
+  void add_gather(PartitionedLayer<Ptensors0>& r, const PartitionedLayer<Ptensors0>& x){
+    PTENS_ASSRT(r.partition==x.partition);
+    const GraphPartition& P=*r.partition;
+    for(int p=0; p<P.k; p++)
+      add_gather(r[p],x[p],*P[p].graph);
+    P.exchange_halo(r.parts);
+  }
+
+  PartitionedLayer<Ptensors0> gather(const PartitionedLayer<Ptensors0>& x){
+    auto R=PartitionedLayer<Ptensors0>::zero(x.partition,AtomsPack(x.size()),x.get_nc());
+    add_gather(R,x);
+    return R;
+  }
+
+
+  // ---- Subgraph layers ------------------------------------------------------------------------------------
+
+
+  template<typename PACK>
+  constexpr int layer_order(){
+    if constexpr(std::is_same<PACK,Ptensors0>::value) return 0;
+    else if constexpr(std::is_same<PACK,Ptensors1>::value) return 1;
+    else return 2;
+  }
+
+  // emp between ptensors of any two orders
+  template<typename RPACK, typename XPACK>
+  void add_emp(RPACK& r, const XPACK& x, const TransferMap& map){
+    constexpr int kin=layer_order<XPACK>();
+    constexpr int kout=layer_order<RPACK>();
+    if constexpr(kin==0 && kout==0) emp00(r,x,map);
+    if constexpr(kin==0 && kout==1) emp01(r,x,map);
+    if constexpr(kin==0 && kout==2) emp02(r,x,map);
+    if constexpr(kin==1 && kout==0) emp10(r,x,map);
+    if constexpr(kin==1 && kout==1) emp11(r,x,map);
+    if constexpr(kin==1 && kout==2) emp12(r,x,map);
+    if constexpr(kin==2 && kout==0) emp20(r,x,map);
+    if constexpr(kin==2 && kout==1) emp21(r,x,map);
+    if constexpr(kin==2 && kout==2) emp22(r,x,map);
+  }
+
+  // Output width of the SubgraphLayer constructors
+  inline int emp_channels(const int kin, const int kout, const int nc){
+    static const int factor[3][3]={{1,1,2},{1,2,5},{2,5,15}};
+    return factor[kin][kout]*nc;
+  }
+
+
+  // Each occurrence of the subgraph is handled by the part that owns its lowest numbered vertex.
+  // Its inputs are the ptensors whose reference domains meet it. These can be further away than
+  // the one hop halo, so they are read from their owners.
+
+  template<typename TLAYER, typename XPACK>
+  void add_subgraph_msgs(TLAYER& R, const PartitionedLayer<XPACK>& x){
+    PTENS_ASSRT(R.dev==0);
+    const GraphPartition& P=*x.partition;
+
+    vector<vector<int> > rows_of(P.n);
+    for(int v=0; v<P.n; v++)
+      for(auto a:x.atoms_of(v)){
+	PTENS_ASSRT(a>=0 && a<P.n);
+	rows_of[a].push_back(v);
+      }
+
+    vector<vector<int> > owned(P.k);
+    for(int i=0; i<R.size(); i++){
+      vector<int> v=R.atoms(i);
+      PTENS_ASSRT(v.size()>0);
+      owned[P.owner[*std::min_element(v.begin(),v.end())]].push_back(i);
+    }
+
+    vector<int> mark(P.n,-1);
+    for(int p=0; p<P.k; p++){
+      if(owned[p].size()==0) continue;
+
+      vector<int> rows;
+      for(auto i:owned[p])
+	for(auto a:R.atoms(i))
+	  for(auto v:rows_of[a])
+	    if(mark[v]!=p){
+	      mark[v]=p;
+	      rows.push_back(v);
+	    }
+
+      AtomsPack xatoms;
+      for(auto v:rows)
+	xatoms.push_back(x.atoms_of(v));
+      XPACK xl=XPACK::zero(xatoms,x.get_nc());
+      for(int l=0; l<rows.size(); l++){
+	const XPACK& src=x[P.owner[rows[l]]];
+	int j=P.local[rows[l]];
+	std::copy(GraphPartition::row_begin(src,j),GraphPartition::row_begin(src,j)+GraphPartition::row_size(src,j),GraphPartition::row_begin(xl,l));
+      }
+
+      AtomsPack ratoms;
+      for(auto i:owned[p])
+	ratoms.push_back(R.atoms(i));
+      TLAYER rl=TLAYER::zero(ratoms,R.get_nc());
+      add_emp(rl,xl,TransferMap(xl.atoms,rl.atoms));
+
+      for(int l=0; l<owned[p].size(); l++)
+	std::copy(GraphPartition::row_begin(rl,l),GraphPartition::row_begin(rl,l)+GraphPartition::row_size(rl,l),GraphPartition::row_begin(R,owned[p][l]));
+    }
+  }
+
+  // Partitioned versions of the SubgraphLayer constructors from Ptensors0/1/2
+  template<typename XPACK>
+  SubgraphLayer0<Ptensors0> subgraph_layer0(const PartitionedLayer<XPACK>& x, const Ggraph& G, const Subgraph& S){
+    SubgraphLayer0<Ptensors0> R(G,S,*G.subgraphs_mx(*S.obj),emp_channels(layer_order<XPACK>(),0,x.get_nc()));
+    add_subgraph_msgs<Ptensors0>(R,x);
+    return R;
+  }
+
+  template<typename XPACK>
+  SubgraphLayer1<Ptensors1> subgraph_layer1(const PartitionedLayer<XPACK>& x, const Ggraph& G, const Subgraph& S){
+    SubgraphLayer1<Ptensors1> R(G,S,*G.subgraphs_mx(*S.obj),emp_channels(layer_order<XPACK>(),1,x.get_nc()));
+    add_subgraph_msgs<Ptensors1>(R,x);
+    return R;
+  }
+
+  template<typename XPACK>
+  SubgraphLayer2<Ptensors2> subgraph_layer2(const PartitionedLayer<XPACK>& x, const Ggraph& G, const Subgraph& S){
+    SubgraphLayer2<Ptensors2> R(G,S,*G.subgraphs_mx(*S.obj),emp_channels(layer_order<XPACK>(),2,x.get_nc()));
+    add_subgraph_msgs<Ptensors2>(R,x);
+    return R;
+  }
+
+}
+
+#endif
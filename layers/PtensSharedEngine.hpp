@@ -0,0 +1,403 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#ifndef _PtensSharedEngine
+#define _PtensSharedEngine
+
+#include <csignal>
+#include <cstring>
+#include <mutex>
+#include <sched.h>
+#include <sys/wait.h>
+#include <fstream>
+
+#include "Ptens_base.hpp"
+#include "PtensParallel.hpp"
+#include "PtensSharedMemory.hpp"
+#include "PtensSharedPack.hpp"
+#include "GraphPartition.hpp"
+#include "EMPlayers.hpp"
+
+
+namespace ptens{
+
+
+  // Runs message passing on a partitioned graph with one persistent worker process per part on
+  // a single node. The layers live in POSIX shared memory (PtensSharedPack): for each layer the
+  // workers attach to the input by name, read their owned and halo rows straight from it, run
+  // the kernels on their part's graph, and write their owned rows into the output, so the halo
+  // exchange needs no extra copies. A chain of layers stays in shared memory:
+  //
+  //   PtensSharedEngine engine(G,4);
+  //   PtensSharedPack h1=engine.add_msg(PtensSharedPack(x),1,nh);
+  //   PtensSharedPack h2=engine.add_msg(h1,1,nh);
+  //   Ptensors1 r=h2.pack<Ptensors1>();
+  //
+  // The backward pass add_msg_back mirrors add_msg_back(xgrad,rgrad,G.reverse()): it runs on a
+  // second partition of the reversed graph with the same owners, so the gradient of each owned
+  // input row is also computed by its owner alone.
+  //
+  // The workers are forked once, when the engine starts, and only inherit the partitions; they
+  // keep their local graphs (with the cached index lists) across layers. Commands go through a
+  // small control block in shared memory and the processes wait for each other by polling with
+  // backoff, so an idle worker wakes up at most every millisecond. Forking a process that has
+  // other threads (OpenMP or torch intra-op pools, for example) is unsafe, since the child
+  // inherits any lock held by those threads in the locked state. The engine should therefore
+  // be created, or start() called, before such threads exist; start() warns on Linux if the
+  // process has more than one thread. Workers exit when the engine is destroyed or when the
+  // parent process dies.
+
+  class PtensSharedEngine{
+  public:
+
+    enum Op{STOP=0, FORWARD=1, BACKWARD=2};
+
+    struct Command{
+      int32_t op;
+      int32_t kin;
+      int32_t kout;
+      int32_t normalized;
+      char src[64];
+      uint64_t src_size;
+      char dest[64];
+      uint64_t dest_size;
+    };
+
+    struct Control{
+      alignas(64) std::atomic<uint64_t> seq;
+      alignas(64) Command cmd;
+    };
+
+    struct Slot{
+      alignas(64) std::atomic<uint64_t> done;
+      std::atomic<int> status;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,"Ptens error: the shared engine needs lock free 64 bit atomics.");
+
+
+    shared_ptr<GraphPartition> partition;
+    shared_ptr<GraphPartition> back_partition;
+    int k;
+    bool pin;
+    int nthreads;
+
+    unique_ptr<PtensSharedSegment> segment;
+    Control* control=nullptr;
+    Slot* slots=nullptr;
+    vector<pid_t> pids;
+    uint64_t seq=0;
+    std::mutex mx;
+
+    ~PtensSharedEngine(){
+      shutdown();
+    }
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    // With pin set, worker p is bound to the p'th of k equal slices of the cores, so that the
+    // workers are spread out over the sockets. Each worker gets nthreads threads for the
+    // parallel preprocessing routines, by default an equal share of ptens_nthreads().
+    PtensSharedEngine(const Hgraph& G, const int _k, const bool _pin=false, const int _nthreads=-1):
+      PtensSharedEngine(G,GraphPartition(G,_k),_pin,_nthreads){}
+
+    PtensSharedEngine(const Hgraph& G, const GraphPartition& P, const bool _pin=false, const int _nthreads=-1):
+      partition(make_shared<GraphPartition>(P)),
+      back_partition(make_shared<GraphPartition>(G.reverse(),P.owner)),
+      k(P.k), pin(_pin), nthreads(_nthreads){
+      PTENS_ASSRT(back_partition->k==k);
+      if(nthreads<0) nthreads=std::max(1,ptens_nthreads()/k);
+      segment.reset(new PtensSharedSegment(sizeof(Control)+k*sizeof(Slot)));
+      control=new(segment->base) Control();
+      control->seq.store(0);
+      slots=reinterpret_cast<Slot*>(segment->base+sizeof(Control));
+      for(int p=0; p<k; p++){
+	new(slots+p) Slot();
+	slots[p].done.store(0);
+	slots[p].status.store(0);
+      }
+    }
+
+    PtensSharedEngine(const PtensSharedEngine& x)=delete;
+    PtensSharedEngine& operator=(const PtensSharedEngine& x)=delete;
+
+
+  public: // ---- Layers in shared memory --------------------------------------------------------------------
+
+
+    // Number of channels of the result of add_msg from order kin to order kout
+    static int msg_channels(const int kin, const int kout, const int nc){
+      int n0=(kin==2? 2 : 1)*nc;
+      int n1=(kin>0 && kout>0)? (kin==2? 3 : 1)*nc : 0;
+      int n2=(kin==2 && kout==2)? nc : 0;
+      if(kout==0) return n0;
+      if(kout==1) return n0+n1;
+      return 2*n0+3*n1+2*n2;
+    }
+
+    // Layer of order kout on the reference domains atoms (one per vertex) receiving the
+    // messages from x along the edges of the graph, as add_msg (or add_msg_n) would compute it
+    PtensSharedPack add_msg(const PtensSharedPack& x, const int kout, const AtomsPack& atoms, const bool normalized=false){
+      PTENS_ASSRT(x.size()==partition->n && atoms.size()==partition->n);
+      PtensSharedPack R(kout,atoms,msg_channels(x.getk(),kout,x.get_nc()));
+      execute(FORWARD,x.getk(),kout,x,R,normalized);
+      return R;
+    }
+
+    // Gradient of the input of add_msg(x,g.getk(),.) given the gradient g of its output, where x
+    // is of order kin with nc channels on the reference domains atoms
+    PtensSharedPack add_msg_back(const PtensSharedPack& g, const int kin, const AtomsPack& atoms, const int nc, const bool normalized=false){
+      PTENS_ASSRT(g.size()==partition->n && atoms.size()==partition->n);
+      PTENS_ASSRT(g.get_nc()==msg_channels(kin,g.getk(),nc));
+      PtensSharedPack R(kin,atoms,nc);
+      execute(BACKWARD,kin,g.getk(),g,R,normalized);
+      return R;
+    }
+
+
+  public: // ---- Layers in process memory -------------------------------------------------------------------
+
+
+    template<typename RPACK, typename XPACK>
+    RPACK transfer(const XPACK& x, const AtomsPack& atoms, const bool normalized=false){
+      return add_msg(PtensSharedPack(x),PtensSharedPack::order_of<RPACK>(),atoms,normalized).template pack<RPACK>();
+    }
+
+    // Add the gradient with respect to the input of transfer to xgrad
+    template<typename XPACK, typename RPACK>
+    void add_msg_back(XPACK& xgrad, const RPACK& rgrad, const bool normalized=false){
+      add_msg_back(PtensSharedPack(rgrad),PtensSharedPack::order_of<XPACK>(),xgrad.atoms,xgrad.get_nc(),normalized).add_to(xgrad);
+    }
+
+
+  public: // ---- Workers ------------------------------------------------------------------------------------
+
+
+    bool is_started() const{
+      return pids.size()>0;
+    }
+
+    // Fork the workers. Called by the first command if not called before.
+    void start(){
+      std::lock_guard<std::mutex> guard(mx);
+      start_workers();
+    }
+
+    // Stop the workers. The next command starts new ones.
+    void shutdown(){
+      std::lock_guard<std::mutex> guard(mx);
+      if(!is_started()) return;
+      control->cmd.op=STOP;
+      control->seq.store(++seq,std::memory_order_release);
+      for(auto pid:pids)
+	waitpid(pid,nullptr,0);
+      pids.clear();
+    }
+
+
+  private:
+
+    void start_workers(){
+      if(is_started()) return;
+      static bool warned=false;
+      if(!warned && process_threads()>1){
+	cerr<<"Ptens warning: PtensSharedEngine forks workers from a process with "<<process_threads()<<" threads; ";
+	cerr<<"locks held by the other threads are inherited locked."<<endl;
+	warned=true;
+      }
+      pid_t parent=getpid();
+      for(int p=0; p<k; p++){
+	pid_t pid=fork();
+	if(pid<0){
+	  stop_workers();
+	  throw std::runtime_error("Ptens error in "+string(__PRETTY_FUNCTION__)+": cannot start worker process.");
+	}
+	if(pid==0) worker_loop(p,parent);
+	pids.push_back(pid);
+      }
+    }
+
+    void execute(const int op, const int kin, const int kout, const PtensSharedPack& src, const PtensSharedPack& dest, const bool normalized){
+      cnine::flog timer("PtensSharedEngine::execute");
+      std::lock_guard<std::mutex> guard(mx);
+      start_workers();
+      Command& c=control->cmd;
+      c.op=op;
+      c.kin=kin;
+      c.kout=kout;
+      c.normalized=normalized;
+      set_name(c.src,src.name());
+      c.src_size=src.bytes();
+      set_name(c.dest,dest.name());
+      c.dest_size=dest.bytes();
+      control->seq.store(++seq,std::memory_order_release);
+
+      int failed=-1;
+      wait_until([&](){
+	  for(int p=0; p<k; p++)
+	    if(slots[p].done.load(std::memory_order_acquire)!=seq) return false;
+	  return true;},
+	[&](){
+	  for(int p=0; p<k; p++){
+	    int st;
+	    if(waitpid(pids[p],&st,WNOHANG)==pids[p]){failed=p; return true;}
+	  }
+	  return false;});
+      if(failed>=0){
+	stop_workers();
+	throw std::runtime_error("Ptens error in "+string(__PRETTY_FUNCTION__)+": worker "+to_string(failed)+" died.");
+      }
+      for(int p=0; p<k; p++)
+	if(slots[p].status.load()!=0)
+	  throw std::runtime_error("Ptens error in "+string(__PRETTY_FUNCTION__)+": worker "+to_string(p)+" failed.");
+    }
+
+    [[noreturn]] void worker_loop(const int p, const pid_t parent){
+      if(pin) pin_worker(p);
+      ptens_nthreads()=nthreads;
+      uint64_t last=0;
+      while(true){
+	wait_until([&](){return control->seq.load(std::memory_order_acquire)!=last;},
+	  [&](){return getppid()!=parent;});
+	if(getppid()!=parent) _exit(0);
+	last=control->seq.load(std::memory_order_acquire);
+	Command c=control->cmd;
+	if(c.op==STOP) _exit(0);
+	int status=0;
+	try{
+	  run_command(p,c);
+	}catch(const std::exception& e){
+	  cerr<<"Worker "<<p<<": "<<e.what()<<endl;
+	  status=1;
+	}
+	slots[p].status.store(status);
+	slots[p].done.store(last,std::memory_order_release);
+      }
+    }
+
+    void run_command(const int p, const Command& c) const{
+      PtensSharedPack src(string(c.src),c.src_size);
+      PtensSharedPack dest(string(c.dest),c.dest_size);
+      with_pack(c.kin,[&](auto xtag){
+	  with_pack(c.kout,[&](auto rtag){
+	      typedef typename std::remove_pointer<decltype(xtag)>::type XPACK;
+	      typedef typename std::remove_pointer<decltype(rtag)>::type RPACK;
+	      if(c.op==FORWARD) forward<RPACK,XPACK>((*partition)[p],src,dest,c.normalized);
+	      else backward<XPACK,RPACK>((*back_partition)[p],src,dest,c.normalized);
+	    });
+	});
+    }
+
+    template<typename RPACK, typename XPACK>
+    static void forward(const GraphPartition::Part& P, const PtensSharedPack& x, const PtensSharedPack& r, const bool normalized){
+      XPACK xl=x.localize<XPACK>(P);
+      RPACK rl=RPACK::zero(r.local_atoms(P),r.get_nc());
+      if constexpr(std::is_same<XPACK,Ptensors0>::value) ptens::add_msg(rl,xl,*P.graph);
+      else if(normalized) ptens::add_msg_n(rl,xl,*P.graph);
+      else ptens::add_msg(rl,xl,*P.graph);
+      r.set_owned(P,rl);
+    }
+
+    template<typename XPACK, typename RPACK>
+    static void backward(const GraphPartition::Part& P, const PtensSharedPack& g, const PtensSharedPack& xg, const bool normalized){
+      RPACK gl=g.localize<RPACK>(P);
+      XPACK xl=XPACK::zero(xg.local_atoms(P),xg.get_nc());
+      if constexpr(std::is_same<XPACK,Ptensors0>::value) ptens::add_msg_back(xl,gl,*P.graph);
+      else if(normalized) ptens::add_msg_back_n(xl,gl,*P.graph);
+      else ptens::add_msg_back(xl,gl,*P.graph);
+      xg.set_owned(P,xl);
+    }
+
+    template<typename FN>
+    static void with_pack(const int _k, const FN& fn){
+      switch(_k){
+      case 0: fn((Ptensors0*)nullptr); break;
+      case 1: fn((Ptensors1*)nullptr); break;
+      default: fn((Ptensors2*)nullptr);
+      }
+    }
+
+    // Wait for cond() to hold: spin briefly, then sleep in growing steps of up to 1 ms, giving up
+    // if abort() returns true
+    template<typename COND, typename ABORT>
+    static void wait_until(const COND& cond, const ABORT& abort){
+      int spins=0;
+      int us=10;
+      while(!cond()){
+	if(spins<256){
+	  spins++;
+	  sched_yield();
+	  continue;
+	}
+	if(abort()) return;
+	usleep(us);
+	us=std::min(2*us,1000);
+      }
+    }
+
+    static void set_name(char* dest, const string& name){
+      PTENS_ASSRT(name.size()<64);
+      std::strncpy(dest,name.c_str(),64);
+    }
+
+    // Kill the workers and reap them
+    void stop_workers(){
+      for(auto pid:pids)
+	kill(pid,SIGKILL);
+      for(auto pid:pids)
+	waitpid(pid,nullptr,0);
+      pids.clear();
+    }
+
+    // Number of threads in this process, or 1 if it cannot be determined
+    static int process_threads(){
+#ifdef __linux__
+      std::ifstream ifs("/proc/self/status");
+      string line;
+      while(std::getline(ifs,line))
+	if(line.compare(0,8,"Threads:")==0) return std::max(1,atoi(line.c_str()+8));
+#endif
+      return 1;
+    }
+
+    void pin_worker(const int p) const{
+#ifdef __linux__
+      int ncores=std::max(1,(int)std::thread::hardware_concurrency());
+      int per=std::max(1,ncores/k);
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for(int c=p*per; c<std::min(ncores,(p+1)*per); c++)
+	CPU_SET(c,&set);
+      if(CPU_COUNT(&set)==0) CPU_SET(p%ncores,&set);
+      sched_setaffinity(0,sizeof(set),&set);
+#endif
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "PtensSharedEngine";
+    }
+
+    string repr() const{
+      return "<PtensSharedEngine[k="+to_string(k)+(is_started()? ",running" : "")+"]>";
+    }
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#ifndef _PtensSharedPack
+#define _PtensSharedPack
+
+#include <new>
+#include <type_traits>
+
+#include "PtensSharedMemory.hpp"
+#include "GraphPartition.hpp"
+#include "Ptensors0.hpp"
+#include "Ptensors1.hpp"
+#include "Ptensors2.hpp"
+
+
+namespace ptens{
+
+
+  // Layer of order k Ptensors held in a POSIX shared memory segment, so that the worker
+  // processes of PtensSharedEngine can attach to it by name and read or write it in place.
+  // Copies share the segment. The segment holds a header, the row offsets, the reference
+  // domains and the entries, in the same layout as the float layers:
+  //
+  //   Header | uint64 offs[n+1] | int aoffs[n+1] | int atoms[natoms] | float arr[nfloats]
+
+  class PtensSharedPack{
+  public:
+
+    struct Header{
+      int32_t k;
+      int32_t nc;
+      int32_t n;
+      int32_t reserved;
+      uint64_t natoms;
+      uint64_t nfloats;
+    };
+
+    shared_ptr<PtensSharedSegment> segment;
+    Header* header=nullptr;
+    uint64_t* offs=nullptr;
+    int* aoffs=nullptr;
+    int* atoms_arr=nullptr;
+    float* arr=nullptr;
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    PtensSharedPack(){}
+
+    // New zero filled layer in a new segment
+    PtensSharedPack(const int _k, const AtomsPack& atoms, const int _nc){
+      PTENS_ASSRT(_k>=0 && _k<=2);
+      int n=atoms.size();
+      uint64_t natoms=0;
+      uint64_t nfloats=0;
+      for(int i=0; i<n; i++){
+	natoms+=atoms.size_of(i);
+	nfloats+=row_size(_k,atoms.size_of(i),_nc);
+      }
+      segment=make_shared<PtensSharedSegment>(footprint(n,natoms,nfloats));
+      new(segment->base) Header{_k,_nc,n,0,natoms,nfloats};
+      bind();
+      offs[0]=0;
+      aoffs[0]=0;
+      for(int i=0; i<n; i++){
+	vector<int> v=atoms(i);
+	std::copy(v.begin(),v.end(),atoms_arr+aoffs[i]);
+	aoffs[i+1]=aoffs[i]+v.size();
+	offs[i+1]=offs[i]+row_size(_k,v.size(),_nc);
+      }
+    }
+
+    // Copy of a Ptensors0, Ptensors1 or Ptensors2 layer on the host
+    template<typename PACK, typename=typename std::enable_if<std::is_base_of<cnine::RtensorPackB,PACK>::value>::type>
+    PtensSharedPack(const PACK& x):
+      PtensSharedPack(order_of<PACK>(),x.atoms,x.get_nc()){
+      PTENS_ASSRT(x.dev==0);
+      for(int i=0; i<size(); i++)
+	std::copy(x.arr+x.dir(i,0),x.arr+x.dir(i,0)+row_size(i),row(i));
+    }
+
+    // Attach to a layer created by another process
+    PtensSharedPack(const string& name, const size_t size):
+      segment(make_shared<PtensSharedSegment>(name,size)){
+      bind();
+    }
+
+    template<typename PACK>
+    static int order_of(){
+      if constexpr(std::is_same<PACK,Ptensors0>::value) return 0;
+      else if constexpr(std::is_same<PACK,Ptensors1>::value) return 1;
+      else return 2;
+    }
+
+
+  public: // ---- Conversions --------------------------------------------------------------------------------
+
+
+    template<typename PACK>
+    PACK pack() const{
+      PTENS_ASSRT(order_of<PACK>()==getk());
+      PACK R=PACK::raw(atoms(),get_nc());
+      for(int i=0; i<size(); i++)
+	std::copy(row(i),row(i)+row_size(i),R.arr+R.dir(i,0));
+      return R;
+    }
+
+    // Add this layer to r, which must have the same reference domains
+    template<typename PACK>
+    void add_to(PACK& r) const{
+      PTENS_ASSRT(r.dev==0);
+      PTENS_ASSRT(order_of<PACK>()==getk() && r.size()==size() && r.get_nc()==get_nc());
+      for(int i=0; i<size(); i++){
+	float* dest=r.arr+r.dir(i,0);
+	const float* src=row(i);
+	size_t s=row_size(i);
+	for(size_t j=0; j<s; j++) dest[j]+=src[j];
+      }
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    string name() const{
+      return segment->name;
+    }
+
+    size_t bytes() const{
+      return segment->size;
+    }
+
+    int getk() const{
+      return header->k;
+    }
+
+    int get_nc() const{
+      return header->nc;
+    }
+
+    int size() const{
+      return header->n;
+    }
+
+    vector<int> atoms_of(const int i) const{
+      return vector<int>(atoms_arr+aoffs[i],atoms_arr+aoffs[i+1]);
+    }
+
+    AtomsPack atoms() const{
+      AtomsPack R;
+      for(int i=0; i<size(); i++)
+	R.push_back(atoms_of(i));
+      return R;
+    }
+
+    float* row(const int i) const{
+      return arr+offs[i];
+    }
+
+    size_t row_size(const int i) const{
+      return offs[i+1]-offs[i];
+    }
+
+
+  public: // ---- Partitions ---------------------------------------------------------------------------------
+
+
+    // The reference domains of part P, halo included
+    AtomsPack local_atoms(const GraphPartition::Part& P) const{
+      AtomsPack R;
+      for(auto g:P.globals)
+	R.push_back(atoms_of(g));
+      return R;
+    }
+
+    // Part P of this layer, halo rows included, read straight from the segment
+    template<typename PACK>
+    PACK localize(const GraphPartition::Part& P) const{
+      PTENS_ASSRT(order_of<PACK>()==getk());
+      PACK R=PACK::zero(local_atoms(P),get_nc());
+      for(int l=0; l<P.size(); l++)
+	std::copy(row(P.globals[l]),row(P.globals[l])+row_size(P.globals[l]),R.arr+R.dir(l,0));
+      return R;
+    }
+
+    // Write the owned rows of the local layer x of part P into the segment
+    template<typename PACK>
+    void set_owned(const GraphPartition::Part& P, const PACK& x) const{
+      PTENS_ASSRT(order_of<PACK>()==getk() && x.get_nc()==get_nc());
+      for(int l=0; l<P.nowned; l++)
+	std::copy(x.arr+x.dir(l,0),x.arr+x.dir(l,0)+row_size(P.globals[l]),row(P.globals[l]));
+    }
+
+
+  private:
+
+    static size_t row_size(const int k, const size_t m, const int nc){
+      return (k==0? 1 : (k==1? m : m*m))*nc;
+    }
+
+    static size_t align64(const size_t x){
+      return ((x+63)/64)*64;
+    }
+
+    static size_t footprint(const int n, const uint64_t natoms, const uint64_t nfloats){
+      size_t t=sizeof(Header)+(n+1)*sizeof(uint64_t)+(n+1)*sizeof(int)+natoms*sizeof(int);
+      return align64(t)+nfloats*sizeof(float);
+    }
+
+    void bind(){
+      char* base=segment->base;
+      header=reinterpret_cast<Header*>(base);
+      int n=header->n;
+      offs=reinterpret_cast<uint64_t*>(base+sizeof(Header));
+      aoffs=reinterpret_cast<int*>(offs+n+1);
+      atoms_arr=aoffs+n+1;
+      arr=reinterpret_cast<float*>(base+align64(reinterpret_cast<char*>(atoms_arr+header->natoms)-base));
+      PTENS_ASSRT(reinterpret_cast<char*>(arr+header->nfloats)<=base+segment->size);
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "PtensSharedPack";
+    }
+
+    string repr() const{
+      return "<PtensSharedPack["+name()+",k="+to_string(getk())+",N="+to_string(size())+",nc="+to_string(get_nc())+"]>";
+    }
+
+  };
+
+}
+
+#endif
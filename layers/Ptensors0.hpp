@@ -19,7 +19,8 @@
 
 //#include "Cgraph.hpp"
 #include "RtensorPackB.hpp"
-#include "AtomsPack.hpp"
+#include "SharedAtomsPack.hpp"
+#include "PtensMemory.hpp"
 #include "AindexPack.hpp"
 #include "Ptensor0.hpp"
 #include "loose_ptr.hpp"
@@ -34,12 +35,13 @@ namespace ptens{
   #ifdef _WITH_CUDA
   extern void Ptensors0_reduce0_cu(cnine::RtensorPackB& R,const cnine::RtensorPackB& x, int offs, int n, const cudaStream_t& stream);
   extern void Ptensors0_reduce0_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, int offs, int n, const cudaStream_t& stream);
-  extern void Ptensors0_broadcast0_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream);
+  extern void Ptensors0_broadcast0_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream, const bool assign);
   extern void Ptensors0_broadcast0_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, const int offs, const cudaStream_t& stream);
   #endif
 
 
-  class Ptensors0: public cnine::RtensorPackB, public cnine::diff_class<Ptensors0>{
+  class Ptensors0: public cnine::RtensorPackB, public cnine::diff_class<Ptensors0>,
+                   public PtensTracked<Ptensors0,PtensMemoryTracker::FEATURES>{
   public:
 
     typedef cnine::Gdims Gdims;
@@ -52,7 +54,7 @@ namespace ptens{
     typedef cnine::Rtensor3_view Rtensor3_view;
 
     //int nc=0;
-    AtomsPack atoms;
+    SharedAtomsPack atoms;
     //bool is_view=false;
     rtensor norms;
 
@@ -178,8 +180,11 @@ namespace ptens{
       return Ptensors0(RtensorPackB::zeros_like(x,_nc),x.atoms);
     }
 
+    // Only used to allocate gradients
     static Ptensors0* new_zeros_like(const Ptensors0& x){
-      return new Ptensors0(RtensorPackB::zeros_like(x),x.atoms);
+      Ptensors0* R=new Ptensors0(RtensorPackB::zeros_like(x),x.atoms);
+      R->set_memory_category(PtensMemoryTracker::GRADIENTS);
+      return R;
     }
 
     static Ptensors0 gaussian_like(const Ptensors0& x){
@@ -268,6 +273,72 @@ namespace ptens{
     }
 
 
+#ifdef WITH_FAKE_GRAD
+  public: // ---- Gradients ----------------------------------------------------------------------------------
+
+    // The gradient is only allocated when something is first accumulated into it. If it is
+    // still empty, an incoming temporary is adopted instead of being added to a zero pack.
+    // Backward functions call free_grad() or take_grad() once they have consumed it, and return 
+    // without touching their inputs if the output never received a gradient. The accumulating 
+    // *_back kernels still start a missing input gradient from zero (through gradp()). 
+
+    using cnine::diff_class<Ptensors0>::add_to_grad;
+
+    bool has_grad() const{
+      return grad!=nullptr;
+    }
+
+    void add_to_grad(const Ptensors0& x){
+      if(grad) grad->add(x);
+      else adopt_grad(new Ptensors0(static_cast<const RtensorPackB&>(x),atoms));
+    }
+
+    void add_to_grad(Ptensors0&& x){
+      if(grad) grad->add(x);
+      else adopt_grad(new Ptensors0(static_cast<RtensorPackB&&>(std::move(x)),atoms));
+    }
+
+    void add_to_grad(const cnine::loose_ptr<Ptensors0>& x){
+      const Ptensors0& _x=x;
+      add_to_grad(_x);
+    }
+
+    Ptensors0 take_grad(){
+      PTENS_ASSRT(grad);
+      Ptensors0 R(static_cast<RtensorPackB&&>(std::move(*grad)),atoms);
+      free_grad();
+      return R;
+    }
+
+    void free_grad(){
+      delete grad;
+      grad=nullptr;
+    }
+
+    void adopt_grad(Ptensors0* g){
+      g->set_memory_category(PtensMemoryTracker::GRADIENTS);
+      grad=g;
+    }
+
+    // Backward of r=ReLU(*this,alpha). If this has no gradient yet, the gradient of r is moved 
+    // in and masked in place rather than added to a zero pack.
+    void add_ReLU_back_from(Ptensors0& r, const float alpha){
+      if(!r.grad) return;
+      if(grad || dev!=0){
+	get_grad().add_ReLU_back(*r.grad,*this,alpha);
+	r.free_grad();
+	return;
+      }
+      Ptensors0* g=r.grad;
+      r.grad=nullptr;
+      PTENS_ASSRT(g->tail==tail);
+      for(size_t i=0; i<(size_t)tail; i++)
+	if(!(arr[i]>0)) g->arr[i]*=alpha;
+      adopt_grad(g);
+    }
+#endif 
+
+
   public: // ---- Access -------------------------------------------------------------------------------------
 
 
@@ -275,6 +346,13 @@ namespace ptens{
       return size();
     }
 
+    // Bytes held by the features, as reported to ptens_memory(). Like AtomsPack, a view does 
+    // not own its array, so views of torch storage are not counted.
+    size_t memory_bytes() const{
+      if(is_view) return 0;
+      return tail*sizeof(float);
+    }
+
     //int get_nc() const{
     //return nc;
     //}
@@ -342,9 +420,9 @@ namespace ptens{
 
 
     static Ptensors0 cat(const vector<reference_wrapper<Ptensors0> >& list){
-      vector<reference_wrapper<AtomsPack> > v;
+      vector<const AtomsPack*> v;
       for(auto& p:list)
-	v.push_back(p.get().atoms);
+	v.push_back(&p.get().atoms.get());
       return Ptensors0(cnine::RtensorPackB::cat
 	(cnine::mapcar<reference_wrapper<Ptensors0>,reference_wrapper<RtensorPackB> >
 	  (list,[](const reference_wrapper<Ptensors0>& x){
@@ -423,12 +501,12 @@ namespace ptens{
     RtensorPackB reduce0(const AindexPack& list) const{
       TimedFn T("Ptensors0","reduce0",*this,list,list.size()*nc);
       int N=list.size();
-      cnine::array_pool<int> dims;
-      RtensorPackB R(N,Gdims(nc),cnine::fill_zero(),dev);
+      RtensorPackB R=list.scratch_pack(0,nc,dev);
       if(dev==0){
 	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  R.view1_of(i)=view_of(list.tix(i)); // OK
+	  float* dest=R.arr+R.dir(i,0);
+	  if(list.nix(i)==0) std::fill(dest,dest+nc,0);
+	  else std::copy(arr+dir(list.tix(i),0),arr+dir(list.tix(i),0)+nc,dest);
 	}
       }
       GPUCODE(CUDA_STREAM(Ptensors0_reduce0_cu(R,*this,list,0,nc,stream)));
@@ -448,17 +526,7 @@ namespace ptens{
 
     // Deprecated 
     RtensorPackB reduce0(const AindexPack& list, const int offs, const int n) const{
-      TimedFn T("Ptensors0","reduce0",*this,list,list.size()*nc);
-      int N=list.size();
-      RtensorPackB R(N,Gdims(nc),cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  R.view1_of(i)=view_of(list.tix(i),offs,n); // OK
-	}
-      }
-      GPUCODE(CUDA_STREAM(Ptensors0_reduce0_cu(R,*this,list,offs,n,stream)));
-      return R;
+      return broadcast0_back(list,offs,n);
     }
 
 
@@ -471,17 +539,24 @@ namespace ptens{
 	for(int i=0; i<size(); i++)
 	  view_of(i)+=x.view1_of(i);
       }
-      GPUCODE(CUDA_STREAM(Ptensors0_broadcast0_cu(*this,x,0,stream)));
+      GPUCODE(CUDA_STREAM(Ptensors0_broadcast0_cu(*this,x,0,stream,false)));
     }
 
-    void broadcast0(const RtensorPackB& x, const int offs){
+    // With assign set, channels offs,...,offs+x.nc-1 are overwritten rather than added to, 
+    // so they need not be initialized
+    void broadcast0(const RtensorPackB& x, const int offs, const bool assign=false){
       TimedFn T("Ptensors0","brcast0",*this,x);
       if(dev==0){
 	const int n=x.nc;
-	for(int i=0; i<size(); i++)
-	  view_of(i,offs,n).add(x.view1_of(i));
+	if(assign){
+	  for(int i=0; i<size(); i++)
+	    std::copy(x.arr+x.dir(i,0),x.arr+x.dir(i,0)+n,arr+dir(i,0)+offs);
+	}else{
+	  for(int i=0; i<size(); i++)
+	    view_of(i,offs,n).add(x.view1_of(i));
+	}
       }
-      GPUCODE(CUDA_STREAM(Ptensors0_broadcast0_cu(*this,x,offs,stream)));
+      GPUCODE(CUDA_STREAM(Ptensors0_broadcast0_cu(*this,x,offs,stream,assign)));
     }
 
 
@@ -502,11 +577,12 @@ namespace ptens{
     RtensorPackB broadcast0_back(const AindexPack& list, const int offs, const int n) const{
       TimedFn T("Ptensors0","brcast0_back",*this,list,list.size()*nc);
       int N=list.size();
-      RtensorPackB R(N,Gdims(n),cnine::fill_zero(),dev);
+      RtensorPackB R=list.scratch_pack(0,n,dev);
       if(dev==0){
 	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  R.view1_of(i)=view_of(list.tix(i),offs,n);
+	  float* dest=R.arr+R.dir(i,0);
+	  if(list.nix(i)==0) std::fill(dest,dest+n,0);
+	  else std::copy(arr+dir(list.tix(i),0)+offs,arr+dir(list.tix(i),0)+offs+n,dest);
 	}
       }
       GPUCODE(CUDA_STREAM(Ptensors0_reduce0_cu(R,*this,list,offs,n,stream)));
@@ -552,6 +628,11 @@ namespace ptens{
     friend ostream& operator<<(ostream& stream, const Ptensors0& x){
       stream<<x.str(); return stream;}
 
+
+  private:
+
+    Registration registration{this}; // last data member, see PtensTracked
+
   };
 
 }
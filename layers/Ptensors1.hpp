@@ -19,7 +19,8 @@
 
 //#include "Cgraph.hpp"
 #include "RtensorPackB.hpp"
-#include "AtomsPack.hpp"
+#include "SharedAtomsPack.hpp"
+#include "PtensMemory.hpp"
 #include "AindexPack.hpp"
 #include "Ptensor1.hpp"
 #include "Ptensors0.hpp"
@@ -38,15 +39,16 @@ namespace ptens{
   extern void Ptensors1_reduce0n_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, int offs, int n, const cudaStream_t& stream);
   extern void Ptensors1_reduce1_cu(cnine::RtensorPackB& R,const cnine::RtensorPackB& x, int offs, int n, const cudaStream_t& stream);
   extern void Ptensors1_reduce1_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, int offs, int n, const cudaStream_t& stream);
-  extern void Ptensors1_broadcast0_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream);
+  extern void Ptensors1_broadcast0_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream, const bool assign);
   extern void Ptensors1_broadcast0n_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream);
   extern void Ptensors1_broadcast0_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, const int offs, const cudaStream_t& stream);
   extern void Ptensors1_broadcast0n_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, const int offs, const cudaStream_t& stream);
-  extern void Ptensors1_broadcast1_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream);
+  extern void Ptensors1_broadcast1_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream, const bool assign);
   extern void Ptensors1_broadcast1_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, const int offs, const cudaStream_t& stream);
   #endif
 
-  class Ptensors1: public cnine::RtensorPackB, public cnine::diff_class<Ptensors1>{
+  class Ptensors1: public cnine::RtensorPackB, public cnine::diff_class<Ptensors1>,
+                   public PtensTracked<Ptensors1,PtensMemoryTracker::FEATURES>{
   public:
 
     typedef cnine::Gdims Gdims;
@@ -58,7 +60,7 @@ namespace ptens{
     typedef cnine::Rtensor3_view Rtensor3_view;
     typedef cnine::RtensorPackB RtensorPackB;
 
-    AtomsPack atoms;
+    SharedAtomsPack atoms;
     //rtensor norms;
 
 
@@ -220,8 +222,11 @@ namespace ptens{
       return Ptensors1(RtensorPackB::zeros_like(x,_nc),x.atoms);
     }
 
+    // Only used to allocate gradients
     static Ptensors1* new_zeros_like(const Ptensors1& x){
-      return new Ptensors1(RtensorPackB::zeros_like(x),x.atoms);
+      Ptensors1* R=new Ptensors1(RtensorPackB::zeros_like(x),x.atoms);
+      R->set_memory_category(PtensMemoryTracker::GRADIENTS);
+      return R;
     }
 
    static Ptensors1 gaussian_like(const Ptensors1& x){
@@ -285,6 +290,72 @@ namespace ptens{
     }
 
 
+#ifdef WITH_FAKE_GRAD
+  public: // ---- Gradients ----------------------------------------------------------------------------------
+
+    // The gradient is only allocated when something is first accumulated into it. If it is
+    // still empty, an incoming temporary is adopted instead of being added to a zero pack.
+    // Backward functions call free_grad() or take_grad() once they have consumed it, and return 
+    // without touching their inputs if the output never received a gradient. The accumulating 
+    // *_back kernels still start a missing input gradient from zero (through gradp()). 
+
+    using cnine::diff_class<Ptensors1>::add_to_grad;
+
+    bool has_grad() const{
+      return grad!=nullptr;
+    }
+
+    void add_to_grad(const Ptensors1& x){
+      if(grad) grad->add(x);
+      else adopt_grad(new Ptensors1(static_cast<const RtensorPackB&>(x),atoms));
+    }
+
+    void add_to_grad(Ptensors1&& x){
+      if(grad) grad->add(x);
+      else adopt_grad(new Ptensors1(static_cast<RtensorPackB&&>(std::move(x)),atoms));
+    }
+
+    void add_to_grad(const cnine::loose_ptr<Ptensors1>& x){
+      const Ptensors1& _x=x;
+      add_to_grad(_x);
+    }
+
+    Ptensors1 take_grad(){
+      PTENS_ASSRT(grad);
+      Ptensors1 R(static_cast<RtensorPackB&&>(std::move(*grad)),atoms);
+      free_grad();
+      return R;
+    }
+
+    void free_grad(){
+      delete grad;
+      grad=nullptr;
+    }
+
+    void adopt_grad(Ptensors1* g){
+      g->set_memory_category(PtensMemoryTracker::GRADIENTS);
+      grad=g;
+    }
+
+    // Backward of r=ReLU(*this,alpha). If this has no gradient yet, the gradient of r is moved 
+    // in and masked in place rather than added to a zero pack.
+    void add_ReLU_back_from(Ptensors1& r, const float alpha){
+      if(!r.grad) return;
+      if(grad || dev!=0){
+	get_grad().add_ReLU_back(*r.grad,*this,alpha);
+	r.free_grad();
+	return;
+      }
+      Ptensors1* g=r.grad;
+      r.grad=nullptr;
+      PTENS_ASSRT(g->tail==tail);
+      for(size_t i=0; i<(size_t)tail; i++)
+	if(!(arr[i]>0)) g->arr[i]*=alpha;
+      adopt_grad(g);
+    }
+#endif 
+
+
   public: // ----- Access ------------------------------------------------------------------------------------
 
 
@@ -292,11 +363,18 @@ namespace ptens{
       return size();
     }
 
+    // Bytes held by the features, as reported to ptens_memory(). Like AtomsPack, a view does 
+    // not own its array, so views of torch storage are not counted.
+    size_t memory_bytes() const{
+      if(is_view) return 0;
+      return tail*sizeof(float);
+    }
+
     //int get_nc() const{
     //return nc;
     //}
 
-    AtomsPack& get_atomsref(){
+    const AtomsPack& get_atomsref() const{
       return atoms;
     }
 
@@ -383,9 +461,9 @@ namespace ptens{
 
 
     static Ptensors1 cat(const vector<reference_wrapper<Ptensors1> >& list){
-      vector<reference_wrapper<AtomsPack> > v;
+      vector<const AtomsPack*> v;
       for(auto& p:list)
-	v.push_back(p.get().atoms);
+	v.push_back(&p.get().atoms.get());
       return Ptensors1(cnine::RtensorPackB::cat
 	(cnine::mapcar<reference_wrapper<Ptensors1>,reference_wrapper<RtensorPackB> >
 	  (list,[](const reference_wrapper<Ptensors1>& x){
@@ -522,14 +600,8 @@ namespace ptens{
 
     RtensorPackB reduce0(const AindexPack& list) const{
       TimedFn T("Ptensors1","reduce0",*this,list,list.count1*nc);
-      int N=list.size();
-      RtensorPackB R(N,Gdims(nc),cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  view_of(list.tens(i),list.ix(i)).sum0_into(R.view1_of(i));
-	}
-      }
+      RtensorPackB R=list.scratch_pack(0,nc,dev);
+      if(dev==0) sum_rows_into(R,list,0,nc);
       GPUCODE(CUDA_STREAM(Ptensors1_reduce0_cu(R,*this,list,0,nc,stream)));
       return R;
     }
@@ -547,17 +619,8 @@ namespace ptens{
 
     RtensorPackB reduce1(const AindexPack& list) const{
       TimedFn T("Ptensors1","reduce1",*this,list,list.count1*nc);
-      int N=list.size();
-      cnine::array_pool<int> dims;
-      for(int i=0; i<N; i++)
-	dims.push_back({list.nix(i),nc});
-      RtensorPackB R(dims,cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  R.view2_of(i)+=view_of(list.tens(i),list.ix(i));
-	}
-      }
+      RtensorPackB R=list.scratch_pack(1,nc,dev);
+      if(dev==0) gather_rows_into(R,list,0,nc);
       GPUCODE(CUDA_STREAM(Ptensors1_reduce1_cu(R,*this,list,0,nc,stream)));
       return R;
     }
@@ -579,49 +642,57 @@ namespace ptens{
 
     RtensorPackB reduce0_n(const AindexPack& list) const{
       TimedFn T("Ptensors1","reduce0_n",*this,list,list.count1*nc);
-      int N=list.size();
-      RtensorPackB R(N,Gdims(nc),cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  view_of(list.tens(i),list.ix(i)).avg0_into(R.view1_of(i));
-	}
-      }
+      RtensorPackB R=list.scratch_pack(0,nc,dev);
+      if(dev==0) sum_rows_into(R,list,0,nc,true);
       GPUCODE(CUDA_STREAM(Ptensors1_reduce0n_cu(R,*this,list,0,nc,stream)));
       return R;
     }
 
     // deprecated 
     RtensorPackB reduce0(const AindexPack& list, const int offs, const int n) const{
-      TimedFn T("Ptensors1","reduce0",*this,list,list.count1*n);
-      int N=list.size();
-      RtensorPackB R(N,Gdims(n),cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  view_of(list.tens(i),list.ix(i),offs,n).sum0_into(R.view1_of(i));
-	}
-      }
-      GPUCODE(CUDA_STREAM(Ptensors1_reduce0_cu(R,*this,list,offs,n,stream)));
-      return R;
+      return broadcast0_back(list,offs,n);
     }
 
     // deprecated 
     RtensorPackB reduce1(const AindexPack& list, const int offs, const int n) const{
-      TimedFn T("Ptensors1","reduce1",*this,list,list.count1*n);
-      int N=list.size();
-      cnine::array_pool<int> dims;
-      for(int i=0; i<N; i++)
-	dims.push_back({list.nix(i),n});
-      RtensorPackB R(dims,cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  R.view2_of(i)+=view_of(list.tens(i),list.ix(i),offs,n);
+      return broadcast1_back(list,offs,n);
+    }
+
+
+  private:
+
+    // Host kernels of the indexed reductions. R comes from AindexPack::scratch_pack, so each
+    // entry is written before it is added to. 
+
+    // R.view1_of(i) is set to the sum (or the average) of rows list.ix(i) of channels 
+    // offs,...,offs+n-1 of ptensor list.tens(i)
+    void sum_rows_into(RtensorPackB& R, const AindexPack& list, const int offs, const int n, const bool normalized=false) const{
+      for(int i=0; i<list.size(); i++){
+	float* dest=R.arr+R.dir(i,0);
+	const int m=list.nix(i);
+	if(m==0){
+	  std::fill(dest,dest+n,0);
+	  continue;
 	}
+	const float* src=arr+dir(list.tens(i),0)+offs;
+	std::copy(src+list.ix(i,1)*nc,src+list.ix(i,1)*nc+n,dest);
+	for(int a=2; a<=m; a++){
+	  const float* row=src+list.ix(i,a)*nc;
+	  for(int c=0; c<n; c++) dest[c]+=row[c];
+	}
+	if(normalized)
+	  for(int c=0; c<n; c++) dest[c]/=m;
+      }
+    }
+
+    // R.view2_of(i) is set to rows list.ix(i) of channels offs,...,offs+n-1 of ptensor list.tens(i)
+    void gather_rows_into(RtensorPackB& R, const AindexPack& list, const int offs, const int n) const{
+      for(int i=0; i<list.size(); i++){
+	float* dest=R.arr+R.dir(i,0);
+	const float* src=arr+dir(list.tens(i),0)+offs;
+	for(int a=0; a<list.nix(i); a++)
+	  std::copy(src+list.ix(i,a+1)*nc,src+list.ix(i,a+1)*nc+n,dest+a*n);
       }
-      GPUCODE(CUDA_STREAM(Ptensors1_reduce1_cu(R,*this,list,offs,n,stream)));
-      return R;
     }
 
 
@@ -635,7 +706,7 @@ namespace ptens{
 	  view_of(i)+=repeat0(x.view1_of(i),k_of(i));
 	}
       }
-      GPUCODE(CUDA_STREAM(Ptensors1_broadcast0_cu(*this,x,0,stream)));
+      GPUCODE(CUDA_STREAM(Ptensors1_broadcast0_cu(*this,x,0,stream,false)));
     }
 
     void broadcast0_n(const RtensorPackB& x){
@@ -648,15 +719,26 @@ namespace ptens{
       GPUCODE(CUDA_STREAM(Ptensors1_broadcast0n_cu(*this,x,0,stream)));
     }
 
-    void broadcast0(const RtensorPackB& x, const int offs){
+    // With assign set, channels offs,...,offs+x.nc-1 are overwritten rather than added to, 
+    // so they need not be initialized
+    void broadcast0(const RtensorPackB& x, const int offs, const bool assign=false){
       TimedFn T("Ptensors1","brcast0",*this,x);
       const int n=x.nc;
       if(dev==0){
-	for(int i=0; i<size(); i++){
-	  view_of(i,offs,n)+=repeat0(x.view1_of(i),k_of(i));
+	if(assign){
+	  for(int i=0; i<size(); i++){
+	    const float* src=x.arr+x.dir(i,0);
+	    float* dest=arr+dir(i,0)+offs;
+	    for(int a=0; a<k_of(i); a++)
+	      std::copy(src,src+n,dest+a*nc);
+	  }
+	}else{
+	  for(int i=0; i<size(); i++){
+	    view_of(i,offs,n)+=repeat0(x.view1_of(i),k_of(i));
+	  }
 	}
       }
-      GPUCODE(CUDA_STREAM(Ptensors1_broadcast0_cu(*this,x,offs,stream)));
+      GPUCODE(CUDA_STREAM(Ptensors1_broadcast0_cu(*this,x,offs,stream,assign)));
     }
 
     void broadcast1(const RtensorPackB& x){
@@ -666,18 +748,27 @@ namespace ptens{
 	  view_of(i)+=x.view2_of(i);
 	}
       }
-      GPUCODE(CUDA_STREAM(Ptensors1_broadcast1_cu(*this,x,0,stream)));
+      GPUCODE(CUDA_STREAM(Ptensors1_broadcast1_cu(*this,x,0,stream,false)));
     }
 
-    void broadcast1(const RtensorPackB& x, const int offs){
+    void broadcast1(const RtensorPackB& x, const int offs, const bool assign=false){
       TimedFn T("Ptensors1","brcast1",*this,x);
       if(dev==0){
 	const int n=x.nc;
-	for(int i=0; i<size(); i++){
-	  view_of(i,offs,n)+=x.view2_of(i);
+	if(assign){
+	  for(int i=0; i<size(); i++){
+	    const float* src=x.arr+x.dir(i,0);
+	    float* dest=arr+dir(i,0)+offs;
+	    for(int a=0; a<k_of(i); a++)
+	      std::copy(src+a*n,src+(a+1)*n,dest+a*nc);
+	  }
+	}else{
+	  for(int i=0; i<size(); i++){
+	    view_of(i,offs,n)+=x.view2_of(i);
+	  }
 	}
       }
-      GPUCODE(CUDA_STREAM(Ptensors1_broadcast1_cu(*this,x,offs,stream)));
+      GPUCODE(CUDA_STREAM(Ptensors1_broadcast1_cu(*this,x,offs,stream,assign)));
     }
 
 
@@ -698,14 +789,8 @@ namespace ptens{
 
     RtensorPackB broadcast0_back(const AindexPack& list, const int offs, const int n) const{
       TimedFn T("Ptensors1","brcast0_back",*this,list,list.count1*n);
-      int N=list.size();
-      RtensorPackB R(N,Gdims(n),cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  view_of(list.tens(i),list.ix(i),offs,n).sum0_into(R.view1_of(i));
-	}
-      }
+      RtensorPackB R=list.scratch_pack(0,n,dev);
+      if(dev==0) sum_rows_into(R,list,offs,n);
       GPUCODE(CUDA_STREAM(Ptensors1_reduce0_cu(R,*this,list,offs,n,stream)));
       return R;
     }
@@ -725,17 +810,8 @@ namespace ptens{
 
     RtensorPackB broadcast1_back(const AindexPack& list, const int offs, const int n) const{
       TimedFn T("Ptensors1","brcast1_back",*this,list,list.count1*n);
-      int N=list.size();
-      cnine::array_pool<int> dims;
-      for(int i=0; i<N; i++)
-	dims.push_back({list.nix(i),n});
-      RtensorPackB R(dims,cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  R.view2_of(i)+=view_of(list.tens(i),list.ix(i),offs,n);
-	}
-      }
+      RtensorPackB R=list.scratch_pack(1,n,dev);
+      if(dev==0) gather_rows_into(R,list,offs,n);
       GPUCODE(CUDA_STREAM(Ptensors1_reduce1_cu(R,*this,list,offs,n,stream)));
       return R;
     }
@@ -807,6 +883,11 @@ namespace ptens{
     friend ostream& operator<<(ostream& stream, const Ptensors1& x){
       stream<<x.str(); return stream;}
 
+
+  private:
+
+    Registration registration{this}; // last data member, see PtensTracked
+
   };
 
 }
@@ -19,7 +19,8 @@
 
 //#include "Cgraph.hpp"
 #include "RtensorPackB.hpp"
-#include "AtomsPack.hpp"
+#include "SharedAtomsPack.hpp"
+#include "PtensMemory.hpp"
 #include "AindexPack.hpp"
 #include "Ptensor2.hpp"
 #include "diff_class.hpp"
@@ -50,28 +51,29 @@ namespace ptens{
   extern void Ptensors2_reduce2_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, int offs, int n, const cudaStream_t& stream);
   extern void Ptensors2_reduce2B_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, int offs, int n, const cudaStream_t& stream);
 
-  extern void Ptensors2_broadcast0_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream);
+  extern void Ptensors2_broadcast0_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream, const bool assign);
   extern void Ptensors2_broadcast0B_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream);
   extern void Ptensors2_broadcast0Bn_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream);
   extern void Ptensors2_broadcast0_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, const int offs, const cudaStream_t& stream);
   extern void Ptensors2_broadcast0B_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, const int offs, const cudaStream_t& stream);
   extern void Ptensors2_broadcast0Bn_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, const int offs, const cudaStream_t& stream);
 
-  extern void Ptensors2_broadcast1_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream);
+  extern void Ptensors2_broadcast1_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream, const bool assign);
   extern void Ptensors2_broadcast1B_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream);
   extern void Ptensors2_broadcast1Bn_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream);
   extern void Ptensors2_broadcast1_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, const int offs, const cudaStream_t& stream);
   extern void Ptensors2_broadcast1B_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, const int offs, const cudaStream_t& stream);
   extern void Ptensors2_broadcast1Bn_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, const int offs, const cudaStream_t& stream);
 
-  extern void Ptensors2_broadcast2_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream);
+  extern void Ptensors2_broadcast2_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream, const bool assign);
   extern void Ptensors2_broadcast2B_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const int offs, const cudaStream_t& stream);
   extern void Ptensors2_broadcast2_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, const int offs, const cudaStream_t& stream);
   extern void Ptensors2_broadcast2B_cu(cnine::RtensorPackB& R, const cnine::RtensorPackB& x, const AindexPack& list, const int offs, const cudaStream_t& stream);
   #endif
 
 
-  class Ptensors2: public cnine::RtensorPackB, public cnine::diff_class<Ptensors2>{
+  class Ptensors2: public cnine::RtensorPackB, public cnine::diff_class<Ptensors2>,
+                   public PtensTracked<Ptensors2,PtensMemoryTracker::FEATURES>{
   public:
 
     typedef cnine::Gdims Gdims;
@@ -84,7 +86,7 @@ namespace ptens{
     typedef cnine::Rtensor2_view Rtensor2_view;
     typedef cnine::Rtensor3_view Rtensor3_view;
 
-    AtomsPack atoms;
+    SharedAtomsPack atoms;
     rtensor norms;
 
 
@@ -236,8 +238,11 @@ namespace ptens{
       return Ptensors2(RtensorPackB::zeros_like(x,_nc),x.atoms);
     }
 
+    // Only used to allocate gradients
     static Ptensors2* new_zeros_like(const Ptensors2& x){
-      return new Ptensors2(RtensorPackB::zeros_like(x),x.atoms);//,x.nc);
+      Ptensors2* R=new Ptensors2(RtensorPackB::zeros_like(x),x.atoms);
+      R->set_memory_category(PtensMemoryTracker::GRADIENTS);
+      return R;
     }
 
    static Ptensors2 gaussian_like(const Ptensors2& x){
@@ -295,6 +300,72 @@ namespace ptens{
     }
 
 
+#ifdef WITH_FAKE_GRAD
+  public: // ---- Gradients ----------------------------------------------------------------------------------
+
+    // The gradient is only allocated when something is first accumulated into it. If it is
+    // still empty, an incoming temporary is adopted instead of being added to a zero pack.
+    // Backward functions call free_grad() or take_grad() once they have consumed it, and return 
+    // without touching their inputs if the output never received a gradient. The accumulating 
+    // *_back kernels still start a missing input gradient from zero (through gradp()). 
+
+    using cnine::diff_class<Ptensors2>::add_to_grad;
+
+    bool has_grad() const{
+      return grad!=nullptr;
+    }
+
+    void add_to_grad(const Ptensors2& x){
+      if(grad) grad->add(x);
+      else adopt_grad(new Ptensors2(static_cast<const RtensorPackB&>(x),atoms));
+    }
+
+    void add_to_grad(Ptensors2&& x){
+      if(grad) grad->add(x);
+      else adopt_grad(new Ptensors2(static_cast<RtensorPackB&&>(std::move(x)),atoms));
+    }
+
+    void add_to_grad(const cnine::loose_ptr<Ptensors2>& x){
+      const Ptensors2& _x=x;
+      add_to_grad(_x);
+    }
+
+    Ptensors2 take_grad(){
+      PTENS_ASSRT(grad);
+      Ptensors2 R(static_cast<RtensorPackB&&>(std::move(*grad)),atoms);
+      free_grad();
+      return R;
+    }
+
+    void free_grad(){
+      delete grad;
+      grad=nullptr;
+    }
+
+    void adopt_grad(Ptensors2* g){
+      g->set_memory_category(PtensMemoryTracker::GRADIENTS);
+      grad=g;
+    }
+
+    // Backward of r=ReLU(*this,alpha). If this has no gradient yet, the gradient of r is moved 
+    // in and masked in place rather than added to a zero pack.
+    void add_ReLU_back_from(Ptensors2& r, const float alpha){
+      if(!r.grad) return;
+      if(grad || dev!=0){
+	get_grad().add_ReLU_back(*r.grad,*this,alpha);
+	r.free_grad();
+	return;
+      }
+      Ptensors2* g=r.grad;
+      r.grad=nullptr;
+      PTENS_ASSRT(g->tail==tail);
+      for(size_t i=0; i<(size_t)tail; i++)
+	if(!(arr[i]>0)) g->arr[i]*=alpha;
+      adopt_grad(g);
+    }
+#endif 
+
+
   public: // ----- Access ------------------------------------------------------------------------------------
 
 
@@ -306,6 +377,13 @@ namespace ptens{
       return size();
     }
 
+    // Bytes held by the features, as reported to ptens_memory(). Like AtomsPack, a view does 
+    // not own its array, so views of torch storage are not counted.
+    size_t memory_bytes() const{
+      if(is_view) return 0;
+      return tail*sizeof(float);
+    }
+
     AtomsPack view_of_atoms(){
       return atoms.view();
     }
@@ -378,9 +456,9 @@ namespace ptens{
 
 
     static Ptensors2 cat(const vector<reference_wrapper<Ptensors2> >& list){
-      vector<reference_wrapper<AtomsPack> > v;
+      vector<const AtomsPack*> v;
       for(auto& p:list)
-	v.push_back(p.get().atoms);
+	v.push_back(&p.get().atoms.get());
       return Ptensors2(cnine::RtensorPackB::cat
 	(cnine::mapcar<reference_wrapper<Ptensors2>,reference_wrapper<RtensorPackB> >
 	  (list,[](const reference_wrapper<Ptensors2>& x){
@@ -555,15 +633,8 @@ namespace ptens{
 
     RtensorPackB reduce0(const AindexPack& list) const{
       TimedFn T("Ptensors2","reduce0",*this,list,(list.count2+list.count1)*nc);
-      int N=list.size();
-      RtensorPackB R(N,Gdims(2*nc),cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  view_of(list.tens(i),list.ix(i)).sum01_into(R.view1_of(i).block(0,nc));
-	  view_of(list.tens(i),list.ix(i)).diag01().sum0_into(R.view1_of(i).block(nc,nc));
-	}
-      }
+      RtensorPackB R=list.scratch_pack(0,2*nc,dev);
+      if(dev==0) reduce0_rows_into(R,list,0,0,nc,true);
       GPUCODE(CUDA_STREAM(Ptensors2_reduce0_cu(R,*this,list,0,nc,stream)));
       return R;
     }
@@ -584,19 +655,8 @@ namespace ptens{
 
     RtensorPackB reduce1(const AindexPack& list) const{
       TimedFn T("Ptensors2","reduce1",*this,list,(list.count1+2*list.count2)*nc);
-      int N=list.size();
-      cnine::array_pool<int> dims;
-      for(int i=0; i<N; i++)
-	dims.push_back(vector<int>({list.nix(i),3*nc}));
-      RtensorPackB R(dims,cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  view_of(list.tens(i),list.ix(i)).sum0_into(R.view2_of(i).block(0,0,-1,nc));
-	  view_of(list.tens(i),list.ix(i)).sum1_into(R.view2_of(i).block(0,nc,-1,nc));
-	  R.view2_of(i).block(0,2*nc,-1,nc)+=view_of(list.tens(i),list.ix(i)).diag01();
-	}
-      }
+      RtensorPackB R=list.scratch_pack(1,3*nc,dev);
+      if(dev==0) reduce1_rows_into(R,list,0,0,0,nc,true);
       GPUCODE(CUDA_STREAM(Ptensors2_reduce1_cu(R,*this,list,0,nc,stream)));
       return R;
     }
@@ -617,17 +677,8 @@ namespace ptens{
 
     RtensorPackB reduce2(const AindexPack& list) const{ // no flipping 
       TimedFn T("Ptensors2","reduce2",*this,list,(list.count2)*nc);
-      int N=list.size();
-      cnine::array_pool<int> dims;
-      for(int i=0; i<N; i++)
-	dims.push_back(vector<int>({list.nix(i),list.nix(i),nc}));
-      RtensorPackB R(dims,cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  R.view3_of(i)+=view_of(list.tens(i),list.ix(i));
-	}
-      }
+      RtensorPackB R=list.scratch_pack(2,nc,dev);
+      if(dev==0) reduce2_rows_into(R,list,0,nc,false);
       GPUCODE(CUDA_STREAM(Ptensors2_reduce2_cu(R,*this,list,0,nc,stream)));
       return R;
     }
@@ -670,57 +721,96 @@ namespace ptens{
 
     // deprecated: now called broadcast0_back
     RtensorPackB reduce0(const AindexPack& list, const int offs, const int n) const{
-      TimedFn T("Ptensors2","reduce0",*this,list,(list.count2+list.count1)*n);
-      int N=list.size();
-      RtensorPackB R(N,Gdims(n),cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  view_of(list.tens(i),list.ix(i),offs,n).sum01_into(R.view1_of(i));
-	  view_of(list.tens(i),list.ix(i),offs+n,n).diag01().sum0_into(R.view1_of(i));
-	}
-      }
-      GPUCODE(CUDA_STREAM(Ptensors2_reduce0B_cu(R,*this,list,offs,n,stream)));
-      return R;
+      return broadcast0_back(list,offs,n);
     }
 
     // deprecated: now called broadcast1_back
     RtensorPackB reduce1(const AindexPack& list, const int offs, const int n) const{
-      TimedFn T("Ptensors2","reduce1",*this,list,(list.count1+2*list.count2)*n);
-      int N=list.size();
-      cnine::array_pool<int> dims;
-      for(int i=0; i<N; i++)
-	dims.push_back(vector<int>({list.nix(i),n}));
-      RtensorPackB R(dims,cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  view_of(list.tens(i),list.ix(i),offs,n).sum0_into(R.view2_of(i));
-	  view_of(list.tens(i),list.ix(i),offs+n,n).sum1_into(R.view2_of(i));
-	  R.view2_of(i)+=view_of(list.tens(i),list.ix(i),offs+2*n,n).diag01();
-	}
-      }
-      GPUCODE(CUDA_STREAM(Ptensors2_reduce1B_cu(R,*this,list,offs,n,stream)));
-      return R;
+      return broadcast1_back(list,offs,n);
     }
 
     // deprecated now called broadcast2_back
     RtensorPackB reduce2(const AindexPack& list, const int offs, const int n) const{
-      TimedFn T("Ptensors2","reduce2",*this,list,(2*list.count2)*n);
-      int N=list.size();
-      cnine::array_pool<int> dims;
-      for(int i=0; i<N; i++)
-	dims.push_back(vector<int>({list.nix(i),list.nix(i),n}));
-      RtensorPackB R(dims,cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  R.view3_of(i)+=view_of(list.tens(i),list.ix(i),offs,n);
-	  R.view3_of(i)+=view_of(list.tens(i),list.ix(i),offs+n,n).transp();
+      return broadcast2_back(list,offs,n);
+    }
+
+
+  private:
+
+    // Host kernels of the indexed reductions. R comes from AindexPack::scratch_pack, so each
+    // entry is written before it is added to. With stacked set, the parts are written to
+    // consecutive blocks of n channels, otherwise they are summed into a single block.
+
+    // Sum of the list.ix(i) x list.ix(i) block of channels offs0,...,offs0+n-1 of ptensor 
+    // list.tens(i), and sum of its diagonal in channels offs1,...,offs1+n-1
+    void reduce0_rows_into(RtensorPackB& R, const AindexPack& list, const int offs0, const int offs1, const int n, const bool stacked) const{
+      for(int i=0; i<list.size(); i++){
+	float* dest=R.arr+R.dir(i,0);
+	float* ddest=stacked? dest+n : dest;
+	const int m=list.nix(i);
+	if(m==0){
+	  std::fill(dest,dest+(stacked? 2*n : n),0);
+	  continue;
 	}
+	const int k=k_of(list.tens(i));
+	const float* x=arr+dir(list.tens(i),0);
+	auto at=[&](const int a, const int b){return x+(list.ix(i,a+1)*k+list.ix(i,b+1))*nc;};
+	std::copy(at(0,0)+offs0,at(0,0)+offs0+n,dest);
+	for(int a=0; a<m; a++)
+	  for(int b=(a==0); b<m; b++)
+	    add_into(dest,at(a,b)+offs0,n);
+	if(stacked) std::copy(at(0,0)+offs1,at(0,0)+offs1+n,ddest);
+	for(int a=stacked; a<m; a++)
+	  add_into(ddest,at(a,a)+offs1,n);
       }
-      GPUCODE(CUDA_STREAM(Ptensors2_reduce2B_cu(R,*this,list,offs,n,stream)));
-      return R;
+    }
+
+    // Row a of R.view2_of(i) is the sum of column list.ix(i)[a] of the block in channels offs0,..., 
+    // the sum of row list.ix(i)[a] of the block in channels offs1,... and its diagonal entry in 
+    // channels offs2,...
+    void reduce1_rows_into(RtensorPackB& R, const AindexPack& list, const int offs0, const int offs1, const int offs2, 
+      const int n, const bool stacked) const{
+      const int w=stacked? 3*n : n;
+      for(int i=0; i<list.size(); i++){
+	const int m=list.nix(i);
+	const int k=k_of(list.tens(i));
+	const float* x=arr+dir(list.tens(i),0);
+	auto at=[&](const int a, const int b){return x+(list.ix(i,a+1)*k+list.ix(i,b+1))*nc;};
+	for(int a=0; a<m; a++){
+	  float* dest=R.arr+R.dir(i,0)+a*w;
+	  std::copy(at(0,a)+offs0,at(0,a)+offs0+n,dest);
+	  for(int b=1; b<m; b++)
+	    add_into(dest,at(b,a)+offs0,n);
+	  float* dest1=stacked? dest+n : dest;
+	  if(stacked) std::copy(at(a,0)+offs1,at(a,0)+offs1+n,dest1);
+	  for(int b=stacked; b<m; b++)
+	    add_into(dest1,at(a,b)+offs1,n);
+	  if(stacked) std::copy(at(a,a)+offs2,at(a,a)+offs2+n,dest+2*n);
+	  else add_into(dest,at(a,a)+offs2,n);
+	}
+      }
+    }
+
+    // The list.ix(i) x list.ix(i) block of channels offs,...,offs+n-1 of ptensor list.tens(i), 
+    // plus with flip set, the transpose of the block in channels offs+n,...,offs+2n-1
+    void reduce2_rows_into(RtensorPackB& R, const AindexPack& list, const int offs, const int n, const bool flip) const{
+      for(int i=0; i<list.size(); i++){
+	const int m=list.nix(i);
+	const int k=k_of(list.tens(i));
+	const float* x=arr+dir(list.tens(i),0);
+	auto at=[&](const int a, const int b){return x+(list.ix(i,a+1)*k+list.ix(i,b+1))*nc;};
+	float* dest=R.arr+R.dir(i,0);
+	for(int a=0; a<m; a++)
+	  for(int b=0; b<m; b++){
+	    float* t=dest+(a*m+b)*n;
+	    std::copy(at(a,b)+offs,at(a,b)+offs+n,t);
+	    if(flip) add_into(t,at(b,a)+offs+n,n);
+	  }
+      }
+    }
+
+    static void add_into(float* dest, const float* src, const int n){
+      for(int c=0; c<n; c++) dest[c]+=src[c];
     }
 
 
@@ -752,16 +842,33 @@ namespace ptens{
       GPUCODE(CUDA_STREAM(Ptensors2_broadcast0Bn_cu(*this,x,0,stream)));
     }
 
-    void broadcast0(const RtensorPackB& x, const int offs){
+    // With assign set, channels offs,...,offs+2*x.nc-1 are overwritten rather than added to, 
+    // so they need not be initialized. The off-diagonal part of the second block is zeroed. 
+    void broadcast0(const RtensorPackB& x, const int offs, const bool assign=false){
       TimedFn T("Ptensors2","brcast0",*this,x);
       const int n=x.nc;
       if(dev==0){
-	for(int i=0; i<size(); i++){
-	  view_of(i,offs,n)+=repeat0(repeat0(x.view1_of(i),k_of(i)),k_of(i));
-	  view_of(i,offs+n,n).diag01()+=repeat0(x.view1_of(i),k_of(i));
+	if(assign){
+	  for(int i=0; i<size(); i++){
+	    const int k=k_of(i);
+	    const float* src=x.arr+x.dir(i,0);
+	    float* dest=arr+dir(i,0)+offs;
+	    for(int a=0; a<k; a++)
+	      for(int b=0; b<k; b++){
+		float* t=dest+(a*k+b)*nc;
+		std::copy(src,src+n,t);
+		if(a==b) std::copy(src,src+n,t+n);
+		else std::fill(t+n,t+2*n,0);
+	      }
+	  }
+	}else{
+	  for(int i=0; i<size(); i++){
+	    view_of(i,offs,n)+=repeat0(repeat0(x.view1_of(i),k_of(i)),k_of(i));
+	    view_of(i,offs+n,n).diag01()+=repeat0(x.view1_of(i),k_of(i));
+	  }
 	}
       }
-      GPUCODE(CUDA_STREAM(Ptensors2_broadcast0_cu(*this,x,offs,stream)));
+      GPUCODE(CUDA_STREAM(Ptensors2_broadcast0_cu(*this,x,offs,stream,assign)));
     }
 
     void broadcast1(const RtensorPackB& x){
@@ -789,17 +896,34 @@ namespace ptens{
       GPUCODE(CUDA_STREAM(Ptensors2_broadcast1Bn_cu(*this,x,0,stream)));
     }
 
-    void broadcast1(const RtensorPackB& x, const int offs){
+    // With assign set, channels offs,...,offs+3*x.nc-1 are overwritten rather than added to 
+    void broadcast1(const RtensorPackB& x, const int offs, const bool assign=false){
       TimedFn T("Ptensors2","brcast1",*this,x);
       const int n=x.nc;
       if(dev==0){
-	for(int i=0; i<size(); i++){
-	  view_of(i,offs,n)+=repeat0(x.view2_of(i),k_of(i));
-	  view_of(i,offs+n,n)+=repeat1(x.view2_of(i),k_of(i));
-	  view_of(i,offs+2*n,n).diag01()+=x.view2_of(i);
+	if(assign){
+	  for(int i=0; i<size(); i++){
+	    const int k=k_of(i);
+	    const float* src=x.arr+x.dir(i,0);
+	    float* dest=arr+dir(i,0)+offs;
+	    for(int a=0; a<k; a++)
+	      for(int b=0; b<k; b++){
+		float* t=dest+(a*k+b)*nc;
+		std::copy(src+b*n,src+(b+1)*n,t);
+		std::copy(src+a*n,src+(a+1)*n,t+n);
+		if(a==b) std::copy(src+a*n,src+(a+1)*n,t+2*n);
+		else std::fill(t+2*n,t+3*n,0);
+	      }
+	  }
+	}else{
+	  for(int i=0; i<size(); i++){
+	    view_of(i,offs,n)+=repeat0(x.view2_of(i),k_of(i));
+	    view_of(i,offs+n,n)+=repeat1(x.view2_of(i),k_of(i));
+	    view_of(i,offs+2*n,n).diag01()+=x.view2_of(i);
+	  }
 	}
       }
-      GPUCODE(CUDA_STREAM(Ptensors2_broadcast1_cu(*this,x,offs,stream)));
+      GPUCODE(CUDA_STREAM(Ptensors2_broadcast1_cu(*this,x,offs,stream,assign)));
     }
 
     void broadcast2(const RtensorPackB& x){ // no flipping
@@ -813,16 +937,31 @@ namespace ptens{
       GPUCODE(CUDA_STREAM(Ptensors2_broadcast2B_cu(*this,x,0,stream)));
     }
 
-    void broadcast2(const RtensorPackB& x, const int offs){
+    // With assign set, channels offs,...,offs+2*x.nc-1 are overwritten rather than added to 
+    void broadcast2(const RtensorPackB& x, const int offs, const bool assign=false){
       TimedFn T("Ptensors2","brcast2",*this,x);
       const int n=x.nc;
       if(dev==0){
-	for(int i=0; i<size(); i++){
-	  view_of(i,offs,n)+=x.view3_of(i);
-	  view_of(i,offs+n,n)+=x.view3_of(i).transp01();
+	if(assign){
+	  for(int i=0; i<size(); i++){
+	    const int k=k_of(i);
+	    const float* src=x.arr+x.dir(i,0);
+	    float* dest=arr+dir(i,0)+offs;
+	    for(int a=0; a<k; a++)
+	      for(int b=0; b<k; b++){
+		float* t=dest+(a*k+b)*nc;
+		std::copy(src+(a*k+b)*n,src+(a*k+b+1)*n,t);
+		std::copy(src+(b*k+a)*n,src+(b*k+a+1)*n,t+n);
+	      }
+	  }
+	}else{
+	  for(int i=0; i<size(); i++){
+	    view_of(i,offs,n)+=x.view3_of(i);
+	    view_of(i,offs+n,n)+=x.view3_of(i).transp01();
+	  }
 	}
       }
-      GPUCODE(CUDA_STREAM(Ptensors2_broadcast2_cu(*this,x,offs,stream)));
+      GPUCODE(CUDA_STREAM(Ptensors2_broadcast2_cu(*this,x,offs,stream,assign)));
     }
 
 
@@ -845,15 +984,8 @@ namespace ptens{
 
     RtensorPackB broadcast0_back(const AindexPack& list, const int offs, const int n) const{
       TimedFn T("Ptensors2","bcast0_back",*this,list,(list.count2+list.count1)*n);
-      int N=list.size();
-      RtensorPackB R(N,Gdims(n),cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  view_of(list.tens(i),list.ix(i),offs,n).sum01_into(R.view1_of(i));
-	  view_of(list.tens(i),list.ix(i),offs+n,n).diag01().sum0_into(R.view1_of(i));
-	}
-      }
+      RtensorPackB R=list.scratch_pack(0,n,dev);
+      if(dev==0) reduce0_rows_into(R,list,offs,offs+n,n,false);
       GPUCODE(CUDA_STREAM(Ptensors2_reduce0B_cu(R,*this,list,offs,n,stream)));
       return R;
     }
@@ -875,19 +1007,8 @@ namespace ptens{
 
     RtensorPackB broadcast1_back(const AindexPack& list, const int offs, const int n) const{
       TimedFn T("Ptensors2","brcast1_back",*this,list,(list.count1+2*list.count2)*n);
-      int N=list.size();
-      cnine::array_pool<int> dims;
-      for(int i=0; i<N; i++)
-	dims.push_back(vector<int>({list.nix(i),n}));
-      RtensorPackB R(dims,cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  view_of(list.tens(i),list.ix(i),offs,n).sum0_into(R.view2_of(i));
-	  view_of(list.tens(i),list.ix(i),offs+n,n).sum1_into(R.view2_of(i));
-	  R.view2_of(i)+=view_of(list.tens(i),list.ix(i),offs+2*n,n).diag01();
-	}
-      }
+      RtensorPackB R=list.scratch_pack(1,n,dev);
+      if(dev==0) reduce1_rows_into(R,list,offs,offs+n,offs+2*n,n,false);
       GPUCODE(CUDA_STREAM(Ptensors2_reduce1B_cu(R,*this,list,offs,n,stream)));
       return R;
     }
@@ -908,18 +1029,8 @@ namespace ptens{
 
     RtensorPackB broadcast2_back(const AindexPack& list, const int offs, const int n) const{
       TimedFn T("Ptensors2","brcast2_back",*this,list,(2*list.count2)*n);
-      int N=list.size();
-      cnine::array_pool<int> dims;
-      for(int i=0; i<N; i++)
-	dims.push_back(vector<int>({list.nix(i),list.nix(i),n}));
-      RtensorPackB R(dims,cnine::fill_zero(),dev);
-      if(dev==0){
-	for(int i=0; i<N; i++){
-	  if(list.nix(i)==0) continue;
-	  R.view3_of(i)+=view_of(list.tens(i),list.ix(i),offs,n);
-	  R.view3_of(i)+=view_of(list.tens(i),list.ix(i),offs+n,n).transp();
-	}
-      }
+      RtensorPackB R=list.scratch_pack(2,n,dev);
+      if(dev==0) reduce2_rows_into(R,list,offs,n,true);
       GPUCODE(CUDA_STREAM(Ptensors2_reduce2B_cu(R,*this,list,offs,n,stream)));
       return R;
     }
@@ -1037,6 +1148,11 @@ namespace ptens{
     friend ostream& operator<<(ostream& stream, const Ptensors2& x){
       stream<<x.str(); return stream;}
 
+
+  private:
+
+    Registration registration{this}; // last data member, see PtensTracked
+
   };
 
 }
@@ -0,0 +1,749 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _ptens_Ptensors2sym
+#define _ptens_Ptensors2sym
+
+#include <numeric>
+
+#include "PtensMemory.hpp"
+#include "PtensParallel.hpp"
+#include "PtensScratch.hpp"
+#include "Hgraph.hpp"
+#include "Ptensors0.hpp"
+#include "Ptensors1.hpp"
+#include "Ptensors2.hpp"
+
+
+namespace ptens{
+
+
+  // Layer of second order Ptensors that are symmetric in their two atom indices, stored on the
+  // host. Only the entries (a,b) with a<=b are kept, row by row, so ptensor i occupies
+  // k(k+1)/2*nc consecutive entries instead of k*k*nc.
+  //
+  // The reductions and broadcasts work on the triangular layout directly. For a symmetric
+  // input the row and column sums coincide and each pair of broadcasts that are transposes of
+  // each other sums to a symmetric one, so the order 2 -> 2 linmaps have 9 rather than 15
+  // blocks of channels, and their output is again symmetric.
+  //
+  // The layer is a function of its stored entries, and gradients are taken with respect to
+  // those, so the *_back functions are the adjoints of the forward ones in the triangular
+  // layout. An off-diagonal entry stands for both (a,b) and (b,a) and gets the gradient of both.
+
+  class Ptensors2sym: public PtensTracked<Ptensors2sym,PtensMemoryTracker::FEATURES>{
+  public:
+
+    typedef cnine::RtensorPackB RtensorPackB;
+
+    int nc=0;
+    SharedAtomsPack atoms;
+    vector<size_t> offsets;
+    vector<float> arr;
+
+#ifdef WITH_FAKE_GRAD
+    Ptensors2sym* grad=nullptr;
+#endif
+
+
+    ~Ptensors2sym(){
+#ifdef WITH_FAKE_GRAD
+      if(grad) delete grad;
+#endif
+    }
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    Ptensors2sym(){}
+
+    Ptensors2sym(const AtomsPack& _atoms, const int _nc):
+      nc(_nc), atoms(_atoms){
+      make_offsets();
+      arr.resize(offsets.back(),0);
+    }
+
+    static Ptensors2sym zero(const AtomsPack& _atoms, const int _nc){
+      return Ptensors2sym(_atoms,_nc);
+    }
+
+
+  public: // ---- Copying ------------------------------------------------------------------------------------
+
+
+    // The gradient is not copied
+    Ptensors2sym(const Ptensors2sym& x):
+      nc(x.nc), atoms(x.atoms), offsets(x.offsets), arr(x.arr){}
+
+    Ptensors2sym(Ptensors2sym&& x):
+      nc(x.nc), atoms(std::move(x.atoms)), offsets(std::move(x.offsets)), arr(std::move(x.arr)){
+#ifdef WITH_FAKE_GRAD
+      grad=x.grad;
+      x.grad=nullptr;
+#endif
+    }
+
+    Ptensors2sym& operator=(const Ptensors2sym& x)=delete;
+
+
+  public: // ---- Conversions --------------------------------------------------------------------------------
+
+
+    // Entry (a,b) is the average of x(a,b) and x(b,a), i.e., x is projected onto the symmetric part
+    Ptensors2sym(const Ptensors2& x){
+      if(x.dev>0) from_full(Ptensors2(x,0));
+      else from_full(x);
+    }
+
+    Ptensors2 ptensors2() const{
+      Ptensors2 R=Ptensors2::raw(atoms,nc);
+      parallel_for(size(),[&](const int tid, const int i){
+	  const int k=k_of(i);
+	  float* dest=R.arr+R.dir(i,0);
+	  for(int a=0; a<k; a++)
+	    for(int b=a; b<k; b++){
+	      const float* src=entry(i,a,b);
+	      std::copy(src,src+nc,dest+(a*k+b)*nc);
+	      if(a!=b) std::copy(src,src+nc,dest+(b*k+a)*nc);
+	    }
+	});
+      return R;
+    }
+
+    // Backward of Ptensors2sym(x): this is the gradient of the result and r that of x
+    void add_symmetrize_back(Ptensors2& r) const{
+      PTENS_ASSRT(r.dev==0 && r.nc==nc && r.size()==size());
+      parallel_for(size(),[&](const int tid, const int i){
+	  const int k=k_of(i);
+	  float* dest=r.arr+r.dir(i,0);
+	  for(int a=0; a<k; a++)
+	    for(int b=a; b<k; b++){
+	      const float* g=entry(i,a,b);
+	      float* u=dest+(a*k+b)*nc;
+	      float* v=dest+(b*k+a)*nc;
+	      if(a==b) for(int c=0; c<nc; c++) u[c]+=g[c];
+	      else for(int c=0; c<nc; c++){u[c]+=g[c]/2; v[c]+=g[c]/2;}
+	    }
+	});
+    }
+
+    // Backward of ptensors2(): g is the gradient of the result
+    void add_ptensors2_back(const Ptensors2& g){
+      PTENS_ASSRT(g.dev==0 && g.nc==nc && g.size()==size());
+      parallel_for(size(),[&](const int tid, const int i){
+	  const int k=k_of(i);
+	  const float* src=g.arr+g.dir(i,0);
+	  for(int a=0; a<k; a++)
+	    for(int b=a; b<k; b++){
+	      float* t=entry(i,a,b);
+	      add_into(t,src+(a*k+b)*nc,nc);
+	      if(a!=b) add_into(t,src+(b*k+a)*nc,nc);
+	    }
+	});
+    }
+
+
+#ifdef WITH_FAKE_GRAD
+  public: // ---- Gradients ----------------------------------------------------------------------------------
+
+
+    bool has_grad() const{
+      return grad!=nullptr;
+    }
+
+    Ptensors2sym& get_grad(){
+      if(!grad){
+	grad=new Ptensors2sym(atoms,nc);
+	grad->set_memory_category(PtensMemoryTracker::GRADIENTS);
+      }
+      return *grad;
+    }
+
+    void add_to_grad(const Ptensors2sym& x){
+      get_grad().add(x);
+    }
+
+    void free_grad(){
+      delete grad;
+      grad=nullptr;
+    }
+#endif
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    int size() const{
+      return atoms.size();
+    }
+
+    int get_nc() const{
+      return nc;
+    }
+
+    int k_of(const int i) const{
+      return atoms.size_of(i);
+    }
+
+    size_t memory_bytes() const{
+      return arr.size()*sizeof(float)+offsets.size()*sizeof(size_t);
+    }
+
+    // Position of (a,b), a<=b, among the stored entries of a ptensor of size k
+    static int tri(const int k, const int a, const int b){
+      return a*(2*k-a+1)/2+b-a;
+    }
+
+    float operator()(const int i, const int a, const int b, const int c) const{
+      PTENS_ASSRT(i<size() && a<k_of(i) && b<k_of(i) && c<nc);
+      return a<=b? entry(i,a,b)[c] : entry(i,b,a)[c];
+    }
+
+
+  public: // ---- Operations ---------------------------------------------------------------------------------
+
+
+    void add(const Ptensors2sym& x){
+      PTENS_ASSRT(x.arr.size()==arr.size());
+      for(size_t j=0; j<arr.size(); j++)
+	arr[j]+=x.arr[j];
+    }
+
+    // Inner product of the stored entries
+    float inp(const Ptensors2sym& x) const{
+      PTENS_ASSRT(x.arr.size()==arr.size());
+      float t=0;
+      for(size_t j=0; j<arr.size(); j++)
+	t+=arr[j]*x.arr[j];
+      return t;
+    }
+
+
+  public: // ---- Broadcasting -------------------------------------------------------------------------------
+
+
+    // Channels offs,...,offs+n-1 get x everywhere and channels offs+n,...,offs+2n-1 get x on
+    // the diagonal, where n=x.nc
+    void broadcast0(const RtensorPackB& x, const int offs){
+      TimedFn T("Ptensors2sym","brcast0",*this);
+      PTENS_ASSRT(x.dev==0);
+      PTENS_ASSRT(offs+2*x.nc<=nc);
+      parallel_for(size(),[&](const int tid, const int i){
+	  const vector<int> ix=all(i);
+	  broadcast0_one(x.arr+x.dir(i,0),x.nc,i,ix.data(),ix.size(),offs);
+	});
+    }
+
+    // Channels offs,...,offs+n-1 get x(a)+x(b) at (a,b) and channels offs+n,...,offs+2n-1 get
+    // x(a) on the diagonal. These are the symmetric combinations of the three broadcasts of
+    // Ptensors2::broadcast1.
+    void broadcast1(const RtensorPackB& x, const int offs){
+      TimedFn T("Ptensors2sym","brcast1",*this);
+      PTENS_ASSRT(x.dev==0);
+      PTENS_ASSRT(offs+2*x.nc<=nc);
+      parallel_for(size(),[&](const int tid, const int i){
+	  const vector<int> ix=all(i);
+	  broadcast1_one(x.arr+x.dir(i,0),x.nc,i,ix.data(),ix.size(),offs);
+	});
+    }
+
+    // Channels offs,...,offs+n-1 get x
+    void broadcast2(const Ptensors2sym& x, const int offs){
+      TimedFn T("Ptensors2sym","brcast2",*this);
+      const int n=x.nc;
+      PTENS_ASSRT(x.size()==size());
+      PTENS_ASSRT(offs+n<=nc);
+      parallel_for(size(),[&](const int tid, const int i){
+	  const int m=k_of(i)*(k_of(i)+1)/2;
+	  const float* src=x.entry(i,0,0);
+	  float* dest=entry(i,0,0)+offs;
+	  for(int j=0; j<m; j++)
+	    add_into(dest+j*nc,src+j*n,n);
+	});
+    }
+
+    Ptensors0 broadcast0_back(const int offs, const int n) const{
+      TimedFn T("Ptensors2sym","brcast0_back",*this);
+      PTENS_ASSRT(offs+2*n<=nc);
+      Ptensors0 R=Ptensors0::raw(atoms,n);
+      parallel_for(size(),[&](const int tid, const int i){
+	  const vector<int> ix=all(i);
+	  broadcast0_back_one(R.arr+R.dir(i,0),n,i,ix.data(),ix.size(),offs);
+	});
+      return R;
+    }
+
+    Ptensors1 broadcast1_back(const int offs, const int n) const{
+      TimedFn T("Ptensors2sym","brcast1_back",*this);
+      PTENS_ASSRT(offs+2*n<=nc);
+      Ptensors1 R=Ptensors1::raw(atoms,n);
+      parallel_for(size(),[&](const int tid, const int i){
+	  const vector<int> ix=all(i);
+	  broadcast1_back_one(R.arr+R.dir(i,0),n,i,ix.data(),ix.size(),offs);
+	});
+      return R;
+    }
+
+    Ptensors2sym broadcast2_back(const int offs, const int n) const{
+      TimedFn T("Ptensors2sym","brcast2_back",*this);
+      PTENS_ASSRT(offs+n<=nc);
+      Ptensors2sym R(atoms,n);
+      parallel_for(size(),[&](const int tid, const int i){
+	  const int m=k_of(i)*(k_of(i)+1)/2;
+	  const float* src=entry(i,0,0)+offs;
+	  float* dest=R.entry(i,0,0);
+	  for(int j=0; j<m; j++)
+	    std::copy(src+j*nc,src+j*nc+n,dest+j*n);
+	});
+      return R;
+    }
+
+
+  public: // ---- Indexed reductions -------------------------------------------------------------------------
+
+
+    // The sum of the list.ix(i) x list.ix(i) block of ptensor list.tens(i) (nc) followed by
+    // its trace (nc)
+    RtensorPackB reduce0(const AindexPack& list, const bool normalized=false) const{
+      TimedFn T("Ptensors2sym","reduce0",*this,list,(list.count1+list.count2)*nc);
+      RtensorPackB R=list.scratch_pack(0,2*nc);
+      parallel_for(list.size(),[&](const int tid, const int i){
+	  const vector<int> ix=list.ix(i);
+	  reduce0_into(R.arr+R.dir(i,0),list.tens(i),ix.data(),ix.size(),normalized);
+	});
+      return R;
+    }
+
+    // For each row of the block, its sum (nc) followed by its diagonal entry (nc)
+    RtensorPackB reduce1(const AindexPack& list, const bool normalized=false) const{
+      TimedFn T("Ptensors2sym","reduce1",*this,list,(list.count1+list.count2)*nc);
+      RtensorPackB R=list.scratch_pack(1,2*nc);
+      parallel_for(list.size(),[&](const int tid, const int i){
+	  const vector<int> ix=list.ix(i);
+	  reduce1_into(R.arr+R.dir(i,0),list.tens(i),ix.data(),ix.size(),normalized);
+	});
+      return R;
+    }
+
+    // Entries of list may share a target, so the backward functions run serially
+    void reduce0_back(const RtensorPackB& x, const AindexPack& list, const bool normalized=false){
+      TimedFn T("Ptensors2sym","reduce0_back",*this,x,list,(list.count1+list.count2)*nc);
+      PTENS_ASSRT(x.dev==0 && x.nc==2*nc);
+      for(int i=0; i<list.size(); i++){
+	const vector<int> ix=list.ix(i);
+	reduce0_back_one(x.arr+x.dir(i,0),list.tens(i),ix.data(),ix.size(),normalized);
+      }
+    }
+
+    void reduce1_back(const RtensorPackB& x, const AindexPack& list, const bool normalized=false){
+      TimedFn T("Ptensors2sym","reduce1_back",*this,x,list,(list.count1+list.count2)*nc);
+      PTENS_ASSRT(x.dev==0 && x.nc==2*nc);
+      for(int i=0; i<list.size(); i++){
+	const vector<int> ix=list.ix(i);
+	reduce1_back_one(x.arr+x.dir(i,0),list.tens(i),ix.data(),ix.size(),normalized);
+      }
+    }
+
+
+  public: // ---- Indexed broadcasting -----------------------------------------------------------------------
+
+
+    void broadcast0(const RtensorPackB& x, const AindexPack& list, const int offs){
+      TimedFn T("Ptensors2sym","brcast0",*this,x,list,(list.count1+list.count2)*x.nc);
+      PTENS_ASSRT(x.dev==0);
+      PTENS_ASSRT(offs+2*x.nc<=nc);
+      for(int i=0; i<list.size(); i++){
+	const vector<int> ix=list.ix(i);
+	broadcast0_one(x.arr+x.dir(i,0),x.nc,list.tens(i),ix.data(),ix.size(),offs);
+      }
+    }
+
+    void broadcast1(const RtensorPackB& x, const AindexPack& list, const int offs){
+      TimedFn T("Ptensors2sym","brcast1",*this,x,list,(list.count1+list.count2)*x.nc);
+      PTENS_ASSRT(x.dev==0);
+      PTENS_ASSRT(offs+2*x.nc<=nc);
+      for(int i=0; i<list.size(); i++){
+	const vector<int> ix=list.ix(i);
+	broadcast1_one(x.arr+x.dir(i,0),x.nc,list.tens(i),ix.data(),ix.size(),offs);
+      }
+    }
+
+    RtensorPackB broadcast0_back(const AindexPack& list, const int offs, const int n) const{
+      TimedFn T("Ptensors2sym","brcast0_back",*this,list,(list.count1+list.count2)*n);
+      PTENS_ASSRT(offs+2*n<=nc);
+      RtensorPackB R=list.scratch_pack(0,n);
+      parallel_for(list.size(),[&](const int tid, const int i){
+	  const vector<int> ix=list.ix(i);
+	  broadcast0_back_one(R.arr+R.dir(i,0),n,list.tens(i),ix.data(),ix.size(),offs);
+	});
+      return R;
+    }
+
+    RtensorPackB broadcast1_back(const AindexPack& list, const int offs, const int n) const{
+      TimedFn T("Ptensors2sym","brcast1_back",*this,list,(list.count1+list.count2)*n);
+      PTENS_ASSRT(offs+2*n<=nc);
+      RtensorPackB R=list.scratch_pack(1,n);
+      parallel_for(list.size(),[&](const int tid, const int i){
+	  const vector<int> ix=list.ix(i);
+	  broadcast1_back_one(R.arr+R.dir(i,0),n,list.tens(i),ix.data(),ix.size(),offs);
+	});
+      return R;
+    }
+
+
+  public: // ---- Linmaps ------------------------------------------------------------------------------------
+
+
+    // Same as ptens::linmaps0(ptensors2()): the sum of all entries followed by the trace
+    Ptensors0 linmaps0(const bool normalized=false) const{
+      TimedFn T("Ptensors2sym","linmaps0",*this);
+      Ptensors0 R=Ptensors0::raw(atoms,2*nc);
+      parallel_for(size(),[&](const int tid, const int i){
+	  const vector<int> ix=all(i);
+	  reduce0_into(R.arr+R.dir(i,0),i,ix.data(),ix.size(),normalized);
+	});
+      return R;
+    }
+
+    // Same as ptens::linmaps1(ptensors2()). The column and row sums blocks are equal.
+    Ptensors1 linmaps1(const bool normalized=false) const{
+      TimedFn T("Ptensors2sym","linmaps1",*this);
+      Ptensors1 R=Ptensors1::raw(atoms,5*nc);
+      parallel_for(size(),[&](const int tid, const int i){
+	  const int k=k_of(i);
+	  const vector<int> ix=all(i);
+	  float* dest=R.arr+R.dir(i,0);
+	  vector<float> r0(2*nc);
+	  vector<float> r1(2*k*nc);
+	  reduce0_into(r0.data(),i,ix.data(),k,normalized);
+	  reduce1_into(r1.data(),i,ix.data(),k,normalized);
+	  for(int a=0; a<k; a++){
+	    float* t=dest+a*5*nc;
+	    const float* s=r1.data()+a*2*nc;
+	    std::copy(r0.begin(),r0.end(),t);
+	    std::copy(s,s+nc,t+2*nc);
+	    std::copy(s,s+2*nc,t+3*nc);
+	  }
+	});
+      return R;
+    }
+
+    // Symmetric part of the 2 -> 2 linmaps, with 9*nc channels: the sum and the trace broadcast
+    // everywhere (2nc) and on the diagonal (2nc), the row sums and the diagonal broadcast as
+    // x(a)+x(b) (2nc) and on the diagonal (2nc), and finally x itself (nc).
+    Ptensors2sym linmaps2(const bool normalized=false) const{
+      TimedFn T("Ptensors2sym","linmaps2",*this);
+      Ptensors2sym R(atoms,9*nc);
+      const int n=nc;
+      parallel_for(size(),[&](const int tid, const int i){
+	  const int k=k_of(i);
+	  const vector<int> ix=all(i);
+	  vector<float> r0(2*n);
+	  vector<float> r1(2*k*n);
+	  reduce0_into(r0.data(),i,ix.data(),k,normalized);
+	  reduce1_into(r1.data(),i,ix.data(),k,normalized);
+	  for(int a=0; a<k; a++)
+	    for(int b=a; b<k; b++){
+	      float* t=R.entry(i,a,b);
+	      const float* ra=r1.data()+a*2*n;
+	      const float* rb=r1.data()+b*2*n;
+	      std::copy(r0.begin(),r0.end(),t);
+	      if(a==b) std::copy(r0.begin(),r0.end(),t+2*n);
+	      for(int c=0; c<2*n; c++) t[4*n+c]=ra[c]+rb[c];
+	      if(a==b) std::copy(ra,ra+2*n,t+6*n);
+	      const float* src=entry(i,a,b);
+	      std::copy(src,src+n,t+8*n);
+	    }
+	});
+      return R;
+    }
+
+    // Backward of linmaps0: g is the gradient of the result
+    void add_linmaps0_back(const Ptensors0& g, const bool normalized=false){
+      TimedFn T("Ptensors2sym","linmaps0_back",*this);
+      PTENS_ASSRT(g.dev==0 && g.nc==2*nc && g.size()==size());
+      parallel_for(size(),[&](const int tid, const int i){
+	  const vector<int> ix=all(i);
+	  reduce0_back_one(g.arr+g.dir(i,0),i,ix.data(),ix.size(),normalized);
+	});
+    }
+
+    void add_linmaps1_back(const Ptensors1& g, const bool normalized=false){
+      TimedFn T("Ptensors2sym","linmaps1_back",*this);
+      PTENS_ASSRT(g.dev==0 && g.nc==5*nc && g.size()==size());
+      parallel_for(size(),[&](const int tid, const int i){
+	  const int k=k_of(i);
+	  const vector<int> ix=all(i);
+	  const float* src=g.arr+g.dir(i,0);
+	  vector<float> g0(2*nc,0);
+	  vector<float> g1(2*k*nc);
+	  for(int a=0; a<k; a++){
+	    const float* s=src+a*5*nc;
+	    float* t=g1.data()+a*2*nc;
+	    add_into(g0.data(),s,2*nc);
+	    for(int c=0; c<nc; c++) t[c]=s[2*nc+c]+s[3*nc+c];
+	    std::copy(s+4*nc,s+5*nc,t+nc);
+	  }
+	  reduce0_back_one(g0.data(),i,ix.data(),k,normalized);
+	  reduce1_back_one(g1.data(),i,ix.data(),k,normalized);
+	});
+    }
+
+    void add_linmaps2_back(const Ptensors2sym& g, const bool normalized=false){
+      TimedFn T("Ptensors2sym","linmaps2_back",*this);
+      PTENS_ASSRT(g.nc==9*nc && g.size()==size());
+      const int n=nc;
+      parallel_for(size(),[&](const int tid, const int i){
+	  const int k=k_of(i);
+	  const vector<int> ix=all(i);
+	  vector<float> g0(2*n,0);
+	  vector<float> g1(2*k*n,0);
+	  for(int a=0; a<k; a++)
+	    for(int b=a; b<k; b++){
+	      const float* s=g.entry(i,a,b);
+	      add_into(g0.data(),s,2*n);
+	      if(a==b) add_into(g0.data(),s+2*n,2*n);
+	      add_into(g1.data()+a*2*n,s+4*n,2*n);
+	      add_into(g1.data()+b*2*n,s+4*n,2*n);
+	      if(a==b) add_into(g1.data()+a*2*n,s+6*n,2*n);
+	      add_into(entry(i,a,b),s+8*n,n);
+	    }
+	  reduce0_back_one(g0.data(),i,ix.data(),k,normalized);
+	  reduce1_back_one(g1.data(),i,ix.data(),k,normalized);
+	});
+    }
+
+
+  private:
+
+    const float* entry(const int i, const int a, const int b) const{
+      return arr.data()+offsets[i]+(size_t)tri(k_of(i),a,b)*nc;
+    }
+
+    float* entry(const int i, const int a, const int b){
+      return arr.data()+offsets[i]+(size_t)tri(k_of(i),a,b)*nc;
+    }
+
+    // Entry (p,q) of ptensor i in either order
+    const float* at(const int i, const int p, const int q) const{
+      return p<=q? entry(i,p,q) : entry(i,q,p);
+    }
+
+    float* at(const int i, const int p, const int q){
+      return p<=q? entry(i,p,q) : entry(i,q,p);
+    }
+
+    vector<int> all(const int i) const{
+      vector<int> R(k_of(i));
+      std::iota(R.begin(),R.end(),0);
+      return R;
+    }
+
+    static void add_into(float* dest, const float* src, const int n){
+      for(int c=0; c<n; c++) dest[c]+=src[c];
+    }
+
+    void make_offsets(){
+      int n=atoms.size();
+      offsets.resize(n+1);
+      offsets[0]=0;
+      for(int i=0; i<n; i++){
+	size_t m=atoms.size_of(i);
+	offsets[i+1]=offsets[i]+m*(m+1)/2*nc;
+      }
+    }
+
+    void from_full(const Ptensors2& x){
+      nc=x.nc;
+      atoms=x.atoms;
+      make_offsets();
+      arr.resize(offsets.back());
+      parallel_for(size(),[&](const int tid, const int i){
+	  const int k=k_of(i);
+	  const float* src=x.arr+x.dir(i,0);
+	  for(int a=0; a<k; a++)
+	    for(int b=a; b<k; b++){
+	      float* t=entry(i,a,b);
+	      const float* u=src+(a*k+b)*nc;
+	      const float* v=src+(b*k+a)*nc;
+	      for(int c=0; c<nc; c++) t[c]=(u[c]+v[c])/2;
+	    }
+	});
+    }
+
+    // The kernels below act on the ix[0],...,ix[m-1] block of ptensor i. The linmaps pass all
+    // of its indices, the indexed reductions and broadcasts those of one entry of the list.
+
+    // The sum of all entries (nc) followed by the trace (nc). Off-diagonal entries count twice.
+    void reduce0_into(float* r, const int i, const int* ix, const int m, const bool normalized) const{
+      std::fill(r,r+2*nc,0);
+      for(int a=0; a<m; a++)
+	for(int b=a; b<m; b++){
+	  const float* src=at(i,ix[a],ix[b]);
+	  if(a==b) for(int c=0; c<nc; c++){r[c]+=src[c]; r[nc+c]+=src[c];}
+	  else for(int c=0; c<nc; c++) r[c]+=2*src[c];
+	}
+      if(normalized && m>0){
+	for(int c=0; c<nc; c++) r[c]/=m*m;
+	for(int c=0; c<nc; c++) r[nc+c]/=m;
+      }
+    }
+
+    // For each row a, the row sum (nc) followed by the diagonal entry (nc)
+    void reduce1_into(float* r, const int i, const int* ix, const int m, const bool normalized) const{
+      std::fill(r,r+2*m*nc,0);
+      for(int a=0; a<m; a++)
+	for(int b=a; b<m; b++){
+	  const float* src=at(i,ix[a],ix[b]);
+	  float* ra=r+a*2*nc;
+	  float* rb=r+b*2*nc;
+	  add_into(ra,src,nc);
+	  if(a==b) std::copy(src,src+nc,ra+nc);
+	  else add_into(rb,src,nc);
+	}
+      if(normalized && m>0)
+	for(int a=0; a<m; a++)
+	  for(int c=0; c<nc; c++) r[a*2*nc+c]/=m;
+    }
+
+    void reduce0_back_one(const float* g, const int i, const int* ix, const int m, const bool normalized){
+      const float s0=(normalized && m>0)? 1.0/(m*m) : 1.0;
+      const float s1=(normalized && m>0)? 1.0/m : 1.0;
+      for(int a=0; a<m; a++)
+	for(int b=a; b<m; b++){
+	  float* t=at(i,ix[a],ix[b]);
+	  if(a==b) for(int c=0; c<nc; c++) t[c]+=s0*g[c]+s1*g[nc+c];
+	  else for(int c=0; c<nc; c++) t[c]+=2*s0*g[c];
+	}
+    }
+
+    void reduce1_back_one(const float* g, const int i, const int* ix, const int m, const bool normalized){
+      const float s=(normalized && m>0)? 1.0/m : 1.0;
+      for(int a=0; a<m; a++)
+	for(int b=a; b<m; b++){
+	  float* t=at(i,ix[a],ix[b]);
+	  const float* ga=g+a*2*nc;
+	  const float* gb=g+b*2*nc;
+	  if(a==b) for(int c=0; c<nc; c++) t[c]+=s*ga[c]+ga[nc+c];
+	  else for(int c=0; c<nc; c++) t[c]+=s*(ga[c]+gb[c]);
+	}
+    }
+
+    void broadcast0_one(const float* x, const int n, const int i, const int* ix, const int m, const int offs){
+      for(int a=0; a<m; a++)
+	for(int b=a; b<m; b++){
+	  float* t=at(i,ix[a],ix[b])+offs;
+	  add_into(t,x,n);
+	  if(a==b) add_into(t+n,x,n);
+	}
+    }
+
+    void broadcast1_one(const float* x, const int n, const int i, const int* ix, const int m, const int offs){
+      for(int a=0; a<m; a++)
+	for(int b=a; b<m; b++){
+	  float* t=at(i,ix[a],ix[b])+offs;
+	  const float* xa=x+a*n;
+	  const float* xb=x+b*n;
+	  for(int c=0; c<n; c++) t[c]+=xa[c]+xb[c];
+	  if(a==b) add_into(t+n,xa,n);
+	}
+    }
+
+    void broadcast0_back_one(float* r, const int n, const int i, const int* ix, const int m, const int offs) const{
+      std::fill(r,r+n,0);
+      for(int a=0; a<m; a++)
+	for(int b=a; b<m; b++){
+	  const float* t=at(i,ix[a],ix[b])+offs;
+	  add_into(r,t,n);
+	  if(a==b) add_into(r,t+n,n);
+	}
+    }
+
+    void broadcast1_back_one(float* r, const int n, const int i, const int* ix, const int m, const int offs) const{
+      std::fill(r,r+m*n,0);
+      for(int a=0; a<m; a++)
+	for(int b=a; b<m; b++){
+	  const float* t=at(i,ix[a],ix[b])+offs;
+	  add_into(r+a*n,t,n);
+	  add_into(r+b*n,t,n);
+	  if(a==b) add_into(r+a*n,t+n,n);
+	}
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "Ptensors2sym";
+    }
+
+    string repr() const{
+      return "<Ptensors2sym[N="+to_string(size())+",nc="+to_string(nc)+"]>";
+    }
+
+    string str(const string indent="") const{
+      return ptensors2().str(indent);
+    }
+
+    friend ostream& operator<<(ostream& stream, const Ptensors2sym& x){
+      stream<<x.str(); return stream;}
+
+
+  private:
+
+    Registration registration{this}; // last data member, see PtensTracked
+
+  };
+
+
+  // ---- Message passing ------------------------------------------------------------------------------------
+
+
+  // Messages from a symmetric layer: the order 0 and order 1 reductions of the overlaps, which
+  // make 2*nc channels for a Ptensors0 target and 4*nc channels for a Ptensors1 target.
+
+  inline void add_msg(Ptensors0& r, const Ptensors2sym& x, const Hgraph& G, const bool normalized=false){
+    if(G.is_empty()) return;
+    PtensScratch::Scope scope;
+    auto indices=G.intersects(x.atoms,r.atoms);
+    r.broadcast0(x.reduce0(indices.first,normalized),indices.second,0);
+  }
+
+  inline void add_msg(Ptensors1& r, const Ptensors2sym& x, const Hgraph& G, const bool normalized=false){
+    if(G.is_empty()) return;
+    PtensScratch::Scope scope;
+    auto indices=G.intersects(x.atoms,r.atoms);
+    r.broadcast0(x.reduce0(indices.first,normalized),indices.second,0);
+    r.broadcast1(x.reduce1(indices.first,normalized),indices.second,2*x.nc);
+  }
+
+  inline void add_msg_back(Ptensors2sym& r, const Ptensors0& x, const Hgraph& G, const bool normalized=false){
+    if(G.is_empty()) return;
+    PtensScratch::Scope scope;
+    auto indices=G.intersects(x.atoms,r.atoms);
+    r.reduce0_back(x.broadcast0_back(indices.first,0,2*r.nc),indices.second,normalized);
+  }
+
+  inline void add_msg_back(Ptensors2sym& r, const Ptensors1& x, const Hgraph& G, const bool normalized=false){
+    if(G.is_empty()) return;
+    PtensScratch::Scope scope;
+    auto indices=G.intersects(x.atoms,r.atoms);
+    r.reduce0_back(x.broadcast0_back(indices.first,0,2*r.nc),indices.second,normalized);
+    r.reduce1_back(x.broadcast1_back(indices.first,2*r.nc,2*r.nc),indices.second,normalized);
+  }
+
+}
+
+#endif
@@ -0,0 +1,598 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+
+#ifndef _ptens_PtensorsH
+#define _ptens_PtensorsH
+
+#include "PtensHalf.hpp"
+#include "PtensMemory.hpp"
+#include "Ptensors0.hpp"
+#include "Ptensors1.hpp"
+#include "Ptensors2.hpp"
+#include "Hgraph.hpp"
+#include "PtensScratch.hpp"
+#include "PtensParallel.hpp"
+#include "LinmapLayers.hpp"
+
+
+namespace ptens{
+
+
+  // Layer of order k Ptensors stored in a 16 bit format (bfloat16 or float16) on the host.
+  // The layout is the same as that of the float layers: ptensor i occupies size_of(i)^k*nc
+  // consecutive entries, one after the other.
+  //
+  // Reductions, broadcasts, linmaps and message passing read the 16 bit entries directly and
+  // accumulate in float: the messages only live in per thread float buffers, and each output
+  // ptensor is rounded once, after all its contributions have been added. Other operations go
+  // through apply, which widens the layer chunk by chunk. The layers are host only and do not
+  // take part in autograd, so they are meant for inference.
+
+  template<typename TYPE>
+  class PtensorsH: public PtensTracked<PtensorsH<TYPE>,PtensMemoryTracker::FEATURES>{
+  public:
+
+    typedef cnine::RtensorPackB RtensorPackB;
+
+    int k=0;
+    int nc=0;
+    SharedAtomsPack atoms;
+    vector<size_t> offs;
+    vector<TYPE> arr;
+
+    static const size_t default_chunk=1<<20;
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    PtensorsH(){}
+
+    PtensorsH(const int _k, const AtomsPack& _atoms, const int _nc):
+      k(_k), nc(_nc), atoms(_atoms){
+      PTENS_ASSRT(k>=0 && k<=2);
+      make_offsets();
+      arr.resize(offs.back());
+    }
+
+    static PtensorsH zero(const int _k, const AtomsPack& _atoms, const int _nc){
+      return PtensorsH(_k,_atoms,_nc);
+    }
+
+
+  public: // ---- Conversions --------------------------------------------------------------------------------
+
+
+    PtensorsH(const Ptensors0& x){
+      from_float(0,x);
+    }
+
+    PtensorsH(const Ptensors1& x){
+      from_float(1,x);
+    }
+
+    PtensorsH(const Ptensors2& x){
+      from_float(2,x);
+    }
+
+    Ptensors0 ptensors0() const{
+      PTENS_ASSRT(k==0);
+      Ptensors0 R=Ptensors0::raw(atoms,nc);
+      to_float(R,0,size());
+      return R;
+    }
+
+    Ptensors1 ptensors1() const{
+      PTENS_ASSRT(k==1);
+      Ptensors1 R=Ptensors1::raw(atoms,nc);
+      to_float(R,0,size());
+      return R;
+    }
+
+    Ptensors2 ptensors2() const{
+      PTENS_ASSRT(k==2);
+      Ptensors2 R=Ptensors2::raw(atoms,nc);
+      to_float(R,0,size());
+      return R;
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    int size() const{
+      return atoms.size();
+    }
+
+    int getk() const{
+      return k;
+    }
+
+    int get_nc() const{
+      return nc;
+    }
+
+    size_t memory_bytes() const{
+      return arr.size()*sizeof(TYPE)+offs.size()*sizeof(size_t);
+    }
+
+    float operator()(const int i, const int j) const{
+      PTENS_ASSRT(i<size() && j<offs[i+1]-offs[i]);
+      return arr[offs[i]+j];
+    }
+
+
+  public: // ---- Reductions ---------------------------------------------------------------------------------
+
+
+    // The result has the same layout as the corresponding reduction of the float layer. The
+    // 16 bit entries are read directly and the sums are accumulated in float.
+
+    RtensorPackB reduce0(const bool normalized=false) const{
+      return reduce(SelfIndices(atoms),0,normalized);
+    }
+
+    RtensorPackB reduce1(const bool normalized=false) const{
+      return reduce(SelfIndices(atoms),1,normalized);
+    }
+
+    RtensorPackB reduce2() const{
+      return reduce(SelfIndices(atoms),2,false);
+    }
+
+    RtensorPackB reduce0(const AindexPack& list, const bool normalized=false) const{
+      return reduce(ListIndices(list),0,normalized);
+    }
+
+    RtensorPackB reduce1(const AindexPack& list, const bool normalized=false) const{
+      return reduce(ListIndices(list),1,normalized);
+    }
+
+    RtensorPackB reduce2(const AindexPack& list) const{
+      return reduce(ListIndices(list),2,false);
+    }
+
+
+  public: // ---- Broadcasting -------------------------------------------------------------------------------
+
+
+    // Each target ptensor is widened once, all the messages in the list addressed to it are added
+    // to it in float, and it is rounded back once.
+
+    void broadcast0(const RtensorPackB& x, const AindexPack& list, const int _offs=0){
+      PTENS_ASSRT(x.dev==0);
+      const int n=x.nc;
+      PTENS_ASSRT(_offs+(k==2? 2*n : n)<=nc);
+      broadcast_all(ListIndices(list),[&](const int i, Work& W, const float*& M0, const float*& M1, const float*& M2){
+	  M0=x.arr+x.dir(i,0);},n,_offs,0,0,0,0,false);
+    }
+
+    void broadcast1(const RtensorPackB& x, const AindexPack& list, const int _offs=0){
+      PTENS_ASSRT(x.dev==0);
+      PTENS_ASSRT(k>=1);
+      const int n=x.nc;
+      PTENS_ASSRT(_offs+(k==2? 3*n : n)<=nc);
+      broadcast_all(ListIndices(list),[&](const int i, Work& W, const float*& M0, const float*& M1, const float*& M2){
+	  M1=x.arr+x.dir(i,0);},0,0,n,_offs,0,0,false);
+    }
+
+    void broadcast2(const RtensorPackB& x, const AindexPack& list, const int _offs=0){
+      PTENS_ASSRT(x.dev==0);
+      PTENS_ASSRT(k==2);
+      const int n=x.nc;
+      PTENS_ASSRT(_offs+2*n<=nc);
+      broadcast_all(ListIndices(list),[&](const int i, Work& W, const float*& M0, const float*& M1, const float*& M2){
+	  M2=x.arr+x.dir(i,0);},0,0,0,0,n,_offs,false);
+    }
+
+
+  public: // ---- Operations ---------------------------------------------------------------------------------
+
+
+    // Linmaps and message passing fuse the reductions and broadcasts: the messages only exist
+    // in per thread float buffers, so the layers themselves are only read and written in 16 bits.
+
+    PtensorsH linmaps0(const bool normalized=false) const{
+      return linmaps(0,normalized);
+    }
+
+    PtensorsH linmaps1(const bool normalized=false) const{
+      return linmaps(1,normalized);
+    }
+
+    PtensorsH linmaps2(const bool normalized=false) const{
+      return linmaps(2,normalized);
+    }
+
+    // Same as add_msg (or add_msg_n if normalized) between the float layers
+    void add_msg(const PtensorsH& x, const Hgraph& G, const int _offs=0, const bool normalized=false){
+      if(G.is_empty()) return;
+      PtensScratch::Scope scope;
+      auto indices=G.intersects(x.atoms,atoms);
+      add_msgs(x,ListIndices(indices.first),ListIndices(indices.second),_offs,normalized,false);
+    }
+
+    PtensorsH unite1(const Hgraph& G, const bool normalized=false) const{
+      PtensorsH R(1,G.merge(atoms),out_width(1));
+      R.add_msg(*this,G,0,normalized);
+      return R;
+    }
+
+    PtensorsH unite2(const Hgraph& G, const bool normalized=false) const{
+      PtensorsH R(2,G.merge(atoms),out_width(2));
+      R.add_msg(*this,G,0,normalized);
+      return R;
+    }
+
+    // Apply a function mapping float layers of order k to float layers, chunk by chunk. This is
+    // the fallback for operations without a 16 bit kernel: each chunk is widened into a float
+    // layer and the result is rounded back. The function must act on each ptensor independently.
+    // An empty layer is passed through fn once as an empty chunk, to find the order and number of
+    // channels of the result.
+    template<typename XPACK, typename FN>
+    PtensorsH apply(const FN& fn, const size_t chunk=default_chunk) const{
+      PtensorsH R;
+      R.atoms=atoms;
+      int n=size();
+      int i0=0;
+      do{
+	int i1=std::min(i0+1,n);
+	while(i1<n && offs[i1+1]-offs[i0]<=chunk) i1++;
+	AtomsPack a;
+	for(int i=i0; i<i1; i++)
+	  a.push_back(atoms(i));
+	XPACK X=XPACK::raw(a,nc);
+	to_float(X,i0,i1);
+	auto Y=fn(X);
+	if(i0==0){
+	  R.k=order_of(Y);
+	  R.nc=Y.nc;
+	  R.make_offsets();
+	  R.arr.resize(R.offs.back());
+	}
+	R.from_float_range(Y,i0,i1);
+	i0=i1;
+      }while(i0<n);
+      return R;
+    }
+
+
+  private: // ---- Kernels -----------------------------------------------------------------------------------
+
+
+    // Per thread buffers
+    struct Work{
+      vector<float> tgt;
+      vector<float> m0;
+      vector<float> m1;
+      vector<float> m2;
+      vector<float> row;
+      vector<int> ix;
+      vector<int> ox;
+    };
+
+    // Entry i is the whole of ptensor i
+    struct SelfIndices{
+      const AtomsPack& atoms;
+      SelfIndices(const AtomsPack& _atoms): atoms(_atoms){}
+      int size() const{return atoms.size();}
+      int tix(const int i) const{return i;}
+      int nix(const int i) const{return atoms.size_of(i);}
+      void load(const int i, vector<int>& ix) const{
+	ix.resize(nix(i));
+	for(int j=0; j<ix.size(); j++) ix[j]=j;
+      }
+    };
+
+    struct ListIndices{
+      const AindexPack& list;
+      ListIndices(const AindexPack& _list): list(_list){}
+      int size() const{return list.size();}
+      int tix(const int i) const{return list.tix(i);}
+      int nix(const int i) const{return list.nix(i);}
+      void load(const int i, vector<int>& ix) const{
+	ix.resize(nix(i));
+	for(int j=0; j<ix.size(); j++) ix[j]=list.ix(i,j+1);
+      }
+    };
+
+    // Number of channels of the order 0, 1 or 2 reduction of this layer
+    int msg_width(const int order) const{
+      if(order==2) return nc;
+      if(k==2) return order==0? 2*nc : 3*nc;
+      return nc;
+    }
+
+    // Number of channels of the linmaps of this layer to order _k, and of its messages to a layer of order _k
+    int out_width(const int _k) const{
+      int n0=msg_width(0);
+      int n1=(k>0 && _k>0)? msg_width(1) : 0;
+      int n2=(k==2 && _k==2)? nc : 0;
+      if(_k==0) return n0;
+      if(_k==1) return n0+n1;
+      return 2*n0+3*n1+2*n2;
+    }
+
+    PtensorsH linmaps(const int _k, const bool normalized) const{
+      PtensorsH R(_k,atoms,out_width(_k));
+      R.add_msgs(*this,SelfIndices(atoms),SelfIndices(atoms),0,normalized,true);
+      return R;
+    }
+
+    template<typename IN>
+    RtensorPackB reduce(const IN& in, const int order, const bool normalized) const{
+      PTENS_ASSRT(order<=k);
+      int N=in.size();
+      int w=msg_width(order);
+      cnine::array_pool<int> dims;
+      for(int i=0; i<N; i++){
+	int m=in.nix(i);
+	if(order==0) dims.push_back(vector<int>({w}));
+	if(order==1) dims.push_back(vector<int>({m,w}));
+	if(order==2) dims.push_back(vector<int>({m,m,w}));
+      }
+      RtensorPackB R(dims,cnine::fill_zero(),0);
+      vector<Work> work(parallel_nthreads(N));
+      parallel_for(N,[&](const int tid, const int i){
+	  Work& W=work[tid];
+	  in.load(i,W.ix);
+	  W.row.resize(nc);
+	  float* M=R.arr+R.dir(i,0);
+	  reduce_one(in.tix(i),W.ix.data(),W.ix.size(),order==0? M : nullptr,order==1? M : nullptr,order==2? M : nullptr,normalized,W.row.data());
+	});
+      return R;
+    }
+
+    // Messages from the entries of in to the matching entries of out, at channel offset _offs. In
+    // assign mode the targets start from zero rather than from their current value.
+    template<typename IN, typename OUT>
+    void add_msgs(const PtensorsH& x, const IN& in, const OUT& out, const int _offs, const bool normalized, const bool assign){
+      PTENS_ASSRT(in.size()==out.size());
+      PTENS_ASSRT(_offs+x.out_width(k)<=nc);
+      const int n0=x.msg_width(0);
+      const int n1=(x.k>0 && k>0)? x.msg_width(1) : 0;
+      const int n2=(x.k==2 && k==2)? x.nc : 0;
+      const int o1=_offs+(k==2? 2*n0 : n0);
+      const int o2=o1+3*n1;
+      broadcast_all(out,[&](const int i, Work& W, const float*& M0, const float*& M1, const float*& M2){
+	  in.load(i,W.ix);
+	  int m=W.ix.size();
+	  W.m0.resize(n0);
+	  W.m1.resize(m*n1);
+	  W.m2.resize(m*m*n2);
+	  W.row.resize(x.nc);
+	  M0=W.m0.data();
+	  if(n1) M1=W.m1.data();
+	  if(n2) M2=W.m2.data();
+	  x.reduce_one(in.tix(i),W.ix.data(),m,W.m0.data(),n1? W.m1.data() : nullptr,n2? W.m2.data() : nullptr,normalized,W.row.data());
+	},n0,_offs,n1,o1,n2,o2,assign);
+    }
+
+    // Group the entries of out by target ptensor, and for each target add the broadcasts of the 
+    // messages supplied by msg(i,W,M0,M1,M2) in a float buffer, rounding only the final value. 
+    template<typename OUT, typename MSG>
+    void broadcast_all(const OUT& out, const MSG& msg, const int n0, const int o0, const int n1, const int o1, 
+      const int n2, const int o2, const bool assign){
+      int n=size();
+      int N=out.size();
+      vector<int> start(n+1,0);
+      for(int i=0; i<N; i++) start[out.tix(i)+1]++;
+      for(int t=0; t<n; t++) start[t+1]+=start[t];
+      vector<int> order(N);
+      vector<int> next(start.begin(),start.end()-1);
+      for(int i=0; i<N; i++) order[next[out.tix(i)]++]=i;
+
+      vector<Work> work(parallel_nthreads(n));
+      parallel_for(n,[&](const int tid, const int t){
+	  if(start[t]==start[t+1] && !assign) return;
+	  Work& W=work[tid];
+	  size_t T=offs[t+1]-offs[t];
+	  W.tgt.resize(T);
+	  if(assign) std::fill(W.tgt.begin(),W.tgt.end(),0.0f);
+	  else convert(arr.data()+offs[t],W.tgt.data(),T);
+	  int K=atoms.size_of(t);
+	  for(int j=start[t]; j<start[t+1]; j++){
+	    int i=order[j];
+	    const float* M0=nullptr;
+	    const float* M1=nullptr;
+	    const float* M2=nullptr;
+	    msg(i,W,M0,M1,M2);
+	    out.load(i,W.ox);
+	    broadcast_one(W.tgt.data(),K,W.ox.data(),W.ox.size(),M0,n0,o0,M1,n1,o1,M2,n2,o2);
+	  }
+	  convert(W.tgt.data(),arr.data()+offs[t],T);
+	});
+    }
+
+    // Reduce the slice of ptensor s picked out by ix[0],...,ix[m-1]. M0 gets the order 0 reduction,
+    // M1 the m rows of the order 1 reduction and M2 the m*m entries of the order 2 reduction; any of
+    // them may be null. row is scratch space for nc floats.
+    void reduce_one(const int s, const int* ix, const int m, float* M0, float* M1, float* M2, 
+      const bool normalized, float* row) const{
+      const TYPE* x=arr.data()+offs[s];
+
+      if(k==0){
+	if(M0) convert(x,M0,nc);
+	return;
+      }
+
+      if(k==1){
+	if(M0) std::fill(M0,M0+nc,0.0f);
+	for(int p=0; p<m; p++){
+	  float* r=M1? M1+p*nc : row;
+	  convert(x+ix[p]*nc,r,nc);
+	  if(M0) add_to(M0,r,nc);
+	}
+	if(M0 && normalized && m>0) scale(M0,nc,1.0/m);
+	return;
+      }
+
+      const int K=atoms.size_of(s);
+      if(M0) std::fill(M0,M0+2*nc,0.0f);
+      if(M1) std::fill(M1,M1+m*3*nc,0.0f);
+      for(int p=0; p<m; p++)
+	for(int q=0; q<m; q++){
+	  float* r=M2? M2+(p*m+q)*nc : row;
+	  convert(x+(ix[p]*K+ix[q])*nc,r,nc);
+	  if(M0){
+	    add_to(M0,r,nc);
+	    if(p==q) add_to(M0+nc,r,nc);
+	  }
+	  if(M1){
+	    add_to(M1+q*3*nc,r,nc);
+	    add_to(M1+p*3*nc+nc,r,nc);
+	    if(p==q) add_to(M1+p*3*nc+2*nc,r,nc);
+	  }
+	}
+      if(normalized && m>0){
+	if(M0){
+	  scale(M0,nc,1.0/(m*m));
+	  scale(M0+nc,nc,1.0/m);
+	}
+	if(M1)
+	  for(int p=0; p<m; p++)
+	    scale(M1+p*3*nc,2*nc,1.0/m);
+      }
+    }
+
+    // Add the broadcasts of the messages M0, M1, M2 (of widths n0, n1, n2) to the rows ox[0],...,ox[m-1]
+    // of the target t of size K, at channel offsets o0, o1, o2
+    void broadcast_one(float* t, const int K, const int* ox, const int m, 
+      const float* M0, const int n0, const int o0, const float* M1, const int n1, const int o1, 
+      const float* M2, const int n2, const int o2) const{
+
+      if(k==0){
+	if(M0) add_to(t+o0,M0,n0);
+	return;
+      }
+
+      if(k==1){
+	for(int p=0; p<m; p++){
+	  float* r=t+ox[p]*nc;
+	  if(M0) add_to(r+o0,M0,n0);
+	  if(M1) add_to(r+o1,M1+p*n1,n1);
+	}
+	return;
+      }
+
+      for(int p=0; p<m; p++)
+	for(int q=0; q<m; q++){
+	  float* r=t+(ox[p]*K+ox[q])*nc;
+	  if(M0){
+	    add_to(r+o0,M0,n0);
+	    if(p==q) add_to(r+o0+n0,M0,n0);
+	  }
+	  if(M1){
+	    add_to(r+o1,M1+q*n1,n1);
+	    add_to(r+o1+n1,M1+p*n1,n1);
+	    if(p==q) add_to(r+o1+2*n1,M1+p*n1,n1);
+	  }
+	  if(M2){
+	    add_to(r+o2,M2+(p*m+q)*n2,n2);
+	    add_to(r+o2+n2,M2+(q*m+p)*n2,n2);
+	  }
+	}
+    }
+
+    static void add_to(float* r, const float* x, const int n){
+      for(int i=0; i<n; i++) r[i]+=x[i];
+    }
+
+    static void scale(float* r, const int n, const float c){
+      for(int i=0; i<n; i++) r[i]*=c;
+    }
+
+
+  private:
+
+    static int order_of(const Ptensors0& x){return 0;}
+    static int order_of(const Ptensors1& x){return 1;}
+    static int order_of(const Ptensors2& x){return 2;}
+
+    void make_offsets(){
+      int n=atoms.size();
+      offs.resize(n+1);
+      offs[0]=0;
+      for(int i=0; i<n; i++){
+	size_t m=atoms.size_of(i);
+	offs[i+1]=offs[i]+(k==0? 1 : (k==1? m : m*m))*nc;
+      }
+    }
+
+    template<typename PACK>
+    void from_float(const int _k, const PACK& x){
+      if(x.dev>0){
+	from_float(_k,PACK(x,0));
+	return;
+      }
+      k=_k;
+      nc=x.nc;
+      atoms=x.atoms;
+      make_offsets();
+      arr.resize(offs.back());
+      from_float_range(x,0,size());
+    }
+
+    // Round ptensors i0,...,i1-1 of this layer from ptensors 0,...,i1-i0-1 of x
+    template<typename PACK>
+    void from_float_range(const PACK& x, const int i0, const int i1){
+      for(int i=i0; i<i1; i++)
+	convert(x.arr+x.dir(i-i0,0),arr.data()+offs[i],offs[i+1]-offs[i]);
+    }
+
+    // Widen ptensors i0,...,i1-1 of this layer into ptensors 0,...,i1-i0-1 of x
+    template<typename PACK>
+    void to_float(PACK& x, const int i0, const int i1) const{
+      for(int i=i0; i<i1; i++)
+	convert(arr.data()+offs[i],x.arr+x.dir(i-i0,0),offs[i+1]-offs[i]);
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "PtensorsH<"+TYPE::str()+">";
+    }
+
+    string repr() const{
+      return "<Ptensors"+to_string(k)+"["+TYPE::str()+",N="+to_string(size())+",nc="+to_string(nc)+"]>";
+    }
+
+    string str(const string indent="") const{
+      ostringstream oss;
+      switch(k){
+      case 0: oss<<ptensors0().str(indent); break;
+      case 1: oss<<ptensors1().str(indent); break;
+      default: oss<<ptensors2().str(indent);
+      }
+      return oss.str();
+    }
+
+    friend ostream& operator<<(ostream& stream, const PtensorsH& x){
+      stream<<x.str(); return stream;}
+
+
+  private:
+
+    typename PtensTracked<PtensorsH<TYPE>,PtensMemoryTracker::FEATURES>::Registration registration{this}; // last data member, see PtensTracked
+
+  };
+
+
+  typedef PtensorsH<bfloat16> Ptensors_bf16;
+  typedef PtensorsH<float16> Ptensors_fp16;
+
+}
+
+#endif
@@ -107,62 +107,62 @@ namespace ptens{
     template<typename TLAYER2>
     SubgraphLayer0(const SubgraphLayer0<TLAYER2>& x, const Subgraph& _S):
       SubgraphLayer0(x.G,_S,AtomsPack(x.getn()),x.get_nc(),x.dev){
-      emp00(*this,x,TransferMap(x.atoms,atoms));
+      emp00(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     template<typename TLAYER2>
     void gather_back(SubgraphLayer0<TLAYER2>& x){
-      emp00(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms)); 
+      emp00(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms)); 
     }
 
     template<typename TLAYER2>
     SubgraphLayer0(const SubgraphLayer1<TLAYER2>& x, const Subgraph& _S):
       SubgraphLayer0(x.G,_S,AtomsPack(x.getn()),x.get_nc(),x.dev){
-      emp10(*this,x,TransferMap(x.atoms,atoms));
+      emp10(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     template<typename TLAYER2>
     void gather_back(SubgraphLayer1<TLAYER2>& x){
-      emp01(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms));
+      emp01(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms));
     }
 
     template<typename TLAYER2>
     SubgraphLayer0(const SubgraphLayer2<TLAYER2>& x, const Subgraph& _S):
       SubgraphLayer0(x.G,_S,AtomsPack(x.getn()),2*x.get_nc(),x.dev){
-      emp20(*this,x,TransferMap(x.atoms,atoms));
+      emp20(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     template<typename TLAYER2>
     void gather_back(SubgraphLayer2<TLAYER2>& x){
-      emp20_back(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms));
+      emp20_back(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms));
     }
 
 
     SubgraphLayer0(const Ptensors0& x, const Ggraph& _G, const Subgraph& _S):
-      SubgraphLayer0(_G,_S,CachedPlantedSubgraphsMx(*_G.obj,*_S.obj),x.get_nc(),x.dev){
-      emp00(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer0(_G,_S,*_G.subgraphs_mx(*_S.obj),x.get_nc(),x.dev){
+      emp00(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     void gather_back(Ptensors0& x){
-      emp00(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms)); 
+      emp00(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms)); 
     }
 
     SubgraphLayer0(const Ptensors1& x, const Ggraph& _G, const Subgraph& _S):
-      SubgraphLayer0(_G,_S,CachedPlantedSubgraphsMx(*_G.obj,*_S.obj),x.get_nc(),x.dev){
-      emp10(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer0(_G,_S,*_G.subgraphs_mx(*_S.obj),x.get_nc(),x.dev){
+      emp10(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     void gather_back(Ptensors1& x){
-      emp01(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms));
+      emp01(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms));
     }
 
     SubgraphLayer0(const Ptensors2& x, const Ggraph& _G, const Subgraph& _S):
-      SubgraphLayer0(_G,_S,CachedPlantedSubgraphsMx(*_G.obj,*_S.obj),2*x.get_nc(),x.dev){
-      emp20(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer0(_G,_S,*_G.subgraphs_mx(*_S.obj),2*x.get_nc(),x.dev){
+      emp20(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     void gather_back(Ptensors2& x){
-      emp20_back(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms));
+      emp20_back(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms));
     }
 
 
@@ -101,64 +101,64 @@ namespace ptens{
 
     template<typename TLAYER2>
     SubgraphLayer1(const SubgraphLayer0<TLAYER2>& x, const Subgraph& _S):
-      SubgraphLayer1(x.G,_S,CachedPlantedSubgraphsMx(*x.G.obj,*_S.obj),x.get_nc(),x.dev){
-      emp01(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer1(x.G,_S,*x.G.subgraphs_mx(*_S.obj),x.get_nc(),x.dev){
+      emp01(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     template<typename TLAYER2>
     void gather_back(SubgraphLayer0<TLAYER2>& x){
-      emp10(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms));
+      emp10(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms));
     }
 
     template<typename TLAYER2>
     SubgraphLayer1(const SubgraphLayer1<TLAYER2>& x, const Subgraph& _S):
-      SubgraphLayer1(x.G,_S,CachedPlantedSubgraphsMx(*x.G.obj,*_S.obj),2*x.get_nc(),x.dev){
-      emp11(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer1(x.G,_S,*x.G.subgraphs_mx(*_S.obj),2*x.get_nc(),x.dev){
+      emp11(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     template<typename TLAYER2>
     void gather_back(SubgraphLayer1<TLAYER2>& x){
-      emp11_back(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms));
+      emp11_back(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms));
     }
 
     template<typename TLAYER2>
     SubgraphLayer1(const SubgraphLayer2<TLAYER2>& x, const Subgraph& _S):
-      SubgraphLayer1(x.G,_S,CachedPlantedSubgraphsMx(*x.G.obj,*_S.obj),5*x.get_nc(),x.dev){
-      emp21(*this,x,TransferMap(x.atoms,atoms)); 
+      SubgraphLayer1(x.G,_S,*x.G.subgraphs_mx(*_S.obj),5*x.get_nc(),x.dev){
+      emp21(*this,x,*G.transfer_map(x.atoms,atoms)); 
     }
 
     template<typename TLAYER2>
     void gather_back(SubgraphLayer2<TLAYER2>& x){
-      emp21_back(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms));
+      emp21_back(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms));
     }
 
 
     SubgraphLayer1(const Ptensors0& x, const Ggraph& _G, const Subgraph& _S):
-      SubgraphLayer1(_G,_S,CachedPlantedSubgraphsMx(*_G.obj,*_S.obj),x.get_nc(),x.dev){
-      emp01(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer1(_G,_S,*_G.subgraphs_mx(*_S.obj),x.get_nc(),x.dev){
+      emp01(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     void gather_back(Ptensors0& x){
-      emp10(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms)); 
+      emp10(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms)); 
     }
 
     SubgraphLayer1(const Ptensors1& x, const Ggraph& _G, const Subgraph& _S):
-      SubgraphLayer1(_G,_S,CachedPlantedSubgraphsMx(*_G.obj,*_S.obj),2*x.get_nc(),x.dev){
+      SubgraphLayer1(_G,_S,*_G.subgraphs_mx(*_S.obj),2*x.get_nc(),x.dev){
       cnine::ftimer timer("SubgraphLayer1 from Ptensors1");
-      emp11(*this,x,TransferMap(x.atoms,atoms));
+      emp11(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     void gather_back(Ptensors1& x){
-      emp11_back(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms)); 
+      emp11_back(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms)); 
     }
 
     SubgraphLayer1(const Ptensors2& x, const Ggraph& _G, const Subgraph& _S):
-      SubgraphLayer1(_G,_S,CachedPlantedSubgraphsMx(*_G.obj,*_S.obj),5*x.get_nc(),x.dev){
-      emp21(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer1(_G,_S,*_G.subgraphs_mx(*_S.obj),5*x.get_nc(),x.dev){
+      emp21(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     void gather_back(Ptensors2& x){
-      emp21_back(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms)); 
+      emp21_back(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms)); 
     }
 
 
@@ -90,64 +90,64 @@ namespace ptens{
     template<typename TLAYER2>
     SubgraphLayer2(const SubgraphLayer0<TLAYER2>& x, const Subgraph& _S):
       //SubgraphLayer2(x.G,_S,AtomsPack(CachedPlantedSubgraphs()(*x.G.obj,*_S.obj)),2*x.get_nc(),x.dev){
-      SubgraphLayer2(x.G,_S,CachedPlantedSubgraphsMx(*x.G.obj,*_S.obj),2*x.get_nc(),x.dev){
-      emp02(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer2(x.G,_S,*x.G.subgraphs_mx(*_S.obj),2*x.get_nc(),x.dev){
+      emp02(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     template<typename TLAYER2>
     void gather_back(SubgraphLayer0<TLAYER2>& x){
-      emp02_back(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms));
+      emp02_back(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms));
     }
 
     template<typename TLAYER2>
     SubgraphLayer2(const SubgraphLayer1<TLAYER2>& x, const Subgraph& _S):
       //SubgraphLayer2(x.G,_S,AtomsPack(CachedPlantedSubgraphs()(*x.G.obj,*_S.obj)),5*x.get_nc(),x.dev){
-      SubgraphLayer2(x.G,_S,CachedPlantedSubgraphsMx(*x.G.obj,*_S.obj),5*x.get_nc(),x.dev){
-      emp12(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer2(x.G,_S,*x.G.subgraphs_mx(*_S.obj),5*x.get_nc(),x.dev){
+      emp12(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     template<typename TLAYER2>
     void gather_back(SubgraphLayer1<TLAYER2>& x){
-      emp12_back(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms));
+      emp12_back(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms));
     }
 
     template<typename TLAYER2>
     SubgraphLayer2(const SubgraphLayer2<TLAYER2>& x, const Subgraph& _S):
-      SubgraphLayer2(x.G,_S,CachedPlantedSubgraphsMx(*x.G.obj,*_S.obj),15*x.get_nc(),x.dev){
-      emp22(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer2(x.G,_S,*x.G.subgraphs_mx(*_S.obj),15*x.get_nc(),x.dev){
+      emp22(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     template<typename TLAYER2>
     void gather_back(SubgraphLayer2<TLAYER2>& x){
-      emp22_back(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms));
+      emp22_back(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms));
     }
 
 
     SubgraphLayer2(const Ptensors0& x, const Ggraph& _G, const Subgraph& _S):
-      SubgraphLayer2(_G,_S,CachedPlantedSubgraphsMx(*_G.obj,*_S.obj),2*x.get_nc(),x.dev){
-      emp02(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer2(_G,_S,*_G.subgraphs_mx(*_S.obj),2*x.get_nc(),x.dev){
+      emp02(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     void gather_back(Ptensors0& x){
-      emp02_back(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms)); 
+      emp02_back(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms)); 
     }
 
     SubgraphLayer2(const Ptensors1& x, const Ggraph& _G, const Subgraph& _S):
-      SubgraphLayer2(_G,_S,CachedPlantedSubgraphsMx(*_G.obj,*_S.obj),5*x.get_nc(),x.dev){
-      emp12(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer2(_G,_S,*_G.subgraphs_mx(*_S.obj),5*x.get_nc(),x.dev){
+      emp12(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     void gather_back(Ptensors1& x){
-      emp12_back(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms)); 
+      emp12_back(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms)); 
     }
 
     SubgraphLayer2(const Ptensors2& x, const Ggraph& _G, const Subgraph& _S):
-      SubgraphLayer2(_G,_S,CachedPlantedSubgraphsMx(*_G.obj,*_S.obj),15*x.get_nc(),x.dev){
-      emp22(*this,x,TransferMap(x.atoms,atoms));
+      SubgraphLayer2(_G,_S,*_G.subgraphs_mx(*_S.obj),15*x.get_nc(),x.dev){
+      emp22(*this,x,*G.transfer_map(x.atoms,atoms));
     }
 
     void gather_back(Ptensors2& x){
-      emp22_back(x.get_grad(),get_grad(),TransferMap(atoms,x.atoms)); 
+      emp22_back(x.get_grad(),get_grad(),*G.transfer_map(atoms,x.atoms)); 
     }
 
 
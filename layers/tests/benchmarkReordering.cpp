@@ -0,0 +1,78 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+
+#include "EMPlayers.hpp"
+#include "LinmapLayers.hpp"
+#include "VertexReordering.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+namespace ptens{
+  PtensSession ptens_session;
+}
+
+template<typename FN>
+double timeit(const FN& lambda, const int reps=5){
+  auto t0=std::chrono::system_clock::now();
+  for(int i=0; i<reps; i++) lambda();
+  return std::chrono::duration<double,std::milli>(std::chrono::system_clock::now()-t0).count()/reps;
+}
+
+
+// add_msg on a grid graph whose vertex ids have been shuffled, before and after reordering
+int main(int argc, char** argv){
+
+  int w=200;
+  int nc=32;
+  if(argc>1) w=atoi(argv[1]);
+  if(argc>2) nc=atoi(argv[2]);
+  int n=w*w;
+
+  vector<int> shuffle(n);
+  for(int i=0; i<n; i++) shuffle[i]=i;
+  std::shuffle(shuffle.begin(),shuffle.end(),std::mt19937(0));
+  vector<int> src, dst;
+  for(int x=0; x<w; x++)
+    for(int y=0; y<w; y++){
+      if(x+1<w){src.push_back(shuffle[x*w+y]); dst.push_back(shuffle[(x+1)*w+y]);}
+      if(y+1<w){src.push_back(shuffle[x*w+y]); dst.push_back(shuffle[x*w+y+1]);}
+    }
+  Hgraph G=Hgraph::edge_index(src.data(),dst.data(),src.size(),n,true);
+
+  auto x=Ptensors0::randn(n,nc);
+  auto r=Ptensors1::zero(G.nhoods(1),nc);
+  double t0=timeit([&](){add_msg(r,x,G);});
+  cout<<"shuffled: bandwidth "<<VertexReordering::bandwidth(G)<<", add_msg "<<t0<<" ms"<<endl;
+
+  for(string method: {"rcm","bfs","degree"}){
+    VertexReordering R(G,method);
+    Hgraph G2=R(G);
+    auto x2=R.apply(x);
+    auto r2=Ptensors1::zero(G2.nhoods(1),nc);
+    double t1=timeit([&](){add_msg(r2,x2,G2);});
+    auto back=R.inv().apply(r2);
+    cout<<method<<": bandwidth "<<VertexReordering::bandwidth(G2)<<", add_msg "<<t1<<" ms, ";
+    cout<<"difference after mapping back "<<back.diff2(r)<<endl;
+
+    // Reordering and mapping back only moves entries around, so it is exact
+    auto r3=R.inv().apply(R.apply(r));
+    PTENS_ASSRT(r3.atoms==r.atoms);
+    PTENS_ASSRT(r3.diff2(r)==0);
+    auto s=linmaps2(r);
+    PTENS_ASSRT(R.inv().apply(R.apply(s)).diff2(s)==0);
+  }
+
+}
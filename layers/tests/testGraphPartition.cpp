@@ -0,0 +1,157 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "EMPlayers.hpp"
+#include "GraphPartition.hpp"
+#include "PartitionedLayers.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+PtensSession ptens_session;
+
+
+void write_buf(const int fd, const vector<float>& v){
+  int n=v.size();
+  PTENS_ASSRT(write(fd,&n,sizeof(int))==sizeof(int));
+  PTENS_ASSRT(write(fd,v.data(),n*sizeof(float))==n*sizeof(float));
+}
+
+vector<float> read_buf(const int fd){
+  int n;
+  PTENS_ASSRT(read(fd,&n,sizeof(int))==sizeof(int));
+  vector<float> v(n);
+  size_t t=0;
+  while(t<n*sizeof(float)){
+    int r=read(fd,reinterpret_cast<char*>(v.data())+t,n*sizeof(float)-t);
+    PTENS_ASSRT(r>0);
+    t+=r;
+  }
+  return v;
+}
+
+
+// Two rounds of message passing on a grid, each part in its own process. The halo of the 
+// intermediate layer is exchanged through pipes. The messages are small enough to fit in the 
+// pipe buffers, so every process can do all its writes before its reads.
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  int w=12;
+  int k=3;
+  int nc=2;
+  if(argc>1) w=atoi(argv[1]);
+  if(argc>2) k=atoi(argv[2]);
+  int n=w*w;
+
+  vector<int> src, dst;
+  for(int x=0; x<w; x++)
+    for(int y=0; y<w; y++){
+      if(x+1<w){src.push_back(x*w+y); dst.push_back((x+1)*w+y);}
+      if(y+1<w){src.push_back(x*w+y); dst.push_back(x*w+y+1);}
+    }
+  Hgraph G=Hgraph::edge_index(src.data(),dst.data(),src.size(),n,true);
+  AtomsPack nh=G.nhoods(1);
+
+  GraphPartition P(G,k);
+  cout<<P.repr()<<endl;
+  cout<<P<<endl;
+
+  auto x=Ptensors0::sequential(n,nc);
+  auto r1=Ptensors1::zero(nh,nc);
+  add_msg(r1,x,G);
+  auto r2=Ptensors1::zero(nh,2*nc);
+  add_msg(r2,r1,G);
+
+  vector<array<int,2> > pipes(k*k); // from p to q
+  vector<array<int,2> > results(k);
+  for(auto& p:pipes) PTENS_ASSRT(pipe(p.data())==0);
+  for(auto& p:results) PTENS_ASSRT(pipe(p.data())==0);
+
+  for(int p=0; p<k; p++){
+    if(fork()!=0) continue;
+    const GraphPartition::Part& part=P[p];
+    const Hgraph& Gl=*part.graph;
+
+    auto xl=P.localize(p,x);
+    auto r1l=Ptensors1::zero(P.atoms(p,nh),nc);
+    add_msg(r1l,xl,Gl);
+
+    for(int q=0; q<k; q++)
+      if(part.send[q].size()>0) write_buf(pipes[p*k+q][1],P.pack_halo(p,q,r1l));
+    for(int q=0; q<k; q++)
+      if(part.recv[q].size()>0) P.unpack_halo(p,q,read_buf(pipes[q*k+p][0]),r1l);
+
+    auto r2l=Ptensors1::zero(P.atoms(p,nh),2*nc);
+    add_msg(r2l,r1l,Gl);
+    write_buf(results[p][1],P.pack_owned(p,r2l));
+    _exit(0);
+  }
+
+  auto R=Ptensors1::zero(nh,2*nc);
+  for(int p=0; p<k; p++)
+    P.unpack_owned(p,read_buf(results[p][0]),R);
+  for(int p=0; p<k; p++)
+    wait(nullptr);
+
+  cout<<"Difference from single process: "<<R.diff2(r2)<<endl;
+
+  // The same with all the parts in this process 
+  vector<Ptensors1> h1;
+  for(int p=0; p<k; p++){
+    h1.push_back(Ptensors1::zero(P.atoms(p,nh),nc));
+    add_msg(h1[p],P.localize(p,x),*P[p].graph);
+  }
+  P.exchange_halo(h1);
+  auto S=Ptensors1::zero(nh,2*nc);
+  for(int p=0; p<k; p++){
+    auto h2=Ptensors1::zero(P.atoms(p,nh),2*nc);
+    add_msg(h2,h1[p],*P[p].graph);
+    P.add_to_global(S,p,h2);
+  }
+  cout<<"Difference in process: "<<S.diff2(r2)<<endl;
+
+  // The same through the partitioned ops
+  auto Pp=make_shared<GraphPartition>(P);
+  PartitionedLayer<Ptensors0> xp(Pp,x);
+  auto p1=PartitionedLayer<Ptensors1>::zero(Pp,nh,nc);
+  add_msg(p1,xp);
+  auto p2=PartitionedLayer<Ptensors1>::zero(Pp,nh,2*nc);
+  add_msg(p2,p1);
+  cout<<"Partitioned add_msg: "<<p2.global().diff2(r2)<<endl;
+
+  auto g2=Ptensors1::gaussian(nh,2*nc);
+  auto g1=Ptensors1::zero(nh,nc);
+  add_msg_back(g1,g2,G.reverse());
+  auto g1p=PartitionedLayer<Ptensors1>::zero(Pp,nh,nc);
+  add_msg_back(g1p,PartitionedLayer<Ptensors1>(Pp,g2));
+  cout<<"Partitioned add_msg_back: "<<g1p.global().diff2(g1)<<endl;
+
+  cout<<"Partitioned gather: "<<gather(xp).global().diff2(gather(x,G))<<endl;
+
+  Ggraph GG(new Hgraph(G));
+  PartitionedLayer<Ptensors1> y(Pp,r1);
+  SubgraphLayer0<Ptensors0> s0(x,GG,Subgraph::edge());
+  cout<<"Partitioned SubgraphLayer0: "<<subgraph_layer0(xp,GG,Subgraph::edge()).diff2(s0)<<endl;
+  SubgraphLayer1<Ptensors1> s1(r1,GG,Subgraph::cycle(4));
+  cout<<"Partitioned SubgraphLayer1: "<<subgraph_layer1(y,GG,Subgraph::cycle(4)).diff2(s1)<<endl;
+  SubgraphLayer2<Ptensors2> s2(r1,GG,Subgraph::edge());
+  cout<<"Partitioned SubgraphLayer2: "<<subgraph_layer2(y,GG,Subgraph::edge()).diff2(s2)<<endl;
+
+}
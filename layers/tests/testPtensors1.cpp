@@ -16,6 +16,7 @@
 
 #include "LinmapLayers.hpp"
 #include "EMPlayers.hpp"
+#include "FusedLayers.hpp"
 
 using namespace ptens;
 using namespace cnine;
@@ -27,6 +28,9 @@ int main(int argc, char** argv){
 
   //cnine_session session;
 
+  // Only objects constructed with accounting on are counted
+  ptens_session.set_memory_accounting(true);
+
   if(false){
     Ptensors1 A=Ptensors1::randn({{1,2,3},{3,5},{2}},2);
     cout<<A<<endl;
@@ -44,6 +48,97 @@ int main(int argc, char** argv){
   cout<<linmaps2(A)<<endl;
   cout<<"-----"<<endl;
 
+  // Layers derived from A refer to the same atoms
+  Ptensors1 B=Ptensors1::zeros_like(A);
+  Ptensors2 C=linmaps2(A);
+  cout<<"atoms ids: "<<A.atoms.id()<<" "<<B.atoms.id()<<" "<<C.atoms.id()<<endl;
+  cout<<"-----"<<endl;
+
+  #ifdef WITH_FAKE_GRAD
+  // Gradients are only allocated on first accumulation
+  cout<<"has grad: "<<B.has_grad()<<endl;
+  B.add_to_grad(Ptensors1::sequential(2,3,1));
+  B.add_to_grad(A);
+  cout<<B.get_grad()<<endl;
+  Ptensors1 G=B.take_grad();
+  cout<<"has grad: "<<B.has_grad()<<endl;
+  cout<<"-----"<<endl;
+  #endif
+
+  // Linear layer with bias and leaky ReLU in one pass, compared against add_linear+add_ReLU
+  {
+    const int nin=3;
+    const int nout=4;
+    const float alpha=0.1;
+    Ptensors1 X=Ptensors1::randn(A.atoms,nin);
+    vector<float> w(nin*nout);
+    vector<float> b(nout);
+    RtensorA W=RtensorA::zero({nin,nout});
+    RtensorA Bv=RtensorA::zero({nout});
+    for(int k=0; k<nin; k++)
+      for(int j=0; j<nout; j++){
+	w[k*nout+j]=0.5*((k*7+j*3)%5-2);
+	W.set(k,j,w[k*nout+j]);
+      }
+    for(int j=0; j<nout; j++){
+      b[j]=0.25*j-0.5;
+      Bv.set(j,b[j]);
+    }
+
+    Ptensors1 L=Ptensors1::raw(X.atoms,nout,0);
+    vector<unsigned char> mask(linear_leaky_mask_size(X,nout));
+    set_linear_leaky(L,X,w.data(),b.data(),alpha,mask.data());
+    cout<<L<<endl;
+
+    Ptensors1 U=Ptensors1::zero(X.atoms,nout);
+    U.add_linear(X,W,Bv);
+    Ptensors1 L2=Ptensors1::zero(X.atoms,nout);
+    L2.add_ReLU(U,alpha);
+    cout<<"forward diff2: "<<L.diff2(L2)<<endl;
+
+    // Backward: x, w and b gradients against add_ReLU_back followed by the linear backward
+    Ptensors1 G=Ptensors1::randn(X.atoms,nout);
+    Ptensors1 XG=Ptensors1::zero(X.atoms,nin);
+    vector<float> wg(nin*nout,0);
+    vector<float> bg(nout,0);
+    add_linear_leaky_back(XG,wg.data(),bg.data(),G,X,w.data(),alpha,mask.data());
+
+    Ptensors1 UG=Ptensors1::zero(X.atoms,nout);
+    UG.add_ReLU_back(G,U,alpha);
+    Ptensors1 XG2=Ptensors1::zero(X.atoms,nin);
+    XG2.add_mprod_back0(UG,W);
+    RtensorA WG2=RtensorA::zero({nin,nout});
+    UG.add_linear_back1_to(WG2,X);
+    RtensorA BG2=RtensorA::zero({nout});
+    UG.add_linear_back2_to(BG2);
+
+    float wdiff=0;
+    float bdiff=0;
+    for(int k=0; k<nin; k++)
+      for(int j=0; j<nout; j++)
+	wdiff+=(wg[k*nout+j]-WG2(k,j))*(wg[k*nout+j]-WG2(k,j));
+    for(int j=0; j<nout; j++)
+      bdiff+=(bg[j]-BG2(j))*(bg[j]-BG2(j));
+    cout<<"x grad diff2: "<<XG.diff2(XG2)<<endl;
+    cout<<"w grad diff2: "<<wdiff<<endl;
+    cout<<"b grad diff2: "<<bdiff<<endl;
+  }
+  cout<<"-----"<<endl;
+
+  // Memory held by the layers above, by category
+  for(auto& p:ptens_session.memory_stats())
+    cout<<p.first<<": "<<p.second<<endl;
+  cout<<"-----"<<endl;
+
+  // A temporary released before the next call to memory_stats() still shows in the peaks
+  ptens_session.reset_memory_peaks();
+  long before=ptens_session.memory_stats()["features"];
+  {
+    Ptensors1 T=Ptensors1::zero(A.atoms,1000);
+  }
+  cout<<"Peak over the temporary: "<<ptens_session.memory_stats()["peak_features"]-before<<endl;
+  cout<<"-----"<<endl;
+
   #ifdef _WITH_CUDA
   Ptensors1 Ag(A,1);
   cout<<linmaps0(Ag)<<endl;
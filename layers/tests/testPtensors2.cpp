@@ -44,6 +44,50 @@ int main(int argc, char** argv){
   cout<<linmaps2(A)<<endl;
   cout<<"-----"<<endl;
 
+  // linmaps* write into uninitialized outputs; compare with accumulating into zero
+  Ptensors2 B=Ptensors2::randn({{1,2,3},{3,5},{2}},2);
+  Ptensors2 R2=Ptensors2::zero(B.atoms,15*B.nc);
+  add_linmaps(R2,B);
+  cout<<"linmaps2 difference: "<<R2.diff2(linmaps2(B))<<endl;
+  Ptensors1 R1=Ptensors1::zero(B.atoms,5*B.nc);
+  add_linmaps_n(R1,B);
+  cout<<"linmaps1_n difference: "<<R1.diff2(linmaps1_n(B))<<endl;
+  cout<<"-----"<<endl;
+
+  // Indexed reductions write into uninitialized scratch packs; compare with accumulating into zero
+  {
+    AtomsPack a({{1,2,3},{3,5},{2}});
+    Ptensors2 C=Ptensors2::randn(a,2);
+    Hgraph G=Hgraph::overlaps(a,a);
+    PtensScratch::Scope scope;
+    auto indices=G.intersects(C.atoms,C.atoms);
+    const AindexPack& list=indices.first;
+    const int nc=C.nc;
+    cnine::array_pool<int> dims1;
+    cnine::array_pool<int> dims2;
+    for(int i=0; i<list.size(); i++){
+      dims1.push_back(vector<int>({list.nix(i),3*nc}));
+      dims2.push_back(vector<int>({list.nix(i),list.nix(i),nc/2}));
+    }
+    RtensorPackB R0(list.size(),Gdims(2*nc),cnine::fill_zero());
+    RtensorPackB R1(dims1,cnine::fill_zero());
+    RtensorPackB R2(dims2,cnine::fill_zero());
+    for(int i=0; i<list.size(); i++){
+      if(list.nix(i)==0) continue;
+      C.view_of(list.tens(i),list.ix(i)).sum01_into(R0.view1_of(i).block(0,nc));
+      C.view_of(list.tens(i),list.ix(i)).diag01().sum0_into(R0.view1_of(i).block(nc,nc));
+      C.view_of(list.tens(i),list.ix(i)).sum0_into(R1.view2_of(i).block(0,0,-1,nc));
+      C.view_of(list.tens(i),list.ix(i)).sum1_into(R1.view2_of(i).block(0,nc,-1,nc));
+      R1.view2_of(i).block(0,2*nc,-1,nc)+=C.view_of(list.tens(i),list.ix(i)).diag01();
+      R2.view3_of(i)+=C.view_of(list.tens(i),list.ix(i),0,nc/2);
+      R2.view3_of(i)+=C.view_of(list.tens(i),list.ix(i),nc/2,nc/2).transp();
+    }
+    cout<<"reduce0 difference: "<<C.reduce0(list).diff2(R0)<<endl;
+    cout<<"reduce1 difference: "<<C.reduce1(list).diff2(R1)<<endl;
+    cout<<"broadcast2_back difference: "<<C.broadcast2_back(list,0,nc/2).diff2(R2)<<endl;
+  }
+  cout<<"-----"<<endl;
+
   #ifdef _WITH_CUDA
   Ptensors2 Ag(A,1);
   cout<<linmaps0(Ag)<<endl;
@@ -0,0 +1,109 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+
+#include "Ptensors2sym.hpp"
+#include "LinmapLayers.hpp"
+#include "EMPlayers.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+PtensSession ptens_session;
+
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  Ptensors2 A=Ptensors2::randn({{1,2,3},{3,5},{2},{0,1,2,4}},3);
+
+  // Converting takes the symmetric part, so B is symmetric and survives the round trip exactly
+  Ptensors2sym As(A);
+  Ptensors2 B=As.ptensors2();
+  cout<<As.repr()<<" "<<As.memory_bytes()<<" bytes"<<endl;
+  cout<<"round trip: "<<B.diff2(Ptensors2sym(B).ptensors2())<<endl;
+
+  // The reductions on the triangular layout agree with those on the full layout
+  cout<<"linmaps0:   "<<linmaps0(B).diff2(As.linmaps0())<<endl;
+  cout<<"linmaps1:   "<<linmaps1(B).diff2(As.linmaps1())<<endl;
+  cout<<"linmaps0_n: "<<linmaps0_n(B).diff2(As.linmaps0(true))<<endl;
+  cout<<"linmaps1_n: "<<linmaps1_n(B).diff2(As.linmaps1(true))<<endl;
+
+  // The symmetric linmaps can be assembled from the broadcasts
+  Ptensors2sym C=Ptensors2sym::zero(B.atoms,9*B.nc);
+  Ptensors1 L1=As.linmaps1();
+  C.broadcast0(As.linmaps0(),0);
+  C.broadcast1(L1.reduce1(3*B.nc,2*B.nc),4*B.nc); // row sums and diagonal
+  C.broadcast2(As,8*B.nc);
+  cout<<"linmaps2:   "<<As.linmaps2().ptensors2().diff2(C.ptensors2())<<endl;
+  cout<<"-----"<<endl;
+
+  // The backward functions are the adjoints of the forward ones: <L(x),g> = <x,L^T(g)>
+  AtomsPack a({{1,2,3},{3,5},{2},{0,1,2,4}});
+  const int nc=3;
+  {
+    Ptensors2sym X(Ptensors2::randn(a,nc));
+    Ptensors0 g0=Ptensors0::randn(a,2*nc);
+    Ptensors1 g1=Ptensors1::randn(a,5*nc);
+    Ptensors2sym g2(Ptensors2::randn(a,9*nc));
+    for(int n=0; n<2; n++){
+      Ptensors2sym Z0=Ptensors2sym::zero(a,nc);
+      Ptensors2sym Z1=Ptensors2sym::zero(a,nc);
+      Ptensors2sym Z2=Ptensors2sym::zero(a,nc);
+      Z0.add_linmaps0_back(g0,n);
+      Z1.add_linmaps1_back(g1,n);
+      Z2.add_linmaps2_back(g2,n);
+      cout<<"linmaps0 adjoint: "<<X.linmaps0(n).inp(g0)-X.inp(Z0)<<endl;
+      cout<<"linmaps1 adjoint: "<<X.linmaps1(n).inp(g1)-X.inp(Z1)<<endl;
+      cout<<"linmaps2 adjoint: "<<X.linmaps2(n).inp(g2)-X.inp(Z2)<<endl;
+    }
+
+    Ptensors2 Y=Ptensors2::randn(a,nc);
+    Ptensors2 ZY=Ptensors2::zero(a,nc);
+    Ptensors2sym ZX=Ptensors2sym::zero(a,nc);
+    X.add_symmetrize_back(ZY);
+    ZX.add_ptensors2_back(Y);
+    cout<<"symmetrize adjoint: "<<Ptensors2sym(Y).inp(X)-Y.inp(ZY)<<endl;
+    cout<<"ptensors2 adjoint:  "<<X.ptensors2().inp(Y)-X.inp(ZX)<<endl;
+  }
+
+  // Message passing through the overlaps, and its backward
+  {
+    Ptensors2sym X(Ptensors2::randn(a,nc));
+    Hgraph G=Hgraph::overlaps(a,a);
+    Ptensors0 g0=Ptensors0::randn(a,2*nc);
+    Ptensors1 g1=Ptensors1::randn(a,4*nc);
+    for(int n=0; n<2; n++){
+      Ptensors0 R0=Ptensors0::zero(a,2*nc);
+      Ptensors1 R1=Ptensors1::zero(a,4*nc);
+      add_msg(R0,X,G,n);
+      add_msg(R1,X,G,n);
+      Ptensors2sym Z0=Ptensors2sym::zero(a,nc);
+      Ptensors2sym Z1=Ptensors2sym::zero(a,nc);
+      add_msg_back(Z0,g0,G,n);
+      add_msg_back(Z1,g1,G,n);
+      cout<<"msg0 adjoint: "<<R0.inp(g0)-X.inp(Z0)<<endl;
+      cout<<"msg1 adjoint: "<<R1.inp(g1)-X.inp(Z1)<<endl;
+    }
+
+    // Through the full layer the messages are the same as those of linmaps0/1 of X
+    Ptensors0 R0=Ptensors0::zero(a,2*nc);
+    add_msg(R0,X,G);
+    Ptensors0 S0=Ptensors0::zero(a,2*nc);
+    add_msg(S0,X.ptensors2(),G);
+    cout<<"msg0 vs full: "<<R0.diff2(S0)<<endl;
+  }
+
+}
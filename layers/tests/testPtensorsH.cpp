@@ -0,0 +1,77 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+
+#include "PtensorsH.hpp"
+#include "EMPlayers.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+PtensSession ptens_session;
+
+
+template<typename TYPE>
+void compare(const Ptensors1& A, const Hgraph& G){
+
+  PtensorsH<TYPE> Ah(A);
+  cout<<Ah.repr()<<" "<<Ah.memory_bytes()<<" bytes"<<endl;
+
+  // Rounding the input and the output each lose about 8 (bfloat16) or 11 (float16) bits
+  cout<<"  round trip:  "<<A.diff2(Ah.ptensors1())<<endl;
+  cout<<"  linmaps0:    "<<linmaps0(A).diff2(Ah.linmaps0().ptensors0())<<endl;
+  cout<<"  linmaps1:    "<<linmaps1(A).diff2(Ah.linmaps1().ptensors1())<<endl;
+  cout<<"  linmaps2:    "<<linmaps2(A).diff2(Ah.linmaps2().ptensors2())<<endl;
+  cout<<"  linmaps2_n:  "<<linmaps2_n(A).diff2(Ah.linmaps2(true).ptensors2())<<endl;
+
+  // The reductions and message passing read the 16 bit layer directly
+  Ptensors1 Ar=Ah.ptensors1();
+  cout<<"  reduce0:     "<<Ar.reduce0().diff2(Ah.reduce0())<<endl;
+  cout<<"  unite1:      "<<unite1(Ar,G).diff2(Ah.unite1(G).ptensors1())<<endl;
+  cout<<"  unite2:      "<<unite2(Ar,G).diff2(Ah.unite2(G).ptensors2())<<endl;
+  cout<<"  unite2_n:    "<<unite2_n(Ar,G).diff2(Ah.unite2(G,true).ptensors2())<<endl;
+
+  Ptensors2 B=linmaps2(A);
+  PtensorsH<TYPE> Bh(B);
+  Ptensors2 Br=Bh.ptensors2();
+  {
+    PtensScratch::Scope scope;
+    auto indices=G.intersects(Br.atoms,Br.atoms);
+    cout<<"  reduce1:     "<<Br.reduce1(indices.first).diff2(Bh.reduce1(indices.first))<<endl;
+  }
+  cout<<"  linmaps1:    "<<linmaps1(Br).diff2(Bh.linmaps1().ptensors1())<<endl;
+  cout<<"  unite2:      "<<unite2(Br,G).diff2(Bh.unite2(G).ptensors2())<<endl;
+  cout<<"  unite1_n:    "<<unite1_n(Br,G).diff2(Bh.unite1(G,true).ptensors1())<<endl;
+
+  // Chunking does not change the result
+  auto B=Ah.template apply<Ptensors1>([](const Ptensors1& x){return linmaps1(x);},16);
+  cout<<"  chunked:     "<<Ah.linmaps1().ptensors1().diff2(B.ptensors1())<<endl;
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  Ptensors1 A=Ptensors1::randn({{1,2,3},{3,5},{2},{0,1,2,4}},3);
+  Hgraph G=Hgraph::random(4,0.5);
+
+  compare<bfloat16>(A,G);
+  compare<float16>(A,G);
+
+  // An empty layer still gets the order and number of channels of the result
+  PtensorsH<bfloat16> E(Ptensors1::zero(AtomsPack(),3));
+  cout<<E.linmaps2().repr()<<" "<<E.linmaps2().ptensors2().repr()<<endl;
+
+}
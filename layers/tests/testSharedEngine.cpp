@@ -0,0 +1,76 @@
+/*
+ * This file is part of ptens, a C++/CUDA library for permutation 
+ * equivariant message passing. 
+ *  
+ * Copyright (c) 2023, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ */
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+
+#include "EMPlayers.hpp"
+#include "PtensSharedEngine.hpp"
+
+using namespace ptens;
+using namespace cnine;
+
+PtensSession ptens_session;
+
+
+// Three rounds of message passing on a grid with 1,2,4 and 8 worker processes, and the backward
+// pass of the last one, compared with the single process result
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  int w=100;
+  int nc=16;
+  if(argc>1) w=atoi(argv[1]);
+  if(argc>2) nc=atoi(argv[2]);
+  int n=w*w;
+
+  vector<int> src, dst;
+  for(int x=0; x<w; x++)
+    for(int y=0; y<w; y++){
+      if(x+1<w){src.push_back(x*w+y); dst.push_back((x+1)*w+y);}
+      if(y+1<w){src.push_back(x*w+y); dst.push_back(x*w+y+1);}
+    }
+  Hgraph G=Hgraph::edge_index(src.data(),dst.data(),src.size(),n,true);
+  AtomsPack nh=G.nhoods(1);
+
+  auto x=Ptensors0::randn(n,nc);
+  auto t0=std::chrono::system_clock::now();
+  auto r1=Ptensors1::zero(nh,nc);
+  add_msg(r1,x,G);
+  auto r2=Ptensors1::zero(nh,2*nc);
+  add_msg(r2,r1,G);
+  auto r3=Ptensors0::zero(nh,2*nc);
+  add_msg(r3,r2,G);
+  double t=std::chrono::duration<double,std::milli>(std::chrono::system_clock::now()-t0).count();
+  cout<<"Single process: "<<t<<" ms"<<endl;
+
+  // Gradient of the input of the last layer
+  auto xg=Ptensors1::zero(nh,2*nc);
+  add_msg_back(xg,r3,G.reverse());
+
+  for(int k: {1,2,4,8}){
+    PtensSharedEngine engine(G,k);
+    engine.start();
+    auto t0=std::chrono::system_clock::now();
+    PtensSharedPack h1=engine.add_msg(PtensSharedPack(x),1,nh);
+    PtensSharedPack h2=engine.add_msg(h1,1,nh);
+    PtensSharedPack h3=engine.add_msg(h2,0,nh);
+    double t=std::chrono::duration<double,std::milli>(std::chrono::system_clock::now()-t0).count();
+    cout<<engine.repr()<<": "<<t<<" ms, difference "<<h3.pack<Ptensors0>().diff2(r3)<<endl;
+
+    auto xg2=Ptensors1::zero(nh,2*nc);
+    engine.add_msg_back(xg2,r3);
+    cout<<"  backward difference "<<xg2.diff2(xg)<<endl;
+  }
+
+}
@@ -34,6 +34,12 @@ int main(int argc, char** argv){
   cout<<x<<endl;
 
   cout<<unite1(x,G)<<endl;
+
+  // The second call reuses the merged atoms cached on G
+  Ptensors1 y=unite1(x,G);
+  cout<<y<<endl;
+  cout<<unite2(y,G)<<endl;
+  cout<<"Cached merges: "<<G._merged.size()<<endl;
   
 
 }
@@ -0,0 +1,29 @@
+// Fused linear layer + leaky ReLU. The forward returns the sign bits of the pre-activations, which 
+// the backward takes back in place of the pre-activations themselves.
+auto bind_linear_leaky=[&](auto* dummy){
+  typedef typename std::remove_pointer<decltype(dummy)>::type PTENSORS;
+
+  m.def("linear_leaky",[](PTENSORS& r, const PTENSORS& x, at::Tensor& w, at::Tensor& b, const float alpha){
+      at::Tensor W=w.detach().to(at::kFloat).cpu().contiguous();
+      at::Tensor B=b.detach().to(at::kFloat).cpu().contiguous();
+      PTENS_ASSRT(W.dim()==2 && W.size(0)==x.nc && W.size(1)==r.nc);
+      PTENS_ASSRT(B.numel()==r.nc);
+      at::Tensor M=at::empty({(int64_t)linear_leaky_mask_size(x,r.nc)},at::kByte);
+      set_linear_leaky(r,x,W.data_ptr<float>(),B.data_ptr<float>(),alpha,M.data_ptr<uint8_t>());
+      return M;});
+
+  m.def("add_linear_leaky_back",[](PTENSORS& x, const cnine::loose_ptr<PTENSORS>& _g, at::Tensor& w, 
+      const float alpha, at::Tensor& mask){
+      const PTENSORS& g=_g;
+      at::Tensor W=w.detach().to(at::kFloat).cpu().contiguous();
+      at::Tensor WG=at::zeros({x.nc,g.nc},at::kFloat);
+      at::Tensor BG=at::zeros({g.nc},at::kFloat);
+      PTENS_ASSRT((size_t)mask.numel()==linear_leaky_mask_size(x,g.nc));
+      add_linear_leaky_back(x.get_grad(),WG.data_ptr<float>(),BG.data_ptr<float>(),g,x,W.data_ptr<float>(),
+	alpha,mask.data_ptr<uint8_t>());
+      return std::make_pair(WG.to(w.device()),BG.to(w.device()));});
+};
+
+bind_linear_leaky((Ptensors0*)nullptr);
+bind_linear_leaky((Ptensors1*)nullptr);
+bind_linear_leaky((Ptensors2*)nullptr);
@@ -2,13 +2,36 @@ pybind11::class_<ptens::Ggraph>(m,"ggraph")
 
   .def(pybind11::init<const at::Tensor&>())
 
-  .def_static("edge_index",[](const at::Tensor& x, const int n=-1){
-      return Ggraph::edges(cnine::RtensorA(x),n);})
+  .def_static("edge_index",[](const at::Tensor& x, const int n, const bool symmetrize){
+      if(!x.is_floating_point() || symmetrize) return Ggraph(new Hgraph(hgraph_from_edge_index(x,n,symmetrize)));
+      return Ggraph::edges(cnine::RtensorA(x),n);},
+    py::arg("M"),py::arg("n")=-1,py::arg("symmetrize")=false)
 
   .def_static("random",static_cast<Ggraph(*)(const int, const float)>(&ptens::Ggraph::random))
+  .def_static("batch",&Ggraph::batch)
+
+  .def("is_batch",&Ggraph::is_batch)
+  .def("nmembers",&Ggraph::nmembers)
+  .def("offsets",[](const Ggraph& G){return G.offsets;})
+
+  .def("shared",&Ggraph::shared)
+  .def("is_shared",&Ggraph::is_shared)
+  .def("freeze",&Ggraph::freeze)
+
+  .def("nhoods",[](const Ggraph& G, const int i, const int max_size, const int seed){
+      return G.nhoods(i,max_size,seed);},py::arg("l"),py::arg("max_size")=-1,py::arg("seed")=0)
+  .def("edges",[](const Ggraph& G){return G.edges();})
 
   .def("dense",[](const Ggraph& G){return G.dense().torch();})
 
+  .def("subgraph_counts",[](const Ggraph& G, const Subgraph& S){
+      return SubgraphCounts(*G.obj,*S.obj).vertex_tensor().torch();
+    })
+
+  .def("subgraph_edge_counts",[](const Ggraph& G, const Subgraph& S){
+      return SubgraphCounts(*G.obj,*S.obj,true).edge_tensor().torch();
+    })
+
   .def("str",&Ggraph::str,py::arg("indent")="")
   .def("__str__",&Ggraph::str,py::arg("indent")="");
 
@@ -1,7 +1,9 @@
 pybind11::class_<Hgraph>(m,"graph")
 
-  .def_static("edge_index",[](const at::Tensor& x, const int n=-1){
-      return Hgraph::edge_index(cnine::RtensorA(x),n);})
+  .def_static("edge_index",[](const at::Tensor& x, const int n, const bool symmetrize){
+      if(!x.is_floating_point() || symmetrize) return hgraph_from_edge_index(x,n,symmetrize);
+      return Hgraph::edge_index(cnine::RtensorA(x),n);},
+    py::arg("M"),py::arg("n")=-1,py::arg("symmetrize")=false)
   .def_static("edge_index",[](const at::Tensor& x, const int n, const int m){
       return Hgraph::edge_index(cnine::RtensorA(x),n,m);})
 
@@ -16,9 +18,11 @@ pybind11::class_<Hgraph>(m,"graph")
   .def_static("random",static_cast<Hgraph(*)(const int, const float)>(&Hgraph::random))
   .def_static("randomd",static_cast<Hgraph(*)(const int, const float)>(&Hgraph::randomd))
 
-  .def("nhoods",&Hgraph::nhoods)
+  .def("nhoods",&Hgraph::nhoods,py::arg("l"),py::arg("max_size")=-1,py::arg("seed")=0)
   .def("edges",&Hgraph::edges)
   .def("set",&Hgraph::set)
+  .def("freeze",[](const Hgraph& G){G.freeze();})
+  .def("is_frozen",&Hgraph::is_frozen)
 
   .def("dense",[](const Hgraph& G){return G.dense().torch();})
 
@@ -28,6 +32,14 @@ pybind11::class_<Hgraph>(m,"graph")
       return AtomsPack(CachedPlantedSubgraphs()(G,H));
     })
 
+  .def("subgraph_counts",[](const Hgraph& G, const Subgraph& S){
+      return SubgraphCounts(G,*S.obj).vertex_tensor().torch();
+    })
+
+  .def("subgraph_edge_counts",[](const Hgraph& G, const Subgraph& S){
+      return SubgraphCounts(G,*S.obj,true).edge_tensor().torch();
+    })
+
   .def("str",&Hgraph::str,py::arg("indent")="")
   .def("__str__",&Hgraph::str,py::arg("indent")="");
 
@@ -0,0 +1,31 @@
+pybind11::class_<PtensArchive>(m,"archive")
+
+  .def(py::init<const string>())
+
+  .def("__len__",&PtensArchive::nrec)
+  .def("type",[](const PtensArchive& x, const int i){
+      switch(x.type(i)){
+      case PtensArchive::ATOMS: return string("atoms");
+      case PtensArchive::AINDEX: return string("aindex");
+      case PtensArchive::GRAPH: return string("graph");
+      }
+      return string("unknown");})
+
+  // The returned atomspack points into the mapped file, so it keeps the archive alive
+  .def("atoms",&PtensArchive::atoms,py::keep_alive<0,1>())
+  .def("graph",&PtensArchive::graph)
+  .def("ggraph",[](const PtensArchive& x, const int i){return Ggraph(new Hgraph(x.graph(i)));})
+
+  .def("__str__",&PtensArchive::repr)
+  .def("__repr__",&PtensArchive::repr);
+
+
+pybind11::class_<PtensArchiveWriter>(m,"archive_writer")
+
+  .def(py::init<const string>())
+
+  .def("add",[](PtensArchiveWriter& w, const AtomsPack& x){return w.add(x);})
+  .def("add",[](PtensArchiveWriter& w, const Hgraph& x){return w.add(x);})
+  .def("add",[](PtensArchiveWriter& w, const Ggraph& x){return w.add(*x.obj);})
+  .def("close",&PtensArchiveWriter::close);
+
@@ -0,0 +1,44 @@
+{
+  auto engine=pybind11::class_<PtensSharedEngine>(m,"shared_engine")
+
+    .def(pybind11::init<const Hgraph&, const int, const bool, const int>(),
+      py::arg("G"),py::arg("k"),py::arg("pin")=false,py::arg("nthreads")=-1)
+
+    .def("start",&PtensSharedEngine::start)
+    .def("shutdown",&PtensSharedEngine::shutdown)
+    .def("is_started",&PtensSharedEngine::is_started)
+
+    .def("str",[](const PtensSharedEngine& x){return x.repr();})
+    .def("__str__",[](const PtensSharedEngine& x){return x.repr();})
+    .def("__repr__",&PtensSharedEngine::repr);
+
+  // The workers do not touch Python objects, so the GIL is released while they run
+  auto bind_input=[&](auto xtag){
+    typedef typename std::remove_pointer<decltype(xtag)>::type XPACK;
+
+    engine.def("transfer0",[](PtensSharedEngine& e, const XPACK& x, const AtomsPack& atoms, const bool normalized){
+	return e.transfer<Ptensors0>(x,atoms,normalized);},
+      py::arg("x"),py::arg("atoms"),py::arg("normalized")=false,py::call_guard<py::gil_scoped_release>());
+    engine.def("transfer1",[](PtensSharedEngine& e, const XPACK& x, const AtomsPack& atoms, const bool normalized){
+	return e.transfer<Ptensors1>(x,atoms,normalized);},
+      py::arg("x"),py::arg("atoms"),py::arg("normalized")=false,py::call_guard<py::gil_scoped_release>());
+    engine.def("transfer2",[](PtensSharedEngine& e, const XPACK& x, const AtomsPack& atoms, const bool normalized){
+	return e.transfer<Ptensors2>(x,atoms,normalized);},
+      py::arg("x"),py::arg("atoms"),py::arg("normalized")=false,py::call_guard<py::gil_scoped_release>());
+
+    auto bind_output=[&](auto rtag){
+      typedef typename std::remove_pointer<decltype(rtag)>::type RPACK;
+      engine.def("add_msg_back",[](PtensSharedEngine& e, loose_ptr<XPACK>& xg, const loose_ptr<RPACK>& rg, const bool normalized){
+	  XPACK& _xg=xg;
+	  const RPACK& _rg=rg;
+	  e.add_msg_back(_xg,_rg,normalized);},
+	py::arg("xgrad"),py::arg("rgrad"),py::arg("normalized")=false,py::call_guard<py::gil_scoped_release>());
+    };
+    bind_output((Ptensors0*)nullptr);
+    bind_output((Ptensors1*)nullptr);
+    bind_output((Ptensors2*)nullptr);
+  };
+  bind_input((Ptensors0*)nullptr);
+  bind_input((Ptensors1*)nullptr);
+  bind_input((Ptensors2*)nullptr);
+}
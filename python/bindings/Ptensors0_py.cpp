@@ -60,6 +60,9 @@ pybind11::class_<Ptensors0/*,cnine::RtensorPack*/>(m,"ptensors0")
   .def("get_grad",&Ptensors0::get_grad)
   .def("get_gradp",&Ptensors0::get_gradp)
   .def("gradp",&Ptensors0::get_gradp)
+  .def("has_grad",&Ptensors0::has_grad)
+  .def("free_grad",&Ptensors0::free_grad)
+  .def("move_grad_to",[](Ptensors0& r, Ptensors0& x){if(r.has_grad()) x.add_to_grad(r.take_grad());})
 
   .def("add_to_grad",[](Ptensors0& x, const int i, at::Tensor& T){
       x.get_grad().view_of_tensor(i).add(RtensorA::view(T));
@@ -85,7 +88,7 @@ pybind11::class_<Ptensors0/*,cnine::RtensorPack*/>(m,"ptensors0")
 
   .def("to_device",&Ptensors0::to_device)
   .def("move_to_device_back",[](Ptensors0& x, const cnine::loose_ptr<Ptensors0>& g, const int dev){
-      if(!x.grad) x.grad=new Ptensors0(g,dev);
+      if(!x.grad) x.adopt_grad(new Ptensors0(g,dev));
       else x.grad->add(Ptensors0(g,dev));})
 
 
@@ -153,8 +156,8 @@ pybind11::class_<Ptensors0/*,cnine::RtensorPack*/>(m,"ptensors0")
 
   .def("add_ReLU",[](Ptensors0& r, const Ptensors0& x, const float alpha){
       r.add_ReLU(x,alpha);})
-  .def("add_ReLU_back",[](Ptensors0& x, const cnine::loose_ptr<Ptensors0>& g, const float alpha){
-      x.get_grad().add_ReLU_back(g,x,alpha);}) // forward is same as backward
+  .def("add_ReLU_back",[](Ptensors0& x, Ptensors0& r, const float alpha){
+      x.add_ReLU_back_from(r,alpha);})
 
   .def("inp",[](const Ptensors0& x, const Ptensors0& y){return x.inp(y);})
   .def("diff2",[](const Ptensors0& x, const Ptensors0& y){return x.diff2(y);})
@@ -46,6 +46,9 @@ pybind11::class_<Ptensors1/*,cnine::RtensorPack*/>(m,"ptensors1")
   .def("get_grad",&Ptensors1::get_grad)
   .def("get_gradp",&Ptensors1::get_gradp)
   .def("gradp",&Ptensors1::get_gradp)
+  .def("has_grad",&Ptensors1::has_grad)
+  .def("free_grad",&Ptensors1::free_grad)
+  .def("move_grad_to",[](Ptensors1& r, Ptensors1& x){if(r.has_grad()) x.add_to_grad(r.take_grad());})
   .def("add_to_grad",[](Ptensors1& x, const int i, at::Tensor& T){
       x.get_grad().view_of_tensor(i).add(RtensorA::view(T));})
 
@@ -73,7 +76,7 @@ pybind11::class_<Ptensors1/*,cnine::RtensorPack*/>(m,"ptensors1")
   .def("to_device",&Ptensors1::to_device)
   .def("move_to_device",&Ptensors1::to_device)
   .def("move_to_device_back",[](Ptensors1& x, const cnine::loose_ptr<Ptensors1>& g, const int dev){
-      if(!x.grad) x.grad=new Ptensors1(g,dev);
+      if(!x.grad) x.adopt_grad(new Ptensors1(g,dev));
       else x.grad->add(Ptensors1(g,dev));})
 
 
@@ -131,8 +134,8 @@ pybind11::class_<Ptensors1/*,cnine::RtensorPack*/>(m,"ptensors1")
 
   .def("add_ReLU",[](Ptensors1& r, const Ptensors1& x, const float alpha){
       r.add_ReLU(x,alpha);})
-  .def("add_ReLU_back",[](Ptensors1& x, const cnine::loose_ptr<Ptensors1>& g, const float alpha){
-      x.get_grad().add_ReLU_back(g,x,alpha);})
+  .def("add_ReLU_back",[](Ptensors1& x, Ptensors1& r, const float alpha){
+      x.add_ReLU_back_from(r,alpha);})
 
   .def("inp",[](const Ptensors1& x, const Ptensors1& y){return x.inp(y);})
   .def("diff2",[](const Ptensors1& x, const Ptensors1& y){return x.diff2(y);})
@@ -44,6 +44,9 @@ pybind11::class_<Ptensors2/*,cnine::RtensorPack*/>(m,"ptensors2")
   .def("get_grad",&Ptensors2::get_grad)
   .def("get_gradp",&Ptensors2::get_gradp)
   .def("gradp",&Ptensors2::get_gradp)
+  .def("has_grad",&Ptensors2::has_grad)
+  .def("free_grad",&Ptensors2::free_grad)
+  .def("move_grad_to",[](Ptensors2& r, Ptensors2& x){if(r.has_grad()) x.add_to_grad(r.take_grad());})
 //  .def("view_of_grad",&Ptensors2::view_of_grad)
 
   .def("add_to_grad",[](Ptensors2& x, const int i, at::Tensor& T){
@@ -66,7 +69,7 @@ pybind11::class_<Ptensors2/*,cnine::RtensorPack*/>(m,"ptensors2")
 
   .def("to_device",&Ptensors2::to_device)
   .def("move_to_device_back",[](Ptensors2& x, const cnine::loose_ptr<Ptensors2>& g, const int dev){
-      if(!x.grad) x.grad=new Ptensors2(g,dev);
+      if(!x.grad) x.adopt_grad(new Ptensors2(g,dev));
       else x.grad->add(Ptensors2(g,dev));})
 
 
@@ -127,8 +130,8 @@ pybind11::class_<Ptensors2/*,cnine::RtensorPack*/>(m,"ptensors2")
 
   .def("add_ReLU",[](Ptensors2& r, const Ptensors2& x, const float alpha){
       r.add_ReLU(x,alpha);})
-  .def("add_ReLU_back",[](Ptensors2& x, const cnine::loose_ptr<Ptensors2>& g, const float alpha){
-      x.get_grad().add_ReLU_back(g,x,alpha);})
+  .def("add_ReLU_back",[](Ptensors2& x, Ptensors2& r, const float alpha){
+      x.add_ReLU_back_from(r,alpha);})
 
   .def("inp",[](const Ptensors2& x, const Ptensors2& y){return x.inp(y);})
   .def("diff2",[](const Ptensors2& x, const Ptensors2& y){return x.diff2(y);})
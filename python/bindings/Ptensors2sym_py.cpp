@@ -0,0 +1,42 @@
+pybind11::class_<Ptensors2sym>(m,"ptensors2sym")
+
+  .def(pybind11::init<const Ptensors2&>())
+  .def("ptensors2",&Ptensors2sym::ptensors2)
+
+  .def("get_grad",[](Ptensors2sym& x){return Ptensors2sym(x.get_grad());})
+  .def("gradp",[](Ptensors2sym& x){return &x.get_grad();},py::return_value_policy::reference)
+  .def("has_grad",&Ptensors2sym::has_grad)
+  .def("free_grad",&Ptensors2sym::free_grad)
+
+  .def("get_nc",&Ptensors2sym::get_nc)
+  .def("get_atoms",[](const Ptensors2sym& x){return x.atoms.as_vecs();})
+  .def("__len__",&Ptensors2sym::size)
+  .def("memory_bytes",&Ptensors2sym::memory_bytes)
+
+  .def("add",&Ptensors2sym::add)
+  .def("inp",&Ptensors2sym::inp)
+
+  .def("linmaps0",&Ptensors2sym::linmaps0,py::arg("normalized")=false)
+  .def("linmaps1",&Ptensors2sym::linmaps1,py::arg("normalized")=false)
+  .def("linmaps2",&Ptensors2sym::linmaps2,py::arg("normalized")=false)
+
+  .def("add_linmaps0_back",&Ptensors2sym::add_linmaps0_back,py::arg("g"),py::arg("normalized")=false)
+  .def("add_linmaps1_back",&Ptensors2sym::add_linmaps1_back,py::arg("g"),py::arg("normalized")=false)
+  .def("add_linmaps2_back",&Ptensors2sym::add_linmaps2_back,py::arg("g"),py::arg("normalized")=false)
+  .def("add_ptensors2_back",&Ptensors2sym::add_ptensors2_back)
+  .def("add_symmetrize_back",&Ptensors2sym::add_symmetrize_back)
+
+  .def("str",&Ptensors2sym::str,py::arg("indent")="")
+  .def("__str__",&Ptensors2sym::str,py::arg("indent")="")
+  .def("__repr__",&Ptensors2sym::repr);
+
+
+m.def("add_msg",[](Ptensors0& r, const Ptensors2sym& x, const Hgraph& G, const bool normalized){return add_msg(r,x,G,normalized);}, 
+  py::arg("r"), py::arg("x"), py::arg("G"), py::arg("normalized")=false);
+m.def("add_msg",[](Ptensors1& r, const Ptensors2sym& x, const Hgraph& G, const bool normalized){return add_msg(r,x,G,normalized);}, 
+  py::arg("r"), py::arg("x"), py::arg("G"), py::arg("normalized")=false);
+
+m.def("add_msg_back",[](Ptensors2sym& r, const Ptensors0& x, const Hgraph& G, const bool normalized){return add_msg_back(r,x,G,normalized);}, 
+  py::arg("r"), py::arg("x"), py::arg("G"), py::arg("normalized")=false);
+m.def("add_msg_back",[](Ptensors2sym& r, const Ptensors1& x, const Hgraph& G, const bool normalized){return add_msg_back(r,x,G,normalized);}, 
+  py::arg("r"), py::arg("x"), py::arg("G"), py::arg("normalized")=false);
@@ -0,0 +1,35 @@
+// The bfloat16 and float16 layers have identical interfaces
+auto bind_ptensorsH=[&](auto dummy, const char* name){
+  typedef PtensorsH<decltype(dummy)> PTENSORS;
+
+  pybind11::class_<PTENSORS>(m,name)
+
+  .def(pybind11::init<const Ptensors0&>())
+  .def(pybind11::init<const Ptensors1&>())
+  .def(pybind11::init<const Ptensors2&>())
+
+  .def("ptensors0",&PTENSORS::ptensors0)
+  .def("ptensors1",&PTENSORS::ptensors1)
+  .def("ptensors2",&PTENSORS::ptensors2)
+
+  .def("getk",&PTENSORS::getk)
+  .def("get_nc",&PTENSORS::get_nc)
+  .def("get_atoms",[](const PTENSORS& x){return x.atoms.as_vecs();})
+  .def("__len__",&PTENSORS::size)
+  .def("memory_bytes",&PTENSORS::memory_bytes)
+
+  .def("linmaps0",&PTENSORS::linmaps0,py::arg("normalized")=false)
+  .def("linmaps1",&PTENSORS::linmaps1,py::arg("normalized")=false)
+  .def("linmaps2",&PTENSORS::linmaps2,py::arg("normalized")=false)
+
+  .def("add_msg",&PTENSORS::add_msg,py::arg("x"),py::arg("G"),py::arg("offs")=0,py::arg("normalized")=false)
+  .def("unite1",&PTENSORS::unite1,py::arg("G"),py::arg("normalized")=false)
+  .def("unite2",&PTENSORS::unite2,py::arg("G"),py::arg("normalized")=false)
+
+  .def("str",&PTENSORS::str,py::arg("indent")="")
+  .def("__str__",&PTENSORS::str,py::arg("indent")="")
+  .def("__repr__",&PTENSORS::repr);
+};
+
+bind_ptensorsH(bfloat16(),"ptensors_bf16");
+bind_ptensorsH(float16(),"ptensors_fp16");
@@ -33,7 +33,7 @@ pybind11::class_<SGlayer0,Ptensors0>(m,"subgraph_layer0")
 
   .def("ptensors0",[](const SGlayer0& x){return Ptensors0(x);})
   .def("toPtensors0_back",[](SGlayer0& x, Ptensors0& r){
-      if(!x.grad) x.grad=new Ptensors0(r.get_grad());
+      if(!x.grad) x.adopt_grad(new Ptensors0(r.get_grad()));
       else x.grad->add(r.get_grad());})
 
   .def("torch",[](const SGlayer0& x){return x.tensor().torch();})
@@ -42,7 +42,7 @@ pybind11::class_<SGlayer0,Ptensors0>(m,"subgraph_layer0")
 
   .def("to_device",[](SGlayer0& x, const int dev){return SGlayer0(x,dev);})
   .def("to_device_back",[](SGlayer0& x, SGlayer0& g, const int dev){
-      if(!x.grad) x.grad=new Ptensors0(g.get_grad(),dev);
+      if(!x.grad) x.adopt_grad(new Ptensors0(g.get_grad(),dev));
       else x.grad->add(g.get_grad(),dev);})
 
 
@@ -36,7 +36,7 @@ pybind11::class_<SGlayer1,Ptensors1>(m,"subgraph_layer1")
 
   .def("ptensors1",[](const SGlayer1& x){return Ptensors1(x);})
   .def("toPtensors1_back",[](SGlayer1& x, Ptensors1& r){
-      if(!x.grad) x.grad=new Ptensors1(r.get_grad());
+      if(!x.grad) x.adopt_grad(new Ptensors1(r.get_grad()));
       else x.grad->add(r.get_grad());})
 
   .def("torch",[](const SGlayer1& x){return x.tensor().torch();})
@@ -47,7 +47,7 @@ pybind11::class_<SGlayer1,Ptensors1>(m,"subgraph_layer1")
 
   .def("to_device",[](SGlayer1& x, const int dev){return SGlayer1(x,dev);})
   .def("to_device_back",[](SGlayer1& x, SGlayer1& g, const int dev){
-      if(!x.grad) x.grad=new Ptensors1(g.get_grad(),dev);
+      if(!x.grad) x.adopt_grad(new Ptensors1(g.get_grad(),dev));
       else x.grad->add(g.get_grad(),dev);})
 
 
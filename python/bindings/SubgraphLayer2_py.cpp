@@ -32,7 +32,7 @@ pybind11::class_<SGlayer2,Ptensors2>(m,"subgraph_layer2")
 
   .def("ptensors2",[](const SGlayer2& x){return Ptensors2(x);})
   .def("toPtensors2_back",[](SGlayer2& x, Ptensors2& r){
-      if(!x.grad) x.grad=new Ptensors2(r.get_grad());
+      if(!x.grad) x.adopt_grad(new Ptensors2(r.get_grad()));
       else x.grad->add(r.get_grad());})
 
   .def("torch",[](const SGlayer2& x){return x.tensor().torch();})
@@ -41,7 +41,7 @@ pybind11::class_<SGlayer2,Ptensors2>(m,"subgraph_layer2")
 
   .def("to_device",[](SGlayer2& x, const int dev){return SGlayer2(x,dev);})
   .def("move_to_device_back",[](SGlayer2& x, SGlayer2& g, const int dev){
-      if(!x.grad) x.grad=new Ptensors2(g.get_grad(),dev);
+      if(!x.grad) x.adopt_grad(new Ptensors2(g.get_grad(),dev));
       else x.grad->add(g.get_grad(),dev);})
 
 
@@ -8,6 +8,7 @@
 
 #include "Hgraph.hpp"
 #include "Ggraph.hpp"
+#include "PtensArchive.hpp"
 #include "Subgraph.hpp"
 #include "Ptensor0.hpp"
 #include "Ptensor1.hpp"
@@ -15,15 +16,20 @@
 #include "Ptensors0.hpp"
 #include "Ptensors1.hpp"
 #include "Ptensors2.hpp"
+#include "PtensorsH.hpp"
+#include "Ptensors2sym.hpp"
+#include "PtensSharedEngine.hpp"
 
 #include "LinmapFunctions.hpp"
 #include "MsgFunctions.hpp"
 #include "PtensFindPlantedSubgraphs.hpp"
+#include "PtensSubgraphCounts.hpp"
 
 #include "GatherLayers.hpp"
 #include "LinmapLayers.hpp"
 #include "EMPlayers.hpp"
 #include "OuterLayers.hpp"
+#include "FusedLayers.hpp"
 #include "ConcatLayers.hpp"
 
 #include "SubgraphLayer0.hpp"
@@ -33,6 +39,19 @@
 
 namespace ptens{ 
   PtensSession ptens_session;
+
+  // Integer edge_index tensors (as produced by PyG) are loaded by the bulk constructor directly
+  inline Hgraph hgraph_from_edge_index(const at::Tensor& _x, const int n, const bool symmetrize){
+    PTENS_ASSRT(_x.dim()==2 && _x.size(0)==2);
+    if(_x.scalar_type()==at::kInt){
+      at::Tensor x=_x.cpu().contiguous();
+      const int* p=x.data_ptr<int>();
+      return Hgraph::edge_index(p,p+x.size(1),x.size(1),n,symmetrize);
+    }
+    at::Tensor x=_x.cpu().to(at::kLong).contiguous();
+    const int64_t* p=x.data_ptr<int64_t>();
+    return Hgraph::edge_index(p,p+x.size(1),x.size(1),n,symmetrize);
+  }
 }
 
 PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
@@ -43,9 +62,22 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
   namespace py=pybind11;
   
 
+  m.def("cache_stats",[](){return ptens_cache().stats();});
+  m.def("set_cache_budget",[](const size_t nbytes){ptens_cache().set_budget(nbytes);});
+  m.def("clear_cache",[](){ptens_cache().clear();});
+  m.def("reset_cache_stats",[](){ptens_cache().reset_stats();});
+  m.def("graph_registry_stats",[](){return ptens_graph_registry().stats();});
+
+  m.def("memory_stats",[](){return ptens_session.memory_stats();});
+  m.def("memory_op_stats",[](){return ptens_session.memory_op_stats();});
+  m.def("set_memory_accounting",[](const bool x){ptens_session.set_memory_accounting(x);});
+  m.def("set_memory_profiling",[](const bool x){ptens_session.set_memory_profiling(x);});
+  m.def("reset_memory_peaks",[](){ptens_session.reset_memory_peaks();});
+
   #include "AtomsPack_py.cpp"
   #include "Hgraph_py.cpp"
   #include "Ggraph_py.cpp"
+  #include "PtensArchive_py.cpp"
   #include "Subgraph_py.cpp"
 
   #include "Ptensor0_py.cpp"
@@ -55,10 +87,14 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
   #include "Ptensors0_py.cpp"
   #include "Ptensors1_py.cpp"
   #include "Ptensors2_py.cpp"
+  #include "PtensorsH_py.cpp"
+  #include "Ptensors2sym_py.cpp"
+  #include "PtensSharedEngine_py.cpp"
 
   #include "LinmapFunctions_py.cpp"
   #include "MsgFunctions_py.cpp"
   #include "OuterFunctions_py.cpp"
+  #include "FusedFunctions_py.cpp"
 
   #include "SubgraphLayer0_py.cpp"
   #include "SubgraphLayer1_py.cpp"
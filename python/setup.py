@@ -1,4 +1,5 @@
 import os
+import platform
 import torch
 from setuptools import setup
 from setuptools import find_packages
@@ -21,6 +22,10 @@ def main():
     copy_warnings = False
     torch_convert_warnings = False
 
+    # Compile for the host CPU, which enables the AVX-512 BF16 and F16C conversions used by the
+    # 16 bit layers
+    native_simd = False
+
     # ------------------------------------------------------------------------------------------------------------
     
     #if 'CUDAHOME' in os.environ:
@@ -94,6 +99,9 @@ def main():
             '-DPTENS_MOVE_WARNINGS',
         ])
 
+    if native_simd:
+        _cxx_compile_args.extend(['-march=native'])
+
     if torch_convert_warnings:
         _cxx_compile_args.extend([
             '-DCNINE_ATEN_CONVERT_WARNINGS'
@@ -106,6 +114,11 @@ def main():
                 'bindings/*'
                 ]
 
+    # shm_open, used by the shared memory engine, lives in librt on older Linux systems
+    _link_args = []
+    if platform.system() == 'Linux':
+        _link_args.append('-lrt')
+
 
     # ---- Compilation commands ----------------------------------------------------------------------------------
 
@@ -125,6 +138,7 @@ def main():
             extra_compile_args={
             'nvcc': _nvcc_compile_args,
             'cxx': _cxx_compile_args},
+            extra_link_args=_link_args,
             depends=_depends
         )]
     else:
@@ -133,6 +147,7 @@ def main():
                                     # sources=sources,
                                     extra_compile_args={
                                         'cxx': _cxx_compile_args},
+                                    extra_link_args=_link_args,
                                     depends=_depends
                                     )]
 
@@ -34,10 +34,14 @@ from ptens.ptensor2 import ptensor2 as ptensor2
 from ptens.ptensors0 import ptensors0 as ptensors0
 from ptens.ptensors1 import ptensors1 as ptensors1
 from ptens.ptensors2 import ptensors2 as ptensors2
+from ptens.ptensorsh import ptensorsh as ptensorsh
+from ptens.ptensors2sym import ptensors2sym as ptensors2sym
 
 from ptens.graph import graph as graph
 from ptens.ggraph import ggraph as ggraph
 from ptens.subgraph import subgraph as subgraph
+from ptens.archive import archive as archive
+from ptens.shared_engine import shared_engine as shared_engine
 
 from ptens.subgraphlayer0 import subgraphlayer0 as subgraphlayer0
 from ptens.subgraphlayer1 import subgraphlayer1 as subgraphlayer1
@@ -0,0 +1,52 @@
+#
+# This file is part of ptens, a C++/CUDA library for permutation 
+# equivariant message passing. 
+#  
+# Copyright (c) 2023, Imre Risi Kondor
+#
+# This source code file is subject to the terms of the noncommercial 
+# license distributed with cnine in the file LICENSE.TXT. Commercial 
+# use is prohibited. All redistributed versions of this file (in 
+# original or modified form) must retain this copyright notice and 
+# must be accompanied by a verbatim copy of the license. 
+#
+#
+import ptens_base
+from ptens_base import archive as _archive
+from ptens_base import archive_writer as _archive_writer
+from ptens.ggraph import ggraph
+
+
+class archive:
+    """Memory mapped file of precomputed graphs and atomspacks. The atomspacks point directly into
+    the mapping, so workers that open the same file share its pages."""
+
+    def __init__(self,filename):
+        self.obj=_archive(filename)
+
+    @classmethod
+    def write(self,filename,items):
+        W=_archive_writer(filename)
+        for x in items:
+            if isinstance(x,ggraph):
+                W.add(x.obj)
+            else:
+                W.add(x)
+        W.close()
+
+    def __len__(self):
+        return len(self.obj)
+
+    def type(self,i):
+        return self.obj.type(i)
+
+    def atoms(self,i):
+        return self.obj.atoms(i)
+
+    def graph(self,i):
+        G=ggraph()
+        G.obj=self.obj.ggraph(i)
+        return G
+
+    def __repr__(self):
+        return self.obj.__repr__()
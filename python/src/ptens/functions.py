@@ -14,6 +14,7 @@
 
 import torch
 
+import ptens_base
 import ptens.subgraphlayer0
 
 
@@ -26,6 +27,9 @@ def linear(x,y,b):
 def relu(x,alpha=0.5):
     return x.relu(alpha)
 
+def linear_act(x,y,b,alpha=0.5):
+    return x.linear_act(y,b,alpha)
+
 
 def linmaps0(x,normalized=False):
     return x.linmaps0(normalized)
@@ -60,6 +64,48 @@ def outer(x,y):
     return x.outer(y)
 
 
+# ---- Subgraph cache ---------------------------------------------------------------------------------------
+
+
+def cache_stats():
+    return ptens_base.cache_stats()
+
+def set_cache_budget(nbytes):
+    ptens_base.set_cache_budget(nbytes)
+
+def clear_cache():
+    ptens_base.clear_cache()
+
+def reset_cache_stats():
+    ptens_base.reset_cache_stats()
+
+def graph_registry_stats():
+    return ptens_base.graph_registry_stats()
+
+
+# ---- Memory accounting ------------------------------------------------------------------------------------
+
+
+def memory_stats():
+    """Current and peak bytes held by features, gradients, indices, caches and temporaries."""
+    return ptens_base.memory_stats()
+
+def memory_op_stats():
+    """Peak bytes allocated by each operation while memory profiling was on."""
+    return ptens_base.memory_op_stats()
+
+def set_memory_accounting(on=True):
+    """Track the bytes held by layers, atoms and index packs constructed from now on."""
+    ptens_base.set_memory_accounting(on)
+
+def set_memory_profiling(on=True):
+    """Record per operation peaks. Also turns accounting on."""
+    ptens_base.set_memory_profiling(on)
+
+def reset_memory_peaks():
+    ptens_base.reset_memory_peaks()
+
+
 def device_id(device):
     if device==0:
         return 0
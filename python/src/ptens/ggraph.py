@@ -19,15 +19,17 @@ from ptens_base import ggraph as _ggraph
 class ggraph:
 
     @classmethod
-    def from_edge_index(self,M,n=-1,labels=None,m=None):
+    def from_edge_index(self,M,n=-1,labels=None,m=None,symmetrize=False,shared=False):
         G=ggraph()
         if labels is None:
             if m is None:
-                G.obj=_ggraph.edge_index(M,n)
+                G.obj=_ggraph.edge_index(M,n,symmetrize)
             else:
                 G.obj=_ggraph.edge_index(M,n,m)
         else:
             G.obj=_ggraph.edge_index(M,labels,n)
+        if shared:
+            G.obj=G.obj.shared()
         return G
 
     @classmethod
@@ -39,15 +41,44 @@ class ggraph:
             G.obj=_ggraph.matrix(M,labels)
         return G
 
+    @classmethod
+    def batch(self,graphs):
+        G=ggraph()
+        G.obj=_ggraph.batch([x.obj for x in graphs])
+        return G
+
     @classmethod
     def random(self,_n,_p):
         G=ggraph()
         G.obj=_ggraph.random(_n,_p)
         return G
 
+    def offsets(self):
+        return self.obj.offsets()
+
+    def shared(self):
+        G=ggraph()
+        G.obj=self.obj.shared()
+        return G
+
+    def freeze(self):
+        self.obj.freeze()
+        return self
+
+    def nhoods(self,l,max_size=-1,seed=0):
+        return self.obj.nhoods(l,max_size,seed)
+
+    def edges(self):
+        return self.obj.edges()
+
     def torch(self):
         return self.obj.dense()
 
+    def subgraph_counts(self,S,edges=False):
+        if edges:
+            return self.obj.subgraph_edge_counts(S.obj)
+        return self.obj.subgraph_counts(S.obj)
+
     def __str__(self):
         return self.obj.__str__()
 
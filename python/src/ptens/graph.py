@@ -19,11 +19,11 @@ from ptens_base import graph as _graph
 class graph:
 
     @classmethod
-    def from_edge_index(self,M,n=-1,labels=None,m=None):
+    def from_edge_index(self,M,n=-1,labels=None,m=None,symmetrize=False):
         G=graph()
         if labels is None:
             if m is None:
-                G.obj=_graph.edge_index(M,n)
+                G.obj=_graph.edge_index(M,n,symmetrize)
             else:
                 G.obj=_graph.edge_index(M,n,m)
         else:
@@ -60,15 +60,24 @@ class graph:
     def torch(self):
         return self.obj.dense()
 
-    def nhoods(self,_l):
-        return self.obj.nhoods(_l)
+    def nhoods(self,_l,max_size=-1,seed=0):
+        return self.obj.nhoods(_l,max_size,seed)
 
     def edges(self):
         return self.obj.edges()
 
+    def freeze(self):
+        self.obj.freeze()
+        return self
+
     def subgraphs(self,H):
         return self.obj.subgraphs(H.obj)
 
+    def subgraph_counts(self,S,edges=False):
+        if edges:
+            return self.obj.subgraph_edge_counts(S.obj)
+        return self.obj.subgraph_counts(S.obj)
+
     def __str__(self):
         return self.obj.__str__()
 
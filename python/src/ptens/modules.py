@@ -9,7 +9,7 @@ import ptens
 from ptens import ptensors0, ptensors1, ptensors2, graph
 from warnings import warn
 from ptens_base import atomspack
-from ptens.functions import linear, linmaps0, outer, unite1, unite2, gather, relu #, cat
+from ptens.functions import linear, linear_act, linmaps0, linmaps1, linmaps2, outer, unite1, unite2, gather, relu #, cat
 ######################################## Functions ###########################################
 def get_edge_maps(edge_index: torch.Tensor, num_nodes: Optional[int] = None) -> Tuple[ptens.graph,ptens.graph]:
   if num_nodes is None:
@@ -47,6 +47,69 @@ def ComputeSubstructureMap(source_domains: atomspack, graph_filter: graph, G: gr
   info = MapInfo(*info,subgraph=graph.overlaps(subgraphs,subgraphs) if include_subgraph_graph else None)
   return info
 
+##################################### CHECKPOINTING ########################################
+
+CheckpointPolicy = Union[bool,Literal['auto']]
+
+class CheckpointFn(torch.autograd.Function):
+  r"""
+  Runs 'fn(x)' without keeping its intermediate layers and reruns it during backward. The ptens
+  autograd functions accumulate gradients in the underlying C++ objects, so the gradient of the
+  original output is moved to the recomputed output, and the rerun writes the gradient of 'x'
+  straight into 'x.obj'. Index plans (overlap graphs, gather maps) are cached on the C++ side,
+  so the rerun only repeats the arithmetic. As with reentrant torch.utils.checkpoint, the
+  parameters used by 'fn' get their gradients accumulated directly, and 'fn' must be
+  deterministic.
+  """
+  @staticmethod
+  def forward(ctx, fn, x, *params):
+    with torch.no_grad():
+      r = fn(x)
+    ctx.fn = fn
+    ctx.x_type = type(x)
+    ctx.x = x.obj
+    ctx.r = r.obj
+    ctx.nparams = len(params)
+    return r
+  @staticmethod
+  def backward(ctx, g):
+    x = ctx.x_type(1)
+    x.obj = ctx.x
+    x.requires_grad_()
+    with torch.enable_grad():
+      r = ctx.fn(x)
+    ctx.r.move_grad_to(r.obj)
+    torch.autograd.backward(r,g)
+    return (None, ctx.x_type(1)) + (None,)*ctx.nparams
+
+def checkpointed(module: torch.nn.Module, fn, x, orders: Optional[Tuple[int,int]], mult_factor=None):
+  r"""
+  Applies 'fn' (a map followed by the linear layers of 'module') to 'x', recomputing it during
+  backward if the policy of 'module' asks for it. With policy 'auto', only maps that multiply
+  the number of channels by 5 or more (those from or to second order ptensors) are recomputed.
+  'mult_factor' gives the channel factor of the map for the given orders and defaults to that of
+  unite and transfer.
+  """
+  policy = getattr(module,'checkpoint',False)
+  if policy is False or not torch.is_grad_enabled():
+    return fn(x)
+  if mult_factor is None:
+    mult_factor = _get_mult_factor
+  if policy == 'auto' and (orders is None or mult_factor(*orders) < 5):
+    return fn(x)
+  params = [p for p in module.parameters() if p.requires_grad]
+  if any(isinstance(p,torch.nn.parameter.UninitializedParameter) for p in params):
+    return fn(x)
+  return CheckpointFn.apply(fn,x,*params)
+
+def set_checkpointing(module: torch.nn.Module, policy: CheckpointPolicy = 'auto') -> None:
+  r"""
+  Sets the checkpointing policy of every submodule of 'module' that supports one.
+  """
+  for m in module.modules():
+    if hasattr(m,'checkpoint'):
+      m.checkpoint = policy
+
 ######################################## MODULES ###########################################
 
 def reset_params_recursive(module: torch.nn.Module):
@@ -122,6 +185,18 @@ class Linear(torch.nn.Module):
     # TODO: figure out why multiplication is broken.
     return linear(x,self.w,torch.zeros(self.w.size(1),device=self.w.device) if self.b is None else self.b)
 
+class LinearAct(Linear):
+  r"""
+  'Linear' followed by a leaky ReLU with slope 'alpha', computed in a single pass by the fused
+  'linear_act' op. The backward pass only keeps the signs of the pre-activations.
+  """
+  def __init__(self, in_channels: int, out_channels: int, bias: bool = True, alpha: float = 0.5) -> None:
+    super().__init__(in_channels,out_channels,bias)
+    self.alpha = alpha
+  def forward(self,x: Union[ptensors0,ptensors1,ptensors2]) -> Union[ptensors0,ptensors1,ptensors2]:
+    assert x.get_nc() == self.w.size(0), f'{x.get_nc()} != {self.w.size(0)}'
+    return linear_act(x,self.w,torch.zeros(self.w.size(1),device=self.w.device) if self.b is None else self.b,self.alpha)
+
 class LazyLinear(torch.nn.Module):
   def __init__(self,out_channels: Optional[int] = None, bias: bool = True) -> None:
     r"""
@@ -227,28 +302,56 @@ def _get_mult_factor(in_order: Literal[0,1,2], out_order: Literal[0,1,2]) -> int
     [1,5,15],
   ][in_order][out_order]
 
+def _get_linmaps_factor(in_order: Literal[0,1,2], out_order: Literal[0,1,2]) -> int:
+  return [
+    [1,1,2],
+    [1,2,5],
+    [2,5,15],
+  ][in_order][out_order]
+
+class Linmaps(torch.nn.Module):
+  def __init__(self, channels_in: int, channels_out: int, in_order: Literal[0,1,2], out_order: Literal[0,1,2], bias : bool = True, normalized : bool = False, checkpoint: CheckpointPolicy = False) -> None:
+    r"""
+    The linmaps of order 'out_order' of an order 'in_order' layer followed by a linear layer.
+    checkpoint: recompute the linmaps during backward instead of keeping them (see 'checkpointed').
+    With 'auto' this covers the maps to and from second order, up to the 15*nc channels of
+    linmaps2 on a second order layer.
+    """
+    super().__init__()
+    self.lin = Linear(channels_in*_get_linmaps_factor(in_order,out_order),channels_out,bias)
+    self.normalized = normalized
+    self.linmaps = [linmaps0,linmaps1,linmaps2][out_order]
+    self.orders = (in_order,out_order)
+    self.checkpoint = checkpoint
+  def reset_parameters(self):
+    self.lin.reset_parameters()
+  def forward(self, features: Union[ptensors0,ptensors1,ptensors2]) -> Union[ptensors0,ptensors1,ptensors2]:
+    return checkpointed(self,lambda x: self.lin(self.linmaps(x,self.normalized)),features,self.orders,_get_linmaps_factor)
+
 class Unite(torch.nn.Module):
-  def __init__(self, channels_in: int, channels_out: int, in_order: Literal[0,1,2], out_order: Literal[0,1,2], bias : bool = True, reduction_type : Literal['sum','mean'] = 'sum') -> None:
+  def __init__(self, channels_in: int, channels_out: int, in_order: Literal[0,1,2], out_order: Literal[0,1,2], bias : bool = True, reduction_type : Literal['sum','mean'] = 'sum', checkpoint: CheckpointPolicy = False) -> None:
     r"""
     reduction_types: "sum" and "mean"
     leave 'out_order' and 'channels_out' as 'None' to keep same as input
+    checkpoint: recompute the united layer during backward instead of keeping it (see 'checkpointed')
     """
     super().__init__()
     self.lin = Linear(channels_in*_get_mult_factor(in_order,out_order),channels_out,bias)
     self.use_mean = reduction_type == "mean"
     self.unite = [lambda x, G, n: linmaps0(x,n),unite1,unite2][out_order]
+    self.orders = (in_order,out_order)
+    self.checkpoint = checkpoint
 
   def reset_parameters(self):
     self.lin.reset_parameters()
   def forward(self, features: Union[ptensors0,ptensors1,ptensors2], graph: graph) -> Union[ptensors0,ptensors1,ptensors2]:
-    F = self.unite(features,graph,self.use_mean)
-    F = self.lin(F)
-    return F
+    return checkpointed(self,lambda x: self.lin(self.unite(x,graph,self.use_mean)),features,self.orders)
 class LazyUnite(torch.nn.Module):
-  def __init__(self, channels_out: Optional[int] = None, out_order: Optional[int] = None, bias : bool = True, reduction_type : Literal['sum','mean'] = 'sum') -> None:
+  def __init__(self, channels_out: Optional[int] = None, out_order: Optional[int] = None, bias : bool = True, reduction_type : Literal['sum','mean'] = 'sum', checkpoint: CheckpointPolicy = False) -> None:
     r"""
     reduction_types: "sum" and "mean"
     leave 'out_order' and 'channels_out' as 'None' to keep same as input
+    checkpoint: recompute the united layer during backward instead of keeping it (see 'checkpointed')
     """
     super().__init__()
     assert reduction_type == "sum" or reduction_type == "mean"
@@ -257,6 +360,8 @@ class LazyUnite(torch.nn.Module):
     self.use_mean = reduction_type == "mean"
     self.out_order = out_order
     self.unite = None
+    self.orders = None
+    self.checkpoint = checkpoint
   def reset_parameters(self):
     self.lin.reset_parameters()
   def forward(self, features: Union[ptensors0,ptensors1,ptensors2], graph: graph) -> Union[ptensors0,ptensors1,ptensors2]:
@@ -287,16 +392,15 @@ class LazyUnite(torch.nn.Module):
       if out_order == 0:
         q = self.unite
         self.unite = lambda x,G,n: q(x,n)
-    F = self.unite(features,graph,self.use_mean)
-    F = self.lin(F)
-    return F
+      self.orders = (in_order,out_order)
+    return checkpointed(self,lambda x: self.lin(self.unite(x,graph,self.use_mean)),features,self.orders)
 class LazySubstructureTransport(LazyUnite):
-  def __init__(self, channels_out: int, graph_filter: Union[graph,Tuple[str,int],None] = None, out_order: Optional[int] = None, bias : bool = True, reduction_type : str = "sum") -> None:
+  def __init__(self, channels_out: int, graph_filter: Union[graph,Tuple[str,int],None] = None, out_order: Optional[int] = None, bias : bool = True, reduction_type : str = "sum", checkpoint: CheckpointPolicy = False) -> None:
     r"""
     reduction_types: "sum" and "mean"
     leave 'out_order' as 'None' to keep same as input (NOTE: cannot leave as default if input is of order 0.)
     """
-    super().__init__(channels_out,out_order,bias,reduction_type)
+    super().__init__(channels_out,out_order,bias,reduction_type,checkpoint)
     assert out_order != 0
     if isinstance(graph_filter,tuple):
       graph_filter = generate_generic_shape(*graph_filter)
@@ -311,22 +415,23 @@ class LazySubstructureTransport(LazyUnite):
       return None
     return super().forward(features,domain_map.forward_map) # type: ignore
 class Transfer(torch.nn.Module):
-  def __init__(self, in_channels: int, channels_out: int, in_order: Literal[0,1,2], out_order: Literal[0,1,2], reduction_type : Literal['mean','sum'] = "sum", bias : bool = True) -> None:
+  def __init__(self, in_channels: int, channels_out: int, in_order: Literal[0,1,2], out_order: Literal[0,1,2], reduction_type : Literal['mean','sum'] = "sum", bias : bool = True, checkpoint: CheckpointPolicy = False) -> None:
     super().__init__()
     self.lin = Linear(in_channels * _get_mult_factor(in_order,out_order),channels_out,bias)
     self.use_mean = reduction_type == "mean"
     self.transfer = [ptens.transfer0,ptens.transfer1,ptens.transfer2][out_order]
+    self.orders = (in_order,out_order)
+    self.checkpoint = checkpoint
   def reset_parameters(self):
     self.lin.reset_parameters()
   def forward(self, features: Union[ptensors0,ptensors1,ptensors2], target_domains: Union[List[List[int]],atomspack], graph: graph) -> Union[ptensors0,ptensors1,ptensors2]:
-    F = self.transfer(features,target_domains, graph, self.use_mean)
-    F = self.lin(F)
-    return F
+    return checkpointed(self,lambda x: self.lin(self.transfer(x,target_domains,graph,self.use_mean)),features,self.orders)
 class LazyTransfer(torch.nn.Module):
-  def __init__(self, channels_out: Optional[int] = None, reduction_type : str = "sum", out_order: Optional[int] = None, bias : bool = True) -> None:
+  def __init__(self, channels_out: Optional[int] = None, reduction_type : str = "sum", out_order: Optional[int] = None, bias : bool = True, checkpoint: CheckpointPolicy = False) -> None:
     r"""
     reduction_types: "sum" and "mean"
     leave 'out_order' and 'channels_out' as 'None' to keep same as input
+    checkpoint: recompute the transferred layer during backward instead of keeping it (see 'checkpointed')
     """
     super().__init__()
     assert reduction_type == "sum" or reduction_type == "mean"
@@ -335,6 +440,8 @@ class LazyTransfer(torch.nn.Module):
     self.use_mean = reduction_type == "mean"
     self.out_order = out_order
     self.transfer = None
+    self.orders = None
+    self.checkpoint = checkpoint
   def forward(self, features: Union[ptensors0,ptensors1,ptensors2], target_domains: Union[List[List[int]],atomspack], graph: graph) -> Union[ptensors0,ptensors1,ptensors2]:
     if self.transfer is None:
       if self.lin.out_channels is None:
@@ -357,16 +464,15 @@ class LazyTransfer(torch.nn.Module):
       if in_order == 0:
         q = self.transfer
         self.transfer = lambda x,t,G,n: q(x,G,n)
-    F = self.transfer(features,target_domains, graph, self.use_mean)
-    F = self.lin(F)
-    return F
+      self.orders = (in_order,out_order)
+    return checkpointed(self,lambda x: self.lin(self.transfer(x,target_domains,graph,self.use_mean)),features,self.orders)
 class LazyTransferNHoods(LazyTransfer):
-  def __init__(self, num_hops: int, channels_out: Optional[int] = None, reduction_type : str = "sum", out_order: Optional[int] = None, bias : bool = True) -> None:
+  def __init__(self, num_hops: int, channels_out: Optional[int] = None, reduction_type : str = "sum", out_order: Optional[int] = None, bias : bool = True, checkpoint: CheckpointPolicy = False) -> None:
     r"""
     reduction_types: "sum" and "mean"
     leave 'out_order' as 'None' to keep same as input
     """
-    super().__init__(channels_out,reduction_type,out_order,bias)
+    super().__init__(channels_out,reduction_type,out_order,bias,checkpoint)
     self.num_hops = num_hops
   def forward(self, features: Union[ptensors0,ptensors1,ptensors2], graph: graph) -> Union[ptensors0,ptensors1,ptensors2]:
     return super().forward(features,graph.nhoods(self.num_hops),graph)
@@ -20,6 +20,7 @@ from ptens.utility import device_id as device_id
 import ptens.ptensor0
 import ptens.ptensors1
 import ptens.ptensors2 
+import ptens.ptensorsh
 
 
 class ptensors0(torch.Tensor):
@@ -114,6 +115,12 @@ class ptensors0(torch.Tensor):
     def to(self, device='cpu'):
         return Ptensors0_toFn.apply(self,device)
         #self.obj.to_device(ptens.device_id(device))
+
+    def to_dtype(self, dtype):
+        """Convert to a bfloat16 or float16 ptensorsh layer (for inference)."""
+        if dtype==torch.float32:
+            return self
+        return ptens.ptensorsh.ptensorsh.from_ptensors(self,dtype)
         
 
     # ---- Operations ----------------------------------------------------------------------------------------
@@ -128,6 +135,11 @@ class ptensors0(torch.Tensor):
     def linear(self,y,b):
         return Ptensors0_linearFn.apply(self,y,b)
 
+    def linear_act(self,y,b,alpha=0.5):
+        if self.get_dev()!=0:
+            return self.linear(y,b).relu(alpha)
+        return Ptensors0_linear_actFn.apply(self,y,b,alpha)
+
     def concat(self,y):
         return Ptensors0_concatFn.apply(self,y)
 
@@ -218,6 +230,8 @@ class Ptensors0_fromMxFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         return ctx.r.get_grad().torch(), None
 
 
@@ -266,7 +280,10 @@ class Ptensors0_toFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.move_to_device_back(ctx.r.get_gradp(),ctx.dev)
+        ctx.r.free_grad()
         return ptensors0.dummy(), None
         
 
@@ -285,8 +302,10 @@ class Ptensors0_addFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_to_grad(ctx.r.get_gradp())
-        ctx.y.add_to_grad(ctx.r.get_gradp())
+        ctx.r.move_grad_to(ctx.y)
         return ptensors0.dummy(),ptensors0.dummy()
 
 
@@ -335,8 +354,11 @@ class Ptensors0_concatFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_concat_back(ctx.r,0)
         ctx.y.add_concat_back(ctx.r,ctx.x.get_nc())
+        ctx.r.free_grad()
         return ptensors0(1),ptensors0(1)
 
     
@@ -352,12 +374,15 @@ class Ptensors0_catFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         offs=0
         dummies=[]
         for x in ctx.args:
             x.add_cat_back(ctx.r,offs)
             offs=offs+len(x)
             dummies.append(ptensors1(1))
+        ctx.r.free_grad()
         return None, *dummies
 
 
@@ -371,10 +396,13 @@ class Ptensors0_sumFn(torch.autograd.Function):
         return r
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         dummies=[]
         for x in ctx.args:
             x.add_to_grad(ctx.r.get_gradp())
             dummies.append(ptensors0(1))
+        ctx.r.free_grad()
         return None, *dummies
 
 
@@ -388,7 +416,10 @@ class Ptensors0_averageFn(torch.autograd.Function):
         return r
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_average_back(ctx.r)
+        ctx.r.free_grad()
         return ptensors0(1)
 
 
@@ -405,8 +436,12 @@ class Ptensors0_mprodFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_mprod_back0(ctx.r.gradp(),ctx.y)
-        return ptensors0.dummy(), ctx.x.mprod_back1(ctx.r.gradp())
+        gy=ctx.x.mprod_back1(ctx.r.gradp())
+        ctx.r.free_grad()
+        return ptensors0.dummy(), gy
 
 
 class Ptensors0_mult_channelsFn(torch.autograd.Function):
@@ -422,7 +457,10 @@ class Ptensors0_mult_channelsFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_scale_channels_back0(ctx.r.gradp(),ctx.y)
+        ctx.r.free_grad()
         return ptensors0.dummy(), None
 
 
@@ -439,8 +477,12 @@ class Ptensors0_scaleFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_scale_back0(ctx.r.gradp(),ctx.y)
-        return ptensors0.dummy(), ctx.x.scale_back1(ctx.r.gradp())
+        gy=ctx.x.scale_back1(ctx.r.gradp())
+        ctx.r.free_grad()
+        return ptensors0.dummy(), gy
 
 
 class Ptensors0_linearFn(torch.autograd.Function):
@@ -456,8 +498,34 @@ class Ptensors0_linearFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_linear_back0(ctx.r.gradp(),ctx.y)
-        return ptensors0.dummy(), ctx.x.linear_back1(ctx.r.gradp()), ctx.x.linear_back2(ctx.r.gradp())
+        gy=ctx.x.linear_back1(ctx.r.gradp())
+        gb=ctx.x.linear_back2(ctx.r.gradp())
+        ctx.r.free_grad()
+        return ptensors0.dummy(), gy, gb
+
+
+class Ptensors0_linear_actFn(torch.autograd.Function):
+    
+    @staticmethod
+    def forward(ctx,x,y,b,alpha):
+        R=ptens.ptensors0.raw(x.obj.view_of_atoms(),y.size(1),x.obj.get_dev())
+        ctx.mask=ptens_base.linear_leaky(R.obj,x.obj,y,b,alpha)
+        ctx.x=x.obj
+        ctx.y=y
+        ctx.alpha=alpha
+        ctx.r=R.obj
+        return R
+
+    @staticmethod
+    def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        gy,gb=ptens_base.add_linear_leaky_back(ctx.x,ctx.r.gradp(),ctx.y,ctx.alpha,ctx.mask)
+        ctx.r.free_grad()
+        return ptensors0.dummy(), gy, gb, None
 
 
 
@@ -474,7 +542,9 @@ class Ptensors0_ReLUFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
-        ctx.x.add_ReLU_back(ctx.r.gradp(),ctx.alpha)
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        ctx.x.add_ReLU_back(ctx.r,ctx.alpha)
         return ptensors0.dummy(), None
 
 
@@ -492,7 +562,10 @@ class Ptensors0_Linmaps0Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.add_linmaps0to0_back(ctx.x.gradp(),ctx.r.gradp())
+        ctx.r.free_grad()
         return ptensors0.dummy()
 
 
@@ -508,7 +581,10 @@ class Ptensors0_Linmaps1Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.add_linmaps0to1_back(ctx.x.gradp(),ctx.r.gradp())
+        ctx.r.free_grad()
         return ptensors0.dummy()
 
 
@@ -524,7 +600,10 @@ class Ptensors0_Linmaps2Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.add_linmaps0to2_back(ctx.x.gradp(),ctx.r.gradp())
+        ctx.r.free_grad()
         return ptensors0.dummy()
 
 
@@ -542,7 +621,10 @@ class Ptensors0_Transfer0Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.add_msg_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors0.dummy(), None, None
 
 
@@ -560,7 +642,10 @@ class Ptensors0_Transfer1Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.add_msg_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors0.dummy(), None, None
 
 
@@ -578,7 +663,10 @@ class Ptensors0_Transfer2Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.add_msg_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors0.dummy(), None, None
 
 
@@ -595,7 +683,10 @@ class Ptensors0_Unite1Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.unite0to1_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors0.dummy(), None
 
 
@@ -612,7 +703,10 @@ class Ptensors0_Unite2Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.unite0to2_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors0.dummy(), None
 
 
@@ -629,7 +723,10 @@ class Ptensors0_GatherFn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.gather_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors0.dummy(), None
 
 
@@ -646,8 +743,11 @@ class Ptensors0_Outer0Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.add_outer_back0(ctx.x.gradp(),ctx.r.gradp(),ctx.y)
         ptens_base.add_outer_back1(ctx.y.gradp(),ctx.r.gradp(),ctx.x)
+        ctx.r.free_grad()
         return ptensors0.dummy(), ptensors0.dummy()
 
 
@@ -664,8 +764,11 @@ class Ptensors0_Outer1Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.add_outer_back0(ctx.x.gradp(),ctx.r.gradp(),ctx.y)
         ptens_base.add_outer_back1(ctx.y.gradp(),ctx.r.gradp(),ctx.x)
+        ctx.r.free_grad()
         return ptensors0.dummy(), ptens.ptensors1.dummy()
 
 
@@ -682,8 +785,11 @@ class Ptensors0_Outer2Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.add_outer_back0(ctx.x.gradp(),ctx.r.gradp(),ctx.y)
         ptens_base.add_outer_back1(ctx.y.gradp(),ctx.r.gradp(),ctx.x)
+        ctx.r.free_grad()
         return ptensors0.dummy(), ptens.ptensors2.dummy()
 
 
@@ -19,6 +19,7 @@ from ptens.utility import device_id as device_id
 
 import ptens.ptensors0 
 import ptens.ptensors2 
+import ptens.ptensorsh
 
 
 class ptensors1(torch.Tensor):
@@ -118,6 +119,12 @@ class ptensors1(torch.Tensor):
         return Ptensors1_toFn.apply(self,device)
         #self.obj.to_device(ptens.device_id(device))
 
+    def to_dtype(self, dtype):
+        """Convert to a bfloat16 or float16 ptensorsh layer (for inference)."""
+        if dtype==torch.float32:
+            return self
+        return ptens.ptensorsh.ptensorsh.from_ptensors(self,dtype)
+
 
     # ---- Operations ----------------------------------------------------------------------------------------
 
@@ -131,6 +138,11 @@ class ptensors1(torch.Tensor):
     def linear(self,y,b):
         return Ptensors1_linearFn.apply(self,y,b)
 
+    def linear_act(self,y,b,alpha=0.5):
+        if self.get_dev()!=0:
+            return self.linear(y,b).relu(alpha)
+        return Ptensors1_linear_actFn.apply(self,y,b,alpha)
+
     def concat(self,y):
         return Ptensors1_concatFn.apply(self,y)
     
@@ -213,6 +225,8 @@ class Ptensors1_fromMxFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         return ctx.r.get_grad().torch(), None
 
 
@@ -238,6 +252,8 @@ class Ptensors1_likeFn(torch.autograd.Function):
         return r
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         return None, ctx.r.get_grad().torch()
 
 
@@ -272,7 +288,10 @@ class Ptensors1_toFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.move_to_device_back(ctx.r.get_gradp(),ctx.dev)
+        ctx.r.free_grad()
         return ptensors1.dummy(), None
         
     
@@ -290,8 +309,10 @@ class Ptensors1_addFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_to_grad(ctx.r.get_gradp())
-        ctx.y.add_to_grad(ctx.r.get_gradp())
+        ctx.r.move_grad_to(ctx.y)
         return ptensors1(1),ptensors1(1)
 
 
@@ -308,7 +329,9 @@ class Ptensors1_ReLUFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
-        ctx.x.add_ReLU_back(ctx.r.gradp(),ctx.alpha)
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        ctx.x.add_ReLU_back(ctx.r,ctx.alpha)
         return ptensors1.dummy(), None
 
 
@@ -357,8 +380,11 @@ class Ptensors1_concatFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_concat_back(ctx.r,0)
         ctx.y.add_concat_back(ctx.r,ctx.x.get_nc())
+        ctx.r.free_grad()
         return ptensors1(1),ptensors1(1)
 
 
@@ -374,12 +400,15 @@ class Ptensors1_catFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         offs=0
         dummies=[]
         for x in ctx.args:
             x.add_cat_back(ctx.r,offs)
             offs=offs+len(x)
             dummies.append(ptensors1(1))
+        ctx.r.free_grad()
         return None, *dummies
 
 
@@ -393,10 +422,13 @@ class Ptensors1_sumFn(torch.autograd.Function):
         return r
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         dummies=[]
         for x in ctx.args:
             x.add_to_grad(ctx.r.get_gradp())
             dummies.append(ptensors1(1))
+        ctx.r.free_grad()
         return None, *dummies
 
 
@@ -413,8 +445,12 @@ class Ptensors1_mprodFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_mprod_back0(ctx.r.gradp(),ctx.y)
-        return ptensors1(1), ctx.x.mprod_back1(ctx.r.gradp())
+        gy=ctx.x.mprod_back1(ctx.r.gradp())
+        ctx.r.free_grad()
+        return ptensors1(1), gy
 
 
 class Ptensors1_linearFn(torch.autograd.Function):
@@ -430,8 +466,34 @@ class Ptensors1_linearFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_linear_back0(ctx.r.gradp(),ctx.y)
-        return ptensors1.dummy(), ctx.x.linear_back1(ctx.r.gradp()), ctx.x.linear_back2(ctx.r.gradp())
+        gy=ctx.x.linear_back1(ctx.r.gradp())
+        gb=ctx.x.linear_back2(ctx.r.gradp())
+        ctx.r.free_grad()
+        return ptensors1.dummy(), gy, gb
+
+
+class Ptensors1_linear_actFn(torch.autograd.Function):
+    
+    @staticmethod
+    def forward(ctx,x,y,b,alpha):
+        R=ptens.ptensors1.raw(x.obj.view_of_atoms(),y.size(1),x.obj.get_dev())
+        ctx.mask=ptens_base.linear_leaky(R.obj,x.obj,y,b,alpha)
+        ctx.x=x.obj
+        ctx.y=y
+        ctx.alpha=alpha
+        ctx.r=R.obj
+        return R
+
+    @staticmethod
+    def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        gy,gb=ptens_base.add_linear_leaky_back(ctx.x,ctx.r.gradp(),ctx.y,ctx.alpha,ctx.mask)
+        ctx.r.free_grad()
+        return ptensors1.dummy(), gy, gb, None
 
 
 class Ptensors1_scaleFn(torch.autograd.Function):
@@ -447,8 +509,12 @@ class Ptensors1_scaleFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_scale_back0(ctx.r.gradp(),ctx.y)
-        return ptensors0.dummy(), ctx.x.scale_back1(ctx.r.gradp())
+        gy=ctx.x.scale_back1(ctx.r.gradp())
+        ctx.r.free_grad()
+        return ptensors0.dummy(), gy
 
 
 class Ptensors1_mult_channelsFn(torch.autograd.Function):
@@ -464,7 +530,10 @@ class Ptensors1_mult_channelsFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_scale_channels_back0(ctx.r.gradp(),ctx.y)
+        ctx.r.free_grad()
         return ptensors1.dummy(), None
 
 
@@ -484,10 +553,13 @@ class Ptensors1_Linmaps0Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.add_linmaps1to0_back_n(ctx.x.gradp(),ctx.r.gradp())
         else:
             ptens_base.add_linmaps1to0_back(ctx.x.gradp(),ctx.r.gradp())
+        ctx.r.free_grad()
         return ptensors1(1), None
 
 
@@ -504,10 +576,13 @@ class Ptensors1_Linmaps1Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.add_linmaps1to1_back_n(ctx.x.gradp(),ctx.r.gradp())
         else:
             ptens_base.add_linmaps1to1_back(ctx.x.gradp(),ctx.r.gradp())
+        ctx.r.free_grad()
         return ptensors1(1), None
 
 
@@ -527,10 +602,13 @@ class Ptensors1_Linmaps2Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.add_linmaps1to2_back_n(ctx.x.gradp(),ctx.r.gradp())
         else:
             ptens_base.add_linmaps1to2_back(ctx.x.gradp(),ctx.r.gradp())
+        ctx.r.free_grad()
         return ptensors1(1), None
 
 
@@ -551,10 +629,13 @@ class Ptensors1_Transfer0Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.add_msg_back_n(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
         else:
             ptens_base.add_msg_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors1.dummy(), None, None, None
 
 
@@ -575,10 +656,13 @@ class Ptensors1_Transfer1Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.add_msg_back_n(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
         else:
             ptens_base.add_msg_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors1.dummy(), None, None, None
 
 
@@ -599,10 +683,13 @@ class Ptensors1_Transfer2Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.add_msg_back_n(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
         else:
             ptens_base.add_msg_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors1.dummy(), None, None, None
 
 
@@ -624,10 +711,13 @@ class Ptensors1_Unite1Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.unite1to1_back_n(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
         else:
             ptens_base.unite1to1_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors1.dummy(), None, None 
 
 
@@ -648,10 +738,13 @@ class Ptensors1_Unite2Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.unite1to2_back_n(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
         else:
             ptens_base.unite1to2_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors1.dummy(), None, None
 
 
@@ -668,8 +761,11 @@ class Ptensors1_Outer0Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.add_outer_back0(ctx.x.gradp(),ctx.r.gradp(),ctx.y)
         ptens_base.add_outer_back1(ctx.y.gradp(),ctx.r.gradp(),ctx.x)
+        ctx.r.free_grad()
         return ptensors1.dummy(), ptens.ptensors0.dummy()
 
 
@@ -686,8 +782,11 @@ class Ptensors1_Outer1Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.add_outer_back0(ctx.x.gradp(),ctx.r.gradp(),ctx.y)
         ptens_base.add_outer_back1(ctx.y.gradp(),ctx.r.gradp(),ctx.x)
+        ctx.r.free_grad()
         return ptensors1.dummy(), ptensors1.dummy()
 
 
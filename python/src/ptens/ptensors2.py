@@ -19,6 +19,8 @@ from ptens.utility import device_id as device_id
 
 import ptens.ptensors0 
 import ptens.ptensors1 
+import ptens.ptensorsh
+import ptens.ptensors2sym
 
 
 class ptensors2(torch.Tensor):
@@ -114,6 +116,16 @@ class ptensors2(torch.Tensor):
         return Ptensors2_toFn.apply(self,device)
         #self.obj.to_device(ptens.device_id(_device))
 
+    def to_dtype(self, dtype):
+        """Convert to a bfloat16 or float16 ptensorsh layer (for inference)."""
+        if dtype==torch.float32:
+            return self
+        return ptens.ptensorsh.ptensorsh.from_ptensors(self,dtype)
+
+    def symmetric(self):
+        """Convert to a ptensors2sym layer holding the symmetric part in upper triangular storage."""
+        return ptens.ptensors2sym.ptensors2sym.from_ptensors(self)
+
 
     # ---- Operations ----------------------------------------------------------------------------------------
 
@@ -127,6 +139,11 @@ class ptensors2(torch.Tensor):
     def linear(self,y,b):
         return Ptensors2_linearFn.apply(self,y,b)
 
+    def linear_act(self,y,b,alpha=0.5):
+        if self.get_dev()!=0:
+            return self.linear(y,b).relu(alpha)
+        return Ptensors2_linear_actFn.apply(self,y,b,alpha)
+
     def concat(self,y):
         return Ptensors2_concatFn.apply(self,y)
 
@@ -204,6 +221,8 @@ class Ptensors2_fromMxFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         return ctx.r.get_grad().torch(), None
 
 
@@ -252,7 +271,10 @@ class Ptensors2_toFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.move_to_device_back(ctx.r.get_gradp(),ctx.dev)
+        ctx.r.free_grad()
         return ptensors2.dummy(), None
         
 
@@ -270,8 +292,10 @@ class Ptensors2_addFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_to_grad(ctx.r.get_gradp())
-        ctx.y.add_to_grad(ctx.r.get_gradp())
+        ctx.r.move_grad_to(ctx.y)
         return ptensors2(1),ptensors2(1)
 
 
@@ -288,7 +312,9 @@ class Ptensors2_ReLUFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
-        ctx.x.add_ReLU_back(ctx.r.gradp(),ctx.alpha)
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        ctx.x.add_ReLU_back(ctx.r,ctx.alpha)
         return ptensors2.dummy(), None
 
 
@@ -337,8 +363,11 @@ class Ptensors2_concatFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_concat_back(ctx.r,0)
         ctx.y.add_concat_back(ctx.r,ctx.x.get_nc())
+        ctx.r.free_grad()
         return ptensors2(1),ptensors2(1)
 
 
@@ -354,12 +383,15 @@ class Ptensors2_catFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         offs=0
         dummies=[]
         for x in ctx.args:
             x.add_cat_back(ctx.r,offs)
             offs=offs+len(x)
             dummies.append(ptensors1(1))
+        ctx.r.free_grad()
         return None, *dummies
 
 
@@ -373,10 +405,13 @@ class Ptensors0_sumFn(torch.autograd.Function):
         return r
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         dummies=[]
         for x in ctx.args:
             x.add_to_grad(ctx.r.get_gradp())
             dummies.append(ptensors2(1))
+        ctx.r.free_grad()
         return None, *dummies
 
 
@@ -393,8 +428,12 @@ class Ptensors2_mprodFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_mprod_back0(ctx.r.gradp(),ctx.y)
-        return ptens.ptensors1(2), ctx.x.mprod_back1(ctx.r.gradp())
+        gy=ctx.x.mprod_back1(ctx.r.gradp())
+        ctx.r.free_grad()
+        return ptens.ptensors1(2), gy
 
 
 class Ptensors2_scaleFn(torch.autograd.Function):
@@ -410,8 +449,12 @@ class Ptensors2_scaleFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_scale_back0(ctx.r.gradp(),ctx.y)
-        return ptensors2.dummy(), ctx.x.scale_back1(ctx.r.gradp())
+        gy=ctx.x.scale_back1(ctx.r.gradp())
+        ctx.r.free_grad()
+        return ptensors2.dummy(), gy
 
 
 class Ptensors2_mult_channelsFn(torch.autograd.Function):
@@ -427,7 +470,10 @@ class Ptensors2_mult_channelsFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_scale_channels_back0(ctx.r.gradp(),ctx.y)
+        ctx.r.free_grad()
         return ptensors2.dummy(), None
 
 
@@ -444,8 +490,34 @@ class Ptensors2_linearFn(torch.autograd.Function):
 
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ctx.x.add_linear_back0(ctx.r.gradp(),ctx.y)
-        return ptensors2.dummy(), ctx.x.linear_back1(ctx.r.gradp()), ctx.x.linear_back2(ctx.r.gradp())
+        gy=ctx.x.linear_back1(ctx.r.gradp())
+        gb=ctx.x.linear_back2(ctx.r.gradp())
+        ctx.r.free_grad()
+        return ptensors2.dummy(), gy, gb
+
+
+class Ptensors2_linear_actFn(torch.autograd.Function):
+    
+    @staticmethod
+    def forward(ctx,x,y,b,alpha):
+        R=ptens.ptensors2.raw(x.obj.view_of_atoms(),y.size(1),x.obj.get_dev())
+        ctx.mask=ptens_base.linear_leaky(R.obj,x.obj,y,b,alpha)
+        ctx.x=x.obj
+        ctx.y=y
+        ctx.alpha=alpha
+        ctx.r=R.obj
+        return R
+
+    @staticmethod
+    def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        gy,gb=ptens_base.add_linear_leaky_back(ctx.x,ctx.r.gradp(),ctx.y,ctx.alpha,ctx.mask)
+        ctx.r.free_grad()
+        return ptensors2.dummy(), gy, gb, None
 
 
 class Ptensors2_Linmaps0Fn(torch.autograd.Function):
@@ -464,10 +536,13 @@ class Ptensors2_Linmaps0Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.add_linmaps2to0_back_n(ctx.x.gradp(),ctx.r.gradp())
         else:
             ptens_base.add_linmaps2to0_back(ctx.x.gradp(),ctx.r.gradp())
+        ctx.r.free_grad()
         return ptensors2(1), None
 
 
@@ -487,10 +562,13 @@ class Ptensors2_Linmaps1Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.add_linmaps2to1_back_n(ctx.x.gradp(),ctx.r.gradp())
         else:
             ptens_base.add_linmaps2to1_back(ctx.x.gradp(),ctx.r.gradp())
+        ctx.r.free_grad()
         return ptensors2(1), None
 
 
@@ -510,10 +588,13 @@ class Ptensors2_Linmaps2Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.add_linmaps2to2_back_n(ctx.x.gradp(),ctx.r.gradp())
         else:
             ptens_base.add_linmaps2to2_back(ctx.x.gradp(),ctx.r.gradp())
+        ctx.r.free_grad()
         return ptensors2(1), None
 
 
@@ -535,10 +616,13 @@ class Ptensors2_Transfer0Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.add_msg_back_n(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
         else:
             ptens_base.add_msg_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors2.dummy(), None, None, None
 
 
@@ -560,10 +644,13 @@ class Ptensors2_Transfer1Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.add_msg_back_n(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
         else:
             ptens_base.add_msg_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors2.dummy(), None, None, None
 
 
@@ -585,10 +672,13 @@ class Ptensors2_Transfer2Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.add_msg_back_n(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
         else:
             ptens_base.add_msg_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors2.dummy(), None, None, None
 
 
@@ -609,10 +699,13 @@ class Ptensors2_Unite1Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.unite2to1_back_n(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
         else:
             ptens_base.unite2to1_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors2.dummy(), None, None
 
 
@@ -633,10 +726,13 @@ class Ptensors2_Unite2Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         if(ctx.normalized):
             ptens_base.unite2to2_back_n(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
         else:
             ptens_base.unite2to2_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G)
+        ctx.r.free_grad()
         return ptensors2.dummy(), None, None
 
 
@@ -653,8 +749,11 @@ class Ptensors2_Outer0Fn(torch.autograd.Function):
         
     @staticmethod
     def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
         ptens_base.add_outer_back0(ctx.x.gradp(),ctx.r.gradp(),ctx.y)
         ptens_base.add_outer_back1(ctx.y.gradp(),ctx.r.gradp(),ctx.x)
+        ctx.r.free_grad()
         return ptensors2.dummy(), ptens.ptensors0.dummy()
 
 
@@ -0,0 +1,229 @@
+#
+# This file is part of ptens, a C++/CUDA library for permutation 
+# equivariant message passing. 
+#  
+# Copyright (c) 2023, Imre Risi Kondor
+#
+# This source code file is subject to the terms of the noncommercial 
+# license distributed with cnine in the file LICENSE.TXT. Commercial 
+# use is prohibited. All redistributed versions of this file (in 
+# original or modified form) must retain this copyright notice and 
+# must be accompanied by a verbatim copy of the license. 
+#
+#
+import torch
+
+import ptens_base
+from ptens_base import ptensors2sym as _ptensors2sym
+
+import ptens.ptensors0
+import ptens.ptensors1
+import ptens.ptensors2
+
+
+class ptensors2sym(torch.Tensor):
+    """Second order Ptensors layer that is symmetric in the two atom indices, storing only the
+    upper triangle of each ptensor. The layer lives on the host; its gradients are taken with
+    respect to the stored entries."""
+
+    @classmethod
+    def from_ptensors(self,x):
+        """The symmetric part (x+x^T)/2 of a ptensors2 layer."""
+        return Ptensors2sym_fromPtensors2Fn.apply(x)
+
+    def float(self):
+        return Ptensors2sym_toPtensors2Fn.apply(self)
+
+
+    # ---- Access --------------------------------------------------------------------------------------------
+
+
+    def get_grad(self):
+        R=ptensors2sym(1)
+        R.obj=self.obj.get_grad()
+        return R
+
+    def get_nc(self):
+        return self.obj.get_nc()
+
+    def get_atoms(self):
+        return self.obj.get_atoms()
+
+    def __len__(self):
+        return len(self.obj)
+
+    def memory_bytes(self):
+        return self.obj.memory_bytes()
+
+
+    # ---- Message passing -----------------------------------------------------------------------------------
+
+
+    def linmaps0(self,normalized=False):
+        return Ptensors2sym_Linmaps0Fn.apply(self,normalized)
+
+    def linmaps1(self,normalized=False):
+        return Ptensors2sym_Linmaps1Fn.apply(self,normalized)
+
+    def linmaps2(self,normalized=False):
+        """The 9*nc channel symmetric part of the linmaps, as another symmetric layer."""
+        return Ptensors2sym_Linmaps2Fn.apply(self,normalized)
+
+    def transfer0(self,_atoms,G,normalized=False):
+        return Ptensors2sym_Transfer0Fn.apply(self,_atoms,G,normalized)
+
+    def transfer1(self,_atoms,G,normalized=False):
+        return Ptensors2sym_Transfer1Fn.apply(self,_atoms,G,normalized)
+
+
+    # ---- I/O -----------------------------------------------------------------------------------------------
+
+
+    def __repr__(self):
+        return self.obj.__repr__()
+
+    def __str__(self):
+        return self.obj.__str__()
+
+
+# ------------------------------------------------------------------------------------------------------------
+
+
+class Ptensors2sym_fromPtensors2Fn(torch.autograd.Function):
+
+    @staticmethod
+    def forward(ctx,x):
+        R=ptensors2sym(1)
+        R.obj=_ptensors2sym(x.obj)
+        ctx.x=x.obj
+        ctx.r=R.obj
+        return R
+
+    @staticmethod
+    def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        ctx.r.gradp().add_symmetrize_back(ctx.x.gradp())
+        ctx.r.free_grad()
+        return ptens.ptensors2.ptensors2.dummy()
+
+
+class Ptensors2sym_toPtensors2Fn(torch.autograd.Function):
+
+    @staticmethod
+    def forward(ctx,x):
+        R=ptens.ptensors2.ptensors2(1)
+        R.obj=x.obj.ptensors2()
+        ctx.x=x.obj
+        ctx.r=R.obj
+        return R
+
+    @staticmethod
+    def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        ctx.x.gradp().add_ptensors2_back(ctx.r.gradp())
+        ctx.r.free_grad()
+        return ptensors2sym(1)
+
+
+class Ptensors2sym_Linmaps0Fn(torch.autograd.Function):
+
+    @staticmethod
+    def forward(ctx,x,normalized=False):
+        R=ptens.ptensors0.ptensors0(1)
+        R.obj=x.obj.linmaps0(normalized)
+        ctx.normalized=normalized
+        ctx.x=x.obj
+        ctx.r=R.obj
+        return R
+
+    @staticmethod
+    def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        ctx.x.gradp().add_linmaps0_back(ctx.r.gradp(),ctx.normalized)
+        ctx.r.free_grad()
+        return ptensors2sym(1), None
+
+
+class Ptensors2sym_Linmaps1Fn(torch.autograd.Function):
+
+    @staticmethod
+    def forward(ctx,x,normalized=False):
+        R=ptens.ptensors1.ptensors1(1)
+        R.obj=x.obj.linmaps1(normalized)
+        ctx.normalized=normalized
+        ctx.x=x.obj
+        ctx.r=R.obj
+        return R
+
+    @staticmethod
+    def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        ctx.x.gradp().add_linmaps1_back(ctx.r.gradp(),ctx.normalized)
+        ctx.r.free_grad()
+        return ptensors2sym(1), None
+
+
+class Ptensors2sym_Linmaps2Fn(torch.autograd.Function):
+
+    @staticmethod
+    def forward(ctx,x,normalized=False):
+        R=ptensors2sym(1)
+        R.obj=x.obj.linmaps2(normalized)
+        ctx.normalized=normalized
+        ctx.x=x.obj
+        ctx.r=R.obj
+        return R
+
+    @staticmethod
+    def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        ctx.x.gradp().add_linmaps2_back(ctx.r.gradp(),ctx.normalized)
+        ctx.r.free_grad()
+        return ptensors2sym(1), None
+
+
+class Ptensors2sym_Transfer0Fn(torch.autograd.Function):
+
+    @staticmethod
+    def forward(ctx,x,atoms,G,normalized=False):
+        R=ptens.ptensors0.ptensors0.zeros(atoms,x.obj.get_nc()*2)
+        ptens_base.add_msg(R.obj,x.obj,G.obj,normalized)
+        ctx.normalized=normalized
+        ctx.x=x.obj
+        ctx.r=R.obj
+        ctx.G=G.obj
+        return R
+
+    @staticmethod
+    def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        ptens_base.add_msg_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G,ctx.normalized)
+        ctx.r.free_grad()
+        return ptensors2sym(1), None, None, None
+
+
+class Ptensors2sym_Transfer1Fn(torch.autograd.Function):
+
+    @staticmethod
+    def forward(ctx,x,atoms,G,normalized=False):
+        R=ptens.ptensors1.ptensors1.zeros(atoms,x.obj.get_nc()*4)
+        ptens_base.add_msg(R.obj,x.obj,G.obj,normalized)
+        ctx.normalized=normalized
+        ctx.x=x.obj
+        ctx.r=R.obj
+        ctx.G=G.obj
+        return R
+
+    @staticmethod
+    def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        ptens_base.add_msg_back(ctx.x.gradp(),ctx.r.gradp(),ctx.G,ctx.normalized)
+        ctx.r.free_grad()
+        return ptensors2sym(1), None, None, None
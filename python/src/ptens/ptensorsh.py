@@ -0,0 +1,117 @@
+#
+# This file is part of ptens, a C++/CUDA library for permutation 
+# equivariant message passing. 
+#  
+# Copyright (c) 2023, Imre Risi Kondor
+#
+# This source code file is subject to the terms of the noncommercial 
+# license distributed with cnine in the file LICENSE.TXT. Commercial 
+# use is prohibited. All redistributed versions of this file (in 
+# original or modified form) must retain this copyright notice and 
+# must be accompanied by a verbatim copy of the license. 
+#
+#
+import torch
+
+import ptens_base
+from ptens_base import ptensors_bf16 as _ptensors_bf16
+from ptens_base import ptensors_fp16 as _ptensors_fp16
+
+import ptens.ptensors0
+import ptens.ptensors1
+import ptens.ptensors2
+
+
+class ptensorsh:
+    """Ptensors layer stored in bfloat16 or float16 on the host. Linmaps and message passing read the
+    16 bit entries directly and accumulate in float32. These layers are meant for inference and do
+    not take part in autograd."""
+
+    def __init__(self,obj):
+        self.obj=obj
+
+    @classmethod
+    def from_ptensors(self,x,dtype=torch.bfloat16):
+        if dtype==torch.bfloat16:
+            return ptensorsh(_ptensors_bf16(x.obj))
+        if dtype==torch.float16:
+            return ptensorsh(_ptensors_fp16(x.obj))
+        raise ValueError("ptensorsh: unsupported dtype "+str(dtype))
+
+    @property
+    def dtype(self):
+        if isinstance(self.obj,_ptensors_bf16):
+            return torch.bfloat16
+        return torch.float16
+
+    def float(self):
+        k=self.obj.getk()
+        if k==0:
+            R=ptens.ptensors0.ptensors0(1)
+            R.obj=self.obj.ptensors0()
+        elif k==1:
+            R=ptens.ptensors1.ptensors1(1)
+            R.obj=self.obj.ptensors1()
+        else:
+            R=ptens.ptensors2.ptensors2(1)
+            R.obj=self.obj.ptensors2()
+        return R
+
+    def to_dtype(self,dtype):
+        if dtype==torch.float32:
+            return self.float()
+        if dtype==self.dtype:
+            return self
+        return ptensorsh.from_ptensors(self.float(),dtype)
+
+
+    # ---- Access --------------------------------------------------------------------------------------------
+
+
+    def getk(self):
+        return self.obj.getk()
+
+    def get_nc(self):
+        return self.obj.get_nc()
+
+    def get_atoms(self):
+        return self.obj.get_atoms()
+
+    def __len__(self):
+        return len(self.obj)
+
+    def memory_bytes(self):
+        return self.obj.memory_bytes()
+
+
+    # ---- Operations ----------------------------------------------------------------------------------------
+
+
+    def linmaps0(self,normalized=False):
+        return ptensorsh(self.obj.linmaps0(normalized))
+
+    def linmaps1(self,normalized=False):
+        return ptensorsh(self.obj.linmaps1(normalized))
+
+    def linmaps2(self,normalized=False):
+        return ptensorsh(self.obj.linmaps2(normalized))
+
+    def unite1(self,G,normalized=False):
+        return ptensorsh(self.obj.unite1(G.obj,normalized))
+
+    def unite2(self,G,normalized=False):
+        return ptensorsh(self.obj.unite2(G.obj,normalized))
+
+    def add_msg(self,x,G,offs=0,normalized=False):
+        self.obj.add_msg(x.obj,G.obj,offs,normalized)
+        return self
+
+
+    # ---- I/O -----------------------------------------------------------------------------------------------
+
+
+    def __repr__(self):
+        return self.obj.__repr__()
+
+    def __str__(self):
+        return self.obj.__str__()
@@ -0,0 +1,84 @@
+#
+# This file is part of ptens, a C++/CUDA library for permutation 
+# equivariant message passing. 
+#  
+# Copyright (c) 2023, Imre Risi Kondor
+#
+# This source code file is subject to the terms of the noncommercial 
+# license distributed with cnine in the file LICENSE.TXT. Commercial 
+# use is prohibited. All redistributed versions of this file (in 
+# original or modified form) must retain this copyright notice and 
+# must be accompanied by a verbatim copy of the license. 
+#
+#
+import torch
+
+import ptens_base
+from ptens_base import shared_engine as _shared_engine
+
+import ptens.ptensors0
+import ptens.ptensors1
+import ptens.ptensors2
+
+
+class shared_engine:
+    """Message passing over the graph G split into k parts, each handled by a persistent worker
+    process on this node. The layers reach the workers through POSIX shared memory. The workers
+    are forked when the engine starts, so it should be started (with start()) before torch
+    creates its thread pools, e.g., right after the graph is built."""
+
+    def __init__(self,G,k,pin=False,nthreads=-1):
+        self.obj=_shared_engine(G.obj,k,pin,nthreads)
+
+    def start(self):
+        self.obj.start()
+        return self
+
+    def shutdown(self):
+        self.obj.shutdown()
+
+    def transfer0(self,x,atoms,normalized=False):
+        return SharedEngine_TransferFn.apply(x,self.obj,0,atoms,normalized)
+
+    def transfer1(self,x,atoms,normalized=False):
+        return SharedEngine_TransferFn.apply(x,self.obj,1,atoms,normalized)
+
+    def transfer2(self,x,atoms,normalized=False):
+        return SharedEngine_TransferFn.apply(x,self.obj,2,atoms,normalized)
+
+    def __repr__(self):
+        return self.obj.__repr__()
+
+    def __str__(self):
+        return self.obj.__str__()
+
+
+class SharedEngine_TransferFn(torch.autograd.Function):
+
+    @staticmethod
+    def forward(ctx,x,engine,k,atoms,normalized=False):
+        if not isinstance(atoms,ptens_base.atomspack):
+            atoms=ptens_base.atomspack(atoms)
+        if k==0:
+            R=ptens.ptensors0.ptensors0(1)
+            R.obj=engine.transfer0(x.obj,atoms,normalized)
+        elif k==1:
+            R=ptens.ptensors1.ptensors1(1)
+            R.obj=engine.transfer1(x.obj,atoms,normalized)
+        else:
+            R=ptens.ptensors2.ptensors2(1)
+            R.obj=engine.transfer2(x.obj,atoms,normalized)
+        ctx.normalized=normalized
+        ctx.engine=engine
+        ctx.dummy=type(x).dummy
+        ctx.x=x.obj
+        ctx.r=R.obj
+        return R
+
+    @staticmethod
+    def backward(ctx,g):
+        if not ctx.r.has_grad():
+            return (None,)*len(ctx.needs_input_grad)
+        ctx.engine.add_msg_back(ctx.x.gradp(),ctx.r.gradp(),ctx.normalized)
+        ctx.r.free_grad()
+        return ctx.dummy(), None, None, None, None
@@ -0,0 +1,57 @@
+import torch
+import ptens as p
+import pytest
+from ptens_base import atomspack
+from ptens.modules import Unite, Transfer, Linmaps
+
+
+class TestCheckpoint(object):
+
+    def run(self, module, M, atoms, fn, testvec=None):
+        M=M.clone().requires_grad_()
+        x=p.ptensors1.from_matrix(M,atoms)
+        z=fn(module,x)
+        if testvec is None:
+            testvec=z.randn_like()
+        loss=z.inp(testvec)
+        loss.backward(torch.tensor(1.0))
+        return z.torch().detach(), M.grad, module.lin.w.grad.clone(), module.lin.b.grad.clone(), testvec
+
+    def compare(self, plain, ckpt, M, atoms, fn):
+        ckpt.load_state_dict(plain.state_dict())
+        plain.checkpoint=False
+        ckpt.checkpoint=True
+        z0,xg0,wg0,bg0,testvec=self.run(plain,M,atoms,fn)
+        z1,xg1,wg1,bg1,_=self.run(ckpt,M,atoms,fn,testvec)
+        assert(torch.allclose(z0,z1,rtol=1e-5,atol=1e-6))
+        assert(torch.allclose(xg0,xg1,rtol=1e-5,atol=1e-6))
+        assert(torch.allclose(wg0,wg1,rtol=1e-5,atol=1e-6))
+        assert(torch.allclose(bg0,bg1,rtol=1e-5,atol=1e-6))
+
+
+    @pytest.mark.parametrize('nc', [1, 3])
+    def test_unite12(self, nc):
+        atoms=[[1,2],[2,3],[3]]
+        G=p.graph.randomd(3,0.6)
+        M=torch.randn(5,nc)
+        self.compare(Unite(nc,4,1,2),Unite(nc,4,1,2),M,atoms,lambda m,x: m(x,G))
+
+    @pytest.mark.parametrize('nc', [1, 3])
+    def test_transfer12(self, nc):
+        atoms=[[1,2],[2,3],[3]]
+        target=[[1,2,3],[3,5]]
+        G=p.graph.overlaps(atomspack(target),atomspack(atoms))
+        M=torch.randn(5,nc)
+        self.compare(Transfer(nc,4,1,2),Transfer(nc,4,1,2),M,atoms,lambda m,x: m(x,target,G))
+
+    @pytest.mark.parametrize('nc', [1, 3])
+    def test_linmaps12(self, nc):
+        atoms=[[1,2],[2,3],[3]]
+        M=torch.randn(5,nc)
+        self.compare(Linmaps(nc,4,1,2),Linmaps(nc,4,1,2),M,atoms,lambda m,x: m(x))
+
+    @pytest.mark.parametrize('nc', [1, 3])
+    def test_linmaps22(self, nc):
+        atoms=[[1,2],[2,3],[3]]
+        M=torch.randn(5,nc)
+        self.compare(Linmaps(5*nc,4,2,2),Linmaps(5*nc,4,2,2),M,atoms,lambda m,x: m(p.linmaps2(x)))
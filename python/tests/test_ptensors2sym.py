@@ -0,0 +1,48 @@
+import torch
+import ptens as p
+import pytest
+from ptens_base import atomspack
+
+class TestPtensors2sym(object):
+
+    def backprop(self,fn,_atoms,_nc):
+        x=p.ptensors2.randn(_atoms,_nc)
+        x.requires_grad_()
+        z=fn(x)
+        
+        testvec=z.randn_like()
+        loss=z.inp(testvec)
+        loss.backward(torch.tensor(1.0))
+        xgrad=x.get_grad()
+
+        xeps=p.ptensors2.randn(_atoms,_nc)
+        z=fn(x+xeps)
+        xloss=z.inp(testvec)
+        assert(torch.allclose(xloss-loss,xeps.inp(xgrad),rtol=1e-3, atol=1e-4))
+
+
+    @pytest.mark.parametrize('atoms', [[[1],[2],[6]],[[1],[2,5],[1,2,6]]])
+    @pytest.mark.parametrize('normalized', [False, True])
+    def test_linmaps0(self,atoms,normalized):
+        self.backprop(lambda x: x.symmetric().linmaps0(normalized),atoms,2)
+
+    @pytest.mark.parametrize('atoms', [[[1],[2],[6]],[[1],[2,3],[2,7,6]]])
+    @pytest.mark.parametrize('normalized', [False, True])
+    def test_linmaps1(self,atoms,normalized):
+        self.backprop(lambda x: x.symmetric().linmaps1(normalized),atoms,3)
+
+    @pytest.mark.parametrize('atoms', [[[1],[2],[6]],[[1],[2],[6,8,9]]])
+    def test_linmaps2(self,atoms):
+        self.backprop(lambda x: x.symmetric().linmaps2().float(),atoms,2)
+
+    @pytest.mark.parametrize('normalized', [False, True])
+    def test_transfer0(self,normalized):
+        atoms=[[1,2],[2,3,4],[4]]
+        G=p.graph.overlaps(atomspack(atoms),atomspack(atoms))
+        self.backprop(lambda x: x.symmetric().transfer0(atoms,G,normalized),atoms,2)
+
+    @pytest.mark.parametrize('normalized', [False, True])
+    def test_transfer1(self,normalized):
+        atoms=[[1,2],[2,3,4],[4]]
+        G=p.graph.overlaps(atomspack(atoms),atomspack(atoms))
+        self.backprop(lambda x: x.symmetric().transfer1(atoms,G,normalized),atoms,2)
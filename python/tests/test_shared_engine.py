@@ -0,0 +1,34 @@
+import torch
+import ptens as p
+import pytest
+
+
+class TestSharedEngine(object):
+
+    def run(self, M, atoms, fn, testvec=None):
+        M=M.clone().requires_grad_()
+        x=p.ptensors1.from_matrix(M,atoms)
+        z=fn(x)
+        if testvec is None:
+            testvec=z.randn_like()
+        loss=z.inp(testvec)
+        loss.backward(torch.tensor(1.0))
+        return z.torch().detach(), M.grad, testvec
+
+    @pytest.mark.parametrize('k', [1, 2, 3])
+    @pytest.mark.parametrize('order', [0, 1, 2])
+    def test_transfer(self, k, order):
+        n=8
+        nc=3
+        G=p.graph.random(n,0.4)
+        nh=G.nhoods(1)
+        atoms=[nh[i] for i in range(len(nh))]
+        M=torch.randn(sum(len(a) for a in atoms),nc)
+        engine=p.shared_engine(G,k).start()
+        plain=[lambda x: x.transfer0(atoms,G), lambda x: x.transfer1(atoms,G), lambda x: x.transfer2(atoms,G)][order]
+        shared=[engine.transfer0, engine.transfer1, engine.transfer2][order]
+        z0,xg0,testvec=self.run(M,atoms,plain)
+        z1,xg1,_=self.run(M,atoms,lambda x: shared(x,atoms),testvec)
+        engine.shutdown()
+        assert(torch.allclose(z0,z1,rtol=1e-5,atol=1e-5))
+        assert(torch.allclose(xg0,xg1,rtol=1e-5,atol=1e-5))